@@ -0,0 +1,53 @@
+#.rst:
+# FindZstd
+# --------
+#
+# Try to find the zstd compression library.
+#
+# This will define the following variables:
+#
+# ``Zstd_FOUND``
+#     True if zstd is available.
+#
+# ``Zstd_INCLUDE_DIRS``
+#     This should be passed to target_include_directories() if
+#     the target is not used for linking
+#
+# ``Zstd_LIBRARIES``
+#     This can be passed to target_link_libraries() instead of
+#     the ``Zstd::Zstd`` target
+#
+# If ``Zstd_FOUND`` is TRUE, the following imported target
+# will be available:
+#
+# ``Zstd::Zstd``
+#     The zstd library
+
+find_path(Zstd_INCLUDE_DIRS
+    NAMES zstd.h
+)
+
+find_library(Zstd_LIBRARIES
+    NAMES zstd zstd_static
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd
+    FOUND_VAR Zstd_FOUND
+    REQUIRED_VARS Zstd_INCLUDE_DIRS Zstd_LIBRARIES
+)
+
+if(Zstd_FOUND AND NOT TARGET Zstd::Zstd)
+    add_library(Zstd::Zstd UNKNOWN IMPORTED)
+    set_target_properties(Zstd::Zstd PROPERTIES
+        IMPORTED_LOCATION "${Zstd_LIBRARIES}"
+        INTERFACE_INCLUDE_DIRECTORIES "${Zstd_INCLUDE_DIRS}")
+endif()
+
+mark_as_advanced(Zstd_INCLUDE_DIRS Zstd_LIBRARIES)
+
+include(FeatureSummary)
+set_package_properties(Zstd PROPERTIES
+    URL "https://facebook.github.io/zstd/"
+    DESCRIPTION "Fast real-time compression algorithm"
+)
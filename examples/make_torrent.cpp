@@ -37,7 +37,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bencode.hpp"
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/create_torrent.hpp"
-#include "libtorrent/miniz.hpp"
 #include "libtorrent/hex.hpp"
 
 
@@ -298,10 +297,20 @@ int main(int argc_, char const* argv_[]) try
 		t.add_similar_torrent(s);
 
 	auto const num = t.num_pieces();
-	lt::set_piece_hashes(t, branch_path(full_path)
-		, [num] (lt::piece_index_t const p) {
-			std::cerr << "\r" << p << "/" << num;
-		});
+	auto const progress = [num] (lt::piece_index_t const p) {
+		std::cerr << "\r" << p << "/" << num;
+	};
+	if (!zip_web_seeds.empty()) {
+		for (std::string const& zs : zip_web_seeds)
+			t.add_zip_web_seed(zs);
+
+		std::string const zipoutpath = zip_output_path.empty()
+			? full_path + ".dat" : zip_output_path;
+		lt::set_piece_hashes_zip(t, branch_path(full_path), zipoutpath, progress);
+	}
+	else {
+		lt::set_piece_hashes(t, branch_path(full_path), progress);
+	}
 
 	std::cerr << "\n";
 	t.set_creator(creator_str.c_str());
@@ -316,84 +325,6 @@ int main(int argc_, char const* argv_[]) try
 
 	auto entry = t.generate();
 
-	if (!zip_web_seeds.empty()) {
-		auto& zipinfo_e = entry["zipinfo"];
-		if (zip_web_seeds.size() > 1) {
-			std::vector<libtorrent::entry> seeds;
-			for (auto&& url : zip_web_seeds)
-			{
-				seeds.push_back(url);
-			}
-
-			zipinfo_e["url-list"] = seeds;
-		}
-		else if (!zip_web_seeds.empty()) {
-			zipinfo_e["url-list"] = zip_web_seeds[0];
-		}
-		
-		std::string zipoutpath(full_path + ".dat");
-		if (!zip_output_path.empty()) {
-			zipoutpath = zip_output_path;
-		}
-		std::ofstream zipfile(zipoutpath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
-		if (!zipfile.is_open()) {
-			std::cerr << "zip output file open filed." << std::endl;
-			return 1;
-		}
-
-		std::string pieces_buffer;
-		std::string pieces_zip_buf;
-		mz_ulong pieces_zip_size = 0;
-		uint32_t net_size = 0;
-		uint64_t total_zip_size = 0;
-		int zip_level = MZ_HUFFMAN_ONLY;
-
-		std::stringstream ss;
-		for (int i = 0; i < t.files().num_pieces(); ++i)
-		{
-			pieces_zip_size = 0;
-			pieces_buffer.clear();
-			pieces_zip_buf.clear();
-			auto index = libtorrent::piece_index_t(i);
-			auto file_slices = t.files().map_block(index, 0, t.files().piece_size(index));
-			for (auto&& slice : file_slices)
-			{
-				auto filePath = t.files().file_path(slice.file_index, full_path, false);
-				std::ifstream slicefile(filePath.c_str(), std::ios::in | std::ios::binary);
-				if (slicefile.is_open() == false)
-				{
-					std::cerr << "open file failed, " << filePath;
-					return 1;
-				}
-				auto pre_buf_len = pieces_buffer.length();
-				pieces_buffer.resize(pre_buf_len + slice.size);
-				slicefile.seekg(slice.offset);
-				slicefile.read((char*)(pieces_buffer.data() + pre_buf_len), slice.size);
-			}
-			//auto _sha1_ctx = lt::hasher();
-			//_sha1_ctx.update(pieces_buffer.data(), pieces_buffer.size());
-			//auto hash = lt::aux::to_hex(_sha1_ctx.final());
-			pieces_zip_size = pieces_buffer.length() * 2;
-			pieces_zip_buf.reserve(pieces_zip_size);
-			auto ret = mz_compress2((unsigned char*)pieces_zip_buf.data(), &pieces_zip_size,
-				(const unsigned char*)pieces_buffer.c_str(), pieces_buffer.length(), zip_level);
-			if (ret != MZ_OK) {
-				std::cerr << "zip piece failed, index: " << i << " err: " << ret;
-				return 1;
-			}
-			net_size = libtorrent::aux::host_to_network(uint32_t(pieces_zip_size));
-			zipfile.write(pieces_zip_buf.c_str(), pieces_zip_size);
-			ss.write((char*)&net_size, sizeof(net_size));
-
-			total_zip_size += pieces_zip_size;
-		}
-		zipfile.close();
-		zipinfo_e["total size"] = total_zip_size;
-		zipinfo_e["level"] = zip_level;
-		zipinfo_e["pieces size"] = ss.str();
-	}
-	
-
 	// create the torrent and print it to stdout
 	std::vector<char> torrent;
 	lt::bencode(back_inserter(torrent), entry);
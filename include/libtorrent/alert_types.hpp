@@ -97,7 +97,7 @@ namespace libtorrent {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 98;
+	constexpr int num_alert_types = 99;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -2955,6 +2955,44 @@ TORRENT_VERSION_NAMESPACE_3
 		operation_t op;
 	};
 
+	// This alert is posted instead of state_update_alert by
+	// session::post_torrent_updates(), when settings_pack::compact_state_updates
+	// is enabled. Rather than a full torrent_status, each torrent that was
+	// updated gets a compact record of the fields that changed since the
+	// previous state_delta_alert. Torrents whose status didn't change in any
+	// of the fields covered by torrent_status_delta are left out. The
+	// strings are only included when they change.
+	struct TORRENT_EXPORT state_delta_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT state_delta_alert(aux::stack_allocator& alloc
+			, span<torrent_status_delta const> d, string_view strings);
+
+		TORRENT_DEFINE_ALERT_PRIO(state_delta_alert, 98, alert_priority::high)
+
+		static constexpr alert_category_t static_category = alert_category::status;
+		std::string message() const override;
+
+		// the records of the torrents whose status changed. They can be
+		// mapped to torrents by torrent_handle::id().
+		span<torrent_status_delta const> deltas() const;
+
+		// the torrent's name, save path and current tracker, if they
+		// changed (i.e. if ``name_field``, ``save_path_field`` or
+		// ``tracker_field`` is set in the record). Otherwise nullptr.
+		char const* name(torrent_status_delta const& d) const;
+		char const* save_path(torrent_status_delta const& d) const;
+		char const* current_tracker(torrent_status_delta const& d) const;
+
+	private:
+		char const* string_at(int offset) const;
+
+		std::reference_wrapper<aux::stack_allocator const> m_alloc;
+		aux::allocation_slot m_deltas_idx;
+		aux::allocation_slot m_strings_idx;
+		int const m_num_deltas;
+	};
+
 TORRENT_VERSION_NAMESPACE_3_END
 
 	// internal
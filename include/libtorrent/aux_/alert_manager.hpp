@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/stack_allocator.hpp"
 #include "libtorrent/alert_types.hpp" // for abi_alert_count
 #include "libtorrent/aux_/array.hpp"
+#include "libtorrent/assert.hpp"
 
 #include <functional>
 #include <utility> // for std::forward
@@ -48,6 +49,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <condition_variable>
 #include <atomic>
 #include <bitset>
+#include <cstdint>
+#include <thread> // for yield
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 #include "libtorrent/extensions.hpp"
@@ -68,33 +71,50 @@ namespace aux {
 
 		~alert_manager();
 
+		// posting alerts is lock-free. There is a single producer, the network
+		// thread, which never blocks on the client draining the queue. It only
+		// waits for wait_for_alert() to read the head of the queue, which is a
+		// handful of instructions. Other threads may only post alerts when the
+		// network thread isn't running. Returns false if the alert was
+		// dropped
 		template <class T, typename... Args>
-		void emplace_alert(Args&&... args) try
+		bool emplace_alert(Args&&... args) try
 		{
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-
-			heterogeneous_queue<alert>& queue = m_alerts[m_generation];
-
-			// don't add more than this number of alerts, unless it's a
-			// high priority alert, in which case we try harder to deliver it
-			// for high priority alerts, double the upper limit
-			if (queue.size() / (1 + static_cast<int>(T::priority)) >= m_queue_size_limit)
+			alert* a = nullptr;
+			bool first = false;
 			{
-				// record that we dropped an alert of this type
-				m_dropped.set(T::alert_type);
-				return;
+				producer_section s(*this);
+
+				heterogeneous_queue<alert>& queue = m_alerts[s.generation];
+
+				// don't add more than this number of alerts, unless it's a
+				// high priority alert, in which case we try harder to deliver it
+				// for high priority alerts, double the upper limit
+				if (queue.size() / (1 + static_cast<int>(T::priority))
+					>= m_queue_size_limit.load(std::memory_order_relaxed))
+				{
+					// record that we dropped an alert of this type
+					set_dropped(T::alert_type);
+					return false;
+				}
+
+				a = &queue.emplace_back<T>(
+					m_allocations[s.generation], std::forward<Args>(args)...);
+
+				// the first alert of a generation is what makes the queue
+				// non-empty to the client
+				first = queue.size() == 1;
+				if (first) m_pending[s.generation].store(true, std::memory_order_release);
 			}
 
-			T& alert = queue.emplace_back<T>(
-				m_allocations[m_generation], std::forward<Args>(args)...);
-
-			maybe_notify(&alert);
+			maybe_notify(a, first);
+			return true;
 		}
 		catch (std::bad_alloc const&)
 		{
 			// record that we dropped an alert of this type
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-			m_dropped.set(T::alert_type);
+			set_dropped(T::alert_type);
+			return false;
 		}
 
 		bool pending() const;
@@ -118,7 +138,8 @@ namespace aux {
 			return m_alert_mask;
 		}
 
-		int alert_queue_size_limit() const noexcept { return m_queue_size_limit; }
+		int alert_queue_size_limit() const noexcept
+		{ return m_queue_size_limit.load(std::memory_order_relaxed); }
 		int set_alert_queue_size_limit(int queue_size_limit_);
 
 		void set_notify_function(std::function<void()> const& fun);
@@ -129,21 +150,75 @@ namespace aux {
 
 	private:
 
-		void maybe_notify(alert* a);
-
-		// this mutex protects everything. Since it's held while executing user
-		// callbacks (the notify function and extension on_alert()) it must be
-		// recursive to support recursively post new alerts.
+		// flags in m_producer_seq. The remaining bits count the alerts posted
+		static constexpr std::uint32_t producer_active = 1;
+		static constexpr std::uint32_t consumer_reading = 2;
+		static constexpr std::uint32_t seq_step = 4;
+
+		// while the producer is writing to a generation, the producer_active
+		// bit is set in m_producer_seq. get_all() waits for it to change
+		// before handing that generation's alerts to the client, if the
+		// producer may have picked up the generation before it was swapped.
+		// The producer doesn't enter while wait_for_alert() holds the
+		// consumer_reading bit
+		struct producer_section
+		{
+			explicit producer_section(alert_manager& m)
+				: m_mgr(m)
+			{
+				std::uint32_t seq = m.m_producer_seq.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					// posting alerts from more than one thread at a time is not
+					// supported
+					TORRENT_ASSERT((seq & producer_active) == 0);
+					if (seq & consumer_reading)
+					{
+						std::this_thread::yield();
+						seq = m.m_producer_seq.load(std::memory_order_relaxed);
+						continue;
+					}
+					if (m.m_producer_seq.compare_exchange_weak(seq
+						, seq | producer_active, std::memory_order_seq_cst))
+						break;
+				}
+				m_seq = seq;
+				generation = m_mgr.m_generation.load(std::memory_order_seq_cst);
+			}
+			~producer_section()
+			{ m_mgr.m_producer_seq.store(m_seq + seq_step, std::memory_order_release); }
+			producer_section(producer_section const&) = delete;
+			producer_section& operator=(producer_section const&) = delete;
+
+			int generation;
+		private:
+			alert_manager& m_mgr;
+			std::uint32_t m_seq;
+		};
+
+		// returns the first alert in the producer's queue, or nullptr. The
+		// producer is kept out while reading it, since it may be growing the
+		// queue, which moves the alerts. Must be called with m_mutex held
+		alert* front_alert();
+
+		void maybe_notify(alert* a, bool first);
+		void set_dropped(int type) noexcept;
+
+		// this mutex is never taken by the producer, except when posting to an
+		// empty queue (to notify the client). It serializes the consumers and
+		// protects m_notify. Since it's held while executing the notify
+		// function, it must be recursive to support recursively posting new
+		// alerts.
 		mutable std::recursive_mutex m_mutex;
 		std::condition_variable_any m_condition;
 		std::atomic<alert_category_t> m_alert_mask;
-		int m_queue_size_limit;
+		std::atomic<int> m_queue_size_limit;
 
 		// a bitfield where each bit represents an alert type. Every time we drop
 		// an alert (because the queue is full or of some other error) we set the
 		// corresponding bit in this mask, to communicate to the client that it
 		// may have missed an update.
-		std::bitset<abi_alert_count> m_dropped;
+		aux::array<std::atomic<std::uint64_t>, (abi_alert_count + 63) / 64> m_dropped;
 
 		// this function (if set) is called whenever the number of alerts in
 		// the alert queue goes from 0 to 1. The client is expected to wake up
@@ -154,22 +229,30 @@ namespace aux {
 		std::function<void()> m_notify;
 
 		// this is either 0 or 1, it indicates which m_alerts and m_allocations
-		// the alert_manager is allowed to use right now. This is swapped when
+		// the producer is allowed to use right now. This is swapped when
 		// the client calls get_all(), at which point all of the alert objects
 		// passed to the client will be owned by libtorrent again, and reset.
-		int m_generation = 0;
+		std::atomic<int> m_generation{0};
+
+		// the producer_active and consumer_reading flags, and a count of the
+		// alerts posted. See producer_section
+		std::atomic<std::uint32_t> m_producer_seq{0};
 
 		// this is where all alerts are queued up. There are two heterogeneous
-		// queues to double buffer the thread access. The std::mutex in the alert
-		// manager gives exclusive access to m_alerts[m_generation] and
-		// m_allocations[m_generation] whereas the other copy is exclusively
-		// used by the client thread.
+		// queues to double buffer the thread access. The producer has exclusive
+		// access to m_alerts[m_generation] and m_allocations[m_generation]
+		// whereas the other copy is exclusively used by the client thread.
 		aux::array<heterogeneous_queue<alert>, 2> m_alerts;
 
 		// this is a stack where alerts can allocate variable length content,
 		// such as strings, to go with the alerts.
 		aux::array<stack_allocator, 2> m_allocations;
 
+		// whether any alert has been posted to each generation. This is how
+		// other threads can tell whether there are alerts pending, without
+		// touching the queue the producer is writing to
+		aux::array<std::atomic<bool>, 2> m_pending;
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		std::list<std::shared_ptr<plugin>> m_ses_extensions;
 #endif
@@ -68,8 +68,58 @@ namespace aux {
 #endif
 		}
 
+		chained_buffer(chained_buffer const&) = delete;
+		chained_buffer& operator=(chained_buffer const&) = delete;
+
+		// small messages that don't fit at the end of the last buffer are
+		// copied into a slab of this size, which is shared with the small
+		// messages following it. This saves an allocation for every message
+		// header in front of a disk buffer
+		static constexpr int slab_size = 4096 - 16;
+
+		// messages larger than this are not put in a slab
+		static constexpr int max_slab_message = 256;
+
 	private:
 
+		struct send_slab
+		{
+			// one reference for each buffer in the chain pointing into this
+			// slab, plus one held by the chained_buffer while this is the
+			// slab new messages are carved out of
+			int refs = 1;
+			char buf[slab_size];
+		};
+
+		static void release(send_slab* s)
+		{
+			TORRENT_ASSERT(s->refs > 0);
+			if (--s->refs == 0) delete s;
+		}
+
+		// the holder of buffers carved out of a slab
+		struct slab_ref
+		{
+			slab_ref(send_slab* s, char* b, int const l) noexcept
+				: m_slab(s), m_buf(b), m_len(l)
+			{ ++m_slab->refs; }
+			slab_ref(slab_ref&& rhs) noexcept
+				: m_slab(rhs.m_slab), m_buf(rhs.m_buf), m_len(rhs.m_len)
+			{ rhs.m_slab = nullptr; }
+			slab_ref(slab_ref const&) = delete;
+			slab_ref& operator=(slab_ref const&) = delete;
+			slab_ref& operator=(slab_ref&&) = delete;
+			~slab_ref() { if (m_slab) release(m_slab); }
+
+			char* data() const { return m_buf; }
+			std::size_t size() const { return std::size_t(m_len); }
+
+		private:
+			send_slab* m_slab;
+			char* m_buf;
+			int m_len;
+		};
+
 		// destructs/frees the holder object
 		using destruct_holder_fun = void (*)(void*);
 		using move_construct_holder_fun = void (*)(void*, void*);
@@ -161,6 +211,12 @@ namespace aux {
 		// enough room, returns 0
 		char* allocate_appendix(int s);
 
+		// copies a small message to the end of the chain, in a buffer
+		// carved out of the current slab. Returns false if the message is
+		// larger than max_slab_message, in which case the caller is expected
+		// to allocate a buffer of its own
+		bool append_to_slab(span<char const> buf);
+
 		span<boost::asio::const_buffer const> build_iovec(int to_send);
 
 		void clear();
@@ -225,6 +281,12 @@ namespace aux {
 		// invoking the async write call
 		std::vector<boost::asio::const_buffer> m_tmp_vec;
 
+		// the slab small messages are currently copied into, and the first
+		// unused byte in it. The last buffer in the chain may grow into the
+		// remainder of the slab, if it ends at m_slab_cursor
+		send_slab* m_slab = nullptr;
+		char* m_slab_cursor = nullptr;
+
 #if TORRENT_USE_ASSERTS
 		bool m_destructed;
 #endif
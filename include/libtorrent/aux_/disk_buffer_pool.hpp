@@ -44,6 +44,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <mutex>
 #include <functional>
 #include <memory>
+#include <atomic>
+#include <array>
 
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/span.hpp"
@@ -56,6 +58,11 @@ namespace libtorrent {
 
 namespace aux {
 
+	// disk buffers are 16 kiB blocks carved out of large, aligned regions.
+	// Freed blocks are kept in a number of small caches, each used by a
+	// subset of the threads, and are returned to their regions in batches.
+	// Allocating and freeing a buffer normally only takes the lock of one
+	// such cache, rather than the pool-wide mutex.
 	struct TORRENT_EXTRA_EXPORT disk_buffer_pool
 	{
 		explicit disk_buffer_pool(io_context& ios);
@@ -71,27 +78,55 @@ namespace aux {
 
 		int in_use() const
 		{
-			std::unique_lock<std::mutex> l(m_pool_mutex);
-			return m_in_use;
+			return m_in_use.load(std::memory_order_relaxed);
 		}
 
+		// returns true if buf was allocated from this pool. This is
+		// constant time
+		bool is_disk_buffer(char const* buf) const;
+
 		void set_settings(settings_interface const& sett);
 
+		// once called, regions are no longer returned to the system when
+		// they become unused, but are kept until the pool is destructed.
+		// This is required when the regions are registered with the kernel,
+		// as io_uring fixed buffers
+		void keep_regions();
+
+		// returns the first byte of the region buf was allocated from
+		static char const* region_base(char const* buf);
+
+		// the size of the regions blocks are allocated from. Regions are
+		// aligned to their size, which is also the size of a huge page on
+		// most systems. The first block of every region holds its header
+		static constexpr int region_size = 2 * 1024 * 1024;
+
 	private:
 
-		void free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l);
-		char* allocate_buffer_impl(std::unique_lock<std::mutex>& l, char const* category);
+		struct region;
+		struct block_cache;
+
+		void free_buffer_impl(char* buf);
+		char* allocate_buffer_impl(char const* category);
+
+		// these must be called while holding m_pool_mutex. They move blocks
+		// between the regions and the block caches
+		char* allocate_block(std::unique_lock<std::mutex>& l);
+		void free_block(char* buf, std::unique_lock<std::mutex>& l);
+		void remove_available(region* r);
+
+		static region* region_of(char const* buf);
 
 		// number of disk buffers currently allocated
-		int m_in_use;
+		std::atomic<int> m_in_use;
 
 		// cache size limit
-		int m_max_use;
+		std::atomic<int> m_max_use;
 
 		// if we have exceeded the limit, we won't start
 		// allowing allocations again until we drop below
 		// this low watermark
-		int m_low_watermark;
+		std::atomic<int> m_low_watermark;
 
 		// if we exceed the max number of buffers, we start
 		// adding up callbacks to this queue. Once the number
@@ -99,23 +134,49 @@ namespace aux {
 		// we start calling these functions back
 		std::vector<std::weak_ptr<disk_observer>> m_observers;
 
-		// set to true to throttle more allocations
-		bool m_exceeded_max_size;
+		// set to true to throttle more allocations. It's only cleared while
+		// holding m_pool_mutex, to not lose observers added concurrently
+		std::atomic<bool> m_exceeded_max_size;
 
 		// this is the main thread io_context. Callbacks are
 		// posted on this in order to have them execute in
 		// the main thread.
 		io_context& m_ios;
 
-		void check_buffer_level(std::unique_lock<std::mutex>& l);
+		void check_buffer_level();
 		void remove_buffer_in_use(char* buf);
 
+		// protects the regions and the observers
 		mutable std::mutex m_pool_mutex;
 
+		// all regions allocated by this pool
+		std::vector<region*> m_regions;
+
+		// the regions with at least one free block. Blocks are allocated from
+		// the last one. Its capacity is kept at the size of m_regions, to
+		// not allocate when freeing blocks
+		std::vector<region*> m_available;
+
+		// the number of regions without any blocks in use. One of them is
+		// kept around, to not allocate and free a region back and forth
+		int m_empty_regions = 0;
+
+		// allocate regions with huge page backing, where supported
+		// (settings_pack::disk_buffer_huge_pages)
+		bool m_huge_pages = false;
+
+		// never free regions (see keep_regions())
+		bool m_keep_regions = false;
+
+		// threads pick a block cache based on a thread local index, assigned
+		// round-robin when the thread first allocates or frees a buffer
+		std::unique_ptr<block_cache[]> m_block_caches;
+
 		// this is specifically exempt from release_asserts
 		// since it's a quite costly check. Only for debug
 		// builds.
 #if TORRENT_USE_INVARIANT_CHECKS
+		// protected by m_pool_mutex
 		std::set<char*> m_buffers_in_use;
 #endif
 #if TORRENT_USE_ASSERTS
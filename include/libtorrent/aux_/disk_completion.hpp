@@ -0,0 +1,67 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_DISK_COMPLETION_HPP_INCLUDED
+#define TORRENT_DISK_COMPLETION_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/ffs.hpp" // for log2p1
+
+#include <algorithm>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// records a batch of ``jobs`` completed disk jobs, whose handlers were
+	// called by the network thread ``latency`` after the batch was posted
+	// to it. This updates the disk_completion_batch and
+	// disk_completion_latency histograms
+	inline void record_completion_batch(counters& cnt, int const jobs
+		, time_duration const latency)
+	{
+		TORRENT_ASSERT(jobs > 0);
+		cnt.add_stats_counter(counters::disk_completion_batch1
+			+ std::min(log2p1(std::uint32_t(jobs)), 7));
+
+		std::int64_t const us = std::min(std::max(std::int64_t(0)
+			, total_microseconds(latency)) >> 3, std::int64_t(0xffffffff));
+		cnt.add_stats_counter(counters::disk_completion_latency4
+			+ std::min(log2p1(std::uint32_t(us)), 11));
+	}
+}
+}
+
+#endif // TORRENT_DISK_COMPLETION_HPP_INCLUDED
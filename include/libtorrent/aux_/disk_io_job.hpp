@@ -114,6 +114,10 @@ namespace aux {
 		// instead of executing
 		static constexpr disk_job_flags_t aborted = 6_bit;
 
+		// set for read jobs whose block a disk thread has already asked the
+		// kernel to read in, while the job was queued
+		static constexpr disk_job_flags_t prefetched = 7_bit;
+
 		// for read and write, this is the disk_buffer_holder
 		// for other jobs, it may point to other job-specific types
 		// for move_storage and rename_file this is a string
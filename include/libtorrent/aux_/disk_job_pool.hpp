@@ -37,6 +37,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/aux_/disk_io_job.hpp" // for job_action_t
 #include "libtorrent/aux_/pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 
 namespace libtorrent {
@@ -44,6 +47,11 @@ namespace aux {
 
 	struct disk_io_job;
 
+	// jobs are handed out from a number of job caches, each protected by its
+	// own mutex and picked by the calling thread. The caches are refilled
+	// from, and drained back into, the shared pool in batches. This keeps
+	// the network thread and the disk threads from contending on a single
+	// mutex for every job they allocate or free
 	struct TORRENT_EXTRA_EXPORT disk_job_pool
 	{
 		disk_job_pool();
@@ -57,17 +65,30 @@ namespace aux {
 		int read_jobs_in_use() const { return m_read_jobs; }
 		int write_jobs_in_use() const { return m_write_jobs; }
 
+		// the number of jobs allocated from a job cache, and the number of
+		// times a job cache was empty and had to be refilled from the shared
+		// pool
+		std::int64_t cache_hits() const;
+		std::int64_t cache_misses() const;
+
 	private:
 
+		struct job_cache;
+
+		void destruct_job(disk_io_job* j);
+
 		// total number of in-use jobs
-		int m_jobs_in_use;
+		std::atomic<int> m_jobs_in_use;
 		// total number of in-use read jobs
-		int m_read_jobs;
+		std::atomic<int> m_read_jobs;
 		// total number of in-use write jobs
-		int m_write_jobs;
+		std::atomic<int> m_write_jobs;
 
+		// protects m_job_pool
 		std::mutex m_job_mutex;
 		aux::pool m_job_pool;
+
+		std::unique_ptr<job_cache[]> m_job_caches;
 	};
 }
 }
@@ -57,6 +57,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/optional.hpp>
 
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
@@ -92,6 +93,11 @@ namespace aux {
 #endif
 			);
 
+		// returns a view of the file at ``file_index`` in storage ``st`` if
+		// it's currently open, without opening it nor affecting its position
+		// in the LRU. Otherwise an empty optional is returned.
+		boost::optional<file_view> find_file(storage_index_t st, file_index_t file_index);
+
 		// release all file views belonging to the specified storage_interface
 		// (``st``) the overload that takes ``file_index`` releases only the file
 		// with that index in storage ``st``.
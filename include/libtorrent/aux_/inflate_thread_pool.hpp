@@ -0,0 +1,173 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_INFLATE_THREAD_POOL_HPP_INCLUDED
+#define TORRENT_INFLATE_THREAD_POOL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/export.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/disk_buffer_holder.hpp"
+#include "libtorrent/zip_codec.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace libtorrent {
+
+	struct counters;
+
+namespace aux {
+
+	struct session_settings;
+	struct inflate_stream;
+
+	// the inflate thread pool decompresses pieces downloaded from zip web
+	// seeds (see web_zip_peer_connection), to keep the network thread from
+	// stalling on large pieces. Each thread has its own job queue. A
+	// connection opens one stream (via open_stream()), which is bound to a
+	// queue, and feeds the compressed bytes of its pieces to it as they
+	// arrive. Since a stream always submits its jobs to the same queue,
+	// completion handlers for a single connection are posted back to the
+	// network thread in the same order the jobs were submitted.
+	// threads are started lazily, the first time a job is queued on them.
+	// Pieces are inflated straight into 16 kiB blocks, recycled through a
+	// free list owned by the pool, so steady state downloading doesn't
+	// allocate any memory per piece.
+	struct TORRENT_EXTRA_EXPORT inflate_thread_pool final
+		: buffer_allocator_interface
+	{
+		// the handler is passed the blocks that were completed by the job
+		// (each ``block_size`` bytes, except possibly the last one of the
+		// piece) and the offset into the piece of the first one. The list may
+		// be empty if the job didn't complete a block. If the piece turns out
+		// to be corrupt, the error is reported once, and the remaining jobs
+		// of that piece complete without any blocks
+		using handler_t = std::function<void(error_code const&, int
+			, std::vector<disk_buffer_holder>)>;
+
+		inflate_thread_pool(io_context& ios, session_settings const& sett
+			, counters& cnt);
+		~inflate_thread_pool();
+
+		inflate_thread_pool(inflate_thread_pool const&) = delete;
+		inflate_thread_pool& operator=(inflate_thread_pool const&) = delete;
+
+		// returns a new stream for a connection to submit all its jobs to,
+		// decoding pieces compressed with codec ``c``. Streams are assigned
+		// to queues round-robin over the first settings_pack::inflate_threads
+		// queues. Lowering the number of threads only affects streams opened
+		// after the change. If the codec isn't supported, every piece fails.
+		// must only be called from the network thread
+		std::shared_ptr<inflate_stream> open_stream(zip_codec c);
+
+		// queue the next chunk of the compressed piece currently being
+		// downloaded on stream ``s``. The piece inflates to ``unzip_length``
+		// bytes, split into blocks of ``block_size`` (which may not exceed
+		// default_block_size). ``last`` is set on the final chunk of a piece,
+		// the next chunk starts a new piece. The handler is posted to the
+		// io_context once the chunk has been consumed.
+		// must only be called from the network thread
+		void async_inflate(std::shared_ptr<inflate_stream> const& s
+			, std::vector<char> input, int unzip_length, int block_size
+			, bool last, handler_t handler);
+
+		// stop all threads. If wait is true, this call blocks until they
+		// have exited. Jobs that have not started yet are discarded
+		// (without calling their handlers)
+		void abort(bool wait);
+
+		// returns a block to the free list. This is called by the
+		// disk_buffer_holders passed to the handlers
+		void free_disk_buffer(char* buf) override;
+
+	private:
+
+		char* allocate_block();
+
+		struct inflate_job
+		{
+			std::shared_ptr<inflate_stream> stream;
+			std::vector<char> input;
+			int unzip_length;
+			int block_size;
+			bool last;
+			handler_t handler;
+		};
+
+		struct job_queue
+		{
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::deque<inflate_job> jobs;
+			std::thread thread;
+			bool abort = false;
+		};
+
+		void thread_fun(job_queue& q
+			, executor_work_guard<io_context::executor_type> work);
+
+		// inflates as much of the job's input as possible into the stream's
+		// current piece. Completed blocks are appended to ``blocks``. Returns
+		// false if the piece is corrupt
+		bool inflate_chunk(inflate_stream& s, inflate_job& j
+			, std::vector<disk_buffer_holder>& blocks);
+
+		io_context& m_ios;
+		session_settings const& m_settings;
+		counters& m_stats_counters;
+
+		// the queues are only ever added to (from the network thread), never
+		// removed until the pool is aborted. Each queue has a stable address,
+		// since its thread holds a reference to it
+		std::vector<std::unique_ptr<job_queue>> m_queues;
+
+		// the next queue to hand out in open_stream()
+		int m_next_queue = 0;
+
+		bool m_abort = false;
+
+		// blocks that have been handed back by the network thread, ready to
+		// be reused by the inflate threads
+		std::mutex m_block_mutex;
+		std::vector<char*> m_free_blocks;
+	};
+}
+}
+
+#endif // TORRENT_INFLATE_THREAD_POOL_HPP_INCLUDED
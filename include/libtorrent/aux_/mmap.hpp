@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/disk_interface.hpp" // for open_file_state
 #include "libtorrent/aux_/open_mode.hpp"
 
+#include <atomic>
+
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 
 #include "libtorrent/aux_/windows.hpp"
@@ -93,6 +95,38 @@ namespace aux {
 
 	struct file_view;
 
+	// hints about how a mapped file is about to be accessed. Where madvise()
+	// is supported, they are passed on to the kernel
+	enum class advice_t : std::uint8_t
+	{
+		// the file is read sequentially, e.g. while it's being checked. This
+		// applies to the whole mapping
+		sequential,
+
+		// back the mapping with huge pages, for file systems that support it.
+		// This applies to the whole mapping
+		huge_page,
+
+		// the range will be read soon, start reading it in
+		will_need,
+
+		// the range isn't expected to be read again anytime soon, e.g. once
+		// it has been uploaded
+		cold,
+	};
+
+	enum class advice_result : std::uint8_t
+	{
+		// the hint was passed on to the kernel
+		applied,
+
+		// the hint was already in effect, or isn't supported on this system
+		skipped,
+
+		// the kernel rejected the hint
+		failed,
+	};
+
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 	struct TORRENT_EXTRA_EXPORT file_mapping_handle
 	{
@@ -136,6 +170,8 @@ namespace aux {
 
 		void close();
 
+		advice_result advise(advice_t a, std::int64_t offset, std::int64_t len);
+
 		// the memory range this file has been mapped into
 		span<byte> memory()
 		{
@@ -151,6 +187,11 @@ namespace aux {
 		file_handle m_file;
 #endif
 		void* m_mapping;
+
+		// the hints applying to the whole mapping that are in effect, one
+		// bit per advice_t value. Views of the mapping are shared between
+		// disk threads
+		std::atomic<std::uint8_t> m_advice{0};
 	};
 
 	struct TORRENT_EXTRA_EXPORT file_view
@@ -171,6 +212,15 @@ namespace aux {
 			return m_mapping->memory();
 		}
 
+		// passes the access pattern hint on for the ``len`` bytes at
+		// ``offset`` into the file. Hints applying to the whole mapping
+		// ignore the range, and are only passed on once
+		advice_result advise(advice_t const a, std::int64_t const offset, std::int64_t const len)
+		{
+			TORRENT_ASSERT(m_mapping);
+			return m_mapping->advise(a, offset, len);
+		}
+
 	private:
 		explicit file_view(std::shared_ptr<file_mapping> m) : m_mapping(std::move(m)) {}
 		std::shared_ptr<file_mapping> m_mapping;
@@ -40,6 +40,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <unordered_map>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/error_code.hpp"
@@ -106,6 +107,12 @@ namespace aux {
 		// allocate a slot and return the slot index
 		slot_index_t allocate_slot(piece_index_t piece);
 
+		// this mutex must be held while accessing the data
+		// structure. Not while reading or writing from the file though!
+		// posix_disk_io reads on its read threads while the network thread
+		// writes
+		std::mutex m_mutex;
+
 		// this is a list of unallocated slots in the part file
 		// within the m_num_allocated range
 		std::vector<slot_index_t> m_free_slots;
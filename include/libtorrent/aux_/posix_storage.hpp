@@ -86,6 +86,17 @@ namespace aux {
 
 		void initialize(settings_interface const&, storage_error& ec);
 
+		// these are used by disk I/O back-ends performing the file I/O
+		// themselves (io_uring_disk_io), for files that aren't pad files and
+		// don't keep their data in the part file. Anything else is read and
+		// written through readv() and writev()
+		std::string file_path(file_index_t idx) const;
+		bool in_part_file(file_index_t idx) const;
+
+		// invalidates the cached size of a file written to outside of
+		// writev()
+		void set_file_dirty(file_index_t const idx) { m_stat_cache.set_dirty(idx); }
+
 	private:
 
 		file_pointer open_file(file_index_t idx, open_mode_t mode, std::int64_t offset
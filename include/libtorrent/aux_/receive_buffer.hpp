@@ -95,6 +95,10 @@ struct TORRENT_EXTRA_EXPORT receive_buffer
 	// This is the "current" packet.
 	span<char const> get() const;
 
+	// returns the bytes received past the read cursor, that haven't been
+	// handed to the upper layer yet. These may span several packets
+	span<char const> unparsed() const;
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 	// returns the buffer from the current packet start position to the last
 	// received byte (possibly part of another packet)
@@ -79,11 +79,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bloom_filter.hpp"
 #include "libtorrent/peer_class.hpp"
 #include "libtorrent/peer_class_type_filter.hpp"
+#include "libtorrent/torrent_status.hpp"
 #include "libtorrent/kademlia/dht_observer.hpp"
 #include "libtorrent/kademlia/dht_state.hpp"
 #include "libtorrent/kademlia/announce_flags.hpp"
 #include "libtorrent/aux_/resolver.hpp"
 #include "libtorrent/aux_/invariant_check.hpp"
+#include "libtorrent/aux_/inflate_thread_pool.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
 #include "libtorrent/extensions.hpp"
 #include "libtorrent/aux_/portmap.hpp"
 #include "libtorrent/aux_/lsd.hpp"
@@ -428,6 +431,8 @@ namespace aux {
 				return m_torrent_lists[i];
 			}
 
+			timer_wheel& torrent_timers() override { return m_torrent_timers; }
+
 			// prioritize this torrent to be allocated some connection
 			// attempts, because this torrent needs more peers.
 			// this is typically done when a torrent starts out and
@@ -705,6 +710,7 @@ namespace aux {
 
 			alert_manager& alerts() override { return m_alerts; }
 			disk_interface& disk_thread() override { return *m_disk_thread; }
+			inflate_thread_pool& inflate_pool() override { return m_inflate_pool; }
 
 			void abort() noexcept;
 			void abort_stage2() noexcept;
@@ -813,7 +819,7 @@ namespace aux {
 			void inc_boost_connections() override
 			{
 				++m_boost_connections;
-				m_stats_counters.inc_stats_counter(counters::boost_connection_attempts);
+				m_stats_counters.add_stats_counter(counters::boost_connection_attempts);
 			}
 
 			// the settings for the client
@@ -938,6 +944,10 @@ namespace aux {
 			// constructed after it.
 			std::unique_ptr<disk_interface> m_disk_thread;
 
+			// decompresses pieces downloaded from zip web seeds. Like the disk
+			// thread, it posts completion events to the io service.
+			inflate_thread_pool m_inflate_pool;
+
 			// the bandwidth manager is responsible for
 			// handing out bandwidth to connections that
 			// asks for it, it can also throttle the
@@ -1109,6 +1119,8 @@ namespace aux {
 			void auto_manage_torrents(std::vector<torrent*>& list
 				, int& dht_limit, int& tracker_limit
 				, int& lsd_limit, int& hard_limit, int type_limit);
+			void queued_auto_managed_torrents(std::vector<torrent*>& checking
+				, std::vector<torrent*>& downloaders) const;
 			void recalculate_auto_managed_torrents();
 			void recalculate_unchoke_slots();
 			void recalculate_optimistic_unchoke_slots();
@@ -1134,6 +1146,12 @@ namespace aux {
 			time_point m_last_tick;
 			time_point m_last_second_tick;
 
+			// deadlines scheduled by torrents. This lets torrents that are
+			// not ticked every second (because they are idle) still be woken
+			// up when they need to, without the session looping over all of
+			// them
+			timer_wheel m_torrent_timers{total_seconds(clock_type::now().time_since_epoch())};
+
 			// the last time we went through the peers
 			// to decide which ones to choke/unchoke
 			time_point m_last_choke;
@@ -1365,6 +1383,13 @@ namespace aux {
 			// called and we post the headers alert
 			bool m_posted_stats_header = false;
 
+			// scratch space used by post_torrent_updates() when posting
+			// compact state updates. These are kept around to not allocate
+			// memory for every update
+			torrent_status m_delta_status;
+			std::vector<torrent_status_delta> m_deltas;
+			std::string m_delta_strings;
+			std::vector<torrent*> m_delta_torrents;
 
 			std::thread m_stun_thread;
 			std::string m_nat_type;
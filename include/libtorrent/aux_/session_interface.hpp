@@ -78,6 +78,8 @@ namespace aux {
 	struct bandwidth_manager;
 	struct resolver_interface;
 	struct alert_manager;
+	struct inflate_thread_pool;
+	struct timer_wheel;
 }
 
 	// hidden
@@ -150,6 +152,7 @@ namespace aux {
 		virtual external_ip external_address() const = 0;
 
 		virtual disk_interface& disk_thread() = 0;
+		virtual aux::inflate_thread_pool& inflate_pool() = 0;
 
 		virtual alert_manager& alerts() = 0;
 
@@ -274,6 +277,11 @@ namespace aux {
 
 		virtual aux::vector<torrent*>& torrent_list(torrent_list_index_t i) = 0;
 
+		// torrents schedule deadlines that aren't checked every second, in
+		// second_tick(), with this timer wheel. Its ticks are seconds of
+		// aux::time_now() and it's advanced once a second
+		virtual timer_wheel& torrent_timers() = 0;
+
 		virtual bool has_lsd() const = 0;
 		virtual void announce_lsd(sha1_hash const& ih, int port) = 0;
 		virtual libtorrent::aux::utp_socket_manager* utp_socket_manager() = 0;
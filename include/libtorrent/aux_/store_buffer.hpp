@@ -35,8 +35,11 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
+#include <array>
 
 #include "libtorrent/storage_defs.hpp"
+#include "libtorrent/assert.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/functional/hash.hpp>
@@ -88,14 +91,27 @@ struct hash<libtorrent::aux::torrent_location>
 namespace libtorrent {
 namespace aux {
 
+// the store buffer maps the locations of blocks being written to their
+// buffers. The locations are spread across a number of shards, each with its
+// own mutex, based on the torrent and the piece. This way the network thread
+// inserting blocks, and the disk threads looking up and erasing them, rarely
+// contend on a lock. All blocks of a piece are in the same shard, which lets
+// get2() look up two adjacent blocks under a single lock.
 struct store_buffer
 {
 	template <typename Fun>
 	bool get(torrent_location const loc, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it = m_store_buffer.find(loc);
-		if (it != m_store_buffer.end())
+		shard const& s = shard_for(loc);
+
+		// the common case is for there to be no blocks in flight in this
+		// shard, in which case we don't need to take the lock. A block
+		// inserted concurrently with the lookup is racing with it anyway
+		if (s.size.load(std::memory_order_acquire) == 0) return false;
+
+		std::unique_lock<std::mutex> l(s.mutex);
+		auto const it = s.buffers.find(loc);
+		if (it != s.buffers.end())
 		{
 			f(it->second);
 			return true;
@@ -106,11 +122,23 @@ struct store_buffer
 	template <typename Fun>
 	int get2(torrent_location const loc1, torrent_location const loc2, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it1 = m_store_buffer.find(loc1);
-		auto const it2 = m_store_buffer.find(loc2);
-		char const* buf1 = (it1 == m_store_buffer.end()) ? nullptr : it1->second;
-		char const* buf2 = (it2 == m_store_buffer.end()) ? nullptr : it2->second;
+		shard const& s1 = shard_for(loc1);
+		shard const& s2 = shard_for(loc2);
+		if (s1.size.load(std::memory_order_acquire) == 0
+			&& s2.size.load(std::memory_order_acquire) == 0)
+			return 0;
+
+		// the two blocks are normally in the same piece, and so in the same
+		// shard
+		std::unique_lock<std::mutex> l1(s1.mutex, std::defer_lock);
+		std::unique_lock<std::mutex> l2(s2.mutex, std::defer_lock);
+		if (&s1 == &s2) l1.lock();
+		else std::lock(l1, l2);
+
+		auto const it1 = s1.buffers.find(loc1);
+		auto const it2 = s2.buffers.find(loc2);
+		char const* buf1 = (it1 == s1.buffers.end()) ? nullptr : it1->second;
+		char const* buf2 = (it2 == s2.buffers.end()) ? nullptr : it2->second;
 
 		if (buf1 == nullptr && buf2 == nullptr)
 			return 0;
@@ -120,22 +148,65 @@ struct store_buffer
 
 	void insert(torrent_location const loc, char const* buf)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		m_store_buffer.insert({loc, buf});
+		shard& s = shard_for(loc);
+		std::lock_guard<std::mutex> l(s.mutex);
+		if (s.buffers.insert({loc, buf}).second)
+			s.size.fetch_add(1, std::memory_order_release);
 	}
 
 	void erase(torrent_location const loc)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		auto it = m_store_buffer.find(loc);
-		TORRENT_ASSERT(it != m_store_buffer.end());
-		m_store_buffer.erase(it);
+		shard& s = shard_for(loc);
+		std::lock_guard<std::mutex> l(s.mutex);
+		auto it = s.buffers.find(loc);
+		TORRENT_ASSERT(it != s.buffers.end());
+		s.buffers.erase(it);
+		s.size.fetch_sub(1, std::memory_order_release);
 	}
 
 private:
 
-	mutable std::mutex m_mutex;
-	std::unordered_map<torrent_location, char const*> m_store_buffer;
+	static constexpr std::size_t num_shards = 32;
+
+	struct shard_state
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<torrent_location, char const*> buffers;
+
+		// the number of entries in buffers. Updated while holding mutex, but
+		// read without it
+		std::atomic<int> size{0};
+	};
+
+	// the store buffer is allocated as part of the disk I/O object, with new,
+	// which doesn't honor alignment beyond the fundamental one before C++17.
+	// Instead of aligning the shards, a whole cache line of padding on either
+	// side of the state keeps it off the cache lines of the adjacent shards
+	// (and of the store buffer's neighbors), wherever the array ends up
+	static constexpr std::size_t cache_line_size = 64;
+	struct cache_line_padding
+	{
+		char padding[cache_line_size];
+	};
+	struct shard : cache_line_padding, shard_state
+	{
+		cache_line_padding trailing_padding;
+	};
+
+	shard& shard_for(torrent_location const& loc)
+	{ return m_shards[shard_index(loc)]; }
+	shard const& shard_for(torrent_location const& loc) const
+	{ return m_shards[shard_index(loc)]; }
+
+	static std::size_t shard_index(torrent_location const& loc)
+	{
+		std::size_t ret = 0;
+		boost::hash_combine(ret, static_cast<int>(loc.torrent));
+		boost::hash_combine(ret, static_cast<int>(loc.piece));
+		return ret % num_shards;
+	}
+
+	std::array<shard, num_shards> m_shards;
 };
 
 }
@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_TIMER_WHEEL_HPP_INCLUDED
+#define TORRENT_TIMER_WHEEL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	struct timer_wheel;
+
+	// an intrusive timer. Objects that need to be woken up at some point in
+	// the future derive from timer_entry and schedule it with a timer_wheel.
+	// An entry that's destructed while scheduled is removed from its wheel.
+	struct TORRENT_EXTRA_EXPORT timer_entry
+	{
+		timer_entry() = default;
+		timer_entry(timer_entry const&) = delete;
+		timer_entry& operator=(timer_entry const&) = delete;
+		virtual ~timer_entry();
+
+		// called by the owner of the wheel for every expired entry it pops
+		virtual void on_timer() = 0;
+
+		// returns true if this entry is scheduled, or has expired but not
+		// been popped from the wheel yet
+		bool scheduled() const { return m_pprev != nullptr; }
+
+		// the tick this entry is (or was last) scheduled for
+		std::int64_t deadline() const { return m_deadline; }
+
+	private:
+		friend struct timer_wheel;
+
+		void unlink();
+
+		timer_entry* m_next = nullptr;
+		// points to the pointer pointing to this entry. Either the m_next of
+		// the previous entry or the head of the list this entry is in
+		timer_entry** m_pprev = nullptr;
+		std::int64_t m_deadline = 0;
+	};
+
+	// a hierarchical timer wheel, with a resolution of one tick. There are
+	// four levels of 64 slots each. Level 0 has a slot per tick, each slot of
+	// level 1 covers 64 ticks and so on, which covers deadlines about 16
+	// million ticks out. Entries further out than that are put in the last
+	// slot and re-inserted when it comes around. Entries cascade down to lower
+	// levels as the wheel turns.
+	//
+	// scheduling and cancelling an entry is O(1) and doesn't allocate.
+	// Advancing the wheel by one tick is O(1) plus the number of entries that
+	// expire or cascade, it doesn't depend on the number of scheduled
+	// entries.
+	struct TORRENT_EXTRA_EXPORT timer_wheel
+	{
+		explicit timer_wheel(std::int64_t now = 0);
+		timer_wheel(timer_wheel const&) = delete;
+		timer_wheel& operator=(timer_wheel const&) = delete;
+		~timer_wheel();
+
+		// schedules the entry to expire at the specified tick. If it's
+		// already scheduled, it's moved. Deadlines that have already passed
+		// expire on the next tick
+		void schedule(timer_entry& e, std::int64_t deadline);
+
+		// removes the entry from the wheel. This is a no-op if it isn't
+		// scheduled.
+		void cancel(timer_entry& e);
+
+		// turn the wheel forward to ``now``. Entries whose deadline is
+		// reached are moved to the expired list, to be picked up by
+		// pop_expired()
+		void advance(std::int64_t now);
+
+		// returns the next expired entry, or nullptr if there are none. The
+		// caller is expected to call on_timer() on it. Expired entries are no
+		// longer scheduled once they have been popped. It's safe to schedule
+		// and cancel entries (including expired ones that haven't been popped
+		// yet) in between calls to pop_expired(). The order entries expiring
+		// in the same call to advance() are popped in is unspecified
+		timer_entry* pop_expired();
+
+		std::int64_t now() const { return m_now; }
+
+		static constexpr int slot_bits = 6;
+		static constexpr int num_slots = 1 << slot_bits;
+		static constexpr int num_levels = 4;
+
+	private:
+
+		void insert(timer_entry& e);
+		static void push(timer_entry*& head, timer_entry& e);
+
+		// the last tick the wheel was advanced to
+		std::int64_t m_now;
+
+		aux::array<aux::array<timer_entry*, num_slots>, num_levels> m_slots;
+
+		// entries whose deadline has been reached
+		timer_entry* m_expired = nullptr;
+	};
+}
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_ZIP_DECODER_HPP_INCLUDED
+#define TORRENT_ZIP_DECODER_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/export.hpp"
+#include "libtorrent/zip_codec.hpp"
+#include "libtorrent/span.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace libtorrent {
+namespace aux {
+
+	// a streaming decoder for the pieces of a zip web seed. A decoder
+	// decodes one piece at a time, and is reused for all pieces downloaded
+	// by a connection, to keep the codec's state (and its window) from
+	// being allocated once per piece.
+	struct TORRENT_EXTRA_EXPORT zip_decoder
+	{
+		enum class status : std::uint8_t
+		{
+			// progress was made, and more may be possible with more room
+			// in the output buffer
+			ok,
+
+			// all input has been consumed, and no more output can be
+			// produced until more is provided
+			need_input,
+
+			// the compressed stream of the piece is complete
+			end,
+
+			// the input is corrupt
+			error
+		};
+
+		zip_decoder() = default;
+		zip_decoder(zip_decoder const&) = delete;
+		zip_decoder& operator=(zip_decoder const&) = delete;
+		virtual ~zip_decoder() = default;
+
+		// starts decoding a new piece, discarding any state left from the
+		// previous one. Returns false if the decoder could not be
+		// initialized.
+		virtual bool reset() = 0;
+
+		// decodes as much of ``in`` into ``out`` as possible. Both spans are
+		// advanced past the bytes consumed and produced, respectively. Once
+		// ``end`` has been returned, any further input is an error.
+		virtual status decode(span<char const>& in, span<char>& out) = 0;
+	};
+
+	// returns nullptr if the codec isn't supported by this build
+	TORRENT_EXTRA_EXPORT std::unique_ptr<zip_decoder> make_zip_decoder(zip_codec c);
+
+	// compresses a whole piece at ``level`` (whose range depends on the
+	// codec), replacing the contents of ``out``. Returns false on failure.
+	TORRENT_EXTRA_EXPORT bool zip_compress(zip_codec c, span<char const> in
+		, std::vector<char>& out, int level);
+}
+}
+
+#endif // TORRENT_ZIP_DECODER_HPP_INCLUDED
@@ -165,9 +165,22 @@ namespace libtorrent {
 		// count the number of bits in the bitfield that are set to 1.
 		int count() const noexcept;
 
+		// returns the number of bits set in both this bitfield and ``rhs``.
+		// Both bitfields are expected to have the same size.
+		int count_and(bitfield const& rhs) const noexcept;
+
+		// returns the number of bits set in this bitfield, but not in
+		// ``rhs``. Both bitfields are expected to have the same size.
+		int count_and_not(bitfield const& rhs) const noexcept;
+
 		// returns the index of the first set bit in the bitfield, i.e. 1 bit.
 		int find_first_set() const noexcept;
 
+		// returns the index of the first bit, at or after ``start``, that is
+		// set in both this bitfield and ``rhs``, or -1 if there is none. Both
+		// bitfields are expected to have the same size.
+		int find_next_set_and(bitfield const& rhs, int start) const noexcept;
+
 		// returns the index to the last cleared bit in the bitfield, i.e. 0 bit.
 		int find_last_clear() const noexcept;
 
@@ -319,6 +332,9 @@ namespace libtorrent {
 		void set_bit(IndexType const index)
 		{ this->bitfield::set_bit(static_cast<int>(index)); }
 
+		IndexType find_next_set_and(bitfield const& rhs, IndexType const start) const noexcept
+		{ return IndexType(this->bitfield::find_next_set_and(rhs, static_cast<int>(start))); }
+
 		IndexType end_index() const noexcept { return IndexType(this->size()); }
 	};
 }
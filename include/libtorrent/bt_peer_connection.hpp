@@ -183,6 +183,14 @@ namespace libtorrent {
 			, std::size_t bytes_transferred) override;
 		void on_receive_impl(std::size_t bytes_transferred);
 
+		// handles all complete messages in the receive buffer past the
+		// current one, without returning to peer_connection in between
+		void parse_buffered_messages();
+
+		// handles the run of HAVE messages at the start of buf as one
+		// packet. Returns the number of bytes consumed
+		int on_have_run(span<char const> buf);
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		// next_barrier, buffers-to-prepend
 		std::tuple<int, span<span<char const>>>
@@ -305,7 +313,7 @@ namespace libtorrent {
 
 			send_buffer(msg);
 
-			stats_counters().inc_stats_counter(counter);
+			stats_counters().add_stats_counter(counter);
 		}
 
 		void write_dht_port();
@@ -354,11 +362,13 @@ namespace libtorrent {
 				// since we'll mutate it
 				aux::buffer buf(size, {holder.data(), size});
 				append_send_buffer(std::move(buf), size);
+				stats_counters().add_stats_counter(counters::send_copied_bytes, size);
 			}
 			else
 #endif
 			{
 				append_send_buffer(std::move(holder), size);
+				stats_counters().add_stats_counter(counters::send_zero_copy_bytes, size);
 			}
 		}
 
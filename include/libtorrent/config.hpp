@@ -167,6 +167,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_HAS_SALEN 0
 #define TORRENT_USE_FDATASYNC 1
 
+// io_uring_disk_io needs IORING_FEAT_FAST_POLL, which was added to the
+// headers in linux 5.7
+#if !defined TORRENT_HAVE_IO_URING && defined __has_include
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_FAST_POLL
+#define TORRENT_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
 #if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ > 24))
 #define TORRENT_USE_GETRANDOM 1
 #endif
@@ -452,6 +463,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_HAVE_MAP_VIEW_OF_FILE 0
 #endif
 
+#ifndef TORRENT_HAVE_IO_URING
+#define TORRENT_HAVE_IO_URING 0
+#endif
+
 #ifndef TORRENT_USE_MADVISE
 #define TORRENT_USE_MADVISE 0
 #endif
@@ -492,6 +507,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_USE_I2P 1
 #endif
 
+#ifndef TORRENT_USE_ZSTD
+#define TORRENT_USE_ZSTD 0
+#endif
+
 #ifndef TORRENT_HAS_SYMLINK
 #define TORRENT_HAS_SYMLINK 0
 #endif
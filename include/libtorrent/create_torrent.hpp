@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/path.hpp" // for combine_path etc.
 #include "libtorrent/fwd.hpp"
 #include "libtorrent/aux_/throw.hpp"
+#include "libtorrent/zip_codec.hpp"
 
 #include <vector>
 #include <string>
@@ -292,6 +293,32 @@ namespace libtorrent {
 		void add_url_seed(string_view url);
 		void add_http_seed(string_view url);
 
+		// This adds a zip web seed to the torrent. A zip web seed serves a
+		// single file with every piece of the torrent compressed on its own,
+		// back-to-back (see set_piece_hashes_zip()). The urls, along with the
+		// size of each compressed piece, are stored in the ``zipinfo``
+		// dictionary, outside of the info dictionary. It's only written by
+		// generate() once the size of every piece has been set.
+		void add_zip_web_seed(string_view url);
+
+		// sets the compression level to use for the zip web seed file. The
+		// range depends on the codec, 0-10 for zlib and 1-22 for zstd.
+		// Defaults to 2.
+		void set_zip_level(int level) { m_zip_level = level; }
+		int zip_level() const { return m_zip_level; }
+
+		// sets the format to compress the pieces of the zip web seed file
+		// in. Defaults to zlib. Any other codec is stored in the ``zipinfo``
+		// dictionary, and clients that don't support it won't use the zip
+		// web seeds.
+		void set_zip_codec(zip_codec c) { m_zip_codec = c; }
+		zip_codec get_zip_codec() const { return m_zip_codec; }
+
+		// sets the size of piece ``index`` in the zip web seed file, once
+		// compressed. Since pieces are stored in order, this also determines
+		// the offset of every piece. This is set by set_piece_hashes_zip().
+		void set_zip_piece_size(piece_index_t index, std::uint32_t size);
+
 		// This adds a DHT node to the torrent. This especially useful if you're creating a
 		// tracker less torrent. It can be used by clients to bootstrap their DHT node from.
 		// The node is a hostname and a port number where there is a DHT node running.
@@ -370,6 +397,13 @@ namespace libtorrent {
 		std::vector<std::string> m_url_seeds;
 		std::vector<std::string> m_http_seeds;
 
+		// the zip web seeds, and the compressed size of each piece in the
+		// file they serve
+		std::vector<std::string> m_zip_web_seeds;
+		aux::vector<std::uint32_t, piece_index_t> m_zip_piece_size;
+		int m_zip_level = 2;
+		zip_codec m_zip_codec = zip_codec::zlib;
+
 		aux::vector<sha1_hash, piece_index_t> m_piece_hash;
 
 		// leave this here for now, to preserve ABI between building with
@@ -502,6 +536,33 @@ namespace aux {
 	}
 #endif
 
+	// This works like set_piece_hashes(), but also writes the payload for
+	// zip web seeds to ``zip_file``: every piece compressed on its own, in
+	// order, with the codec and level set by create_torrent::set_zip_codec()
+	// and create_torrent::set_zip_level(). The size of each compressed piece
+	// is set in the ``create_torrent`` object, for the ``zipinfo``
+	// dictionary. If the codec isn't supported by this build, this fails
+	// with ``operation_not_supported``. Each piece is read once, and hashed and
+	// compressed in one pass, on ``settings_pack::hashing_threads`` threads.
+	// The function ``f`` is called for every piece, in order, once it has
+	// been written to ``zip_file``.
+	TORRENT_EXPORT void set_piece_hashes_zip(create_torrent& t, std::string const& p
+		, std::string const& zip_file
+		, std::function<void(piece_index_t)> const& f, error_code& ec);
+	TORRENT_EXPORT void set_piece_hashes_zip(create_torrent& t, std::string const& p
+		, std::string const& zip_file, settings_interface const& settings
+		, std::function<void(piece_index_t)> const& f, error_code& ec);
+#ifndef BOOST_NO_EXCEPTIONS
+	inline void set_piece_hashes_zip(create_torrent& t, std::string const& p
+		, std::string const& zip_file
+		, std::function<void(piece_index_t)> const& f)
+	{
+		error_code ec;
+		set_piece_hashes_zip(t, p, zip_file, f, ec);
+		if (ec) aux::throw_ex<system_error>(ec);
+	}
+#endif
+
 namespace aux {
 	TORRENT_EXTRA_EXPORT file_flags_t get_file_attributes(std::string const& p);
 	TORRENT_EXTRA_EXPORT std::string get_symlink_path(std::string const& p);
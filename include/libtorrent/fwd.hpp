@@ -141,6 +141,7 @@ struct dht_sample_infohashes_alert;
 struct block_uploaded_alert;
 struct alerts_dropped_alert;
 struct socks5_alert;
+struct state_delta_alert;
 TORRENT_VERSION_NAMESPACE_3_END
 
 // include/libtorrent/announce_entry.hpp
@@ -279,6 +280,7 @@ TORRENT_VERSION_NAMESPACE_3_END
 // include/libtorrent/torrent_status.hpp
 TORRENT_VERSION_NAMESPACE_3
 struct torrent_status;
+struct torrent_status_delta;
 TORRENT_VERSION_NAMESPACE_3_END
 
 #if TORRENT_ABI_VERSION <= 2
@@ -0,0 +1,62 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_IO_URING_DISK_IO_HPP_INCLUDED
+#define TORRENT_IO_URING_DISK_IO_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <memory>
+
+namespace libtorrent {
+
+#if TORRENT_HAVE_IO_URING
+
+	struct counters;
+	struct disk_interface;
+	struct settings_interface;
+
+	// constructs a disk I/O object submitting reads and writes to the
+	// kernel through an io_uring, from a single thread. The disk buffers
+	// and the open files are registered with the ring, as fixed buffers and
+	// fixed files, where the kernel allows it. If the kernel doesn't support
+	// io_uring (or it's disabled), this falls back to posix_disk_io.
+	TORRENT_EXPORT std::unique_ptr<disk_interface> io_uring_disk_io_constructor(
+		io_context& ios, settings_interface const&, counters& cnt);
+
+#endif // TORRENT_HAVE_IO_URING
+
+}
+
+#endif // TORRENT_IO_URING_DISK_IO_HPP_INCLUDED
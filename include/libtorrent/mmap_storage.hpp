@@ -62,6 +62,7 @@ namespace aux {
 	struct session_settings;
 	struct file_view_pool;
 	struct file_view;
+	enum class advice_t : std::uint8_t;
 }
 
 	struct TORRENT_EXTRA_EXPORT mmap_storage
@@ -114,6 +115,14 @@ namespace aux {
 		int hashv2(settings_interface const&, hasher256& ph, std::ptrdiff_t len
 			, piece_index_t piece, int offset, aux::open_mode_t flags, storage_error&);
 
+		// passes the access pattern hint ``a`` on for the files backing
+		// ``len`` bytes of ``piece``, starting at ``offset``. Files that
+		// aren't currently mapped are skipped, this never opens files. The
+		// outcome is recorded in the mmap_advise_* counters. This may be
+		// called from the network thread.
+		void advise(piece_index_t piece, int offset, int len, aux::advice_t a
+			, counters&);
+
 		// if the files in this storage are mapped, returns the mapped
 		// file_storage, otherwise returns the original file_storage object.
 		file_storage const& files() const { return m_mapped_files ? *m_mapped_files : m_files; }
@@ -462,6 +462,15 @@ namespace aux {
 
 		void update_interest();
 
+		// the wanted state (see piece_picker::is_wanted()) of a piece this
+		// peer has changed, without changing the picker's wanted_epoch().
+		// ``delta`` is 1 if it became wanted, -1 if it stopped being wanted
+		void wanted_piece_changed(piece_picker const& p, int delta);
+
+		// forget the number of wanted pieces, it's recomputed next time it's
+		// needed
+		void invalidate_wanted_pieces() { m_wanted_epoch = 0; }
+
 		void get_peer_info(peer_info& p) const override;
 
 		// returns the torrent this connection is a part of
@@ -580,6 +589,9 @@ namespace aux {
 		void incoming_interested();
 		void incoming_not_interested();
 		void incoming_have(piece_index_t piece_index);
+		// a run of HAVE messages received at once. Has the same effect as
+		// calling incoming_have() for each of them
+		void incoming_haves(span<piece_index_t const> pieces);
 		void incoming_dont_have(piece_index_t piece_index);
 		void incoming_bitfield(typed_bitfield<piece_index_t> const& bits);
 		void incoming_request(peer_request const& r);
@@ -788,6 +800,11 @@ namespace aux {
 		void account_received_bytes(int bytes_transferred);
 
 		void do_update_interest();
+
+		// recomputes m_num_wanted_pieces, unless it's already up to date
+		// with the piece picker
+		void sync_wanted_pieces(piece_picker const& p);
+
 		void fill_send_buffer();
 		void on_disk_read_complete(disk_buffer_holder buffer
 			, storage_error const& error, peer_request const&, time_point issue_time);
@@ -833,6 +850,19 @@ namespace aux {
 		// m_have_piece.end(), true)
 		int m_num_pieces;
 
+		// the number of pieces this peer has that we want (see
+		// piece_picker::is_wanted()). We're interested in the peer as long as
+		// this is greater than zero. It's updated as the peer announces
+		// pieces and as pieces pass the hash check, and it's only valid while
+		// m_wanted_epoch matches the piece picker's wanted_epoch(). Zero is a
+		// valid count, meaning the peer has nothing we want
+		int m_num_wanted_pieces = 0;
+
+		// the piece picker's wanted_epoch() m_num_wanted_pieces was computed
+		// at. Zero means it has to be recomputed (see
+		// invalidate_wanted_pieces())
+		std::uint32_t m_wanted_epoch = 0;
+
 	public:
 		// upload and download channel state
 		// enum from peer_info::bw_state
@@ -841,6 +871,12 @@ namespace aux {
 	protected:
 		aux::receive_buffer m_recv_buffer;
 
+		// the number of bytes on_receive() consumed from m_recv_buffer in
+		// addition to the ones it was passed, by parsing all complete
+		// messages in the buffer in one go. on_receive_data() won't pass
+		// these to on_receive() again
+		int m_recv_parsed_ahead = 0;
+
 		// number of bytes this peer can send and receive
 		int m_quota[2];
 
@@ -324,6 +324,77 @@ namespace libtorrent {
 			socket_recv_size19,
 			socket_recv_size20,
 
+			// the cumulative time spent inflating pieces downloaded from
+			// zip web seeds, in microseconds
+			inflate_time,
+
+			// the number of completed disk jobs whose handlers were called
+			// in a single batch on the network thread. The batch size is
+			// less than 1 << n, where n is the number at the end of the
+			// counter name, except for the last one
+			// 2, 4, 8, 16, 32, 64, 128, 256 (and above)
+			disk_completion_batch1,
+			disk_completion_batch2,
+			disk_completion_batch3,
+			disk_completion_batch4,
+			disk_completion_batch5,
+			disk_completion_batch6,
+			disk_completion_batch7,
+			disk_completion_batch8,
+
+			// the time from a batch of disk job completions being posted
+			// to the network thread until their handlers are called. The
+			// latency is less than 1 << n microseconds, where n is the
+			// number at the end of the counter name, except for the last one
+			// 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384,
+			// 32768 (and above)
+			disk_completion_latency4,
+			disk_completion_latency5,
+			disk_completion_latency6,
+			disk_completion_latency7,
+			disk_completion_latency8,
+			disk_completion_latency9,
+			disk_completion_latency10,
+			disk_completion_latency11,
+			disk_completion_latency12,
+			disk_completion_latency13,
+			disk_completion_latency14,
+			disk_completion_latency15,
+
+			// the number of blocks read ahead of being requested by
+			// posix_disk_io, and the number of read requests served from
+			// those blocks
+			disk_read_ahead_blocks,
+			disk_read_ahead_hits,
+
+			// the number of disk jobs allocated from a per-thread job cache,
+			// and the number of times a job cache had to be refilled from the
+			// shared job pool
+			disk_job_cache_hits,
+			disk_job_cache_misses,
+
+			// the number of bytes of piece data and metadata queued for
+			// sending straight from the buffer they were read into, and
+			// the number of bytes that had to be copied first, in order to
+			// be encrypted
+			send_zero_copy_bytes,
+			send_copied_bytes,
+
+			// the number of access pattern hints passed on to the kernel for
+			// memory mapped files by mmap_disk_io (see the mmap_advice
+			// setting), and the number of hints the kernel rejected
+			mmap_advise_sequential,
+			mmap_advise_will_need,
+			mmap_advise_huge_page,
+			mmap_advise_cold,
+			mmap_advise_failed,
+
+			// the number of major (requiring disk I/O) and minor page faults
+			// incurred by the disk threads of mmap_disk_io. These are sampled
+			// by each thread at most once a second
+			disk_major_page_faults,
+			disk_minor_page_faults,
+
 			num_stats_counters
 		};
 
@@ -459,6 +530,9 @@ namespace libtorrent {
 
 			num_queued_tracker_announces,
 
+			// the number of zip web seed pieces waiting to be inflated
+			queued_inflate_jobs,
+
 			num_counters,
 			num_gauges_counters = num_counters - num_stats_counters
 		};
@@ -469,12 +543,25 @@ namespace libtorrent {
 #endif
 
 		counters() TORRENT_COUNTER_NOEXCEPT;
+		~counters();
 
 		counters(counters const&) TORRENT_COUNTER_NOEXCEPT;
 		counters& operator=(counters const&) & TORRENT_COUNTER_NOEXCEPT;
 
-		// returns the new value
+		// adds ``value`` to counter ``c`` and returns the new value. This may
+		// be called from any thread. For gauges, this is cheap. For stats
+		// counters, computing the returned value means summing up the
+		// per-thread shards, use add_stats_counter() when it's not needed
 		std::int64_t inc_stats_counter(int c, std::int64_t value = 1) TORRENT_COUNTER_NOEXCEPT;
+
+		// adds ``value`` to counter ``c``, like inc_stats_counter(), without
+		// returning the new value. Stats counters are incremented in the
+		// calling thread's shard, which is cheap and doesn't touch cache
+		// lines used by other threads
+		void add_stats_counter(int c, std::int64_t value = 1) TORRENT_COUNTER_NOEXCEPT;
+
+		// reading a gauge is cheap. Reading a stats counter sums up its
+		// per-thread shards
 		std::int64_t operator[](int i) const TORRENT_COUNTER_NOEXCEPT;
 
 		void set_value(int c, std::int64_t value) TORRENT_COUNTER_NOEXCEPT;
@@ -483,11 +570,27 @@ namespace libtorrent {
 	private:
 
 		// TODO: some space could be saved here by making gauges 32 bits
-		// TODO: restore these to regular integers. Instead have one copy
-		// of the counters per thread and collect them at convenient
-		// synchronization points
 #ifdef ATOMIC_LLONG_LOCK_FREE
+		// threads increment stats counters in one of these shards, picked by
+		// aux::thread_index(). Each shard is kept on cache lines of its
+		// own, to not have threads updating counters contend on them. There
+		// are usually few enough threads for each to have a shard of its own.
+		// Gauges aren't sharded, they are read often, on the network thread,
+		// and assigned by set_value() and blend_stats_counter()
+		static constexpr int num_shards = 16;
+		struct shard;
+		std::atomic<std::int64_t>* local_shard() TORRENT_COUNTER_NOEXCEPT;
+
+		// the gauges, and the part of the stats counters not in any shard.
+		// For stats counters, this holds the values assigned by set_value(),
+		// values copied from another counters object, and increments made
+		// when a shard couldn't be allocated. The value of a stats counter
+		// is the sum of this and the counter in all shards
 		aux::array<std::atomic<std::int64_t>, num_counters> m_stats_counter;
+
+		// shards are allocated the first time a thread using it increments a
+		// counter
+		aux::array<std::atomic<shard*>, num_shards> m_shards;
 #else
 		// if the atomic type isn't lock-free, use a single lock instead, for
 		// the whole array
@@ -61,13 +61,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/flags.hpp"
 #include "libtorrent/units.hpp"
 #include "libtorrent/index_range.hpp"
+#include "libtorrent/bitfield.hpp"
 
 namespace libtorrent {
 
 	struct torrent;
 	struct peer_connection;
-	template <typename Index>
-	struct typed_bitfield;
 	struct counters;
 	struct torrent_peer;
 
@@ -230,6 +229,10 @@ namespace libtorrent {
 		void inc_refcount(piece_index_t, torrent_peer const*);
 		void dec_refcount(piece_index_t, torrent_peer const*);
 
+		// increases the peer count for each of the given pieces (is used
+		// when a run of HAVE messages is received at once)
+		void inc_refcount(span<piece_index_t const> pieces, torrent_peer const*);
+
 		// increases the peer count for the given piece
 		// (is used when a BITFIELD message is received)
 		void inc_refcount(typed_bitfield<piece_index_t> const& bitmask
@@ -268,6 +271,22 @@ namespace libtorrent {
 
 		bool have_piece(piece_index_t) const;
 
+		// returns true if we don't have the piece, it hasn't passed the hash
+		// check and it isn't filtered, i.e. whether a peer that has it is
+		// interesting
+		bool is_wanted(piece_index_t) const;
+
+		// returns the number of pieces in ``bitmask`` that are wanted, as
+		// defined by is_wanted()
+		int num_wanted_pieces(typed_bitfield<piece_index_t> const& bitmask) const;
+
+		// this changes whenever the set of wanted pieces changes, except
+		// for pieces passing the hash check (piece_passed()). Counts based
+		// on num_wanted_pieces() can be kept up to date incrementally as
+		// pieces pass, but have to be recomputed when this changes, e.g.
+		// after priorities are updated
+		std::uint32_t wanted_epoch() const { return m_wanted_epoch; }
+
 		bool is_downloading(piece_index_t const index) const
 		{
 			TORRENT_ASSERT(index >= piece_index_t(0));
@@ -543,6 +562,22 @@ namespace libtorrent {
 
 		bool can_pick(piece_index_t piece, typed_bitfield<piece_index_t> const& bitmask) const;
 		bool is_piece_free(piece_index_t piece, typed_bitfield<piece_index_t> const& bitmask) const;
+
+		// updates the bit for this piece in m_free_pieces, after its have or
+		// filtered state changed
+		void update_free_piece(piece_index_t piece);
+
+		// zero is never used, so it can mean "not computed" to users of
+		// wanted_epoch()
+		void bump_wanted_epoch()
+		{ if (++m_wanted_epoch == 0) m_wanted_epoch = 1; }
+
+		// if the peer (``bitmask``) has few of the pieces that are free to
+		// pick, the ones at or past ``start`` in m_pieces are stored in
+		// ``pieces``, in the order they appear in m_pieces (i.e. rarest first),
+		// and true is returned. Otherwise false is returned.
+		bool sparse_free_pieces(typed_bitfield<piece_index_t> const& bitmask
+			, prio_index_t start, std::vector<piece_index_t>& pieces) const;
 		index_range<piece_index_t>
 		expand_piece(piece_index_t piece, int contiguous_blocks
 			, typed_bitfield<piece_index_t> const& have
@@ -795,6 +830,16 @@ namespace libtorrent {
 		// TODO: should this be allocated lazily?
 		mutable aux::vector<piece_pos, piece_index_t> m_piece_map;
 
+		// one bit per piece, set for pieces we don't have and that aren't
+		// filtered. This mirrors have() and filtered() of the entries in
+		// m_piece_map, but packed 64 times denser. It lets is_piece_free()
+		// and the scan for pieces a peer has that we're missing stay within a
+		// few cache lines, rather than touching a piece_pos for every piece
+		typed_bitfield<piece_index_t> m_free_pieces;
+
+		// see wanted_epoch()
+		std::uint32_t m_wanted_epoch = 1;
+
 		// this indicates whether a block has been marked as a pad
 		// block or not. It's indexed by block index, i.e. piece_index
 		// * blocks_per_piece + block. These blocks should not be
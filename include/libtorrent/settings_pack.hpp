@@ -993,6 +993,20 @@ namespace aux {
 			// forbid bt connection
 			forbid_bt_connet,
 
+			// when true, the 2 MiB regions disk buffers are allocated from are
+			// backed by huge pages, where the operating system supports it
+			// (transparent huge pages on Linux). This reduces TLB pressure when
+			// moving large amounts of data through the disk buffers, at the
+			// cost of committing a whole region of memory at a time.
+			disk_buffer_huge_pages,
+
+			// when true, session::post_torrent_updates() posts a
+			// state_delta_alert, with compact records of only the fields that
+			// changed for each torrent, instead of a state_update_alert with
+			// the full torrent_status of each torrent. This is a lot cheaper
+			// for sessions with many torrents.
+			compact_state_updates,
+
 			max_bool_setting_internal
 		};
 
@@ -1435,7 +1449,8 @@ namespace aux {
 			// read cache when a read cache miss occurs. Setting this to 0 is
 			// essentially the same thing as disabling read cache. The number of
 			// blocks read into the read cache is always capped by the piece
-			// boundary.
+			// boundary. The posix disk I/O back-end keeps up to four cache
+			// lines worth of read-ahead blocks per torrent.
 			//
 			// When a piece in the write cache has ``write_cache_line_size``
 			// contiguous blocks in it, they will be flushed. Setting this to 1
@@ -1718,7 +1733,9 @@ namespace aux {
 			predictive_piece_announce,
 
 			// for some aio back-ends, ``aio_threads`` specifies the number of
-			// io-threads to use.
+			// io-threads to use. The posix disk I/O back-end uses them for
+			// reads only. When set to 0, it performs reads on the network
+			// thread.
 			aio_threads,
 
 #if TORRENT_ABI_VERSION == 1
@@ -1995,6 +2012,27 @@ namespace aux {
 			// torrent_info::parse_info_section(), if those are used.
 			max_piece_count,
 
+			// ``inflate_threads`` is the number of threads used to decompress
+			// pieces downloaded from zip web seeds. Each zip web seed
+			// connection is bound to one of these threads when it's created,
+			// so changing this setting only affects new connections.
+			inflate_threads,
+
+			// ``mmap_advice`` is a bitmask of mmap_advice_t flags, controlling
+			// which access pattern hints are passed on to the kernel (via
+			// ``madvise()``) for files memory mapped by the mmap disk I/O
+			// back-end. It has no effect on systems without ``madvise()``.
+			// The policy applies to all torrents in the session, there is no
+			// per-torrent override.
+			mmap_advice,
+
+			// ``state_update_batch_size`` is the maximum number of torrents
+			// included in a single update posted by
+			// session::post_torrent_updates(). The torrents left out are
+			// included in the next update, ahead of any torrent updated after
+			// them. 0 means there is no limit.
+			state_update_batch_size,
+
 			max_int_setting_internal
 		};
 
@@ -2057,6 +2095,32 @@ namespace aux {
 			disable_os_cache = 2
 		};
 
+		// the flags for use with settings_pack::mmap_advice
+		enum mmap_advice_t : std::uint8_t
+		{
+			// files are advised to be read sequentially while checking or
+			// hashing whole pieces
+			advise_sequential_check = 1,
+
+			// when a disk thread picks up a job, the kernel is asked to start
+			// reading in the blocks of the next few read jobs in the queue,
+			// if their files are already mapped. This lets the disk reads
+			// overlap with the jobs waiting in the queue
+			advise_prefetch_requests = 2,
+
+			// file mappings are advised to be backed by transparent huge
+			// pages. This is only supported by some file systems (e.g. tmpfs,
+			// or when ``CONFIG_READ_ONLY_THP_FOR_FS`` is enabled), on others
+			// the hint is rejected. This may reduce TLB pressure when seeding
+			// large files
+			advise_huge_pages = 4,
+
+			// once a block has been read to be sent to a peer, its pages are
+			// advised to be reclaimed first, under memory pressure. This is
+			// useful when seeding a lot more data than fits in RAM
+			advise_cold_after_upload = 8
+		};
+
 		enum bandwidth_mixed_algo_t : std::uint8_t
 		{
 			// disables the mixed mode bandwidth balancing
@@ -89,6 +89,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/deferred_handler.hpp"
 #include "libtorrent/aux_/allocating_handler.hpp"
 #include "libtorrent/aux_/announce_entry.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
 #include "libtorrent/extensions.hpp" // for add_peer_flags_t
 #include "libtorrent/ssl.hpp"
 
@@ -552,6 +553,8 @@ namespace libtorrent {
 		void set_announce_to_dht(bool b) { m_announce_to_dht = b; }
 		void set_announce_to_trackers(bool b) { m_announce_to_trackers = b; }
 		void set_announce_to_lsd(bool b) { m_announce_to_lsd = b; }
+		bool announces_anywhere() const
+		{ return m_announce_to_dht || m_announce_to_trackers || m_announce_to_lsd; }
 
 		void stop_when_ready(bool b);
 
@@ -619,6 +622,19 @@ namespace libtorrent {
 
 		void status(torrent_status* st, status_flags_t flags);
 
+		// fills in ``d`` with the parts of the torrent's status that changed
+		// since the last time this was called. ``st`` is scratch space, reused
+		// across torrents to avoid allocations. The strings that changed are
+		// appended to ``strings``, and referred to by offset. Returns false if
+		// nothing changed.
+		bool status_delta(torrent_status& st, status_flags_t flags
+			, torrent_status_delta& d, std::string& strings);
+
+		// forgets the state last reported by status_delta(), which makes the
+		// next record complete. This is used when the alert carrying a
+		// record was dropped
+		void reset_status_delta();
+
 		// this torrent changed state, if the user is subscribing to
 		// it, add it to the m_state_updates list in session_impl
 		void state_updated();
@@ -888,6 +904,10 @@ namespace libtorrent {
 		// when we get a have message, this is called for that piece
 		void peer_has(piece_index_t index, peer_connection const* peer);
 
+		// when we get a run of have messages, this is called with all of
+		// the pieces
+		void peer_has(span<piece_index_t const> pieces, peer_connection const* peer);
+
 		// when we get a bitfield message, this is called for that piece
 		void peer_has(typed_bitfield<piece_index_t> const& bits, peer_connection const* peer);
 
@@ -1332,8 +1352,16 @@ namespace libtorrent {
 		deadline_timer m_tracker_timer;
 
 		// used to detect when we are active or inactive for long enough
-		// to trigger the auto-manage logic
-		deadline_timer m_inactivity_timer;
+		// to trigger the auto-manage logic. It's scheduled with the session's
+		// timer wheel (see session_interface::torrent_timers())
+		struct inactivity_timer final : aux::timer_entry
+		{
+			explicit inactivity_timer(torrent& t) : m_torrent(t) {}
+			void on_timer() override;
+		private:
+			torrent& m_torrent;
+		};
+		inactivity_timer m_inactivity_timer;
 
 		// this is the upload and download statistics for the whole torrent.
 		// it's updated from all its peers once every second.
@@ -1421,6 +1449,11 @@ namespace libtorrent {
 		// longer be used and will be reset
 		std::unique_ptr<std::string> m_name;
 
+		// the state last reported by status_delta(). This is only allocated
+		// once compact state updates are posted for this torrent
+		struct delta_state;
+		std::unique_ptr<delta_state> m_last_delta;
+
 		// the posix time this torrent was added and when
 		// it was completed. If the torrent isn't yet
 		// completed, m_completed_time is 0
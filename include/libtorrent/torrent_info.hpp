@@ -58,6 +58,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/copy_ptr.hpp"
 #include "libtorrent/sha1_hash.hpp"
 #include "libtorrent/info_hash.hpp"
+#include "libtorrent/zip_codec.hpp"
 #include "libtorrent/file_storage.hpp"
 #include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/announce_entry.hpp"
@@ -130,9 +131,60 @@ namespace aux {
 		std::vector<std::string> urls;
 		uint64_t total_size = 0;
 		uint64_t zip_level = 0;
-		std::vector<pieces_size_t> pieces_size;
+
+		// the format the pieces are compressed in
+		zip_codec codec = zip_codec::zlib;
+
+		// the number of pieces in the piece size table
+		int num_pieces() const
+		{ return m_table ? int(m_table->sizes.size() / sizeof(std::uint32_t)) : 0; }
+
+		// returns the offset and size of the compressed piece ``index`` in
+		// the zip file. The offset is computed from the closest preceding
+		// checkpoint, summing at most 63 piece sizes.
+		pieces_size_t piece(piece_index_t index) const;
+
+		// the compressed size of every piece, in piece order. Each size is 4
+		// bytes, big-endian. This is the same format as the "pieces size"
+		// string in the ``zipinfo`` dictionary.
+		string_view piece_size_table() const
+		{ return m_table ? string_view(m_table->sizes) : string_view(); }
+
+		// sets the piece size table, in the format returned by
+		// piece_size_table(). Its size must be a multiple of 4.
+		void set_piece_size_table(string_view sizes);
+
+	private:
+
+		// the number of pieces between checkpoints
+		static constexpr int checkpoint_interval = 64;
+
+		// the table is kept in its original form, 4 bytes per piece. Offsets
+		// are not stored for every piece, only for every
+		// checkpoint_interval:th one
+		struct piece_table
+		{
+			std::string sizes;
+			std::vector<std::uint64_t> checkpoints;
+		};
+
+		// the table never changes once it's been set, it's replaced as a
+		// whole. Copies of the entry (and of the torrent_info it belongs to)
+		// share it
+		std::shared_ptr<piece_table const> m_table;
 	};
 
+namespace aux {
+
+	// parses the ``zipinfo`` dictionary of a torrent file (or of resume
+	// data) into ``ret``, which is left untouched if it fails. It fails if
+	// the dictionary is invalid, if its piece size table doesn't have
+	// ``num_pieces`` entries or if the pieces are compressed with a codec
+	// this build doesn't support
+	TORRENT_EXTRA_EXPORT bool parse_zip_info(bdecode_node const& zip_info
+		, int num_pieces, zip_web_seed_entry& ret);
+}
+
 	// hidden
 	class from_span_t {};
 
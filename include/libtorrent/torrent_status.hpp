@@ -591,6 +591,99 @@ TORRENT_VERSION_NAMESPACE_3
 		torrent_flags_t flags{};
 	};
 
+	using delta_fields_t = flags::bitfield_flag<std::uint32_t, struct delta_fields_tag>;
+
+	// a compact record of the parts of a torrent's status that changed since
+	// the previous record for the same torrent. These are posted in a
+	// state_delta_alert, when the session is set to post compact state
+	// updates (see settings_pack::compact_state_updates). The members hold
+	// the current values, ``fields`` indicates which of them changed. The
+	// strings are only included when they changed. In the first record
+	// posted for a torrent, all fields are marked as changed.
+	struct TORRENT_EXPORT torrent_status_delta
+	{
+		// the ``state``
+		static constexpr delta_fields_t state_field = 0_bit;
+
+		// the torrent ``flags``
+		static constexpr delta_fields_t flags_field = 1_bit;
+
+		// ``progress_ppm``
+		static constexpr delta_fields_t progress_field = 2_bit;
+
+		// ``download_payload_rate`` and ``upload_payload_rate``
+		static constexpr delta_fields_t rates_field = 3_bit;
+
+		// ``num_peers`` and ``num_seeds``
+		static constexpr delta_fields_t peers_field = 4_bit;
+
+		// ``total_done``, ``total_wanted_done``, ``total_wanted``,
+		// ``total_payload_download``, ``total_payload_upload``,
+		// ``all_time_download`` and ``all_time_upload``
+		static constexpr delta_fields_t transfer_field = 5_bit;
+
+		// ``queue_position``
+		static constexpr delta_fields_t queue_position_field = 6_bit;
+
+		// ``num_pieces``, ``is_seeding``, ``is_finished``, ``has_metadata``
+		// and ``need_save_resume``
+		static constexpr delta_fields_t pieces_field = 7_bit;
+
+		// ``errc`` and ``error_file``
+		static constexpr delta_fields_t error_field = 8_bit;
+
+		// the name, save path and current tracker, see
+		// state_delta_alert::name(), save_path() and current_tracker()
+		static constexpr delta_fields_t name_field = 9_bit;
+		static constexpr delta_fields_t save_path_field = 10_bit;
+		static constexpr delta_fields_t tracker_field = 11_bit;
+
+		// identifies the torrent this record belongs to. This is the same
+		// as torrent_handle::id().
+		std::uint32_t id = 0;
+
+		// the fields that changed since the previous record
+		delta_fields_t fields{};
+
+		// the members below have the same meaning as their counterparts in
+		// torrent_status
+		torrent_status::state_t state = torrent_status::checking_resume_data;
+		torrent_flags_t flags{};
+		int progress_ppm = 0;
+
+		int download_payload_rate = 0;
+		int upload_payload_rate = 0;
+
+		int num_peers = 0;
+		int num_seeds = 0;
+
+		std::int64_t total_done = 0;
+		std::int64_t total_wanted_done = 0;
+		std::int64_t total_wanted = 0;
+		std::int64_t total_payload_download = 0;
+		std::int64_t total_payload_upload = 0;
+		std::int64_t all_time_download = 0;
+		std::int64_t all_time_upload = 0;
+
+		queue_position_t queue_position{};
+
+		int num_pieces = 0;
+		bool is_seeding = false;
+		bool is_finished = false;
+		bool has_metadata = false;
+		bool need_save_resume = false;
+
+		error_code errc;
+		file_index_t error_file = torrent_status::error_file_none;
+
+		// the offsets of the strings in the alert they were posted in. Use
+		// state_delta_alert::name(), save_path() and current_tracker() to
+		// access them.
+		int name_offset = -1;
+		int save_path_offset = -1;
+		int tracker_offset = -1;
+	};
+
 TORRENT_VERSION_NAMESPACE_3_END
 } // namespace libtorrent
 
@@ -36,6 +36,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "libtorrent/web_peer_connection.hpp"
+#include "libtorrent/aux_/inflate_thread_pool.hpp"
+#include "libtorrent/span.hpp"
+
+#include <vector>
 
 namespace libtorrent {
 
@@ -48,10 +52,7 @@ namespace libtorrent {
 		// The peer_connection should handshake and verify that the
 		// other end has the correct id
 		web_zip_peer_connection(peer_connection_args& pack
-			, web_seed_t& web) :web_peer_connection(pack, web){
-			m_picker_options |= piece_picker::align_expanded_pieces;
-			m_picker_options |= piece_picker::on_parole;
-		}
+			, web_seed_t& web);
 
 		// void on_connected() override;
 
@@ -62,8 +63,28 @@ namespace libtorrent {
 		void send_block_requests() override;
 		void incoming_payload(char const* buf, int len) override;
 		void write_request(peer_request const& r) override;
+
+		// issue a single range request covering the pieces in ``rs``, which
+		// must be stored back-to-back in the zip file
+		void write_requests(span<peer_request const> rs);
 		void incoming_piece_fragment(int const bytes);
 
+		// called on the network thread once the inflate thread pool is done
+		// with a chunk of the piece requested by r. ``start`` is the offset
+		// into the piece of the first block
+		void on_blocks_inflated(error_code const& ec, peer_request const& r
+			, int start, std::vector<disk_buffer_holder> blocks);
+
+		// the inflate_thread_pool stream the compressed pieces of this
+		// connection are fed to, as they arrive
+		std::shared_ptr<aux::inflate_stream> m_inflate_stream;
+
+		// compressed bytes not yet handed to the inflate stream. They are
+		// passed on about one block at a time
+		std::vector<char> m_inflate_input;
+
+		// the number of compressed bytes received for the front request
+		int m_zip_received = 0;
 	};
 }
 
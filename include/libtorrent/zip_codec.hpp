@@ -0,0 +1,71 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_ZIP_CODEC_HPP_INCLUDED
+#define TORRENT_ZIP_CODEC_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/string_view.hpp"
+
+#include <cstdint>
+
+namespace libtorrent {
+
+	// the compression format of the pieces served by a zip web seed. Every
+	// piece is compressed on its own, in the format specified by the
+	// "codec" key in the ``zipinfo`` dictionary.
+	enum class zip_codec : std::uint8_t
+	{
+		// zlib streams, as produced by zlib's ``compress2()``. This is the
+		// default, when the ``zipinfo`` dictionary has no "codec" key.
+		zlib,
+
+		// zstandard frames. This decompresses several times faster than
+		// zlib, at a similar ratio. It's only supported if libtorrent is
+		// built with zstd support (``TORRENT_USE_ZSTD``).
+		zstd,
+	};
+
+	// returns true if this build of libtorrent can compress and decompress
+	// pieces in the specified format.
+	TORRENT_EXPORT bool zip_codec_supported(zip_codec c);
+
+	// returns the name of the codec, as stored in the "codec" key of the
+	// ``zipinfo`` dictionary.
+	TORRENT_EXPORT char const* zip_codec_name(zip_codec c);
+
+	// parses the name of a codec. Returns false if the name isn't
+	// recognized.
+	TORRENT_EXPORT bool parse_zip_codec(string_view name, zip_codec& c);
+}
+
+#endif // TORRENT_ZIP_CODEC_HPP_INCLUDED
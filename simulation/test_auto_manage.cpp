@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "simulator/simulator.hpp"
 #include "simulator/utils.hpp" // for timer
 #include <iostream>
+#include <set>
 
 using namespace sim;
 using namespace lt;
@@ -909,6 +910,76 @@ TORRENT_TEST(pause_completed_torrents)
 		});
 }
 
+// torrents the auto manager has paused are skipped by later passes, as long as
+// they stay outside of the active set. Moving one of them to the front of the
+// queue must still start it, and pause the one it pushed out of the active
+// set, leaving the torrents at the front of the queue active
+TORRENT_TEST(move_paused_torrent_to_front)
+{
+	sim::default_config network_cfg;
+	sim::simulation sim{network_cfg};
+	std::unique_ptr<sim::asio::io_context> ios = make_io_context(sim, 0);
+	lt::session_proxy zombie;
+
+	lt::settings_pack pack = settings();
+	pack.set_bool(settings_pack::dont_count_slow_torrents, false);
+	pack.set_int(settings_pack::active_downloads, 3);
+	std::shared_ptr<lt::session> ses = std::make_shared<lt::session>(pack, *ios);
+
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		lt::add_torrent_params params = ::create_torrent(i, false);
+		params.flags |= torrent_flags::auto_managed;
+		params.flags |= torrent_flags::paused;
+		ses->async_add_torrent(params);
+	}
+
+	// the queue positions of the torrents that are started
+	auto started_positions = [&]
+	{
+		std::set<int> ret;
+		for (torrent_handle const& h : ses->get_torrents())
+		{
+			torrent_status const st = h.status();
+			if (!(st.flags & torrent_flags::paused))
+				ret.insert(static_cast<int>(st.queue_position));
+		}
+		return ret;
+	};
+	std::set<int> const front_of_queue{0, 1, 2};
+
+	torrent_handle moved;
+	sim::timer t1(sim, lt::seconds(num_torrents * 60)
+		, [&](boost::system::error_code const&)
+	{
+		TEST_CHECK(started_positions() == front_of_queue);
+
+		// the last torrent in the queue was paused by an earlier pass
+		for (torrent_handle const& h : ses->get_torrents())
+		{
+			torrent_status const st = h.status();
+			if (st.queue_position != queue_position_t{num_torrents - 1}) continue;
+			TEST_CHECK(st.flags & torrent_flags::paused);
+			moved = h;
+		}
+		TEST_CHECK(moved.is_valid());
+		moved.queue_position_top();
+	});
+
+	sim::timer t2(sim, lt::seconds((num_torrents + 2) * 60)
+		, [&](boost::system::error_code const&)
+	{
+		TEST_CHECK(started_positions() == front_of_queue);
+		torrent_status const st = moved.status();
+		TEST_EQUAL(st.queue_position, queue_position_t{0});
+		TEST_CHECK(!(st.flags & torrent_flags::paused));
+
+		zombie = ses->abort();
+		ses.reset();
+	});
+
+	sim.run();
+}
 
 // TODO: assert that the torrent_paused_alert is posted when pausing
 //       downloading, seeding, checking torrents as well as the graceful pause
@@ -2241,7 +2241,8 @@ namespace {
 		return arr;
 	}
 }
-#else
+#endif
+
 namespace {
 	template <typename T, typename U>
 	T* align_pointer(U* ptr)
@@ -2250,7 +2251,6 @@ namespace {
 			& ~(alignof(T) - 1));
 	}
 }
-#endif
 
 #if TORRENT_ABI_VERSION == 1
 	session_stats_alert::session_stats_alert(aux::stack_allocator&, struct counters const& cnt)
@@ -3001,7 +3001,7 @@ namespace {
 		"picker_log", "session_error", "dht_live_nodes",
 		"session_stats_header", "dht_sample_infohashes",
 		"block_uploaded", "alerts_dropped", "socks5",
-		"file_prio"
+		"file_prio", "state_delta"
 		}};
 
 		TORRENT_ASSERT(alert_type >= 0);
@@ -3060,6 +3060,50 @@ namespace {
 #endif
 	}
 
+	state_delta_alert::state_delta_alert(aux::stack_allocator& alloc
+		, span<torrent_status_delta const> d, string_view strings)
+		: m_alloc(alloc)
+		, m_deltas_idx(alloc.allocate(int(sizeof(torrent_status_delta) * std::size_t(d.size())
+			+ alignof(torrent_status_delta) - 1)))
+		, m_strings_idx(alloc.copy_buffer(strings))
+		, m_num_deltas(int(d.size()))
+	{
+		std::uninitialized_copy(d.begin(), d.end()
+			, align_pointer<torrent_status_delta>(alloc.ptr(m_deltas_idx)));
+	}
+
+	std::string state_delta_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char msg[100];
+		std::snprintf(msg, sizeof(msg), "state deltas for %d torrents", m_num_deltas);
+		return msg;
+#endif
+	}
+
+	span<torrent_status_delta const> state_delta_alert::deltas() const
+	{
+		return { align_pointer<torrent_status_delta const>(m_alloc.get().ptr(m_deltas_idx))
+			, m_num_deltas };
+	}
+
+	char const* state_delta_alert::string_at(int const offset) const
+	{
+		if (offset < 0) return nullptr;
+		return m_alloc.get().ptr(m_strings_idx) + offset;
+	}
+
+	char const* state_delta_alert::name(torrent_status_delta const& d) const
+	{ return string_at(d.name_offset); }
+
+	char const* state_delta_alert::save_path(torrent_status_delta const& d) const
+	{ return string_at(d.save_path_offset); }
+
+	char const* state_delta_alert::current_tracker(torrent_status_delta const& d) const
+	{ return string_at(d.tracker_offset); }
+
 	// this will no longer be necessary in C++17
 	constexpr alert_category_t torrent_removed_alert::static_category;
 	constexpr alert_category_t read_piece_alert::static_category;
@@ -3152,6 +3196,7 @@ namespace {
 	constexpr alert_category_t alerts_dropped_alert::static_category;
 	constexpr alert_category_t socks5_alert::static_category;
 	constexpr alert_category_t file_prio_alert::static_category;
+	constexpr alert_category_t state_delta_alert::static_category;
 #if TORRENT_ABI_VERSION == 1
 	constexpr alert_category_t anonymous_mode_alert::static_category;
 	constexpr alert_category_t mmap_cache_alert::static_category;
@@ -37,6 +37,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/alert_manager.hpp"
 #include "libtorrent/alert_types.hpp"
 
+#include <thread> // for yield
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 #include "libtorrent/extensions.hpp"
 #include <memory> // for shared_ptr
@@ -48,7 +50,10 @@ namespace aux {
 	alert_manager::alert_manager(int const queue_limit, alert_category_t const alert_mask)
 		: m_alert_mask(alert_mask)
 		, m_queue_size_limit(queue_limit)
-	{}
+	{
+		for (auto& d : m_dropped) d.store(0, std::memory_order_relaxed);
+		for (auto& p : m_pending) p.store(false, std::memory_order_relaxed);
+	}
 
 	alert_manager::~alert_manager() = default;
 
@@ -56,25 +61,48 @@ namespace aux {
 	{
 		std::unique_lock<std::recursive_mutex> lock(m_mutex);
 
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+		// the producer notifies without holding the mutex while posting, so a
+		// notification may be for alerts that have already been drained. Keep
+		// waiting until there actually are alerts
+		if (!pending())
+			m_condition.wait_for(lock, max_wait, [this] { return pending(); });
+		return front_alert();
+	}
+
+	alert* alert_manager::front_alert()
+	{
+		std::uint32_t seq = m_producer_seq.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			TORRENT_ASSERT((seq & consumer_reading) == 0);
+			if (seq & producer_active)
+			{
+				std::this_thread::yield();
+				seq = m_producer_seq.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (m_producer_seq.compare_exchange_weak(seq, seq | consumer_reading
+				, std::memory_order_acquire))
+				break;
+		}
 
-		// this call can be interrupted prematurely by other signals
-		m_condition.wait_for(lock, max_wait);
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+		heterogeneous_queue<alert>& queue
+			= m_alerts[m_generation.load(std::memory_order_relaxed)];
+		alert* const a = queue.empty() ? nullptr : queue.front();
 
-		return nullptr;
+		m_producer_seq.fetch_and(~consumer_reading, std::memory_order_release);
+		return a;
 	}
 
-	void alert_manager::maybe_notify(alert* a)
+	void alert_manager::maybe_notify(alert* a, bool const first)
 	{
-		if (m_alerts[m_generation].size() == 1)
+		if (first)
 		{
 			// we just posted to an empty queue. If anyone is waiting for
 			// alerts, we need to notify them. Also (potentially) call the
 			// user supplied m_notify callback to let the client wake up its
 			// message loop to poll for alerts.
+			std::lock_guard<std::recursive_mutex> lock(m_mutex);
 			if (m_notify) m_notify();
 
 			// TODO: 2 keep a count of the number of threads waiting. Only if it's
@@ -90,11 +118,17 @@ namespace aux {
 #endif
 	}
 
+	void alert_manager::set_dropped(int const type) noexcept
+	{
+		m_dropped[type / 64].fetch_or(std::uint64_t(1) << (type % 64)
+			, std::memory_order_relaxed);
+	}
+
 	void alert_manager::set_notify_function(std::function<void()> const& fun)
 	{
 		std::unique_lock<std::recursive_mutex> lock(m_mutex);
 		m_notify = fun;
-		if (!m_alerts[m_generation].empty())
+		if (pending())
 		{
 			if (m_notify) m_notify();
 		}
@@ -109,40 +143,73 @@ namespace aux {
 
 	void alert_manager::get_all(std::vector<alert*>& alerts)
 	{
+		// only one consumer at a time. The producer doesn't take this mutex
+		// (other than to notify)
 		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 
-		if (m_alerts[m_generation].empty())
+		int const gen = m_generation.load(std::memory_order_relaxed);
+		if (!m_pending[gen].load(std::memory_order_acquire))
 		{
 			alerts.clear();
 			return;
 		}
 
-		if (m_dropped.any()) {
-			emplace_alert<alerts_dropped_alert>(m_dropped);
-			m_dropped.reset();
+		// clear the one the producer will start writing to now. These are the
+		// alerts passed to the client in the previous call
+		int const next = gen ^ 1;
+		m_alerts[next].clear();
+		m_allocations[next].reset();
+		m_pending[next].store(false, std::memory_order_relaxed);
+
+		// swap buffers
+		m_generation.store(next, std::memory_order_seq_cst);
+
+		// the producer may have loaded the old generation before we swapped
+		// it, and still be in the middle of posting an alert to it. If so,
+		// wait for it to finish. This is never longer than constructing a
+		// single alert, and the producer can't be waiting on us
+		std::uint32_t const seq = m_producer_seq.load(std::memory_order_seq_cst);
+		if (seq & producer_active)
+		{
+			while (m_producer_seq.load(std::memory_order_acquire) == seq)
+				std::this_thread::yield();
 		}
 
-		m_alerts[m_generation].get_pointers(alerts);
+		// m_alerts[gen] is now exclusively ours
+		std::bitset<abi_alert_count> dropped;
+		for (int i = 0; i < abi_alert_count; i += 64)
+		{
+			std::uint64_t const d = m_dropped[i / 64].exchange(0, std::memory_order_relaxed);
+			for (int k = 0; k < 64 && i + k < abi_alert_count; ++k)
+				if (d & (std::uint64_t(1) << k)) dropped.set(std::size_t(i + k));
+		}
 
-		// swap buffers
-		m_generation = (m_generation + 1) & 1;
-		// clear the one we will start writing to now
-		m_alerts[m_generation].clear();
-		m_allocations[m_generation].reset();
+		if (dropped.any())
+		{
+			try
+			{
+				m_alerts[gen].emplace_back<alerts_dropped_alert>(m_allocations[gen], dropped);
+			}
+			catch (std::bad_alloc const&)
+			{
+				// report them the next time instead
+				for (int i = 0; i < abi_alert_count; ++i)
+					if (dropped.test(std::size_t(i))) set_dropped(i);
+			}
+		}
+
+		m_alerts[gen].get_pointers(alerts);
 	}
 
 	bool alert_manager::pending() const
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		return !m_alerts[m_generation].empty();
+		return m_pending[m_generation.load(std::memory_order_acquire)]
+			.load(std::memory_order_acquire);
 	}
 
-	int alert_manager::set_alert_queue_size_limit(int queue_size_limit_)
+	int alert_manager::set_alert_queue_size_limit(int const queue_size_limit_)
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-
-		std::swap(m_queue_size_limit, queue_size_limit_);
-		return queue_size_limit_;
+		return m_queue_size_limit.exchange(queue_size_limit_);
 	}
 }
 }
@@ -36,12 +36,296 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
 
+#include <algorithm> // for min
+
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+#if TORRENT_HAS_SSE
+#include <immintrin.h>
+#endif
+
+#if TORRENT_HAS_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// the AVX2 and AVX-512 kernels are built regardless of the instruction set
+// the rest of the library targets, and only called if cpuid says the CPU
+// supports them. GCC and clang need to be told which functions may use them
+#if TORRENT_HAS_SSE && defined __GNUC__
+#define TORRENT_TARGET(x) __attribute__((target(x)))
+#else
+#define TORRENT_TARGET(x)
+#endif
+
+#if TORRENT_HAS_SSE && (defined __GNUC__ || (defined _MSC_VER && _MSC_VER >= 1700))
+#define TORRENT_HAS_AVX2 1
+#else
+#define TORRENT_HAS_AVX2 0
+#endif
+
+// the VPOPCNTDQ intrinsics were added in GCC 8, clang 6 and MSVC 2019
+#if TORRENT_HAS_SSE && ((defined __clang__ && __clang_major__ >= 6) \
+	|| (defined __GNUC__ && !defined __clang__ && __GNUC__ >= 8) \
+	|| (defined _MSC_VER && _MSC_VER >= 1920))
+#define TORRENT_HAS_AVX512_POPCNT 1
+#else
+#define TORRENT_HAS_AVX512_POPCNT 0
+#endif
+
 namespace libtorrent {
 
+namespace {
+
+	// the operation the counting kernels apply to each pair of words before
+	// counting the bits. op_none only looks at the first range
+	enum bit_op { op_none, op_and, op_and_not };
+
+	template <bit_op Op>
+	std::uint32_t combine(std::uint32_t const* a, std::uint32_t const* b, int const i) noexcept
+	{
+		return Op == op_none ? a[i]
+			: Op == op_and ? (a[i] & b[i])
+			: (a[i] & ~b[i]);
+	}
+
+	int popcount_sw(std::uint32_t const v) noexcept
+	{
+#if defined __GNUC__ || defined __clang__
+		return __builtin_popcount(v);
+#else
+		// from:
+		// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+		static const int S[] = {1, 2, 4, 8, 16}; // Magic Binary Numbers
+		static const std::uint32_t B[] = {0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF};
+
+		std::uint32_t c = v - ((v >> 1) & B[0]);
+		c = ((c >> S[1]) & B[1]) + (c & B[1]);
+		c = ((c >> S[2]) + c) & B[2];
+		c = ((c >> S[3]) + c) & B[3];
+		c = ((c >> S[4]) + c) & B[4];
+		return int(c);
+#endif
+	}
+
+	template <bit_op Op>
+	int count_sw(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		int ret = 0;
+		for (int i = 0; i < words; ++i)
+			ret += popcount_sw(combine<Op>(a, b, i));
+		return ret;
+	}
+
+	int find_and_sw(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, int i) noexcept
+	{
+		for (; i < words; ++i)
+			if ((a[i] & b[i]) != 0) return i;
+		return words;
+	}
+
+#if TORRENT_HAS_SSE
+	template <bit_op Op>
+	TORRENT_TARGET("popcnt")
+	int count_popcnt(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		int ret = 0;
+		for (int i = 0; i < words; ++i)
+			ret += int(_mm_popcnt_u32(combine<Op>(a, b, i)));
+		return ret;
+	}
+#endif
+
+#if TORRENT_HAS_AVX2
+	template <bit_op Op>
+	TORRENT_TARGET("avx2")
+	__m256i combine_avx2(std::uint32_t const* a, std::uint32_t const* b, int const i) noexcept
+	{
+		__m256i const va = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+		if (Op == op_none) return va;
+		__m256i const vb = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+		return Op == op_and ? _mm256_and_si256(va, vb) : _mm256_andnot_si256(vb, va);
+	}
+
+	// AVX2 has no popcount instruction. Instead, each nibble is looked up in
+	// a 16 entry table with a byte shuffle, and the per-byte counts are
+	// summed into four 64 bit lanes with a sum of absolute differences
+	// against zero
+	template <bit_op Op>
+	TORRENT_TARGET("avx2,popcnt")
+	int count_avx2(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		__m256i const lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+			, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		__m256i const low_mask = _mm256_set1_epi8(0x0f);
+		__m256i const zero = _mm256_setzero_si256();
+		__m256i acc = zero;
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i const v = combine_avx2<Op>(a, b, i);
+			__m256i const lo = _mm256_and_si256(v, low_mask);
+			__m256i const hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+			__m256i const cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo)
+				, _mm256_shuffle_epi8(lookup, hi));
+			acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, zero));
+		}
+		alignas(32) std::uint64_t lanes[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+		std::uint64_t ret = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		for (; i < words; ++i)
+			ret += _mm_popcnt_u32(combine<Op>(a, b, i));
+		return int(ret);
+	}
+
+	TORRENT_TARGET("avx2")
+	int find_and_avx2(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, int i) noexcept
+	{
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i const va = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+			__m256i const vb = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+			if (!_mm256_testz_si256(va, vb)) break;
+		}
+		return find_and_sw(a, b, words, i);
+	}
+#endif // TORRENT_HAS_AVX2
+
+#if TORRENT_HAS_AVX512_POPCNT
+	// the last, partial, block is loaded with a mask, the masked-off words
+	// read as zero
+	template <bit_op Op>
+	TORRENT_TARGET("avx512f")
+	__m512i combine_avx512(std::uint32_t const* a, std::uint32_t const* b
+		, int const i, __mmask16 const m) noexcept
+	{
+		__m512i const va = _mm512_maskz_loadu_epi32(m, a + i);
+		if (Op == op_none) return va;
+		__m512i const vb = _mm512_maskz_loadu_epi32(m, b + i);
+		return Op == op_and ? _mm512_and_si512(va, vb) : _mm512_maskz_andnot_epi32(m, vb, va);
+	}
+
+	__mmask16 tail_mask(int const words, int const i) noexcept
+	{
+		return words - i >= 16 ? __mmask16(0xffff)
+			: __mmask16((1u << (words - i)) - 1);
+	}
+
+	template <bit_op Op>
+	TORRENT_TARGET("avx512f,avx512vpopcntdq")
+	int count_avx512(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		__m512i acc = _mm512_setzero_si512();
+		for (int i = 0; i < words; i += 16)
+		{
+			__m512i const v = combine_avx512<Op>(a, b, i, tail_mask(words, i));
+			acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+		}
+		alignas(64) std::uint64_t lanes[8];
+		_mm512_store_si512(lanes, acc);
+		std::uint64_t ret = 0;
+		for (auto const l : lanes) ret += l;
+		return int(ret);
+	}
+
+	TORRENT_TARGET("avx512f")
+	int find_and_avx512(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, int i) noexcept
+	{
+		for (; i < words; i += 16)
+		{
+			__mmask16 const m = tail_mask(words, i);
+			__m512i const va = _mm512_maskz_loadu_epi32(m, a + i);
+			__m512i const vb = _mm512_maskz_loadu_epi32(m, b + i);
+			if (_mm512_test_epi32_mask(va, vb) != 0) break;
+		}
+		return find_and_sw(a, b, words, i);
+	}
+#endif // TORRENT_HAS_AVX512_POPCNT
+
+#if TORRENT_HAS_ARM_NEON
+	template <bit_op Op>
+	uint32x4_t combine_neon(std::uint32_t const* a, std::uint32_t const* b, int const i) noexcept
+	{
+		uint32x4_t const va = vld1q_u32(a + i);
+		if (Op == op_none) return va;
+		uint32x4_t const vb = vld1q_u32(b + i);
+		return Op == op_and ? vandq_u32(va, vb) : vbicq_u32(va, vb);
+	}
+
+	template <bit_op Op>
+	int count_neon(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		uint32x4_t acc = vdupq_n_u32(0);
+		int i = 0;
+		for (; i + 4 <= words; i += 4)
+		{
+			uint8x16_t const cnt = vcntq_u8(vreinterpretq_u8_u32(combine_neon<Op>(a, b, i)));
+			acc = vpadalq_u16(acc, vpaddlq_u8(cnt));
+		}
+		uint64x2_t const sum = vpaddlq_u32(acc);
+		int ret = int(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+		for (; i < words; ++i)
+			ret += popcount_sw(combine<Op>(a, b, i));
+		return ret;
+	}
+
+	int find_and_neon(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, int i) noexcept
+	{
+		for (; i + 4 <= words; i += 4)
+		{
+			uint32x4_t const v = combine_neon<op_and>(a, b, i);
+			uint32x2_t const r = vorr_u32(vget_low_u32(v), vget_high_u32(v));
+			if ((vget_lane_u32(r, 0) | vget_lane_u32(r, 1)) != 0) break;
+		}
+		return find_and_sw(a, b, words, i);
+	}
+#endif // TORRENT_HAS_ARM_NEON
+
+	// counts the bits set in ``words`` words of a, combined with b according
+	// to Op, using the widest instructions the CPU supports
+	template <bit_op Op>
+	int count_bits(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+#if TORRENT_HAS_AVX512_POPCNT
+		if (aux::avx512_popcnt_support) return count_avx512<Op>(a, b, words);
+#endif
+#if TORRENT_HAS_AVX2
+		if (aux::avx2_support) return count_avx2<Op>(a, b, words);
+#endif
+#if TORRENT_HAS_SSE
+		// mmx_support is really the popcnt cpuid bit
+		if (aux::mmx_support) return count_popcnt<Op>(a, b, words);
+#endif
+#if TORRENT_HAS_ARM_NEON
+		if (aux::arm_neon_support) return count_neon<Op>(a, b, words);
+#endif
+		return count_sw<Op>(a, b, words);
+	}
+
+	// returns the index of the first word, at or after i, that has a bit set
+	// in both a and b. Returns words if there is none
+	int find_and(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, int const i) noexcept
+	{
+#if TORRENT_HAS_AVX512_POPCNT
+		if (aux::avx512_popcnt_support) return find_and_avx512(a, b, words, i);
+#endif
+#if TORRENT_HAS_AVX2
+		if (aux::avx2_support) return find_and_avx2(a, b, words, i);
+#endif
+#if TORRENT_HAS_ARM_NEON
+		if (aux::arm_neon_support) return find_and_neon(a, b, words, i);
+#endif
+		return find_and_sw(a, b, words, i);
+	}
+} // anonymous namespace
+
 	bool bitfield::all_set() const noexcept
 	{
 		if(size() == 0) return false;
@@ -62,77 +346,56 @@ namespace libtorrent {
 
 	int bitfield::count() const noexcept
 	{
-		int ret = 0;
 		int const words = num_words();
-#if TORRENT_HAS_SSE
-		if (aux::mmx_support)
-		{
-			for (int i = 1; i < words + 1; ++i)
-			{
-#ifdef __GNUC__
-				std::uint32_t cnt = 0;
-				__asm__("popcnt %1, %0"
-					: "=r"(cnt)
-					: "r"(m_buf[i]));
-				ret += cnt;
-#else
-				ret += _mm_popcnt_u32(m_buf[i]);
-#endif
-			}
+		if (words == 0) return 0;
+		int const ret = count_bits<op_none>(buf(), nullptr, words);
+		TORRENT_ASSERT(ret <= size());
+		TORRENT_ASSERT(ret >= 0);
+		return ret;
+	}
 
-			TORRENT_ASSERT(ret <= size());
-			TORRENT_ASSERT(ret >= 0);
-			return ret;
-		}
-#endif // TORRENT_HAS_SSE
+	int bitfield::count_and(bitfield const& rhs) const noexcept
+	{
+		TORRENT_ASSERT(rhs.size() == size());
+		int const words = std::min(num_words(), rhs.num_words());
+		if (words == 0) return 0;
+		int const ret = count_bits<op_and>(buf(), rhs.buf(), words);
+		TORRENT_ASSERT(ret <= size());
+		TORRENT_ASSERT(ret >= 0);
+		return ret;
+	}
 
-#if TORRENT_HAS_ARM_NEON && defined __arm__
-		if (aux::arm_neon_support)
-		{
-			for (int i = 1; i < words + 1; ++i)
-			{
-				std::uint32_t cnt;
-				__asm__(
-					"vld1.u32 d0[0], [%1] \n"
-					"vcnt.u8 d0, d0 \n"
-					"vpaddl.u8 d0, d0 \n"
-					"vpaddl.u16 d0, d0 \n"
-					"vst1.u32 d0[0], [%0]"
-					:: "r"(&cnt), "r"(&m_buf[i])
-					: "d0", "memory");
-				ret += cnt;
-			}
+	int bitfield::count_and_not(bitfield const& rhs) const noexcept
+	{
+		TORRENT_ASSERT(rhs.size() == size());
+		int const words = std::min(num_words(), rhs.num_words());
+		if (words == 0) return 0;
+		int const ret = count_bits<op_and_not>(buf(), rhs.buf(), words);
+		TORRENT_ASSERT(ret <= size());
+		TORRENT_ASSERT(ret >= 0);
+		return ret;
+	}
 
-			TORRENT_ASSERT(ret <= size());
-			TORRENT_ASSERT(ret >= 0);
-			return ret;
-		}
-#endif // TORRENT_HAS_ARM_NEON
+	int bitfield::find_next_set_and(bitfield const& rhs, int const start) const noexcept
+	{
+		TORRENT_ASSERT(rhs.size() == size());
+		TORRENT_ASSERT(start >= 0);
+		if (start >= std::min(size(), rhs.size())) return -1;
 
-		for (int i = 1; i < words + 1; ++i)
+		std::uint32_t const* a = buf();
+		std::uint32_t const* b = rhs.buf();
+		int const words = std::min(num_words(), rhs.num_words());
+
+		// the first word may be partial
+		int w = start / 32;
+		std::uint32_t v = a[w] & b[w] & aux::host_to_network(0xffffffffu >> (start & 31));
+		if (v == 0)
 		{
-#if defined __GNUC__ || defined __clang__
-			ret += __builtin_popcountl(m_buf[i]);
-#else
-			std::uint32_t const v = m_buf[i];
-			// from:
-			// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-			static const int S[] = {1, 2, 4, 8, 16}; // Magic Binary Numbers
-			static const std::uint32_t B[] = {0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF};
-
-			std::uint32_t c = v - ((v >> 1) & B[0]);
-			c = ((c >> S[1]) & B[1]) + (c & B[1]);
-			c = ((c >> S[2]) + c) & B[2];
-			c = ((c >> S[3]) + c) & B[3];
-			c = ((c >> S[4]) + c) & B[4];
-			ret += c;
-			TORRENT_ASSERT(ret <= size());
-#endif
+			w = find_and(a, b, words, w + 1);
+			if (w == words) return -1;
+			v = a[w] & b[w];
 		}
-
-		TORRENT_ASSERT(ret <= size());
-		TORRENT_ASSERT(ret >= 0);
-		return ret;
+		return w * 32 + aux::count_leading_zeros({&v, 1});
 	}
 
 	void bitfield::resize(int const bits, bool const val)
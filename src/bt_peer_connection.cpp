@@ -352,7 +352,7 @@ namespace {
 		aux::write_uint16(listen_port, ptr);
 		send_buffer(msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_dht_port);
+		stats_counters().add_stats_counter(counters::num_outgoing_dht_port);
 	}
 
 	template<class F, typename... Args>
@@ -399,7 +399,7 @@ namespace {
 	{
 		INVARIANT_CHECK;
 
-		stats_counters().inc_stats_counter(counters::piece_rejects);
+		stats_counters().add_stats_counter(counters::piece_rejects);
 
 		if (!m_supports_fast) return;
 
@@ -1703,7 +1703,7 @@ namespace {
 
 		send_buffer({buf, ptr - buf});
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_extended);
+		stats_counters().add_stats_counter(counters::num_outgoing_extended);
 	}
 
 	void bt_peer_connection::write_hash_request(hash_request const& req)
@@ -1730,7 +1730,7 @@ namespace {
 		aux::write_uint32(req.count, ptr);
 		aux::write_uint32(req.proof_layers, ptr);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_hash_request);
+		stats_counters().add_stats_counter(counters::num_outgoing_hash_request);
 
 		m_hash_requests.push_back(req);
 
@@ -1773,7 +1773,7 @@ namespace {
 		for (auto const& h : hashes)
 			ptr = std::copy(h.begin(), h.end(), ptr);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_hashes);
+		stats_counters().add_stats_counter(counters::num_outgoing_hashes);
 
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(peer_log_alert::outgoing_message))
@@ -1804,7 +1804,7 @@ namespace {
 		aux::write_uint32(req.count, ptr);
 		aux::write_uint32(req.proof_layers, ptr);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_hash_reject);
+		stats_counters().add_stats_counter(counters::num_outgoing_hash_reject);
 
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(peer_log_alert::outgoing_message))
@@ -2081,7 +2081,7 @@ namespace {
 			)
 			disconnect(errors::upload_upload_connection, operation_t::bittorrent);
 
-		stats_counters().inc_stats_counter(counters::num_incoming_ext_handshake);
+		stats_counters().add_stats_counter(counters::num_incoming_ext_handshake);
 	}
 
 	bool bt_peer_connection::dispatch_message(int const received)
@@ -2170,7 +2170,7 @@ namespace {
 				? counters::num_incoming_suggest + packet_type
 				: counters::num_incoming_extended;
 
-			stats_counters().inc_stats_counter(counter);
+			stats_counters().add_stats_counter(counter);
 		}
 
 		return finished;
@@ -2198,7 +2198,7 @@ namespace {
 		aux::write_uint8(enabled, ptr);
 		send_buffer(msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_extended);
+		stats_counters().add_stats_counter(counters::num_outgoing_extended);
 	}
 
 #ifndef TORRENT_DISABLE_SHARE_MODE
@@ -2215,7 +2215,7 @@ namespace {
 		aux::write_uint8(t->share_mode(), ptr);
 		send_buffer(msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_extended);
+		stats_counters().add_stats_counter(counters::num_outgoing_extended);
 	}
 #endif
 
@@ -2380,7 +2380,7 @@ namespace {
 
 		send_buffer(msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_bitfield);
+		stats_counters().add_stats_counter(counters::num_outgoing_bitfield);
 	}
 
 	void bt_peer_connection::write_extensions()
@@ -2501,7 +2501,7 @@ namespace {
 		send_buffer(msg);
 		send_buffer(dict_msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_ext_handshake);
+		stats_counters().add_stats_counter(counters::num_outgoing_ext_handshake);
 
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(peer_log_alert::outgoing_message))
@@ -2595,7 +2595,7 @@ namespace {
 		aux::write_int32(static_cast<int>(index), ptr);
 		send_buffer(msg);
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_extended);
+		stats_counters().add_stats_counter(counters::num_outgoing_extended);
 	}
 
 	void bt_peer_connection::write_piece(peer_request const& r, disk_buffer_holder buffer)
@@ -2629,6 +2629,7 @@ namespace {
 		if (buffer.is_mutable())
 		{
 			append_send_buffer(std::move(buffer), r.length);
+			stats_counters().add_stats_counter(counters::send_zero_copy_bytes, r.length);
 		}
 		else
 		{
@@ -2638,7 +2639,7 @@ namespace {
 		m_payloads.emplace_back(send_buffer_size() - r.length, r.length);
 		setup_send();
 
-		stats_counters().inc_stats_counter(counters::num_outgoing_piece);
+		stats_counters().add_stats_counter(counters::num_outgoing_piece);
 
 		if (t->alerts().should_post<block_uploaded_alert>())
 		{
@@ -2719,7 +2720,93 @@ namespace {
 		}
 		else
 #endif
+		{
 			on_receive_impl(bytes_transferred);
+			if (!m_disconnecting) parse_buffered_messages();
+		}
+	}
+
+	void bt_peer_connection::parse_buffered_messages()
+	{
+		// the upper layer's view of the receive buffer only reaches the read
+		// cursor. The bytes past it are only looked at while they are
+		// plaintext
+		aux::receive_buffer& buffer = peer_connection::m_recv_buffer;
+		int parsed = 0;
+
+		while (m_state == state_t::read_packet_size
+			&& m_recv_buffer.pos() == 0
+#if !defined TORRENT_DISABLE_ENCRYPTION
+			&& m_enc_handler.is_recv_plaintext()
+#endif
+			&& !m_disconnecting)
+		{
+			span<char const> const pending = buffer.unparsed();
+			if (pending.size() < 4) break;
+
+			const char* ptr = pending.data();
+			int const packet_size = aux::read_int32(ptr);
+
+			// incomplete and invalid messages are left to the regular path
+			if (packet_size < 0 || packet_size > 1024 * 1024
+				|| pending.size() - 4 < packet_size)
+				break;
+
+			if (packet_size == 5 && static_cast<std::uint8_t>(pending[4]) == msg_have
+				&& !associated_torrent().expired())
+			{
+				parsed += on_have_run(pending);
+				continue;
+			}
+
+			// this is what on_receive_data() would do with these bytes
+			int left = 4 + packet_size;
+			parsed += left;
+			while (left > 0 && !m_disconnecting)
+			{
+				int const sub_transferred = buffer.advance_pos(left);
+				TORRENT_ASSERT(sub_transferred > 0);
+				on_receive_impl(std::size_t(sub_transferred));
+				left -= sub_transferred;
+			}
+		}
+
+		m_recv_parsed_ahead += parsed;
+	}
+
+	int bt_peer_connection::on_have_run(span<char const> const buf)
+	{
+		INVARIANT_CHECK;
+
+		TORRENT_ASSERT(m_state == state_t::read_packet_size);
+		TORRENT_ASSERT(m_recv_buffer.pos() == 0);
+
+		// length prefix, message type and piece index
+		int const msg_size = 9;
+		int const max_run = int(buf.size() / msg_size);
+		TORRENT_ALLOCA(pieces, piece_index_t, max_run);
+
+		int num_pieces = 0;
+		const char* ptr = buf.data();
+		while (num_pieces < max_run
+			&& aux::read_int32(ptr) == 5
+			&& aux::read_uint8(ptr) == msg_have)
+		{
+			pieces[num_pieces++] = piece_index_t(aux::read_int32(ptr));
+		}
+		TORRENT_ASSERT(num_pieces > 0);
+
+		// consume the whole run as a single packet
+		int const bytes = num_pieces * msg_size;
+		m_recv_buffer.cut(0, bytes);
+		peer_connection::m_recv_buffer.advance_pos(bytes);
+		received_bytes(0, bytes);
+		stats_counters().add_stats_counter(counters::num_incoming_have, num_pieces);
+		m_recv_buffer.reset(5);
+
+		incoming_haves(pieces.first(num_pieces));
+		if (!m_disconnecting) maybe_send_hash_request();
+		return bytes;
 	}
 
 	void bt_peer_connection::on_receive_impl(std::size_t bytes_transferred)
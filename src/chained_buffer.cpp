@@ -107,13 +107,51 @@ namespace aux {
 		buffer_t& b = m_vec.back();
 		TORRENT_ASSERT(b.buf != nullptr);
 		char* const insert = b.buf + b.used_size;
-		if (insert + s > b.buf + b.size) return nullptr;
+		if (insert + s > b.buf + b.size)
+		{
+			// if the last buffer is the most recent one carved out of the
+			// slab, it can grow into the remainder of the slab
+			if (m_slab == nullptr
+				|| insert != m_slab_cursor
+				|| m_slab->buf + slab_size - insert < s)
+				return nullptr;
+			b.size += s;
+			m_capacity += s;
+			m_slab_cursor += s;
+		}
 		b.used_size += s;
 		m_bytes += s;
 		TORRENT_ASSERT(m_bytes <= m_capacity);
 		return insert;
 	}
 
+	bool chained_buffer::append_to_slab(span<char const> buf)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_destructed);
+		int const s = static_cast<int>(buf.size());
+		if (s > max_slab_message) return false;
+
+		// once every buffer carved out of the slab has been sent, we're the
+		// only one referencing it and it can be reused from the start
+		if (m_slab != nullptr && m_slab->refs == 1)
+			m_slab_cursor = m_slab->buf;
+
+		if (m_slab == nullptr || m_slab->buf + slab_size - m_slab_cursor < s)
+		{
+			if (m_slab != nullptr) release(m_slab);
+			m_slab = nullptr;
+			m_slab = new send_slab;
+			m_slab_cursor = m_slab->buf;
+		}
+
+		char* const insert = m_slab_cursor;
+		std::copy(buf.begin(), buf.end(), insert);
+		m_slab_cursor += s;
+		append_buffer(slab_ref(m_slab, insert, s), s);
+		return true;
+	}
+
 	span<boost::asio::const_buffer const> chained_buffer::build_iovec(int const to_send)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -165,6 +203,7 @@ namespace aux {
 		TORRENT_ASSERT(m_bytes >= 0);
 		TORRENT_ASSERT(m_capacity >= 0);
 		clear();
+		if (m_slab != nullptr) release(m_slab);
 #if TORRENT_USE_ASSERTS
 		m_destructed = true;
 #endif
@@ -43,10 +43,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <nmmintrin.h>
 #endif
 
+#include <cstring> // for std::memset
+
 #if TORRENT_HAS_SSE && defined __GNUC__
 #include <cpuid.h>
-#else
-#include <cstring> // for std::memset
 #endif
 
 #if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 16))
@@ -95,6 +95,47 @@ namespace {
 		std::memset(&info[0], 0, sizeof(std::uint32_t) * 4);
 #endif
 	}
+
+	// internal
+	// like cpuid(), but for leaves that take a sub-leaf in ECX
+	void cpuid_count(std::uint32_t* info, int type, int subtype) noexcept
+	{
+#if defined _MSC_VER
+		__cpuidex(reinterpret_cast<int*>(info), type, subtype);
+
+#elif defined __GNUC__
+		std::memset(&info[0], 0, sizeof(std::uint32_t) * 4);
+		if (__get_cpuid_max(0, nullptr) < std::uint32_t(type)) return;
+		__cpuid_count(std::uint32_t(type), std::uint32_t(subtype)
+			, info[0], info[1], info[2], info[3]);
+#else
+		TORRENT_UNUSED(type);
+		TORRENT_UNUSED(subtype);
+		std::memset(&info[0], 0, sizeof(std::uint32_t) * 4);
+#endif
+	}
+
+	// returns true if the operating system saves the register state
+	// selected by ``mask`` in XCR0 on context switches. Without it, the
+	// wider registers can't be used, regardless of what the CPU supports
+	bool os_saves_state(std::uint32_t const mask) noexcept
+	{
+		std::uint32_t cpui[4] = {0};
+		cpuid(cpui, 1);
+		// OSXSAVE
+		if ((cpui[2] & (1 << 27)) == 0) return false;
+#if defined _MSC_VER
+		std::uint64_t const xcr0 = _xgetbv(0);
+#elif defined __GNUC__
+		std::uint32_t eax;
+		std::uint32_t edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		std::uint64_t const xcr0 = (std::uint64_t(edx) << 32) | eax;
+#else
+		std::uint64_t const xcr0 = 0;
+#endif
+		return (xcr0 & mask) == mask;
+	}
 #endif
 
 	bool supports_sse42() noexcept
@@ -119,6 +160,33 @@ namespace {
 #endif
 	}
 
+	bool supports_avx2() noexcept
+	{
+#if TORRENT_HAS_SSE
+		// XMM and YMM state
+		if (!os_saves_state(0x06)) return false;
+		std::uint32_t cpui[4] = {0};
+		cpuid_count(cpui, 7, 0);
+		return (cpui[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool supports_avx512_popcnt() noexcept
+	{
+#if TORRENT_HAS_SSE
+		// XMM, YMM, opmask and ZMM state
+		if (!os_saves_state(0xe6)) return false;
+		std::uint32_t cpui[4] = {0};
+		cpuid_count(cpui, 7, 0);
+		// AVX512F and AVX512_VPOPCNTDQ
+		return (cpui[1] & (1 << 16)) != 0 && (cpui[2] & (1 << 14)) != 0;
+#else
+		return false;
+#endif
+	}
+
 	bool supports_arm_neon() noexcept
 	{
 #if TORRENT_HAS_ARM_NEON && TORRENT_HAS_AUXV
@@ -157,6 +225,8 @@ namespace {
 
 	bool const sse42_support = supports_sse42();
 	bool const mmx_support = supports_mmx();
+	bool const avx2_support = supports_avx2();
+	bool const avx512_popcnt_support = supports_avx512_popcnt();
 	bool const arm_neon_support = supports_arm_neon();
 	bool const arm_crc32c_support = supports_arm_crc32c();
 } }
@@ -48,6 +48,11 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/directory.hpp"
 #include "libtorrent/hex.hpp"
 #include "libtorrent/disk_interface.hpp"
+#include "libtorrent/aux_/posix_storage.hpp"
+#include "libtorrent/aux_/file_pointer.hpp"
+#include "libtorrent/aux_/io.hpp"
+#include "libtorrent/aux_/zip_decoder.hpp"
+#include "libtorrent/aux_/scope_end.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -55,6 +60,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <functional>
 #include <memory>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std::placeholders;
 
@@ -181,6 +189,36 @@ namespace {
 		error_code& ec;
 	};
 
+	// sets the v2 hash of ``piece`` from the hashes of its 16 kiB blocks
+	void set_piece_hash2(create_torrent& ct, piece_index_t const piece
+		, span<sha256_hash> v2_blocks)
+	{
+		file_index_t const current_file = ct.files().file_index_at_piece(piece);
+		if (!ct.files().pad_file_at(current_file))
+		{
+			piece_index_t const file_first_piece(int(ct.files().file_offset(current_file) / ct.piece_length()));
+			TORRENT_ASSERT(ct.files().file_offset(current_file) % ct.piece_length() == 0);
+
+			auto const file_piece_offset = piece - file_first_piece;
+			auto const file_size = ct.files().file_size(current_file);
+			auto const file_blocks = ct.files().file_num_blocks(current_file);
+			auto const piece_blocks = ct.files().blocks_in_piece2(piece);
+			int const num_leafs = merkle_num_leafs(file_blocks);
+			// If the file is smaller than one piece then the block hashes
+			// should be padded to the next power of two instead of the next
+			// piece boundary.
+			int const padded_leafs = file_size < ct.piece_length()
+				? num_leafs
+				: ct.piece_length() / default_block_size;
+
+			TORRENT_ASSERT(padded_leafs <= int(v2_blocks.size()));
+			for (auto i = piece_blocks; i < padded_leafs; ++i)
+				v2_blocks[i].clear();
+			sha256_hash const piece_root = merkle_root(v2_blocks.first(padded_leafs));
+			ct.set_hash2(current_file, file_piece_offset, piece_root);
+		}
+	}
+
 	void on_hash(aux::vector<sha256_hash> v2_blocks, piece_index_t const piece
 		, sha1_hash const& piece_hash, storage_error const& error, hash_state* st)
 	{
@@ -196,33 +234,7 @@ namespace {
 			st->ct.set_hash(piece, piece_hash);
 
 		if (!st->ct.is_v1_only())
-		{
-			file_index_t const current_file = st->ct.files().file_index_at_piece(piece);
-			if (!st->ct.files().pad_file_at(current_file))
-			{
-				piece_index_t const file_first_piece(int(st->ct.files().file_offset(current_file) / st->ct.piece_length()));
-				TORRENT_ASSERT(st->ct.files().file_offset(current_file) % st->ct.piece_length() == 0);
-
-				auto const file_piece_offset = piece - file_first_piece;
-				auto const file_size = st->ct.files().file_size(current_file);
-				auto const file_blocks = st->ct.files().file_num_blocks(current_file);
-				auto const piece_blocks = st->ct.files().blocks_in_piece2(piece);
-				int const num_leafs = merkle_num_leafs(file_blocks);
-				// If the file is smaller than one piece then the block hashes
-				// should be padded to the next power of two instead of the next
-				// piece boundary.
-				int const padded_leafs = file_size < st->ct.piece_length()
-					? num_leafs
-					: st->ct.piece_length() / default_block_size;
-
-				TORRENT_ASSERT(padded_leafs <= int(v2_blocks.size()));
-				for (auto i = piece_blocks; i < padded_leafs; ++i)
-					v2_blocks[i].clear();
-				sha256_hash const piece_root = merkle_root(
-					span<sha256_hash>(v2_blocks).first(padded_leafs));
-				st->ct.set_hash2(current_file, file_piece_offset, piece_root);
-			}
-		}
+			set_piece_hash2(st->ct, piece, v2_blocks);
 
 		auto flags = disk_interface::sequential_access;
 		if (!st->ct.is_v2_only()) flags |= disk_interface::v1_hash;
@@ -400,6 +412,235 @@ namespace {
 		}
 	}
 
+namespace {
+
+	// a piece that has been read, hashed and compressed by one of the
+	// threads of set_piece_hashes_zip(), waiting to be written
+	struct zip_piece
+	{
+		bool done = false;
+		sha1_hash hash;
+		aux::vector<sha256_hash> v2_blocks;
+		std::vector<char> compressed;
+	};
+
+	struct zip_state
+	{
+		create_torrent& ct;
+		aux::posix_storage& storage;
+		settings_interface const& sett;
+
+		std::mutex mutex;
+		std::condition_variable cond;
+
+		// the next piece for a thread to pick up
+		piece_index_t next_piece{0};
+
+		// the next piece to write to the zip file. Threads don't get ahead of
+		// this by more than the number of slots, which bounds the memory used
+		// for pieces waiting for their turn
+		piece_index_t next_write{0};
+		std::vector<zip_piece> slots;
+
+		error_code ec;
+		bool abort = false;
+	};
+
+	void zip_pieces(zip_state& st)
+	{
+		create_torrent const& ct = st.ct;
+		int const window = int(st.slots.size());
+		std::vector<char> buf;
+		for (;;)
+		{
+			piece_index_t piece;
+			{
+				std::unique_lock<std::mutex> l(st.mutex);
+				while (!st.abort && st.next_piece < ct.files().end_piece()
+					&& static_cast<int>(st.next_piece) - static_cast<int>(st.next_write) >= window)
+					st.cond.wait(l);
+				if (st.abort || st.next_piece >= ct.files().end_piece()) return;
+				piece = st.next_piece++;
+			}
+
+			zip_piece result;
+			int const piece_size = ct.piece_size(piece);
+			buf.resize(std::size_t(piece_size));
+
+			storage_error error;
+			iovec_t const b = { buf.data(), piece_size };
+			int const ret = st.storage.readv(st.sett, b, piece, 0, error);
+			if (!error && ret != piece_size)
+				error.ec = errors::file_too_short;
+
+			if (!error)
+			{
+				if (!ct.is_v2_only())
+					result.hash = hasher(buf).final();
+
+				if (!ct.is_v1_only())
+				{
+					result.v2_blocks.resize(ct.piece_length() / default_block_size);
+					int const piece_size2 = ct.files().piece_size2(piece);
+					int const blocks = ct.files().blocks_in_piece2(piece);
+					for (int i = 0; i < blocks; ++i)
+					{
+						int const offset = i * default_block_size;
+						result.v2_blocks[i] = hasher256(buf.data() + offset
+							, std::min(default_block_size, piece_size2 - offset)).final();
+					}
+				}
+
+				if (!aux::zip_compress(ct.get_zip_codec(), buf, result.compressed
+					, ct.zip_level()))
+					error.ec = errors::no_memory;
+			}
+
+			std::lock_guard<std::mutex> l(st.mutex);
+			if (error)
+			{
+				if (!st.ec) st.ec = error.ec;
+				st.abort = true;
+			}
+			else
+			{
+				result.done = true;
+				st.slots[std::size_t(static_cast<int>(piece) % window)] = std::move(result);
+			}
+			st.cond.notify_all();
+		}
+	}
+}
+
+	void set_piece_hashes_zip(create_torrent& t, std::string const& p
+		, std::string const& zip_file
+		, std::function<void(piece_index_t)> const& f, error_code& ec)
+	{
+		aux::session_settings sett;
+		int const num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		sett.set_int(settings_pack::hashing_threads, num_threads);
+		set_piece_hashes_zip(t, p, zip_file, sett, f, ec);
+	}
+
+	void set_piece_hashes_zip(create_torrent& t, std::string const& p
+		, std::string const& zip_file, settings_interface const& sett
+		, std::function<void(piece_index_t)> const& f, error_code& ec)
+	{
+#if TORRENT_USE_UNC_PATHS
+		std::string const path = canonicalize_path(p);
+#else
+		std::string const& path = p;
+#endif
+
+		if (t.files().num_files() == 0)
+		{
+			ec = errors::no_files_in_torrent;
+			return;
+		}
+
+		if (t.files().total_size() == 0)
+		{
+			ec = errors::torrent_invalid_length;
+			return;
+		}
+
+		if (!zip_codec_supported(t.get_zip_codec()))
+		{
+			ec = boost::asio::error::operation_not_supported;
+			return;
+		}
+
+#ifdef TORRENT_WINDOWS
+		aux::file_pointer const out(::_wfopen(convert_to_native_path_string(zip_file).c_str(), L"wb"));
+#else
+		aux::file_pointer const out(std::fopen(zip_file.c_str(), "wb"));
+#endif
+		if (out.file() == nullptr)
+		{
+			ec.assign(errno, generic_category());
+			return;
+		}
+
+		aux::vector<download_priority_t, file_index_t> priorities;
+		sha1_hash info_hash;
+		storage_params params{
+			t.files(),
+			nullptr,
+			path,
+			storage_mode_t::storage_mode_sparse,
+			priorities,
+			info_hash
+		};
+		aux::posix_storage storage(params);
+
+		int const num_threads = std::max(1, sett.get_int(settings_pack::hashing_threads));
+
+		// each thread may have two pieces in flight, one waiting to be
+		// written and one being compressed
+		zip_state st{t, storage, sett, {}, {}, piece_index_t(0), piece_index_t(0)
+			, std::vector<zip_piece>(std::size_t(num_threads * 2)), {}, false};
+
+		std::vector<std::thread> threads;
+
+		// if anything below throws, including the callback, the threads must
+		// be stopped and joined before they're destructed
+		auto stop_threads = aux::scope_end([&]
+		{
+			{
+				std::lock_guard<std::mutex> l(st.mutex);
+				st.abort = true;
+				st.cond.notify_all();
+			}
+			for (auto& th : threads)
+				if (th.joinable()) th.join();
+		});
+
+		for (int i = 0; i < num_threads; ++i)
+			threads.emplace_back(&zip_pieces, std::ref(st));
+
+		// the pieces are written (and their hashes set) on this thread, in
+		// order, as they complete
+		int const window = int(st.slots.size());
+		for (piece_index_t piece(0); piece < t.files().end_piece(); ++piece)
+		{
+			zip_piece result;
+			{
+				std::unique_lock<std::mutex> l(st.mutex);
+				zip_piece& slot = st.slots[std::size_t(static_cast<int>(piece) % window)];
+				while (!slot.done && !st.abort) st.cond.wait(l);
+				if (st.abort) break;
+				result = std::move(slot);
+				slot.done = false;
+				++st.next_write;
+				st.cond.notify_all();
+			}
+
+			std::size_t const size = result.compressed.size();
+			if (std::fwrite(result.compressed.data(), 1, size, out.file()) != size)
+			{
+				std::lock_guard<std::mutex> l(st.mutex);
+				st.ec.assign(errno, generic_category());
+				st.abort = true;
+				st.cond.notify_all();
+				break;
+			}
+
+			if (!t.is_v2_only())
+				t.set_hash(piece, result.hash);
+			if (!t.is_v1_only())
+				set_piece_hash2(t, piece, result.v2_blocks);
+			t.set_zip_piece_size(piece, std::uint32_t(size));
+			f(piece);
+		}
+
+		for (auto& th : threads) th.join();
+		stop_threads.disarm();
+
+		if (!st.ec && std::fflush(out.file()) != 0)
+			st.ec.assign(errno, generic_category());
+		if (st.ec) ec = st.ec;
+	}
+
 	create_torrent::~create_torrent() = default;
 
 	create_torrent::create_torrent(file_storage& fs, int piece_size
@@ -690,6 +931,43 @@ namespace {
 			}
 		}
 
+		// the compressed size of every piece has to be known for the
+		// zipinfo dictionary to be of any use
+		if (!m_zip_web_seeds.empty() && !m_zip_piece_size.empty()
+			&& std::find(m_zip_piece_size.begin(), m_zip_piece_size.end(), 0u)
+				== m_zip_piece_size.end())
+		{
+			entry& zip = dict["zipinfo"];
+			if (m_zip_web_seeds.size() == 1)
+			{
+				zip["url-list"] = m_zip_web_seeds.front();
+			}
+			else
+			{
+				entry& list = zip["url-list"];
+				for (auto const& url : m_zip_web_seeds)
+				{
+					list.list().emplace_back(url);
+				}
+			}
+
+			std::int64_t total_size = 0;
+			std::string& sizes = zip["pieces size"].string();
+			sizes.resize(m_zip_piece_size.size() * sizeof(std::uint32_t));
+			span<char> out(sizes);
+			for (std::uint32_t const size : m_zip_piece_size)
+			{
+				aux::write_uint32(size, out);
+				total_size += size;
+			}
+			zip["total size"] = total_size;
+			zip["level"] = m_zip_level;
+			// zlib is implied, to stay compatible with clients that don't
+			// know about other codecs
+			if (m_zip_codec != zip_codec::zlib)
+				zip["codec"] = zip_codec_name(m_zip_codec);
+		}
+
 		if (!m_http_seeds.empty())
 		{
 			if (m_http_seeds.size() == 1)
@@ -991,6 +1269,21 @@ namespace {
 		m_http_seeds.emplace_back(url);
 	}
 
+	void create_torrent::add_zip_web_seed(string_view url)
+	{
+		m_zip_web_seeds.emplace_back(url);
+	}
+
+	void create_torrent::set_zip_piece_size(piece_index_t const index, std::uint32_t const size)
+	{
+		if (m_zip_piece_size.empty())
+			m_zip_piece_size.resize(m_files.num_pieces());
+
+		TORRENT_ASSERT_PRECOND(index >= piece_index_t(0));
+		TORRENT_ASSERT_PRECOND(index < m_zip_piece_size.end_index());
+		m_zip_piece_size[index] = size;
+	}
+
 	void create_torrent::set_comment(char const* str)
 	{
 		if (str == nullptr) m_comment.clear();
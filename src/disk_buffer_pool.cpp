@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/disk_observer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/aux_/thread_index.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
@@ -50,13 +51,72 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <linux/unistd.h>
 #endif
 
+#ifdef TORRENT_WINDOWS
+#include <malloc.h> // for _aligned_malloc
+#else
+#include <cstdlib> // for posix_memalign
+#include <sys/mman.h> // for madvise
+#endif
+
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+#include <algorithm>
+#include <cstring> // for memcpy
+#include <cstdint>
+#include <new>
+
 namespace libtorrent {
 namespace aux {
 
+	constexpr int disk_buffer_pool::region_size;
+
 	namespace {
 
+	// the number of blocks in a region that are handed out as buffers. The
+	// first block holds the region header
+	constexpr int blocks_per_region = disk_buffer_pool::region_size / default_block_size - 1;
+
+	constexpr int num_block_caches = 16;
+
+	// the number of blocks each block cache holds at most. When it's full,
+	// half of it is returned to the regions, and when it's empty, half of it
+	// is refilled
+	constexpr int block_cache_size = 32;
+
+	char* allocate_region_memory(bool const huge_pages)
+	{
+#ifdef TORRENT_WINDOWS
+		TORRENT_UNUSED(huge_pages);
+		return static_cast<char*>(_aligned_malloc(disk_buffer_pool::region_size
+			, disk_buffer_pool::region_size));
+#else
+		void* ret = nullptr;
+		if (posix_memalign(&ret, disk_buffer_pool::region_size
+			, disk_buffer_pool::region_size) != 0)
+			return nullptr;
+#ifdef MADV_HUGEPAGE
+		if (huge_pages) ::madvise(ret, disk_buffer_pool::region_size, MADV_HUGEPAGE);
+#else
+		TORRENT_UNUSED(huge_pages);
+#endif
+		return static_cast<char*>(ret);
+#endif
+	}
+
+	void free_region_memory(char* mem)
+	{
+#ifdef TORRENT_WINDOWS
+		_aligned_free(mem);
+#else
+		std::free(mem);
+#endif
+	}
+
+	int block_cache_index()
+	{
+		return thread_index() % num_block_caches;
+	}
+
 	// this is posted to the network thread
 	void watermark_callback(std::vector<std::weak_ptr<disk_observer>> const& cbs)
 	{
@@ -69,12 +129,43 @@ namespace aux {
 
 	} // anonymous namespace
 
+	// the header of a region, stored in its first block
+	struct disk_buffer_pool::region
+	{
+		explicit region(disk_buffer_pool const* o) : owner(o) {}
+
+		disk_buffer_pool const* owner;
+
+		// blocks that have been freed back to this region. They form a
+		// singly linked list, through the first bytes of every block
+		char* free_list = nullptr;
+
+		// blocks past this index have never been handed out. They're not
+		// on the free list, to not touch their pages until they're needed
+		int next_unused = 1;
+
+		int num_free = blocks_per_region;
+
+		// this region's index in m_regions, and in m_available (or -1 if
+		// it has no free blocks)
+		int index = -1;
+		int available_index = -1;
+	};
+
+	struct disk_buffer_pool::block_cache
+	{
+		std::mutex mutex;
+		int size = 0;
+		std::array<char*, block_cache_size> blocks;
+	};
+
 	disk_buffer_pool::disk_buffer_pool(io_context& ios)
 		: m_in_use(0)
 		, m_max_use(64)
-		, m_low_watermark(std::max(m_max_use - 32, 0))
+		, m_low_watermark(32)
 		, m_exceeded_max_size(false)
 		, m_ios(ios)
+		, m_block_caches(new block_cache[num_block_caches])
 	{}
 
 	disk_buffer_pool::~disk_buffer_pool()
@@ -83,15 +174,46 @@ namespace aux {
 #if TORRENT_USE_ASSERTS
 		m_magic = 0;
 #endif
+		for (region* r : m_regions)
+		{
+			r->~region();
+			free_region_memory(reinterpret_cast<char*>(r));
+		}
+	}
+
+	disk_buffer_pool::region* disk_buffer_pool::region_of(char const* buf)
+	{
+		std::uintptr_t const addr = reinterpret_cast<std::uintptr_t>(buf);
+		return reinterpret_cast<region*>(addr & ~std::uintptr_t(region_size - 1));
+	}
+
+	char const* disk_buffer_pool::region_base(char const* buf)
+	{
+		return reinterpret_cast<char const*>(region_of(buf));
+	}
+
+	void disk_buffer_pool::keep_regions()
+	{
+		std::lock_guard<std::mutex> l(m_pool_mutex);
+		m_keep_regions = true;
+	}
+
+	// the buffer must have been allocated by a disk_buffer_pool, this checks
+	// whether it was this one
+	bool disk_buffer_pool::is_disk_buffer(char const* buf) const
+	{
+		return region_of(buf)->owner == this;
 	}
 
 	// checks to see if we're no longer exceeding the high watermark,
 	// and if we're in fact below the low watermark. If so, we need to
 	// post the notification messages to the peers that are waiting for
 	// more buffers to received data into
-	void disk_buffer_pool::check_buffer_level(std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::check_buffer_level()
 	{
-		TORRENT_ASSERT(l.owns_lock());
+		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
+
+		std::unique_lock<std::mutex> l(m_pool_mutex);
 		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
 
 		m_exceeded_max_size = false;
@@ -104,8 +226,7 @@ namespace aux {
 
 	char* disk_buffer_pool::allocate_buffer(char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		return allocate_buffer_impl(l, category);
+		return allocate_buffer_impl(category);
 	}
 
 	// we allow allocating more blocks even after we exceed the max size,
@@ -118,25 +239,40 @@ namespace aux {
 	char* disk_buffer_pool::allocate_buffer(bool& exceeded
 		, std::shared_ptr<disk_observer> o, char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		char* ret = allocate_buffer_impl(l, category);
+		char* ret = allocate_buffer_impl(category);
 		if (m_exceeded_max_size)
 		{
-			exceeded = true;
-			if (o) m_observers.push_back(o);
+			std::lock_guard<std::mutex> l(m_pool_mutex);
+			if (m_exceeded_max_size)
+			{
+				exceeded = true;
+				if (o) m_observers.push_back(o);
+			}
 		}
 		return ret;
 	}
 
-	char* disk_buffer_pool::allocate_buffer_impl(std::unique_lock<std::mutex>& l
-		, char const*)
+	char* disk_buffer_pool::allocate_buffer_impl(char const*)
 	{
 		TORRENT_ASSERT(m_settings_set);
 		TORRENT_ASSERT(m_magic == 0x1337);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		char* ret = static_cast<char*>(std::malloc(default_block_size));
+		char* ret = nullptr;
+		{
+			block_cache& c = m_block_caches[block_cache_index()];
+			std::lock_guard<std::mutex> l(c.mutex);
+			if (c.size == 0)
+			{
+				std::unique_lock<std::mutex> pl(m_pool_mutex);
+				while (c.size < block_cache_size / 2)
+				{
+					char* const b = allocate_block(pl);
+					if (b == nullptr) break;
+					c.blocks[std::size_t(c.size++)] = b;
+				}
+			}
+			if (c.size > 0) ret = c.blocks[std::size_t(--c.size)];
+		}
 
 		if (ret == nullptr)
 		{
@@ -144,22 +280,24 @@ namespace aux {
 			return nullptr;
 		}
 
-		++m_in_use;
+		int const in_use = ++m_in_use;
 
 #if TORRENT_USE_INVARIANT_CHECKS
 		try
 		{
+			std::lock_guard<std::mutex> l(m_pool_mutex);
 			TORRENT_ASSERT(m_buffers_in_use.count(ret) == 0);
 			m_buffers_in_use.insert(ret);
 		}
 		catch (...)
 		{
-			free_buffer_impl(ret, l);
+			free_buffer_impl(ret);
 			return nullptr;
 		}
 #endif
 
-		if (m_in_use >= m_low_watermark + (m_max_use - m_low_watermark)
+		int const low_watermark = m_low_watermark;
+		if (in_use >= low_watermark + (m_max_use - low_watermark)
 			/ 2 && !m_exceeded_max_size)
 		{
 			m_exceeded_max_size = true;
@@ -168,27 +306,117 @@ namespace aux {
 		return ret;
 	}
 
+	char* disk_buffer_pool::allocate_block(std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_ASSERT(l.owns_lock());
+		TORRENT_UNUSED(l);
+
+		region* r;
+		if (!m_available.empty())
+		{
+			r = m_available.back();
+			if (r->num_free == blocks_per_region) --m_empty_regions;
+		}
+		else
+		{
+			char* const mem = allocate_region_memory(m_huge_pages);
+			if (mem == nullptr) return nullptr;
+			r = new (mem) region(this);
+			try
+			{
+				// m_available never needs to grow when blocks are freed
+				m_available.reserve(m_regions.size() + 1);
+				m_regions.push_back(r);
+			}
+			catch (...)
+			{
+				r->~region();
+				free_region_memory(mem);
+				return nullptr;
+			}
+			r->index = int(m_regions.size()) - 1;
+			r->available_index = int(m_available.size());
+			m_available.push_back(r);
+		}
+
+		char* ret;
+		if (r->free_list != nullptr)
+		{
+			ret = r->free_list;
+			std::memcpy(&r->free_list, ret, sizeof(char*));
+		}
+		else
+		{
+			TORRENT_ASSERT(r->next_unused <= blocks_per_region);
+			ret = reinterpret_cast<char*>(r) + std::ptrdiff_t(r->next_unused) * default_block_size;
+			++r->next_unused;
+		}
+		--r->num_free;
+		if (r->num_free == 0) remove_available(r);
+		return ret;
+	}
+
+	void disk_buffer_pool::remove_available(region* r)
+	{
+		TORRENT_ASSERT(r->available_index >= 0);
+		region* const last = m_available.back();
+		last->available_index = r->available_index;
+		m_available[std::size_t(r->available_index)] = last;
+		m_available.pop_back();
+		r->available_index = -1;
+	}
+
+	void disk_buffer_pool::free_block(char* buf, std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_ASSERT(l.owns_lock());
+		TORRENT_UNUSED(l);
+
+		region* r = region_of(buf);
+		TORRENT_ASSERT(r->owner == this);
+		std::memcpy(buf, &r->free_list, sizeof(char*));
+		r->free_list = buf;
+		if (r->num_free++ == 0)
+		{
+			TORRENT_ASSERT(m_available.size() < m_available.capacity());
+			r->available_index = int(m_available.size());
+			m_available.push_back(r);
+		}
+		if (r->num_free < blocks_per_region) return;
+
+		++m_empty_regions;
+		if (m_empty_regions == 1 || m_keep_regions) return;
+
+		// this region is unused, and there's another one to allocate from,
+		// return its memory
+		remove_available(r);
+		region* const last = m_regions.back();
+		last->index = r->index;
+		m_regions[std::size_t(r->index)] = last;
+		m_regions.pop_back();
+		--m_empty_regions;
+		r->~region();
+		free_region_memory(reinterpret_cast<char*>(r));
+	}
+
 	void disk_buffer_pool::free_multiple_buffers(span<char*> bufvec)
 	{
 		// sort the pointers in order to maximize cache hits
 		std::sort(bufvec.begin(), bufvec.end());
 
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		for (char* buf : bufvec)
 		{
 			remove_buffer_in_use(buf);
-			free_buffer_impl(buf, l);
+			free_buffer_impl(buf);
 		}
 
-		check_buffer_level(l);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::free_buffer(char* buf)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		remove_buffer_in_use(buf);
-		free_buffer_impl(buf, l);
-		check_buffer_level(l);
+		free_buffer_impl(buf);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::set_settings(settings_interface const& sett)
@@ -197,7 +425,8 @@ namespace aux {
 
 		int const pool_size = std::max(1, sett.get_int(settings_pack::max_queued_disk_bytes) / default_block_size);
 		m_max_use = pool_size;
-		m_low_watermark = m_max_use / 2;
+		m_low_watermark = pool_size / 2;
+		m_huge_pages = sett.get_bool(settings_pack::disk_buffer_huge_pages);
 		if (m_in_use >= m_max_use && !m_exceeded_max_size)
 		{
 			m_exceeded_max_size = true;
@@ -212,21 +441,36 @@ namespace aux {
 	{
 		TORRENT_UNUSED(buf);
 #if TORRENT_USE_INVARIANT_CHECKS
+		std::lock_guard<std::mutex> l(m_pool_mutex);
 		std::set<char*>::iterator i = m_buffers_in_use.find(buf);
 		TORRENT_ASSERT(i != m_buffers_in_use.end());
 		m_buffers_in_use.erase(i);
 #endif
 	}
 
-	void disk_buffer_pool::free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::free_buffer_impl(char* buf)
 	{
 		TORRENT_ASSERT(buf);
 		TORRENT_ASSERT(m_magic == 0x1337);
 		TORRENT_ASSERT(m_settings_set);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
+		TORRENT_ASSERT(is_disk_buffer(buf));
 
-		std::free(buf);
+		{
+			block_cache& c = m_block_caches[block_cache_index()];
+			std::lock_guard<std::mutex> l(c.mutex);
+			if (c.size == block_cache_size)
+			{
+				// return the oldest half of the cache to the regions
+				std::unique_lock<std::mutex> pl(m_pool_mutex);
+				for (int i = 0; i < block_cache_size / 2; ++i)
+					free_block(c.blocks[std::size_t(i)], pl);
+				pl.unlock();
+				std::move(c.blocks.begin() + block_cache_size / 2, c.blocks.end()
+					, c.blocks.begin());
+				c.size -= block_cache_size / 2;
+			}
+			c.blocks[std::size_t(c.size++)] = buf;
+		}
 
 		--m_in_use;
 	}
@@ -119,6 +119,7 @@ namespace aux {
 	constexpr disk_job_flags_t disk_io_job::fence;
 	constexpr disk_job_flags_t disk_io_job::in_progress;
 	constexpr disk_job_flags_t disk_io_job::aborted;
+	constexpr disk_job_flags_t disk_io_job::prefetched;
 
 	disk_io_job::disk_io_job()
 		: argument(remove_flags_t{})
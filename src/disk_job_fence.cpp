@@ -211,7 +211,7 @@ namespace aux {
 		j->blocked = true;
 #endif
 		m_blocked_jobs.push_back(j);
-		cnt.inc_stats_counter(counters::blocked_disk_jobs);
+		cnt.add_stats_counter(counters::blocked_disk_jobs);
 
 		return fence_post_none;
 	}
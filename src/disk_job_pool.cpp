@@ -33,15 +33,39 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disk_job_pool.hpp"
 #include "libtorrent/aux_/disk_io_job.hpp"
+#include "libtorrent/aux_/thread_index.hpp"
+
+#include <array>
 
 namespace libtorrent {
 namespace aux {
 
+	namespace {
+
+	constexpr int num_job_caches = 16;
+
+	// the number of jobs each job cache holds at most. When it's full, half
+	// of it is returned to the shared pool, and when it's empty, half of it
+	// is refilled
+	constexpr int job_cache_size = 64;
+
+	}
+
+	struct disk_job_pool::job_cache
+	{
+		std::mutex mutex;
+		int size = 0;
+		std::int64_t hits = 0;
+		std::int64_t misses = 0;
+		std::array<void*, job_cache_size> jobs;
+	};
+
 	disk_job_pool::disk_job_pool()
 		: m_jobs_in_use(0)
 		, m_read_jobs(0)
 		, m_write_jobs(0)
 		, m_job_pool(sizeof(disk_io_job))
+		, m_job_caches(new job_cache[num_job_caches])
 	{}
 
 	disk_job_pool::~disk_job_pool()
@@ -52,14 +76,33 @@ namespace aux {
 
 	disk_io_job* disk_job_pool::allocate_job(job_action_t const type)
 	{
-		std::unique_lock<std::mutex> l(m_job_mutex);
-		void* storage = m_job_pool.malloc();
-		m_job_pool.set_next_size(100);
+		void* storage = nullptr;
+		{
+			job_cache& c = m_job_caches[thread_index() % num_job_caches];
+			std::lock_guard<std::mutex> l(c.mutex);
+			if (c.size == 0)
+			{
+				++c.misses;
+				std::lock_guard<std::mutex> pl(m_job_mutex);
+				while (c.size < job_cache_size / 2)
+				{
+					void* const j = m_job_pool.malloc();
+					if (j == nullptr) break;
+					c.jobs[std::size_t(c.size++)] = j;
+				}
+				m_job_pool.set_next_size(100);
+			}
+			else
+			{
+				++c.hits;
+			}
+			if (c.size > 0) storage = c.jobs[std::size_t(--c.size)];
+		}
+		TORRENT_ASSERT(storage);
+
 		++m_jobs_in_use;
 		if (type == job_action_t::read) ++m_read_jobs;
 		else if (type == job_action_t::write) ++m_write_jobs;
-		l.unlock();
-		TORRENT_ASSERT(storage);
 
 		auto ptr = new (storage) disk_io_job;
 		ptr->action = type;
@@ -69,43 +112,67 @@ namespace aux {
 		return ptr;
 	}
 
-	void disk_job_pool::free_job(disk_io_job* j)
+	void disk_job_pool::destruct_job(disk_io_job* j)
 	{
-		TORRENT_ASSERT(j);
-		if (j == nullptr) return;
 #if TORRENT_USE_ASSERTS
 		TORRENT_ASSERT(j->in_use);
 		j->in_use = false;
 #endif
 		job_action_t const type = j->action;
 		j->~disk_io_job();
-		std::lock_guard<std::mutex> l(m_job_mutex);
 		if (type == job_action_t::read) --m_read_jobs;
 		else if (type == job_action_t::write) --m_write_jobs;
 		--m_jobs_in_use;
-		m_job_pool.free(j);
+	}
+
+	void disk_job_pool::free_job(disk_io_job* j)
+	{
+		TORRENT_ASSERT(j);
+		if (j == nullptr) return;
+		free_jobs(&j, 1);
 	}
 
 	void disk_job_pool::free_jobs(disk_io_job** j, int const num)
 	{
 		if (num == 0) return;
 
-		int read_jobs = 0;
-		int write_jobs = 0;
+		for (int i = 0; i < num; ++i)
+			destruct_job(j[i]);
+
+		job_cache& c = m_job_caches[thread_index() % num_job_caches];
+		std::lock_guard<std::mutex> l(c.mutex);
 		for (int i = 0; i < num; ++i)
 		{
-			job_action_t const type = j[i]->action;
-			j[i]->~disk_io_job();
-			if (type == job_action_t::read) ++read_jobs;
-			else if (type == job_action_t::write) ++write_jobs;
+			if (c.size == job_cache_size)
+			{
+				std::lock_guard<std::mutex> pl(m_job_mutex);
+				while (c.size > job_cache_size / 2)
+					m_job_pool.free(c.jobs[std::size_t(--c.size)]);
+			}
+			c.jobs[std::size_t(c.size++)] = j[i];
 		}
+	}
 
-		std::lock_guard<std::mutex> l(m_job_mutex);
-		m_read_jobs -= read_jobs;
-		m_write_jobs -= write_jobs;
-		m_jobs_in_use -= num;
-		for (int i = 0; i < num; ++i)
-			m_job_pool.free(j[i]);
+	std::int64_t disk_job_pool::cache_hits() const
+	{
+		std::int64_t ret = 0;
+		for (int i = 0; i < num_job_caches; ++i)
+		{
+			std::lock_guard<std::mutex> l(m_job_caches[i].mutex);
+			ret += m_job_caches[i].hits;
+		}
+		return ret;
+	}
+
+	std::int64_t disk_job_pool::cache_misses() const
+	{
+		std::int64_t ret = 0;
+		for (int i = 0; i < num_job_caches; ++i)
+		{
+			std::lock_guard<std::mutex> l(m_job_caches[i].mutex);
+			ret += m_job_caches[i].misses;
+		}
+		return ret;
 	}
 }
 }
@@ -181,6 +181,16 @@ namespace libtorrent { namespace aux {
 		return ret;
 	}
 
+	boost::optional<file_view> file_view_pool::find_file(storage_index_t const st
+		, file_index_t const file_index)
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		auto& key_view = m_files.get<0>();
+		auto const i = key_view.find(file_id{st, file_index});
+		if (i == key_view.end()) return boost::none;
+		return i->mapping->view();
+	}
+
 	std::shared_ptr<file_mapping> file_view_pool::remove_oldest(std::unique_lock<std::mutex>&)
 	{
 		auto& lru_view = m_files.get<1>();
@@ -0,0 +1,303 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/inflate_thread_pool.hpp"
+#include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/aux_/zip_decoder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	// the max number of unused blocks to keep around for reuse. Anything
+	// beyond this is returned to the heap
+	constexpr std::size_t max_free_blocks = 128;
+}
+
+	// the state of a connection's inflate stream. It's only ever touched by
+	// the thread of the queue it's bound to. This holds on to no more than
+	// the decoder state (including its window) and the block currently
+	// being inflated into
+	struct inflate_stream
+	{
+		inflate_stream(int const q, std::unique_ptr<zip_decoder> d)
+			: queue(q), decoder(std::move(d)) {}
+
+		int const queue;
+
+		std::unique_ptr<zip_decoder> decoder;
+
+		// true while the decoder is decoding a piece, from the first chunk
+		// of it until it's done (or failed)
+		bool open = false;
+
+		// true while a piece is in progress, i.e. the last chunk of it
+		// hasn't been seen yet
+		bool in_piece = false;
+
+		// the number of bytes of the current piece in completed blocks
+		int inflated = 0;
+
+		// the block currently being inflated into, and how many bytes of
+		// it have been filled in so far
+		disk_buffer_holder block;
+		int block_fill = 0;
+	};
+
+	inflate_thread_pool::inflate_thread_pool(io_context& ios
+		, session_settings const& sett, counters& cnt)
+		: m_ios(ios)
+		, m_settings(sett)
+		, m_stats_counters(cnt)
+	{}
+
+	inflate_thread_pool::~inflate_thread_pool()
+	{
+		abort(true);
+		for (char* b : m_free_blocks) std::free(b);
+	}
+
+	char* inflate_thread_pool::allocate_block()
+	{
+		{
+			std::lock_guard<std::mutex> l(m_block_mutex);
+			if (!m_free_blocks.empty())
+			{
+				char* ret = m_free_blocks.back();
+				m_free_blocks.pop_back();
+				return ret;
+			}
+		}
+		char* ret = static_cast<char*>(std::malloc(default_block_size));
+		if (ret == nullptr) throw std::bad_alloc();
+		return ret;
+	}
+
+	void inflate_thread_pool::free_disk_buffer(char* const buf)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_block_mutex);
+			if (m_free_blocks.size() < max_free_blocks)
+			{
+				m_free_blocks.push_back(buf);
+				return;
+			}
+		}
+		std::free(buf);
+	}
+
+	std::shared_ptr<inflate_stream> inflate_thread_pool::open_stream(zip_codec const c)
+	{
+		int const num_threads = std::max(1
+			, m_settings.get_int(settings_pack::inflate_threads));
+		if (m_next_queue >= num_threads) m_next_queue = 0;
+		while (int(m_queues.size()) <= m_next_queue)
+			m_queues.emplace_back(new job_queue);
+		return std::make_shared<inflate_stream>(m_next_queue++, make_zip_decoder(c));
+	}
+
+	void inflate_thread_pool::async_inflate(std::shared_ptr<inflate_stream> const& s
+		, std::vector<char> input, int const unzip_length
+		, int const block_size, bool const last, handler_t handler)
+	{
+		TORRENT_ASSERT(block_size > 0 && block_size <= default_block_size);
+		if (m_abort) return;
+
+		TORRENT_ASSERT(s);
+		TORRENT_ASSERT(s->queue >= 0 && s->queue < int(m_queues.size()));
+		job_queue& q = *m_queues[std::size_t(s->queue)];
+
+		m_stats_counters.add_stats_counter(counters::queued_inflate_jobs);
+		{
+			std::lock_guard<std::mutex> l(q.mutex);
+			q.jobs.push_back({s, std::move(input), unzip_length, block_size
+				, last, std::move(handler)});
+		}
+		q.cond.notify_one();
+
+		if (!q.thread.joinable())
+		{
+			// the work guard keeps the io_context running until the thread
+			// has exited, so that any completion handler it posts still has
+			// an event loop to run on
+			q.thread = std::thread(&inflate_thread_pool::thread_fun, this
+				, std::ref(q), make_work_guard(m_ios));
+		}
+	}
+
+	void inflate_thread_pool::abort(bool const wait)
+	{
+		if (m_abort) return;
+		m_abort = true;
+
+		for (auto& q : m_queues)
+		{
+			std::lock_guard<std::mutex> l(q->mutex);
+			q->abort = true;
+			m_stats_counters.add_stats_counter(counters::queued_inflate_jobs
+				, -std::int64_t(q->jobs.size()));
+			// the handlers hold references to peer connections, make sure
+			// they are destructed on this thread
+			q->jobs.clear();
+			q->cond.notify_all();
+		}
+
+		for (auto& q : m_queues)
+		{
+			if (!q->thread.joinable()) continue;
+			if (wait) q->thread.join();
+			else q->thread.detach();
+		}
+	}
+
+	bool inflate_thread_pool::inflate_chunk(inflate_stream& s, inflate_job& j
+		, std::vector<disk_buffer_holder>& blocks)
+	{
+		span<char const> in = j.input;
+
+		// inflate one block at a time, straight into the buffers handed to
+		// the network thread. A block is handed over as soon as it's full,
+		// if we run out of input half-way, the remainder is filled in by
+		// the next chunk
+		while (s.inflated < j.unzip_length)
+		{
+			if (!s.block)
+			{
+				int const len = std::min(j.unzip_length - s.inflated, j.block_size);
+				s.block = disk_buffer_holder(*this, allocate_block(), len);
+				s.block_fill = 0;
+			}
+
+			int const block_size = int(s.block.size());
+			span<char> out(s.block.data() + s.block_fill, block_size - s.block_fill);
+			auto const ret = s.decoder->decode(in, out);
+			s.block_fill = block_size - int(out.size());
+
+			if (s.block_fill == block_size)
+			{
+				s.inflated += block_size;
+				blocks.emplace_back(std::move(s.block));
+				continue;
+			}
+
+			// the stream ended before the piece was complete
+			if (ret == zip_decoder::status::end) return false;
+
+			// we need more input to make progress
+			if (ret == zip_decoder::status::need_input) break;
+			if (ret != zip_decoder::status::ok) return false;
+		}
+
+		if (s.inflated < j.unzip_length) return !j.last;
+
+		// the inflated piece must consume all of the compressed input, and
+		// not have any more bytes to produce. The end of the stream may
+		// still be in the next chunk
+		if (in.empty() && !j.last) return true;
+		span<char> no_room;
+		auto const ret = s.decoder->decode(in, no_room);
+		if (!in.empty()) return false;
+		return !j.last || ret == zip_decoder::status::end;
+	}
+
+	void inflate_thread_pool::thread_fun(job_queue& q
+		, executor_work_guard<io_context::executor_type> work)
+	{
+		TORRENT_UNUSED(work);
+
+		std::unique_lock<std::mutex> l(q.mutex);
+		for (;;)
+		{
+			while (q.jobs.empty() && !q.abort) q.cond.wait(l);
+			if (q.abort) break;
+
+			inflate_job j = std::move(q.jobs.front());
+			q.jobs.pop_front();
+			l.unlock();
+			m_stats_counters.add_stats_counter(counters::queued_inflate_jobs, -1);
+
+			time_point const start_time = clock_type::now();
+
+			inflate_stream& s = *j.stream;
+			error_code ec;
+			std::vector<disk_buffer_holder> blocks;
+
+			if (!s.in_piece)
+			{
+				s.in_piece = true;
+				s.inflated = 0;
+				s.block.reset();
+				s.open = s.decoder && s.decoder->reset();
+				if (!s.open) ec = errors::http_failed_decompress;
+			}
+			int const start = s.inflated;
+
+			// once a piece has failed, the rest of its chunks are ignored
+			if (s.open)
+			{
+				if (!inflate_chunk(s, j, blocks))
+				{
+					ec = errors::http_failed_decompress;
+					blocks.clear();
+				}
+				if (ec || j.last)
+				{
+					s.open = false;
+					s.block.reset();
+				}
+			}
+			if (j.last) s.in_piece = false;
+
+			m_stats_counters.add_stats_counter(counters::inflate_time
+				, total_microseconds(clock_type::now() - start_time));
+
+			// the handler is always posted, even when there are no blocks,
+			// since it may hold the last reference to the connection, which
+			// must be destructed on the network thread
+			post(m_ios, [h = std::move(j.handler), ec, start, b = std::move(blocks)]() mutable
+				{ h(ec, start, std::move(b)); });
+
+			l.lock();
+		}
+	}
+}
+}
@@ -0,0 +1,1745 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/disk_interface.hpp"
+#include "libtorrent/disk_buffer_holder.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/aux_/posix_storage.hpp"
+#include "libtorrent/aux_/storage_utils.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/aux_/disk_completion.hpp"
+#include "libtorrent/aux_/heterogeneous_queue.hpp"
+#include "libtorrent/aux_/disk_io_thread_pool.hpp"
+#include "libtorrent/aux_/throw.hpp"
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+namespace libtorrent {
+
+namespace {
+
+	using aux::posix_storage;
+
+	// there's no need for liburing, the ring is simple enough to drive with
+	// the plain system calls
+	int sys_io_uring_setup(unsigned const entries, io_uring_params* p)
+	{
+		return int(::syscall(__NR_io_uring_setup, entries, p));
+	}
+
+	int sys_io_uring_enter(int const fd, unsigned const to_submit
+		, unsigned const min_complete, unsigned const flags)
+	{
+		return int(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete
+			, flags, nullptr, 0));
+	}
+
+	int sys_io_uring_register(int const fd, unsigned const opcode
+		, void const* arg, unsigned const nr_args)
+	{
+		return int(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+	}
+
+	// the submission and completion queues shared with the kernel. Only a
+	// single thread may use a ring
+	struct ring
+	{
+		explicit ring(unsigned const entries)
+		{
+			io_uring_params p{};
+			m_fd = sys_io_uring_setup(entries, &p);
+			if (m_fd < 0) aux::throw_ex<system_error>(error_code(errno, generic_category()));
+
+			// without this, the kernel drops completions when the completion
+			// queue overflows (before linux 5.5), and their jobs would never
+			// complete
+			if ((p.features & IORING_FEAT_NODROP) == 0)
+			{
+				::close(m_fd);
+				aux::throw_ex<system_error>(error_code(ENOTSUP, generic_category()));
+			}
+
+			m_sq_size = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+			m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+			bool const single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single_mmap) m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+
+			m_sq_ring = map(m_sq_size, IORING_OFF_SQ_RING);
+			m_cq_ring = single_mmap ? m_sq_ring : map(m_cq_size, IORING_OFF_CQ_RING);
+			m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+			m_sqes = static_cast<io_uring_sqe*>(map(m_sqes_size, IORING_OFF_SQES));
+			if (m_sq_ring == nullptr || m_cq_ring == nullptr || m_sqes == nullptr)
+			{
+				error_code const ec(errno, generic_category());
+				unmap();
+				aux::throw_ex<system_error>(ec);
+			}
+
+			char* const sq = static_cast<char*>(m_sq_ring);
+			m_sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+			m_sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+			m_sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+			m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+			m_sq_entries = p.sq_entries;
+			m_tail = *m_sq_tail;
+
+			char* const cq = static_cast<char*>(m_cq_ring);
+			m_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+			m_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+			m_cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+			m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+			m_cq_entries = p.cq_entries;
+		}
+
+		~ring()
+		{
+			unmap();
+		}
+
+		ring(ring const&) = delete;
+		ring& operator=(ring const&) = delete;
+
+		int cq_entries() const { return int(m_cq_entries); }
+
+		// returns a cleared submission queue entry, or nullptr if the
+		// submission queue is full
+		io_uring_sqe* get_sqe()
+		{
+			unsigned const head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			if (m_tail - head >= m_sq_entries) return nullptr;
+			unsigned const idx = m_tail & m_sq_mask;
+			io_uring_sqe* const sqe = &m_sqes[idx];
+			std::memset(sqe, 0, sizeof(io_uring_sqe));
+			m_sq_array[idx] = idx;
+			++m_tail;
+			return sqe;
+		}
+
+		// submits all queued entries, and waits for at least min_complete
+		// completions. Returns the number of entries submitted or a negative
+		// error code
+		int submit(unsigned const min_complete)
+		{
+			__atomic_store_n(m_sq_tail, m_tail, __ATOMIC_RELEASE);
+			unsigned const to_submit = m_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			if (to_submit == 0 && min_complete == 0) return 0;
+			int const ret = sys_io_uring_enter(m_fd, to_submit, min_complete
+				, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0u);
+			return ret < 0 ? -errno : ret;
+		}
+
+		// calls f with every completion queue entry available, and returns
+		// the number of entries
+		template <typename Fun>
+		int reap(Fun f)
+		{
+			unsigned head = *m_cq_head;
+			int ret = 0;
+			for (;;)
+			{
+				unsigned const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+				if (head == tail) break;
+				for (; head != tail; ++head, ++ret)
+				{
+					io_uring_cqe const cqe = m_cqes[head & m_cq_mask];
+					__atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+					f(cqe);
+				}
+			}
+			return ret;
+		}
+
+		// returns a negative error code on failure
+		int register_op(unsigned const opcode, void const* arg, unsigned const nr_args)
+		{
+			int const ret = sys_io_uring_register(m_fd, opcode, arg, nr_args);
+			return ret < 0 ? -errno : ret;
+		}
+
+	private:
+
+		void* map(std::size_t const size, std::uint64_t const offset) const
+		{
+			void* const ret = ::mmap(nullptr, size, PROT_READ | PROT_WRITE
+				, MAP_SHARED | MAP_POPULATE, m_fd, off_t(offset));
+			return ret == MAP_FAILED ? nullptr : ret;
+		}
+
+		void unmap()
+		{
+			if (m_sqes) ::munmap(m_sqes, m_sqes_size);
+			if (m_cq_ring && m_cq_ring != m_sq_ring) ::munmap(m_cq_ring, m_cq_size);
+			if (m_sq_ring) ::munmap(m_sq_ring, m_sq_size);
+			::close(m_fd);
+		}
+
+		int m_fd = -1;
+
+		void* m_sq_ring = nullptr;
+		void* m_cq_ring = nullptr;
+		io_uring_sqe* m_sqes = nullptr;
+		std::size_t m_sq_size = 0;
+		std::size_t m_cq_size = 0;
+		std::size_t m_sqes_size = 0;
+
+		unsigned* m_sq_head = nullptr;
+		unsigned* m_sq_tail = nullptr;
+		unsigned* m_sq_array = nullptr;
+		unsigned m_sq_mask = 0;
+		unsigned m_sq_entries = 0;
+
+		// our copy of the submission queue tail, published to the kernel by
+		// submit()
+		unsigned m_tail = 0;
+
+		unsigned* m_cq_head = nullptr;
+		unsigned* m_cq_tail = nullptr;
+		io_uring_cqe* m_cqes = nullptr;
+		unsigned m_cq_mask = 0;
+		unsigned m_cq_entries = 0;
+	};
+
+	// the number of submission queue entries of the ring. The completion
+	// queue is twice as large. The ring thread keeps no more than half of it
+	// in flight, leaving room for the operations a running job may add
+	constexpr unsigned ring_entries = 256;
+
+	// the number of slots in the fixed file table. Files opened while it's
+	// full are used by their file descriptor
+	constexpr int max_fixed_files = 512;
+
+	// the number of disk buffer regions that may be registered as fixed
+	// buffers
+	constexpr int max_fixed_buffers = 1024;
+
+	// the number of blocks a hash job reads at a time
+	constexpr int hash_batch_size = 8;
+
+	// the user_data of the read on the eventfd that wakes up the ring
+	// thread when there are new jobs
+	constexpr std::uint64_t wakeup_tag = 0;
+
+	struct io_job;
+
+	struct torrent_storage
+	{
+		explicit torrent_storage(storage_params const& p) : storage(p) {}
+
+		posix_storage storage;
+
+		// the following members are only used by the ring thread
+
+		// the number of jobs on this storage that have started but not
+		// completed yet, including the ones waiting for an overlapping write.
+		// Jobs operating on the storage as a whole (fences) wait for this to
+		// drop to zero
+		int outstanding = 0;
+
+		// a fence waiting for the outstanding jobs, followed by the jobs
+		// issued after it
+		std::deque<io_job*> blocked;
+
+		// jobs waiting for an overlapping write to complete
+		std::vector<io_job*> deferred;
+
+		// the writes in flight, by piece and offset. They never overlap
+		std::map<std::pair<piece_index_t, int>, io_job*> writes;
+	};
+
+	enum class job_type : std::uint8_t { read, write, hash, hash2, fence };
+
+	struct hash_state
+	{
+		hasher ph;
+		span<sha256_hash> block_hashes;
+		bool v1 = false;
+		int piece_size = 0;
+		int piece_size2 = 0;
+		int blocks_in_piece = 0;
+		int blocks_in_piece2 = 0;
+		int blocks = 0;
+		bool started = false;
+
+		// the first block of the batch being read, and the number of blocks
+		// in it
+		int next = 0;
+		int batch = 0;
+		std::array<char*, hash_batch_size> buffers{};
+	};
+
+	struct io_job
+	{
+		job_type type;
+		std::shared_ptr<torrent_storage> storage;
+
+		// for hash2 jobs, the offset is the block to hash
+		peer_request r;
+
+		// the buffer read into, or written from
+		char* buffer = nullptr;
+
+		// the hash of the block, for hash2 jobs
+		sha256_hash block_hash;
+
+		// the number of operations in flight
+		int pending = 0;
+
+		// set once the job is counted in its storage's outstanding jobs.
+		// Jobs put back in the pending queue after being held up by a fence
+		// or an overlapping write are started without being dispatched again
+		bool admitted = false;
+
+		storage_error error;
+		time_point start_time;
+
+		std::function<void(disk_buffer_holder, storage_error const&)> read_handler;
+		std::function<void(storage_error const&)> write_handler;
+		std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> hash_handler;
+		std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> hash2_handler;
+
+		// fences are performed synchronously on the ring thread, once all
+		// other jobs on the storage have completed. The function posts its
+		// own completion
+		std::function<void()> fence;
+
+		std::unique_ptr<hash_state> hash;
+	};
+
+	struct open_file
+	{
+		torrent_storage const* storage;
+		file_index_t index;
+		int fd;
+
+		// the slot in the fixed file table, or -1
+		int slot;
+		bool writable;
+
+		// the number of operations in flight on this file. It may only be
+		// closed once this is 0
+		int refs;
+		std::uint64_t last_use;
+	};
+
+	// an operation submitted to the ring. This is the user_data of its
+	// submission queue entry. A short read or write is resubmitted for the
+	// remainder, with the offset and buffer advanced past what completed
+	struct ring_op
+	{
+		io_job* job;
+		open_file* file;
+		std::int64_t offset;
+		iovec_t buf;
+		bool write;
+	};
+
+	// the caller must hold the storage exclusively, i.e. run on the ring
+	// thread with no jobs in flight on it
+	status_t check_files(posix_storage& st, settings_interface const& sett
+		, add_torrent_params const* resume_data
+		, aux::vector<std::string, file_index_t> links, storage_error& error)
+	{
+		add_torrent_params tmp;
+		add_torrent_params const* rd = resume_data ? resume_data : &tmp;
+
+		st.initialize(sett, error);
+		if (error) return status_t::fatal_disk_error;
+
+		bool const verify_success = st.verify_resume_data(*rd
+			, std::move(links), error);
+
+		if (sett.get_bool(settings_pack::no_recheck_incomplete_resume))
+			return status_t::no_error;
+
+		if (!aux::contains_resume_data(*rd))
+		{
+			// if we don't have any resume data, we still may need to trigger a
+			// full re-check, if there are *any* files.
+			storage_error ignore;
+			return (st.has_any_file(ignore))
+				? status_t::need_full_check
+				: status_t::no_error;
+		}
+
+		return verify_success
+			? status_t::no_error
+			: status_t::need_full_check;
+	}
+
+} // anonymous namespace
+
+	// all file I/O is submitted to an io_uring by a single thread, the ring
+	// thread. The network thread queues jobs for it, and wakes it up by
+	// writing to an eventfd the ring thread always has a read pending on.
+	// Operations on a storage as a whole (moving, renaming, checking files
+	// etc.) are performed synchronously on the ring thread, once the reads
+	// and writes issued before them have completed. The blocks read by hash
+	// jobs are hashed by the hasher threads (settings_pack::hashing_threads),
+	// which hand the jobs back to the ring thread.
+	struct TORRENT_EXTRA_EXPORT io_uring_disk_io final
+		: disk_interface
+		, buffer_allocator_interface
+		, aux::pool_thread_interface
+	{
+		io_uring_disk_io(io_context& ios, settings_interface const& sett, counters& cnt)
+			: m_settings(sett)
+			, m_buffer_pool(ios)
+			, m_stats_counters(cnt)
+			, m_ios(ios)
+			, m_hash_threads(*this, ios)
+			, m_ring(ring_entries)
+		{
+			settings_updated();
+
+			m_event_fd = ::eventfd(0, EFD_CLOEXEC);
+			if (m_event_fd < 0) aux::throw_ex<system_error>(error_code(errno, generic_category()));
+
+			register_resources();
+			m_thread = std::thread([this] { thread_fun(); });
+		}
+
+		~io_uring_disk_io() override
+		{
+			abort(true);
+			for (auto& f : m_files) ::close(f->fd);
+			::close(m_event_fd);
+		}
+
+		void settings_updated() override
+		{
+			m_buffer_pool.set_settings(m_settings);
+			m_hash_threads.set_max_threads(m_settings.get_int(settings_pack::hashing_threads));
+		}
+
+		storage_holder new_torrent(storage_params const& params
+			, std::shared_ptr<void> const&) override
+		{
+			// make sure we can remove this torrent without causing a memory
+			// allocation, by causing the allocation now instead
+			m_free_slots.reserve(m_torrents.size() + 1);
+			storage_index_t idx;
+			if (m_free_slots.empty())
+			{
+				idx = m_torrents.end_index();
+			}
+			else
+			{
+				idx = m_free_slots.back();
+				m_free_slots.pop_back();
+			}
+			auto storage = std::make_shared<torrent_storage>(params);
+			if (idx == m_torrents.end_index()) m_torrents.emplace_back(std::move(storage));
+			else m_torrents[idx] = std::move(storage);
+			return storage_holder(idx, *this);
+		}
+
+		void remove_torrent(storage_index_t const idx) override
+		{
+			if (!m_torrents[idx]) return;
+
+			// the storage is kept alive by its outstanding jobs, and its files
+			// are closed once they have completed
+			add_fence(idx, [] {});
+			m_torrents[idx].reset();
+			m_free_slots.push_back(idx);
+		}
+
+		void abort(bool const wait) override
+		{
+			{
+				std::lock_guard<std::mutex> l(m_job_mutex);
+				m_abort = true;
+			}
+			{
+				std::lock_guard<std::mutex> l(m_hash_mutex);
+				m_abort_hashing = true;
+			}
+			wake_up();
+			if (wait && m_thread.joinable()) m_thread.join();
+
+			// the hasher threads stay until the ring thread has completed
+			// all jobs
+			m_hash_threads.abort(wait);
+		}
+
+		void async_read(storage_index_t const storage, peer_request const& r
+			, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
+			, disk_job_flags_t) override
+		{
+			io_job* j = new_job(job_type::read, storage);
+			j->r = r;
+			j->read_handler = std::move(handler);
+			queue_job(j);
+		}
+
+		bool async_write(storage_index_t const storage, peer_request const& r
+			, char const* buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t) override
+		{
+			TORRENT_ASSERT(r.length <= default_block_size);
+			bool exceeded = false;
+			char* copy = m_buffer_pool.allocate_buffer(exceeded, std::move(o), "receive buffer");
+			if (copy == nullptr)
+			{
+				// the pool failed to allocate memory. It has flagged itself as
+				// exceeded, so the peer waits for the observer to be
+				// notified before receiving more
+				storage_error error;
+				error.ec = errors::no_memory;
+				error.operation = operation_t::alloc_cache_piece;
+				post_completion([=, h = std::move(handler)]{ h(error); });
+				return exceeded;
+			}
+			io_job* j = new_job(job_type::write, storage);
+			std::memcpy(copy, buf, std::size_t(r.length));
+			j->r = r;
+			j->buffer = copy;
+			j->write_handler = std::move(handler);
+			queue_job(j);
+			return exceeded;
+		}
+
+		void async_hash(storage_index_t const storage, piece_index_t const piece
+			, span<sha256_hash> block_hashes, disk_job_flags_t const flags
+			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override
+		{
+			io_job* j = new_job(job_type::hash, storage);
+			++m_hash_jobs_issued;
+			j->r.piece = piece;
+			j->hash.reset(new hash_state);
+			j->hash->block_hashes = block_hashes;
+			j->hash->v1 = bool(flags & disk_interface::v1_hash);
+			j->hash_handler = std::move(handler);
+			queue_job(j);
+		}
+
+		void async_hash2(storage_index_t const storage, piece_index_t const piece
+			, int const offset, disk_job_flags_t
+			, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override
+		{
+			io_job* j = new_job(job_type::hash2, storage);
+			++m_hash_jobs_issued;
+			j->r.piece = piece;
+			j->r.start = offset;
+			j->hash2_handler = std::move(handler);
+			queue_job(j);
+		}
+
+		void async_move_storage(storage_index_t const storage, std::string p
+			, move_flags_t const flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, p, flags, h = std::move(handler)] () mutable
+			{
+				storage_error ec;
+				status_t ret;
+				std::tie(ret, p) = st->storage.move_storage(p, flags, ec);
+				post_completion([=, h = std::move(h)]{ h(ret, p, ec); });
+			});
+		}
+
+		void async_release_files(storage_index_t const storage, std::function<void()> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, h = std::move(handler)]
+			{
+				st->storage.release_files();
+				if (h) post_completion(h);
+			});
+		}
+
+		void async_delete_files(storage_index_t const storage, remove_flags_t const options
+			, std::function<void(storage_error const&)> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, options, h = std::move(handler)]
+			{
+				storage_error error;
+				st->storage.delete_files(options, error);
+				post_completion([=]{ h(error); });
+			});
+		}
+
+		void async_check_files(storage_index_t const storage
+			, add_torrent_params const* resume_data
+			, aux::vector<std::string, file_index_t> links
+			, std::function<void(status_t, storage_error const&)> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, resume_data, l = std::move(links)
+				, h = std::move(handler)] () mutable
+			{
+				storage_error error;
+				status_t const ret = check_files(st->storage, m_settings
+					, resume_data, std::move(l), error);
+				post_completion([error, ret, h = std::move(h)]{ h(ret, error); });
+			});
+		}
+
+		void async_rename_file(storage_index_t const storage
+			, file_index_t const idx
+			, std::string name
+			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, idx, n = std::move(name), h = std::move(handler)] () mutable
+			{
+				storage_error error;
+				st->storage.rename_file(idx, n, error);
+				post_completion([idx, error, h = std::move(h), n = std::move(n)] () mutable
+					{ h(std::move(n), idx, error); });
+			});
+		}
+
+		void async_stop_torrent(storage_index_t const storage, std::function<void()> handler) override
+		{
+			add_fence(storage, [this, h = std::move(handler)]
+			{
+				if (h) post_completion(h);
+			});
+		}
+
+		void async_set_file_priority(storage_index_t const storage
+			, aux::vector<download_priority_t, file_index_t> prio
+			, std::function<void(storage_error const&
+				, aux::vector<download_priority_t, file_index_t>)> handler) override
+		{
+			auto st = m_torrents[storage];
+			add_fence(storage, [this, st, p = std::move(prio), h = std::move(handler)] () mutable
+			{
+				storage_error error;
+				st->storage.set_file_priority(p, error);
+				post_completion([p = std::move(p), h = std::move(h), error] () mutable
+					{ h(error, std::move(p)); });
+			});
+		}
+
+		void async_clear_piece(storage_index_t, piece_index_t const index
+			, std::function<void(piece_index_t)> handler) override
+		{
+			post_completion([=, h = std::move(handler)]{ h(index); });
+		}
+
+		// implements buffer_allocator_interface
+		void free_disk_buffer(char* b) override
+		{ m_buffer_pool.free_buffer(b); }
+
+		void update_stats_counters(counters&) const override {}
+
+		std::vector<open_file_state> get_status(storage_index_t) const override
+		{ return {}; }
+
+		void submit_jobs() override
+		{
+			{
+				std::lock_guard<std::mutex> l(m_job_mutex);
+				if (!m_jobs_queued) return;
+				m_jobs_queued = false;
+			}
+			if (m_hash_jobs_issued > 0)
+			{
+				// start hasher threads for the hash jobs, ahead of their
+				// blocks being read
+				std::lock_guard<std::mutex> l(m_hash_mutex);
+				m_hash_threads.job_queued(m_hash_jobs_issued);
+				m_hash_jobs_issued = 0;
+			}
+			wake_up();
+		}
+
+		// implements pool_thread_interface
+		void notify_all() override
+		{
+			m_hash_cond.notify_all();
+		}
+
+		// the hasher threads
+		void thread_fun(aux::disk_io_thread_pool& pool
+			, executor_work_guard<io_context::executor_type> work) override
+		{
+			m_stats_counters.add_stats_counter(counters::num_running_threads, 1);
+
+			std::unique_lock<std::mutex> l(m_hash_mutex);
+			while (!wait_for_hash_job(pool, l))
+			{
+				io_job* j = m_hash_jobs.front();
+				m_hash_jobs.pop_front();
+				l.unlock();
+
+				hash_blocks(j);
+				{
+					std::lock_guard<std::mutex> jl(m_job_mutex);
+					m_hashed_jobs.push_back(j);
+				}
+				wake_up();
+				l.lock();
+			}
+			l.unlock();
+
+			m_stats_counters.add_stats_counter(counters::num_running_threads, -1);
+
+			// the work guard keeps the io_context running until this thread
+			// stops posting completions to it
+			TORRENT_UNUSED(work);
+		}
+
+	private:
+
+		// returns true if the hasher thread should exit
+		bool wait_for_hash_job(aux::disk_io_thread_pool& threads
+			, std::unique_lock<std::mutex>& l)
+		{
+			TORRENT_ASSERT(l.owns_lock());
+			if (!m_hash_jobs.empty()) return false;
+
+			threads.thread_idle();
+			do
+			{
+				// when aborting, the ring thread may hand us jobs until it
+				// exits. The last thread finishes up all queued jobs first
+				if (threads.should_exit()
+					&& (!m_abort_hashing || !m_ring_running)
+					&& (m_hash_jobs.empty() || threads.num_threads() > 1)
+					// try_thread_exit must be the last condition
+					&& threads.try_thread_exit(std::this_thread::get_id()))
+				{
+					threads.thread_active();
+					return true;
+				}
+
+				m_hash_cond.wait(l);
+			} while (m_hash_jobs.empty());
+			threads.thread_active();
+			return false;
+		}
+
+		io_job* new_job(job_type const type, storage_index_t const storage)
+		{
+			auto* j = new io_job;
+			j->type = type;
+			j->storage = m_torrents[storage];
+			return j;
+		}
+
+		void queue_job(io_job* j)
+		{
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			m_queued_jobs.push_back(j);
+			m_jobs_queued = true;
+		}
+
+		template <typename Fun>
+		void add_fence(storage_index_t const storage, Fun f)
+		{
+			io_job* j = new_job(job_type::fence, storage);
+			j->fence = std::move(f);
+			queue_job(j);
+		}
+
+		void wake_up()
+		{
+			std::uint64_t const one = 1;
+			int const ret = int(::write(m_event_fd, &one, sizeof(one)));
+			TORRENT_UNUSED(ret);
+		}
+
+		// sets up the sparse fixed file table and fixed buffer table. If the
+		// kernel doesn't support them, files and buffers are used as they
+		// are
+		void register_resources()
+		{
+			std::vector<int> fds(max_fixed_files, -1);
+			if (m_ring.register_op(IORING_REGISTER_FILES, fds.data(), max_fixed_files) >= 0)
+			{
+				for (int i = max_fixed_files - 1; i >= 0; --i)
+					m_free_file_slots.push_back(i);
+			}
+
+#ifdef IORING_RSRC_REGISTER_SPARSE
+			io_uring_rsrc_register reg{};
+			reg.nr = max_fixed_buffers;
+			reg.flags = IORING_RSRC_REGISTER_SPARSE;
+			if (m_ring.register_op(IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) >= 0)
+			{
+				// registered memory must stay mapped while the ring uses it
+				m_buffer_pool.keep_regions();
+				m_fixed_buffers = true;
+			}
+#endif
+		}
+
+		// returns the index of the fixed buffer holding buf, registering the
+		// disk buffer region it belongs to, if necessary. Returns -1 if buf
+		// can't be used as a fixed buffer
+		int buffer_index(char const* buf)
+		{
+#ifdef IORING_RSRC_REGISTER_SPARSE
+			if (!m_fixed_buffers) return -1;
+			char const* const base = aux::disk_buffer_pool::region_base(buf);
+			auto const i = m_buffer_slots.find(base);
+			if (i != m_buffer_slots.end()) return i->second;
+			if (int(m_buffer_slots.size()) >= max_fixed_buffers) return -1;
+
+			int const slot = int(m_buffer_slots.size());
+			iovec v{const_cast<char*>(base), std::size_t(aux::disk_buffer_pool::region_size)};
+			io_uring_rsrc_update2 up{};
+			up.offset = std::uint32_t(slot);
+			up.data = reinterpret_cast<std::uintptr_t>(&v);
+			up.nr = 1;
+			if (m_ring.register_op(IORING_REGISTER_BUFFERS_UPDATE, &up, sizeof(up)) < 0)
+			{
+				// most likely, we've hit the limit of locked memory. Don't
+				// try again
+				m_fixed_buffers = false;
+				return -1;
+			}
+			m_buffer_slots.emplace(base, slot);
+			return slot;
+#else
+			TORRENT_UNUSED(buf);
+			return -1;
+#endif
+		}
+
+		// ==== the following functions are only called by the ring thread ====
+
+		void thread_fun()
+		{
+			m_stats_counters.add_stats_counter(counters::num_running_threads, 1);
+
+			// the work guard keeps the io_context running until this thread
+			// stops posting completions to it
+			auto work = make_work_guard(m_ios);
+
+			arm_wake_up();
+
+			std::vector<io_job*> jobs;
+			std::vector<io_job*> hashed;
+			for (;;)
+			{
+				bool abort;
+				{
+					std::lock_guard<std::mutex> l(m_job_mutex);
+					jobs.swap(m_queued_jobs);
+					hashed.swap(m_hashed_jobs);
+					abort = m_abort;
+				}
+				m_num_jobs += int(jobs.size());
+				m_pending_jobs.insert(m_pending_jobs.end(), jobs.begin(), jobs.end());
+				jobs.clear();
+				for (io_job* j : hashed) hash_done(j);
+				hashed.clear();
+
+				// the completion queue bounds the number of operations in
+				// flight. The remaining jobs are started as operations
+				// complete. This includes the jobs released by a fence or a
+				// completed write, which are put back at the front
+				while (!m_pending_jobs.empty() && m_in_flight < m_ring.cq_entries() / 2)
+				{
+					io_job* j = m_pending_jobs.front();
+					m_pending_jobs.pop_front();
+					dispatch(j);
+				}
+
+				if (abort && m_num_jobs == 0) break;
+
+				int const ret = m_ring.submit(1);
+				TORRENT_ASSERT(ret >= 0 || ret == -EINTR || ret == -EBUSY || ret == -EAGAIN);
+				TORRENT_UNUSED(ret);
+				m_ring.reap([this](io_uring_cqe const& cqe) { on_completion(cqe); });
+			}
+
+			{
+				std::lock_guard<std::mutex> l(m_hash_mutex);
+				m_ring_running = false;
+			}
+			m_hash_cond.notify_all();
+
+			m_stats_counters.add_stats_counter(counters::num_running_threads, -1);
+			TORRENT_UNUSED(work);
+		}
+
+		void arm_wake_up()
+		{
+			io_uring_sqe* sqe = get_sqe();
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = m_event_fd;
+			sqe->addr = reinterpret_cast<std::uintptr_t>(&m_event_buf);
+			sqe->len = sizeof(m_event_buf);
+			sqe->user_data = wakeup_tag;
+		}
+
+		io_uring_sqe* get_sqe()
+		{
+			io_uring_sqe* sqe = m_ring.get_sqe();
+			while (sqe == nullptr)
+			{
+				// the submission queue is full, hand its entries to the kernel
+				m_ring.submit(0);
+				sqe = m_ring.get_sqe();
+			}
+			return sqe;
+		}
+
+		void dispatch(io_job* j)
+		{
+			if (j->admitted)
+			{
+				start(j);
+				return;
+			}
+
+			torrent_storage& st = *j->storage;
+			if (!st.blocked.empty()
+				|| (j->type == job_type::fence && st.outstanding > 0))
+			{
+				st.blocked.push_back(j);
+				return;
+			}
+
+			if (j->type == job_type::fence)
+			{
+				run_fence(j);
+				return;
+			}
+
+			++st.outstanding;
+			j->admitted = true;
+			j->start_time = clock_type::now();
+			start(j);
+		}
+
+		// puts jobs that were held up back at the front of the pending queue,
+		// in order, to be started within the limit of operations in flight
+		void requeue(std::vector<io_job*> const& jobs)
+		{
+			TORRENT_ASSERT(std::all_of(jobs.begin(), jobs.end()
+				, [](io_job const* j) { return j->admitted; }));
+			m_pending_jobs.insert(m_pending_jobs.begin(), jobs.begin(), jobs.end());
+		}
+
+		void run_fence(io_job* j)
+		{
+			torrent_storage& st = *j->storage;
+			TORRENT_ASSERT(st.outstanding == 0);
+			close_files(&st);
+			j->fence();
+			finish_job(j);
+		}
+
+		// starts (or continues) a job. A job overlapping a write in flight
+		// is deferred until the write completes. Reads entirely covered by
+		// writes in flight are served from their buffers
+		void start(io_job* j)
+		{
+			torrent_storage& st = *j->storage;
+			switch (j->type)
+			{
+				case job_type::read:
+				case job_type::hash2:
+				{
+					int length = j->r.length;
+					if (j->type == job_type::hash2)
+					{
+						length = std::min(default_block_size
+							, st.storage.files().piece_size2(j->r.piece) - j->r.start);
+						j->r.length = length;
+					}
+					auto const o = overlap(st, j->r.piece, j->r.start, length);
+					if (o == overlap_t::partial)
+					{
+						st.deferred.push_back(j);
+						return;
+					}
+					j->buffer = m_buffer_pool.allocate_buffer("send buffer");
+					if (j->buffer == nullptr)
+					{
+						j->error.ec = errors::no_memory;
+						j->error.operation = operation_t::alloc_cache_piece;
+						break;
+					}
+					if (o == overlap_t::covered)
+						copy_from_writes(st, j->r.piece, j->r.start, {j->buffer, length});
+					else
+						submit_range(j, j->r.piece, j->r.start, {j->buffer, length}, false);
+					break;
+				}
+				case job_type::write:
+				{
+					if (overlap(st, j->r.piece, j->r.start, j->r.length) != overlap_t::none)
+					{
+						st.deferred.push_back(j);
+						return;
+					}
+					st.writes.emplace(std::make_pair(j->r.piece, j->r.start), j);
+					submit_range(j, j->r.piece, j->r.start, {j->buffer, j->r.length}, true);
+					break;
+				}
+				case job_type::hash:
+				{
+					if (!start_hash_batch(j)) return;
+					break;
+				}
+				case job_type::fence:
+					TORRENT_ASSERT_FAIL();
+					return;
+			}
+			if (j->pending == 0) stage_done(j);
+		}
+
+		enum class overlap_t { none, partial, covered };
+
+		// determines whether the range is (partially) covered by the writes
+		// in flight
+		overlap_t overlap(torrent_storage const& st, piece_index_t const piece
+			, int const start, int const length) const
+		{
+			int const end = start + length;
+			int pos = start;
+			bool any = false;
+			for (auto i = st.writes.lower_bound({piece, start - default_block_size})
+				; i != st.writes.end() && i->first.first == piece && i->first.second < end; ++i)
+			{
+				int const write_start = i->first.second;
+				int const write_end = write_start + i->second->r.length;
+				if (write_end <= start) continue;
+				any = true;
+				if (write_start <= pos) pos = std::max(pos, write_end);
+			}
+			if (!any) return overlap_t::none;
+			return pos >= end ? overlap_t::covered : overlap_t::partial;
+		}
+
+		void copy_from_writes(torrent_storage const& st, piece_index_t const piece
+			, int const start, span<char> buf) const
+		{
+			int const end = start + int(buf.size());
+			for (auto i = st.writes.lower_bound({piece, start - default_block_size})
+				; i != st.writes.end() && i->first.first == piece && i->first.second < end; ++i)
+			{
+				io_job const& w = *i->second;
+				int const from = std::max(start, w.r.start);
+				int const to = std::min(end, w.r.start + w.r.length);
+				if (from >= to) continue;
+				std::memcpy(buf.data() + (from - start), w.buffer + (from - w.r.start)
+					, std::size_t(to - from));
+			}
+		}
+
+		// submits the reads or writes of the range, one per file it spans.
+		// Pad files and files whose data is kept in the part file are handled
+		// synchronously. Errors are recorded in the job
+		void submit_range(io_job* j, piece_index_t const piece, int const offset
+			, span<char> buf, bool const write)
+		{
+			torrent_storage* const ts = j->storage.get();
+			posix_storage& st = ts->storage;
+			iovec_t const b = buf;
+			storage_error error;
+			aux::readwritev(st.files(), b, piece, offset, error
+				, [&](file_index_t const file, std::int64_t const file_offset
+					, span<iovec_t const> vec, storage_error& ec) -> int
+			{
+				if (st.files().pad_file_at(file))
+					return write ? bufs_size(vec) : aux::read_zeroes(vec);
+
+				if (st.in_part_file(file))
+				{
+					peer_request const map = st.files().map_file(file, file_offset, 0);
+					return write
+						? st.writev(m_settings, vec, map.piece, map.start, ec)
+						: st.readv(m_settings, vec, map.piece, map.start, ec);
+				}
+
+				open_file* const f = open(ts, file, write, ec);
+				if (f == nullptr) return -1;
+				if (write) st.set_file_dirty(file);
+
+				std::int64_t pos = file_offset;
+				for (auto const& v : vec)
+				{
+					submit_op(j, f, pos, v, write);
+					pos += v.size();
+				}
+				return bufs_size(vec);
+			});
+			if (error && !j->error) j->error = error;
+		}
+
+		void submit_op(io_job* j, open_file* f, std::int64_t const file_offset
+			, iovec_t const buf, bool const write)
+		{
+			ring_op* op = alloc_op();
+			op->job = j;
+			op->file = f;
+			op->offset = file_offset;
+			op->buf = buf;
+			op->write = write;
+			queue_op(op);
+
+			++f->refs;
+			++j->pending;
+			++m_in_flight;
+		}
+
+		void queue_op(ring_op* op)
+		{
+			io_uring_sqe* sqe = get_sqe();
+			int const buf_index = buffer_index(op->buf.data());
+			if (buf_index >= 0)
+			{
+				sqe->opcode = op->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+				sqe->buf_index = std::uint16_t(buf_index);
+			}
+			else
+			{
+				sqe->opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+			}
+			if (op->file->slot >= 0)
+			{
+				sqe->fd = op->file->slot;
+				sqe->flags |= IOSQE_FIXED_FILE;
+			}
+			else
+			{
+				sqe->fd = op->file->fd;
+			}
+			sqe->off = std::uint64_t(op->offset);
+			sqe->addr = reinterpret_cast<std::uintptr_t>(op->buf.data());
+			sqe->len = std::uint32_t(op->buf.size());
+			sqe->user_data = reinterpret_cast<std::uintptr_t>(op);
+		}
+
+		void on_completion(io_uring_cqe const& cqe)
+		{
+			if (cqe.user_data == wakeup_tag)
+			{
+				arm_wake_up();
+				return;
+			}
+
+			ring_op* op = reinterpret_cast<ring_op*>(std::uintptr_t(cqe.user_data));
+			io_job* j = op->job;
+			open_file* f = op->file;
+
+			if (cqe.res > 0 && cqe.res < int(op->buf.size()) && !j->error)
+			{
+				// a short read or write, e.g. interrupted by a signal.
+				// Submit the remainder, it's still in flight
+				op->offset += cqe.res;
+				op->buf = op->buf.subspan(cqe.res);
+				queue_op(op);
+				return;
+			}
+
+			--m_in_flight;
+			--f->refs;
+			--j->pending;
+
+			// a read returning 0 bytes has hit the end of the file. A write
+			// making no progress fails the same way, rather than being retried
+			if (cqe.res <= 0 && !j->error)
+			{
+				if (cqe.res < 0) j->error.ec.assign(-cqe.res, generic_category());
+				else j->error.ec.assign(errors::file_too_short, libtorrent_category());
+				j->error.file(f->index);
+				j->error.operation = op->write ? operation_t::file_write : operation_t::file_read;
+			}
+			free_op(op);
+
+			if (j->pending == 0) stage_done(j);
+		}
+
+		// called when all operations of a job (or of a batch of a hash job)
+		// have completed
+		void stage_done(io_job* j)
+		{
+			std::int64_t const job_time = total_microseconds(clock_type::now() - j->start_time);
+			switch (j->type)
+			{
+				case job_type::read:
+				{
+					if (!j->error)
+					{
+						m_stats_counters.add_stats_counter(counters::num_blocks_read);
+						m_stats_counters.add_stats_counter(counters::num_read_ops);
+						m_stats_counters.add_stats_counter(counters::disk_read_time, job_time);
+						m_stats_counters.add_stats_counter(counters::disk_job_time, job_time);
+					}
+					disk_buffer_holder b;
+					if (!j->error) b = disk_buffer_holder(*this, j->buffer, j->r.length);
+					else if (j->buffer) m_buffer_pool.free_buffer(j->buffer);
+					post_completion([h = std::move(j->read_handler), b = std::move(b)
+						, e = j->error] () mutable { h(std::move(b), e); });
+					break;
+				}
+				case job_type::write:
+				{
+					std::shared_ptr<torrent_storage> const storage = j->storage;
+					torrent_storage& st = *storage;
+					st.writes.erase(std::make_pair(j->r.piece, j->r.start));
+					if (!j->error)
+					{
+						m_stats_counters.add_stats_counter(counters::num_blocks_written);
+						m_stats_counters.add_stats_counter(counters::num_write_ops);
+						m_stats_counters.add_stats_counter(counters::disk_write_time, job_time);
+						m_stats_counters.add_stats_counter(counters::disk_job_time, job_time);
+					}
+					post_completion([h = std::move(j->write_handler), e = j->error]{ h(e); });
+					job_done(j);
+
+					// jobs overlapping this write may be able to start now
+					std::vector<io_job*> deferred;
+					deferred.swap(st.deferred);
+					requeue(deferred);
+					return;
+				}
+				case job_type::hash:
+				case job_type::hash2:
+					queue_hash(j);
+					return;
+				case job_type::fence:
+					TORRENT_ASSERT_FAIL();
+					break;
+			}
+			job_done(j);
+		}
+
+		// hands the blocks a hash job just read to a hasher thread, which
+		// passes the job back to hash_done(). Without hasher threads, or if
+		// the read failed, this is done right here
+		void queue_hash(io_job* j)
+		{
+			if (!j->error)
+			{
+				std::lock_guard<std::mutex> l(m_hash_mutex);
+				if (m_hash_threads.num_threads() > 0)
+				{
+					m_hash_jobs.push_back(j);
+					m_hash_cond.notify_one();
+					return;
+				}
+			}
+			hash_blocks(j);
+			hash_done(j);
+		}
+
+		// hashes the blocks the job just read. This is called on a hasher
+		// thread, while the ring thread doesn't touch the job
+		void hash_blocks(io_job* j) const
+		{
+			if (j->error) return;
+			if (j->type == job_type::hash2)
+			{
+				j->block_hash = hasher256(span<char const>(j->buffer, j->r.length)).final();
+				return;
+			}
+
+			hash_state& hs = *j->hash;
+			for (int i = 0; i < hs.batch; ++i)
+			{
+				int const block = hs.next + i;
+				int const offset = block * default_block_size;
+				char const* buf = hs.buffers[std::size_t(i)];
+				if (hs.v1)
+					hs.ph.update(span<char const>(buf, std::min(default_block_size, hs.piece_size - offset)));
+				if (block < hs.blocks_in_piece2)
+				{
+					hs.block_hashes[block] = hasher256(span<char const>(buf
+						, std::min(default_block_size, hs.piece_size2 - offset))).final();
+				}
+			}
+		}
+
+		// called once the blocks read by a hash job have been hashed
+		void hash_done(io_job* j)
+		{
+			if (j->type == job_type::hash)
+			{
+				if (hash_batch_done(j)) job_done(j);
+				return;
+			}
+
+			if (!j->error)
+			{
+				std::int64_t const job_time = total_microseconds(clock_type::now() - j->start_time);
+				m_stats_counters.add_stats_counter(counters::num_read_back);
+				m_stats_counters.add_stats_counter(counters::num_blocks_read);
+				m_stats_counters.add_stats_counter(counters::num_read_ops);
+				m_stats_counters.add_stats_counter(counters::disk_hash_time, job_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, job_time);
+			}
+			if (j->buffer) m_buffer_pool.free_buffer(j->buffer);
+			post_completion([h = std::move(j->hash2_handler), p = j->r.piece
+				, hash = j->block_hash, e = j->error]{ h(p, hash, e); });
+			job_done(j);
+		}
+
+		// reads the next batch of blocks of a hash job. Returns false if the
+		// job was deferred
+		bool start_hash_batch(io_job* j)
+		{
+			torrent_storage& st = *j->storage;
+			hash_state& hs = *j->hash;
+			piece_index_t const piece = j->r.piece;
+
+			if (!hs.started)
+			{
+				hs.started = true;
+				bool const v2 = !hs.block_hashes.empty();
+				hs.piece_size = hs.v1 ? st.storage.files().piece_size(piece) : 0;
+				hs.piece_size2 = v2 ? st.storage.orig_files().piece_size2(piece) : 0;
+				hs.blocks_in_piece = hs.v1 ? (hs.piece_size + default_block_size - 1) / default_block_size : 0;
+				hs.blocks_in_piece2 = v2 ? st.storage.orig_files().blocks_in_piece2(piece) : 0;
+				hs.blocks = std::max(hs.blocks_in_piece, hs.blocks_in_piece2);
+				TORRENT_ASSERT(!v2 || int(hs.block_hashes.size()) >= hs.blocks_in_piece2);
+
+				for (auto& b : hs.buffers)
+				{
+					b = m_buffer_pool.allocate_buffer("hash buffer");
+					if (b != nullptr) continue;
+					j->error.ec = errors::no_memory;
+					j->error.operation = operation_t::alloc_cache_piece;
+					return true;
+				}
+			}
+
+			int const batch = std::min(hash_batch_size, hs.blocks - hs.next);
+			bool covered[hash_batch_size] = {};
+			for (int i = 0; i < batch; ++i)
+			{
+				int const offset = (hs.next + i) * default_block_size;
+				auto const o = overlap(st, piece, offset, block_length(hs, hs.next + i));
+				if (o == overlap_t::partial)
+				{
+					st.deferred.push_back(j);
+					return false;
+				}
+				covered[i] = o == overlap_t::covered;
+			}
+
+			hs.batch = batch;
+			for (int i = 0; i < batch; ++i)
+			{
+				int const offset = (hs.next + i) * default_block_size;
+				span<char> const buf(hs.buffers[std::size_t(i)], block_length(hs, hs.next + i));
+				if (covered[i]) copy_from_writes(st, piece, offset, buf);
+				else submit_range(j, piece, offset, buf, false);
+			}
+			return true;
+		}
+
+		int block_length(hash_state const& hs, int const block) const
+		{
+			int const offset = block * default_block_size;
+			int const len = hs.v1 ? std::min(default_block_size, hs.piece_size - offset) : 0;
+			int const len2 = block < hs.blocks_in_piece2
+				? std::min(default_block_size, hs.piece_size2 - offset) : 0;
+			return std::max(len, len2);
+		}
+
+		// starts reading the next batch, once the one that was just read has
+		// been hashed. Returns true once the job is complete
+		bool hash_batch_done(io_job* j)
+		{
+			hash_state& hs = *j->hash;
+			if (!j->error)
+			{
+				hs.next += hs.batch;
+
+				if (hs.next < hs.blocks)
+				{
+					if (start_hash_batch(j) && j->pending == 0) queue_hash(j);
+					return false;
+				}
+
+				std::int64_t const job_time = total_microseconds(clock_type::now() - j->start_time);
+				m_stats_counters.add_stats_counter(counters::num_read_back);
+				m_stats_counters.add_stats_counter(counters::num_blocks_read, hs.blocks);
+				m_stats_counters.add_stats_counter(counters::num_read_ops);
+				m_stats_counters.add_stats_counter(counters::disk_hash_time, job_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, job_time);
+			}
+
+			for (char* b : hs.buffers)
+				if (b) m_buffer_pool.free_buffer(b);
+
+			sha1_hash const hash = hs.v1 && !j->error ? hs.ph.final() : sha1_hash();
+			post_completion([h = std::move(j->hash_handler), p = j->r.piece
+				, hash, e = j->error]{ h(p, hash, e); });
+			return true;
+		}
+
+		// called once a job that isn't a fence has completed
+		void job_done(io_job* j)
+		{
+			torrent_storage& st = *j->storage;
+			TORRENT_ASSERT(st.outstanding > 0);
+			--st.outstanding;
+			if (j->type == job_type::write && j->buffer)
+				m_buffer_pool.free_buffer(j->buffer);
+			std::shared_ptr<torrent_storage> keep = std::move(j->storage);
+			finish_job(j);
+			start_blocked(keep);
+		}
+
+		// runs the fence waiting for the outstanding jobs on the storage, if
+		// they have completed, and starts the jobs issued after it, up to the
+		// next fence
+		void start_blocked(std::shared_ptr<torrent_storage> const& storage)
+		{
+			torrent_storage& st = *storage;
+			std::vector<io_job*> ready;
+			while (!st.blocked.empty())
+			{
+				io_job* j = st.blocked.front();
+				if (j->type == job_type::fence)
+				{
+					if (st.outstanding > 0) break;
+					st.blocked.pop_front();
+					run_fence(j);
+					continue;
+				}
+				st.blocked.pop_front();
+				++st.outstanding;
+				j->admitted = true;
+				j->start_time = clock_type::now();
+				ready.push_back(j);
+			}
+			requeue(ready);
+		}
+
+		void finish_job(io_job* j)
+		{
+			TORRENT_ASSERT(m_num_jobs > 0);
+			--m_num_jobs;
+			delete j;
+		}
+
+		ring_op* alloc_op()
+		{
+			if (m_free_ops.empty())
+			{
+				m_ops.emplace_back(new ring_op);
+				return m_ops.back().get();
+			}
+			ring_op* ret = m_free_ops.back();
+			m_free_ops.pop_back();
+			return ret;
+		}
+
+		void free_op(ring_op* op) { m_free_ops.push_back(op); }
+
+		// returns an open file for the storage and file index, opening it if
+		// necessary. Files are closed in least recently used order, once
+		// there are more than settings_pack::file_pool_size of them
+		open_file* open(torrent_storage const* st, file_index_t const idx
+			, bool const write, storage_error& ec)
+		{
+			for (auto& f : m_files)
+			{
+				if (f->storage != st || f->index != idx || (write && !f->writable)) continue;
+				f->last_use = ++m_file_clock;
+				return f.get();
+			}
+
+			int const limit = std::max(1, m_settings.get_int(settings_pack::file_pool_size));
+			while (int(m_files.size()) >= limit)
+			{
+				auto const i = std::min_element(m_files.begin(), m_files.end()
+					, [](std::unique_ptr<open_file> const& lhs, std::unique_ptr<open_file> const& rhs)
+					{
+						// files with operations in flight can't be closed
+						if ((lhs->refs == 0) != (rhs->refs == 0)) return lhs->refs == 0;
+						return lhs->last_use < rhs->last_use;
+					});
+				if ((*i)->refs > 0) break;
+				close_file(*i);
+				m_files.erase(i);
+			}
+
+			std::string const path = st->storage.file_path(idx);
+			int const flags = (write ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC;
+			int fd = ::open(path.c_str(), flags, 0666);
+			if (fd < 0 && write && errno == ENOENT)
+			{
+				// the directory the file is in doesn't exist. Create it and
+				// try again
+				create_directories(parent_path(path), ec.ec);
+				if (ec.ec)
+				{
+					ec.file(idx);
+					ec.operation = operation_t::mkdir;
+					return nullptr;
+				}
+				fd = ::open(path.c_str(), flags, 0666);
+			}
+			if (fd < 0)
+			{
+				ec.ec.assign(errno, generic_category());
+				ec.file(idx);
+				ec.operation = operation_t::file_open;
+				return nullptr;
+			}
+
+			int slot = -1;
+			if (!m_free_file_slots.empty())
+			{
+				slot = m_free_file_slots.back();
+				if (update_file_slot(slot, fd)) m_free_file_slots.pop_back();
+				else slot = -1;
+			}
+
+			m_files.emplace_back(new open_file{st, idx, fd, slot, write, 0, ++m_file_clock});
+			return m_files.back().get();
+		}
+
+		bool update_file_slot(int const slot, int fd)
+		{
+			io_uring_files_update up{};
+			up.offset = std::uint32_t(slot);
+			up.fds = reinterpret_cast<std::uintptr_t>(&fd);
+			return m_ring.register_op(IORING_REGISTER_FILES_UPDATE, &up, 1) >= 0;
+		}
+
+		void close_file(std::unique_ptr<open_file> const& f)
+		{
+			TORRENT_ASSERT(f->refs == 0);
+			if (f->slot >= 0)
+			{
+				update_file_slot(f->slot, -1);
+				m_free_file_slots.push_back(f->slot);
+			}
+			::close(f->fd);
+		}
+
+		void close_files(torrent_storage const* st)
+		{
+			auto const i = std::remove_if(m_files.begin(), m_files.end()
+				, [&](std::unique_ptr<open_file> const& f)
+				{
+					if (f->storage != st) return false;
+					close_file(f);
+					return true;
+				});
+			m_files.erase(i, m_files.end());
+		}
+
+		// the handlers of completed jobs are queued, and called by a single
+		// message posted to the io_context, rather than one each
+		template <typename Handler>
+		void post_completion(Handler h)
+		{
+			std::lock_guard<std::mutex> l(m_completion_mutex);
+			m_completed_jobs.emplace_back<completion<Handler>>(std::move(h));
+			if (m_job_completions_in_flight) return;
+			m_job_completions_in_flight = true;
+			post(m_ios, [this, t = clock_type::now()] { call_job_handlers(t); });
+		}
+
+		void call_job_handlers(time_point const posted)
+		{
+			{
+				std::lock_guard<std::mutex> l(m_completion_mutex);
+				TORRENT_ASSERT(m_job_completions_in_flight);
+				m_job_completions_in_flight = false;
+
+				// handlers may issue new jobs, their completions go in the
+				// next batch
+				TORRENT_ASSERT(m_calling_jobs.empty());
+				m_calling_jobs.swap(m_completed_jobs);
+			}
+			m_calling_jobs.get_pointers(m_handlers);
+
+			aux::record_completion_batch(m_stats_counters, int(m_handlers.size())
+				, clock_type::now() - posted);
+			for (auto* h : m_handlers) h->call();
+			m_calling_jobs.clear();
+		}
+
+		aux::vector<std::shared_ptr<torrent_storage>, storage_index_t> m_torrents;
+
+		// slots that are unused in the m_torrents vector
+		std::vector<storage_index_t> m_free_slots;
+
+		settings_interface const& m_settings;
+
+		aux::disk_buffer_pool m_buffer_pool;
+
+		counters& m_stats_counters;
+
+		// callbacks are posted on this
+		io_context& m_ios;
+
+		struct completion_handler
+		{
+			virtual void call() = 0;
+			virtual ~completion_handler() = default;
+		};
+
+		template <typename Handler>
+		struct completion final : completion_handler
+		{
+			explicit completion(Handler h) : m_handler(std::move(h)) {}
+			void call() override { m_handler(); }
+			Handler m_handler;
+		};
+
+		// handlers of completed jobs, waiting for the message posted to
+		// m_ios to call them. m_calling_jobs holds the batch whose handlers
+		// are being called
+		heterogeneous_queue<completion_handler> m_completed_jobs;
+		heterogeneous_queue<completion_handler> m_calling_jobs;
+		std::vector<completion_handler*> m_handlers;
+
+		// true while there's a call_job_handlers message in flight
+		bool m_job_completions_in_flight = false;
+
+		// protects m_completed_jobs and m_job_completions_in_flight
+		std::mutex m_completion_mutex;
+
+		// jobs queued by the network thread, waiting for the ring thread to
+		// pick them up. m_jobs_queued is set when jobs have been queued since
+		// the ring thread was last woken up
+		std::mutex m_job_mutex;
+		std::vector<io_job*> m_queued_jobs;
+		bool m_jobs_queued = false;
+		bool m_abort = false;
+
+		// hash jobs whose blocks have been hashed by a hasher thread, waiting
+		// for the ring thread to pick them up. Protected by m_job_mutex
+		std::vector<io_job*> m_hashed_jobs;
+
+		// the number of hash jobs issued since the last call to
+		// submit_jobs(), to start hasher threads for. Only used by the
+		// network thread
+		int m_hash_jobs_issued = 0;
+
+		// hash jobs whose blocks have been read, waiting for a hasher thread
+		std::mutex m_hash_mutex;
+		std::condition_variable m_hash_cond;
+		std::deque<io_job*> m_hash_jobs;
+
+		// the hasher threads may not exit when aborting while the ring thread
+		// is still running. Protected by m_hash_mutex
+		bool m_abort_hashing = false;
+		bool m_ring_running = true;
+
+		// the hasher threads (settings_pack::hashing_threads)
+		aux::disk_io_thread_pool m_hash_threads;
+
+		// the ring is destructed before the buffer pool, to unregister the
+		// buffers before they're freed
+		ring m_ring;
+
+		// the ring thread is woken up by writing to this eventfd
+		int m_event_fd = -1;
+
+		// the following members are only used by the ring thread
+
+		// the buffer the eventfd is read into
+		std::uint64_t m_event_buf = 0;
+
+		// jobs picked up from m_queued_jobs but not started yet
+		std::deque<io_job*> m_pending_jobs;
+
+		// the number of jobs picked up and not completed yet
+		int m_num_jobs = 0;
+
+		// the number of operations submitted to the ring, whose completions
+		// haven't been reaped yet
+		int m_in_flight = 0;
+
+		std::vector<std::unique_ptr<ring_op>> m_ops;
+		std::vector<ring_op*> m_free_ops;
+
+		std::vector<std::unique_ptr<open_file>> m_files;
+		std::uint64_t m_file_clock = 0;
+		std::vector<int> m_free_file_slots;
+
+		// the fixed buffer slot of every disk buffer region registered with
+		// the ring
+		std::unordered_map<char const*, int> m_buffer_slots;
+		bool m_fixed_buffers = false;
+
+		std::thread m_thread;
+	};
+
+	TORRENT_EXPORT std::unique_ptr<disk_interface> io_uring_disk_io_constructor(
+		io_context& ios, settings_interface const& sett, counters& cnt)
+	{
+		try
+		{
+			return std::make_unique<io_uring_disk_io>(ios, sett, cnt);
+		}
+		catch (system_error const&)
+		{
+			// io_uring isn't supported by this kernel, or it's disabled
+			return posix_disk_io_constructor(ios, sett, cnt);
+		}
+	}
+}
+
+#endif // TORRENT_HAVE_IO_URING
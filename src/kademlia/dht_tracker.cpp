@@ -71,9 +71,9 @@ namespace libtorrent { namespace dht {
 		int nodes, replacements, allocated_observers;
 		std::tie(nodes, replacements, allocated_observers) = dht.get_stats_counters();
 
-		c.inc_stats_counter(counters::dht_nodes, nodes);
-		c.inc_stats_counter(counters::dht_node_cache, replacements);
-		c.inc_stats_counter(counters::dht_allocated_observers, allocated_observers);
+		c.add_stats_counter(counters::dht_nodes, nodes);
+		c.add_stats_counter(counters::dht_node_cache, replacements);
+		c.add_stats_counter(counters::dht_allocated_observers, allocated_observers);
 	}
 
 	std::vector<udp::endpoint> concat(std::vector<udp::endpoint> const& v1
@@ -505,11 +505,11 @@ namespace libtorrent { namespace dht {
 			|| buf.front() != 'd'
 			|| buf.back() != 'e') return false;
 
-		m_counters.inc_stats_counter(counters::dht_bytes_in, buf_size);
+		m_counters.add_stats_counter(counters::dht_bytes_in, buf_size);
 		// account for IP and UDP overhead
-		m_counters.inc_stats_counter(counters::recv_ip_overhead_bytes
+		m_counters.add_stats_counter(counters::recv_ip_overhead_bytes
 			, aux::is_v6(ep) ? 48 : 28);
-		m_counters.inc_stats_counter(counters::dht_messages_in);
+		m_counters.add_stats_counter(counters::dht_messages_in);
 
 		if (m_settings.get_bool(settings_pack::dht_ignore_dark_internet) && aux::is_v4(ep))
 		{
@@ -522,14 +522,14 @@ namespace libtorrent { namespace dht {
 
 			if (std::find(std::begin(class_a), std::end(class_a), b[0]) != std::end(class_a))
 			{
-				m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+				m_counters.add_stats_counter(counters::dht_messages_in_dropped);
 				return true;
 			}
 		}
 
 		if (!m_blocker.incoming(ep.address(), clock_type::now(), m_log))
 		{
-			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+			m_counters.add_stats_counter(counters::dht_messages_in_dropped);
 			return true;
 		}
 
@@ -540,7 +540,7 @@ namespace libtorrent { namespace dht {
 		int const ret = bdecode(buf.data(), buf.data() + buf_size, m_msg, err, &pos, 10, 500);
 		if (ret != 0)
 		{
-			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+			m_counters.add_stats_counter(counters::dht_messages_in_dropped);
 #ifndef TORRENT_DISABLE_LOGGING
 			m_log->log_packet(dht_logger::incoming_message, buf, ep);
 #endif
@@ -549,7 +549,7 @@ namespace libtorrent { namespace dht {
 
 		if (m_msg.type() != bdecode_node::dict_t)
 		{
-			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+			m_counters.add_stats_counter(counters::dht_messages_in_dropped);
 #ifndef TORRENT_DISABLE_LOGGING
 			m_log->log_packet(dht_logger::incoming_message, buf, ep);
 #endif
@@ -708,18 +708,18 @@ namespace {
 
 		if (ec)
 		{
-			m_counters.inc_stats_counter(counters::dht_messages_out_dropped);
+			m_counters.add_stats_counter(counters::dht_messages_out_dropped);
 #ifndef TORRENT_DISABLE_LOGGING
 			m_log->log_packet(dht_logger::outgoing_message, m_send_buf, addr);
 #endif
 			return false;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_bytes_out, int(m_send_buf.size()));
+		m_counters.add_stats_counter(counters::dht_bytes_out, int(m_send_buf.size()));
 		// account for IP and UDP overhead
-		m_counters.inc_stats_counter(counters::sent_ip_overhead_bytes
+		m_counters.add_stats_counter(counters::sent_ip_overhead_bytes
 			, aux::is_v6(addr) ? 48 : 28);
-		m_counters.inc_stats_counter(counters::dht_messages_out);
+		m_counters.add_stats_counter(counters::dht_messages_out);
 #ifndef TORRENT_DISABLE_LOGGING
 		m_log->log_packet(dht_logger::outgoing_message, m_send_buf, addr);
 #endif
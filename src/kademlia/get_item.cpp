@@ -146,7 +146,7 @@ bool get_item::invoke(observer_ptr o)
 	e["q"] = "get";
 	a["target"] = target().to_string();
 
-	m_node.stats_counters().inc_stats_counter(counters::dht_get_out);
+	m_node.stats_counters().add_stats_counter(counters::dht_get_out);
 
 	return m_node.m_rpc.invoke(e, o->target_ep(), o);
 }
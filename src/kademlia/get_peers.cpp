@@ -150,7 +150,7 @@ bool get_peers::invoke(observer_ptr o)
 		m_node.observer()->outgoing_get_peers(target(), target(), o->target_ep());
 	}
 
-	m_node.stats_counters().inc_stats_counter(counters::dht_get_peers_out);
+	m_node.stats_counters().add_stats_counter(counters::dht_get_peers_out);
 
 	return m_node.m_rpc.invoke(e, o->target_ep(), o);
 }
@@ -253,7 +253,7 @@ bool obfuscated_get_peers::invoke(observer_ptr o)
 			, o->target_ep());
 	}
 
-	m_node.stats_counters().inc_stats_counter(counters::dht_get_peers_out);
+	m_node.stats_counters().add_stats_counter(counters::dht_get_peers_out);
 
 	return m_node.m_rpc.invoke(e, o->target_ep(), o);
 }
@@ -323,7 +323,7 @@ void node::incoming(aux::listen_socket_handle const& s, msg const& m)
 
 			if (!m_sock_man->has_quota())
 			{
-				m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+				m_counters.add_stats_counter(counters::dht_messages_in_dropped);
 				return;
 			}
 
@@ -401,7 +401,7 @@ namespace {
 			a["token"] = p.second;
 			a["seed"] = (flags & announce::seed) ? 1 : 0;
 			if (flags & announce::implied_port) a["implied_port"] = 1;
-			node.stats_counters().inc_stats_counter(counters::dht_announce_peer_out);
+			node.stats_counters().add_stats_counter(counters::dht_announce_peer_out);
 			node.m_rpc.invoke(e, p.first.ep(), o);
 		}
 	}
@@ -605,7 +605,7 @@ void node::sample_infohashes(udp::endpoint const& ep, sha1_hash const& target
 	e["q"] = "sample_infohashes";
 	e["a"]["target"] = target;
 
-	stats_counters().inc_stats_counter(counters::dht_sample_infohashes_out);
+	stats_counters().add_stats_counter(counters::dht_sample_infohashes_out);
 
 	m_rpc.invoke(e, ep, o);
 }
@@ -698,7 +698,7 @@ void node::send_single_refresh(udp::endpoint const& ep, int const bucket
 	{
 		// current bucket is full, just ping it.
 		e["q"] = "ping";
-		m_counters.inc_stats_counter(counters::dht_ping_out);
+		m_counters.add_stats_counter(counters::dht_ping_out);
 	}
 	else
 	{
@@ -706,7 +706,7 @@ void node::send_single_refresh(udp::endpoint const& ep, int const bucket
 		// either way.
 		e["q"] = "get_peers";
 		e["a"]["info_hash"] = target.to_string();
-		m_counters.inc_stats_counter(counters::dht_get_peers_out);
+		m_counters.add_stats_counter(counters::dht_get_peers_out);
 	}
 
 	m_rpc.invoke(e, ep, o);
@@ -840,7 +840,7 @@ void node::incoming_request(msg const& m, entry& e)
 
 	if (query == "ping")
 	{
-		m_counters.inc_stats_counter(counters::dht_ping_in);
+		m_counters.add_stats_counter(counters::dht_ping_in);
 		// we already have 't' and 'id' in the response
 		// no more left to add
 	}
@@ -856,14 +856,14 @@ void node::incoming_request(msg const& m, entry& e)
 		bdecode_node msg_keys[4];
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_get_peers);
+			m_counters.add_stats_counter(counters::dht_invalid_get_peers);
 			incoming_error(e, error_string);
 			return;
 		}
 
 		sha1_hash const info_hash(msg_keys[0].string_ptr());
 
-		m_counters.inc_stats_counter(counters::dht_get_peers_in);
+		m_counters.add_stats_counter(counters::dht_get_peers_in);
 
 		// always return nodes as well as peers
 		write_nodes_entries(info_hash, msg_keys[3], reply);
@@ -894,12 +894,12 @@ void node::incoming_request(msg const& m, entry& e)
 		bdecode_node msg_keys[2];
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_find_node);
+			m_counters.add_stats_counter(counters::dht_invalid_find_node);
 			incoming_error(e, error_string);
 			return;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_find_node_in);
+		m_counters.add_stats_counter(counters::dht_find_node_in);
 		sha1_hash const target(msg_keys[0].string_ptr());
 
 		write_nodes_entries(target, msg_keys[1], reply);
@@ -918,7 +918,7 @@ void node::incoming_request(msg const& m, entry& e)
 		bdecode_node msg_keys[6];
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_announce);
+			m_counters.add_stats_counter(counters::dht_invalid_announce);
 			incoming_error(e, error_string);
 			return;
 		}
@@ -932,7 +932,7 @@ void node::incoming_request(msg const& m, entry& e)
 
 		if (port < 0 || port >= 65536)
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_announce);
+			m_counters.add_stats_counter(counters::dht_invalid_announce);
 			incoming_error(e, "invalid port");
 			return;
 		}
@@ -945,12 +945,12 @@ void node::incoming_request(msg const& m, entry& e)
 		if (!verify_token(msg_keys[2].string_value()
 			, sha1_hash(msg_keys[0].string_ptr()), m.addr))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_announce);
+			m_counters.add_stats_counter(counters::dht_invalid_announce);
 			incoming_error(e, "invalid token");
 			return;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_announce_peer_in);
+		m_counters.add_stats_counter(counters::dht_announce_peer_in);
 
 		// the token was correct. That means this
 		// node is not spoofing its address. So, let
@@ -986,12 +986,12 @@ void node::incoming_request(msg const& m, entry& e)
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string)
 			|| arg_ent.has_soft_error(error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_put);
+			m_counters.add_stats_counter(counters::dht_invalid_put);
 			incoming_error(e, error_string);
 			return;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_put_in);
+		m_counters.add_stats_counter(counters::dht_put_in);
 
 		// is this a mutable put?
 		bool const mutable_put = (msg_keys[2] && msg_keys[3] && msg_keys[4]);
@@ -1008,7 +1008,7 @@ void node::incoming_request(msg const& m, entry& e)
 		span<char const> buf = msg_keys[1].data_section();
 		if (buf.size() > 1000 || buf.empty())
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_put);
+			m_counters.add_stats_counter(counters::dht_invalid_put);
 			incoming_error(e, "message too big", 205);
 			return;
 		}
@@ -1018,7 +1018,7 @@ void node::incoming_request(msg const& m, entry& e)
 			salt = {msg_keys[6].string_ptr(), msg_keys[6].string_length()};
 		if (salt.size() > 64)
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_put);
+			m_counters.add_stats_counter(counters::dht_invalid_put);
 			incoming_error(e, "salt too big", 207);
 			return;
 		}
@@ -1037,7 +1037,7 @@ void node::incoming_request(msg const& m, entry& e)
 		// specific target hashes. it must match the one we got a "get" for
 		if (!verify_token(msg_keys[0].string_value(), target, m.addr))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_put);
+			m_counters.add_stats_counter(counters::dht_invalid_put);
 			incoming_error(e, "invalid token");
 			return;
 		}
@@ -1055,7 +1055,7 @@ void node::incoming_request(msg const& m, entry& e)
 
 			if (seq < sequence_number(0))
 			{
-				m_counters.inc_stats_counter(counters::dht_invalid_put);
+				m_counters.add_stats_counter(counters::dht_invalid_put);
 				incoming_error(e, "invalid (negative) sequence number");
 				return;
 			}
@@ -1063,7 +1063,7 @@ void node::incoming_request(msg const& m, entry& e)
 			// msg_keys[4] is the signature, msg_keys[3] is the public key
 			if (!verify_mutable_item(buf, salt, seq, pk, sig))
 			{
-				m_counters.inc_stats_counter(counters::dht_invalid_put);
+				m_counters.add_stats_counter(counters::dht_invalid_put);
 				incoming_error(e, "invalid signature", 206);
 				return;
 			}
@@ -1085,14 +1085,14 @@ void node::incoming_request(msg const& m, entry& e)
 				// writers are accessing the same slot
 				if (msg_keys[5] && item_seq.value != msg_keys[5].int_value())
 				{
-					m_counters.inc_stats_counter(counters::dht_invalid_put);
+					m_counters.add_stats_counter(counters::dht_invalid_put);
 					incoming_error(e, "CAS mismatch", 301);
 					return;
 				}
 
 				if (item_seq > seq)
 				{
-					m_counters.inc_stats_counter(counters::dht_invalid_put);
+					m_counters.add_stats_counter(counters::dht_invalid_put);
 					incoming_error(e, "old sequence number", 302);
 					return;
 				}
@@ -1118,12 +1118,12 @@ void node::incoming_request(msg const& m, entry& e)
 		bdecode_node msg_keys[3];
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_get);
+			m_counters.add_stats_counter(counters::dht_invalid_get);
 			incoming_error(e, error_string);
 			return;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_get_in);
+		m_counters.add_stats_counter(counters::dht_get_in);
 		sha1_hash const target(msg_keys[1].string_ptr());
 
 //		std::fprintf(stderr, "%s GET target: %s\n"
@@ -1162,12 +1162,12 @@ void node::incoming_request(msg const& m, entry& e)
 		bdecode_node msg_keys[2];
 		if (!verify_message(arg_ent, msg_desc, msg_keys, error_string))
 		{
-			m_counters.inc_stats_counter(counters::dht_invalid_sample_infohashes);
+			m_counters.add_stats_counter(counters::dht_invalid_sample_infohashes);
 			incoming_error(e, error_string);
 			return;
 		}
 
-		m_counters.inc_stats_counter(counters::dht_sample_infohashes_in);
+		m_counters.add_stats_counter(counters::dht_sample_infohashes_in);
 		sha1_hash const target(msg_keys[0].string_ptr());
 
 		// TODO: keep the returned value to pass as a limit
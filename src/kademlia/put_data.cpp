@@ -110,7 +110,7 @@ bool put_data::invoke(observer_ptr o)
 		}
 	}
 
-	m_node.stats_counters().inc_stats_counter(counters::dht_put_out);
+	m_node.stats_counters().add_stats_counter(counters::dht_put_out);
 
 	return m_node.m_rpc.invoke(e, o->target_ep(), o);
 }
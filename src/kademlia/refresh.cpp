@@ -74,7 +74,7 @@ bool bootstrap::invoke(observer_ptr o)
 
 //	e["q"] = "find_node";
 //	a["target"] = target.to_string();
-	m_node.stats_counters().inc_stats_counter(counters::dht_get_peers_out);
+	m_node.stats_counters().add_stats_counter(counters::dht_get_peers_out);
 	return m_node.m_rpc.invoke(e, o->target_ep(), o);
 }
 
@@ -55,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <sys/mman.h> // for mmap
 #include <sys/stat.h>
 #include <fcntl.h> // for open
+#include <unistd.h> // for sysconf
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 auto const map_failed = MAP_FAILED;
@@ -571,17 +572,15 @@ file_mapping::file_mapping(file_handle file, open_mode_t const mode, std::int64_
 #if TORRENT_USE_MADVISE
 	if (file_size > 0)
 	{
-		int const advise = ((mode & open_mode::random_access) ? 0 : MADV_SEQUENTIAL)
+		// access pattern hints are issued by the disk I/O back-end, per job,
+		// via advise()
 #ifdef MADV_DONTDUMP
 		// on versions of linux that support it, ask for this region to not be
 		// included in coredumps (mostly to make the coredumps more manageable
 		// with large disk caches)
 		// ignore errors here, since this is best-effort
-			| MADV_DONTDUMP
+		madvise(m_mapping, static_cast<std::size_t>(m_size), MADV_DONTDUMP);
 #endif
-		;
-		if (advise != 0)
-			madvise(m_mapping, static_cast<std::size_t>(m_size), advise);
 	}
 #endif
 }
@@ -630,6 +629,7 @@ file_mapping::file_mapping(file_mapping&& rhs)
 	: m_size(rhs.m_size)
 	, m_file(std::move(rhs.m_file))
 	, m_mapping(rhs.m_mapping)
+	, m_advice(rhs.m_advice.load())
 	{
 		TORRENT_ASSERT(m_mapping);
 		rhs.m_mapping = nullptr;
@@ -642,6 +642,7 @@ file_mapping::file_mapping(file_mapping&& rhs)
 		m_file = std::move(rhs.m_file);
 		m_size = rhs.m_size;
 		m_mapping = rhs.m_mapping;
+		m_advice = rhs.m_advice.load();
 		rhs.m_mapping = nullptr;
 		return *this;
 	}
@@ -653,6 +654,81 @@ file_mapping::file_mapping(file_mapping&& rhs)
 		return file_view(shared_from_this());
 	}
 
+#if TORRENT_USE_MADVISE
+namespace {
+	std::int64_t page_size()
+	{
+		static std::int64_t const ret = [] {
+			long const s = ::sysconf(_SC_PAGESIZE);
+			return s > 0 ? std::int64_t(s) : std::int64_t(4096);
+		}();
+		return ret;
+	}
+} // anonymous
+#endif
+
+	advice_result file_mapping::advise(advice_t const a
+		, std::int64_t const offset, std::int64_t const len)
+	{
+#if TORRENT_USE_MADVISE
+		if (m_mapping == nullptr) return advice_result::skipped;
+
+		int advice = 0;
+		switch (a)
+		{
+			case advice_t::sequential: advice = MADV_SEQUENTIAL; break;
+#ifdef MADV_HUGEPAGE
+			case advice_t::huge_page: advice = MADV_HUGEPAGE; break;
+#else
+			case advice_t::huge_page: return advice_result::skipped;
+#endif
+			case advice_t::will_need: advice = MADV_WILLNEED; break;
+#ifdef MADV_COLD
+			case advice_t::cold: advice = MADV_COLD; break;
+#else
+			case advice_t::cold: advice = MADV_DONTNEED; break;
+#endif
+		}
+
+		if (a == advice_t::sequential || a == advice_t::huge_page)
+		{
+			// these set flags on the whole mapping. Applying them to a range
+			// would split it into multiple VMAs in the kernel, so they are
+			// only applied once, to all of it
+			std::uint8_t const bit = std::uint8_t(1 << int(a));
+			if (m_advice.fetch_or(bit) & bit) return advice_result::skipped;
+			if (madvise(m_mapping, static_cast<std::size_t>(m_size), advice) != 0)
+				return advice_result::failed;
+			return advice_result::applied;
+		}
+
+		// madvise() requires the address to be page aligned
+		std::int64_t const begin = std::max(offset, std::int64_t(0));
+		std::int64_t const end = std::min(offset + len, m_size);
+		if (end <= begin) return advice_result::skipped;
+		std::int64_t const ps = page_size();
+		std::int64_t const start = begin / ps * ps;
+
+		void* const addr = static_cast<char*>(m_mapping) + start;
+		auto const size = static_cast<std::size_t>(end - start);
+		if (madvise(addr, size, advice) == 0) return advice_result::applied;
+#ifdef MADV_COLD
+		// MADV_COLD was introduced in linux 5.4. On older kernels, fall back
+		// to dropping the pages, which for a shared file mapping just means
+		// they will have to be read back from the page cache
+		if (a == advice_t::cold && errno == EINVAL
+			&& madvise(addr, size, MADV_DONTNEED) == 0)
+			return advice_result::applied;
+#endif
+		return advice_result::failed;
+#else
+		TORRENT_UNUSED(a);
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(len);
+		return advice_result::skipped;
+#endif
+	}
+
 } // aux
 } // libtorrent
 
@@ -63,6 +63,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/settings_pack.hpp"
 #include "libtorrent/aux_/file_view_pool.hpp"
 #include "libtorrent/aux_/scope_end.hpp"
+#include "libtorrent/aux_/disk_completion.hpp"
+#include "libtorrent/aux_/mmap.hpp"
 
 #ifdef _WIN32
 #include "libtorrent/aux_/windows.hpp"
@@ -71,6 +73,12 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <functional>
 #include <condition_variable>
+#include <atomic>
+#include <array>
+
+#if TORRENT_HAVE_MMAP
+#include <sys/resource.h> // for getrusage
+#endif
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/get.hpp>
@@ -140,6 +148,27 @@ namespace {
 		return ret;
 	}
 
+	struct page_faults
+	{
+		std::int64_t major = 0;
+		std::int64_t minor = 0;
+	};
+
+	// the page faults taken by the calling thread so far
+	page_faults thread_page_faults()
+	{
+		page_faults ret;
+#ifdef RUSAGE_THREAD
+		rusage ru;
+		if (::getrusage(RUSAGE_THREAD, &ru) == 0)
+		{
+			ret.major = ru.ru_majflt;
+			ret.minor = ru.ru_minflt;
+		}
+#endif
+		return ret;
+	}
+
 	storage_index_t pop(std::vector<storage_index_t>& q)
 	{
 		TORRENT_ASSERT(!q.empty());
@@ -229,10 +258,14 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 	status_t do_file_priority(aux::disk_io_job* j);
 	status_t do_clear_piece(aux::disk_io_job* j);
 
-	void call_job_handlers();
+	void call_job_handlers(time_point posted);
 
 private:
 
+	// passes the hints enabled by settings_pack::mmap_advice on, for a
+	// block that was just read to be sent to a peer
+	void advise_read_block(aux::disk_io_job* j, int offset, int len);
+
 	struct job_queue : aux::pool_thread_interface
 	{
 		explicit job_queue(mmap_disk_io& owner) : m_owner(owner) {}
@@ -266,6 +299,28 @@ private:
 
 	void thread_fun(job_queue& queue, aux::disk_io_thread_pool& pool);
 
+	// the location of a block the kernel is asked to read in ahead of its
+	// job being performed
+	struct prefetch_block
+	{
+		std::shared_ptr<mmap_storage> storage;
+		piece_index_t piece;
+		int offset;
+		int length;
+	};
+	static constexpr std::size_t max_prefetch_jobs = 4;
+
+	// copies the locations of the first few read jobs in the queue that
+	// haven't been prefetched yet, if advise_prefetch_requests is enabled,
+	// and marks them as prefetched. Returns the number of blocks. Must be
+	// called with m_job_mutex held
+	int collect_prefetch(job_queue& q
+		, std::array<prefetch_block, max_prefetch_jobs>& blocks);
+
+	// adds the page faults the calling thread has taken since the last time
+	// to the counters, and updates reported
+	void report_page_faults(page_faults& reported);
+
 	// returns true if the thread should exit
 	static bool wait_for_job(job_queue& jobq, aux::disk_io_thread_pool& threads
 		, std::unique_lock<std::mutex>& l);
@@ -343,24 +398,23 @@ private:
 	// the main thread.
 	io_context& m_ios;
 
-	// jobs that are completed are put on this queue
-	// whenever the queue size grows from 0 to 1
-	// a message is posted to the network thread, which
-	// will then drain the queue and execute the jobs'
-	// handler functions
-	std::mutex m_completed_jobs_mutex;
-	jobqueue_t m_completed_jobs;
+	// jobs that are completed are pushed onto this lock-free stack (linked
+	// through disk_io_job::next) by the disk threads. Whenever there is no
+	// call_job_handlers message in flight, a message is posted to the
+	// network thread, which will then take all jobs on the stack at once
+	// and execute their handler functions
+	std::atomic<aux::disk_io_job*> m_completed_jobs{nullptr};
 
 	// storages that have had write activity recently and will get ticked
 	// soon, for deferred actions (say, flushing partfile metadata)
 	std::vector<std::pair<time_point, std::weak_ptr<mmap_storage>>> m_need_tick;
 	std::mutex m_need_tick_mutex;
 
-	// this is protected by the completed_jobs_mutex. It's true whenever
-	// there's a call_job_handlers message in-flight to the network thread. We
-	// only ever keep one such message in flight at a time, and coalesce
-	// completion callbacks in m_completed jobs
-	bool m_job_completions_in_flight = false;
+	// this is true whenever there's a call_job_handlers message in-flight to
+	// the network thread. We only ever keep one such message in flight at a
+	// time (give or take one, while it's being picked up), and coalesce
+	// completion callbacks in m_completed_jobs
+	std::atomic<bool> m_job_completions_in_flight{false};
 
 	aux::vector<std::shared_ptr<mmap_storage>, storage_index_t> m_torrents;
 
@@ -553,7 +607,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		TORRENT_ASSERT(static_cast<int>(j->action) < int(job_functions.size()));
 
-		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, 1);
+		m_stats_counters.add_stats_counter(counters::num_running_disk_jobs, 1);
 
 		// call disk function
 		// TODO: in the future, propagate exceptions back to the handlers
@@ -586,7 +640,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		TORRENT_ASSERT(ret != status_t::fatal_disk_error
 			|| (j->error.ec && j->error.operation != operation_t::unknown));
 
-		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -1);
+		m_stats_counters.add_stats_counter(counters::num_running_disk_jobs, -1);
 
 		j->ret = ret;
 
@@ -611,13 +665,15 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		if (!j->error.ec)
 		{
+			advise_read_block(j, j->d.io.offset, j->d.io.buffer_size);
+
 			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-			m_stats_counters.inc_stats_counter(counters::num_read_back);
-			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-			m_stats_counters.inc_stats_counter(counters::num_read_ops);
-			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
-			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+			m_stats_counters.add_stats_counter(counters::num_read_back);
+			m_stats_counters.add_stats_counter(counters::num_blocks_read);
+			m_stats_counters.add_stats_counter(counters::num_read_ops);
+			m_stats_counters.add_stats_counter(counters::disk_read_time, read_time);
+			m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 		}
 		return status_t::no_error;
 	}
@@ -646,17 +702,58 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		if (!j->error.ec)
 		{
+			advise_read_block(j, j->d.io.offset, j->d.io.buffer_size);
+
 			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-			m_stats_counters.inc_stats_counter(counters::num_read_back);
-			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-			m_stats_counters.inc_stats_counter(counters::num_read_ops);
-			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
-			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+			m_stats_counters.add_stats_counter(counters::num_read_back);
+			m_stats_counters.add_stats_counter(counters::num_blocks_read);
+			m_stats_counters.add_stats_counter(counters::num_read_ops);
+			m_stats_counters.add_stats_counter(counters::disk_read_time, read_time);
+			m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 		}
 		return status_t::no_error;
 	}
 
+	void mmap_disk_io::advise_read_block(aux::disk_io_job* j, int const offset, int const len)
+	{
+		int const mask = m_settings.get_int(settings_pack::mmap_advice);
+		if (mask & settings_pack::advise_huge_pages)
+			j->storage->advise(j->piece, offset, len, aux::advice_t::huge_page, m_stats_counters);
+		if (mask & settings_pack::advise_cold_after_upload)
+			j->storage->advise(j->piece, offset, len, aux::advice_t::cold, m_stats_counters);
+	}
+
+	int mmap_disk_io::collect_prefetch(job_queue& q
+		, std::array<prefetch_block, max_prefetch_jobs>& blocks)
+	{
+		if (!(m_settings.get_int(settings_pack::mmap_advice) & settings_pack::advise_prefetch_requests))
+			return 0;
+
+		int ret = 0;
+		for (auto i = q.m_queued_jobs.iterate(); i.get() && ret < int(blocks.size()); i.next())
+		{
+			aux::disk_io_job* j = i.get();
+			if (j->action != aux::job_action_t::read) continue;
+			if (j->flags & (aux::disk_io_job::prefetched | aux::disk_io_job::aborted)) continue;
+			j->flags |= aux::disk_io_job::prefetched;
+			blocks[std::size_t(ret++)] = {j->storage, j->piece, j->d.io.offset, j->d.io.buffer_size};
+		}
+		return ret;
+	}
+
+	void mmap_disk_io::report_page_faults(page_faults& reported)
+	{
+		page_faults const now = thread_page_faults();
+		if (now.major != reported.major)
+			m_stats_counters.add_stats_counter(counters::disk_major_page_faults
+				, now.major - reported.major);
+		if (now.minor != reported.minor)
+			m_stats_counters.add_stats_counter(counters::disk_minor_page_faults
+				, now.minor - reported.minor);
+		reported = now;
+	}
+
 	status_t mmap_disk_io::do_write(aux::disk_io_job* j)
 	{
 		time_point const start_time = clock_type::now();
@@ -665,22 +762,22 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		iovec_t const b = { buffer.data(), j->d.io.buffer_size};
 		aux::open_mode_t const file_flags = file_flags_for_job(j);
 
-		m_stats_counters.inc_stats_counter(counters::num_writing_threads, 1);
+		m_stats_counters.add_stats_counter(counters::num_writing_threads, 1);
 
 		// the actual write operation
 		int const ret = j->storage->writev(m_settings, b
 			, j->piece, j->d.io.offset, file_flags, j->error);
 
-		m_stats_counters.inc_stats_counter(counters::num_writing_threads, -1);
+		m_stats_counters.add_stats_counter(counters::num_writing_threads, -1);
 
 		if (!j->error.ec)
 		{
 			std::int64_t const write_time = total_microseconds(clock_type::now() - start_time);
 
-			m_stats_counters.inc_stats_counter(counters::num_blocks_written);
-			m_stats_counters.inc_stats_counter(counters::num_write_ops);
-			m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
-			m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+			m_stats_counters.add_stats_counter(counters::num_blocks_written);
+			m_stats_counters.add_stats_counter(counters::num_write_ops);
+			m_stats_counters.add_stats_counter(counters::disk_write_time, write_time);
+			m_stats_counters.add_stats_counter(counters::disk_job_time, write_time);
 		}
 
 		{
@@ -783,7 +880,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				if (j->storage->is_blocked(j))
 				{
 					// this means the job was queued up inside storage
-					m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+					m_stats_counters.add_stats_counter(counters::blocked_disk_jobs);
 					DLOG("blocked job: %s (torrent: %d total: %d)\n"
 						, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
 						, int(m_stats_counters[counters::blocked_disk_jobs]));
@@ -829,7 +926,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (j->storage->is_blocked(j))
 		{
 			// this means the job was queued up inside storage
-			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+			m_stats_counters.add_stats_counter(counters::blocked_disk_jobs);
 			DLOG("blocked job: %s (torrent: %d total: %d)\n"
 				, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
 				, int(m_stats_counters[counters::blocked_disk_jobs]));
@@ -869,7 +966,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (j->storage->is_blocked(j))
 		{
 			// this means the job was queued up inside storage
-			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+			m_stats_counters.add_stats_counter(counters::blocked_disk_jobs);
 			DLOG("blocked job: %s (torrent: %d total: %d)\n"
 				, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
 				, int(m_stats_counters[counters::blocked_disk_jobs]));
@@ -1101,10 +1198,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			{
 				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read, blocks_to_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+				m_stats_counters.add_stats_counter(counters::num_blocks_read, blocks_to_read);
+				m_stats_counters.add_stats_counter(counters::num_read_ops);
+				m_stats_counters.add_stats_counter(counters::disk_hash_time, read_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 			}
 
 			if (v2_block)
@@ -1117,6 +1214,21 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		if (v1)
 			j->d.h.piece_hash = h.final();
+
+		// when checking, the files are read sequentially. The files may not
+		// have been mapped until the first read of this piece, so the hints
+		// are passed on afterwards. They apply to the whole file, and only
+		// take effect once
+		if (ret >= 0 && (j->flags & disk_interface::sequential_access))
+		{
+			int const mask = m_settings.get_int(settings_pack::mmap_advice);
+			int const len = j->storage->orig_files().piece_size(j->piece);
+			if (mask & settings_pack::advise_sequential_check)
+				j->storage->advise(j->piece, 0, len, aux::advice_t::sequential, m_stats_counters);
+			if (mask & settings_pack::advise_huge_pages)
+				j->storage->advise(j->piece, 0, len, aux::advice_t::huge_page, m_stats_counters);
+		}
+
 		return ret >= 0 ? status_t::no_error : status_t::fatal_disk_error;
 	}
 
@@ -1152,10 +1264,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		{
 			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-			m_stats_counters.inc_stats_counter(counters::num_read_ops);
-			m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+			m_stats_counters.add_stats_counter(counters::num_blocks_read);
+			m_stats_counters.add_stats_counter(counters::num_read_ops);
+			m_stats_counters.add_stats_counter(counters::disk_hash_time, read_time);
+			m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 		}
 
 		j->d.piece_hash2 = h.final();
@@ -1280,6 +1392,9 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		jl.unlock();
 
+		c.set_value(counters::disk_job_cache_hits, m_job_pool.cache_hits());
+		c.set_value(counters::disk_job_cache_misses, m_job_pool.cache_misses());
+
 		// gauges
 		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
 	}
@@ -1314,7 +1429,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			, j->storage->num_outstanding_jobs());
 
 		TORRENT_ASSERT(j->storage);
-		m_stats_counters.inc_stats_counter(counters::num_fenced_read + static_cast<int>(j->action));
+		m_stats_counters.add_stats_counter(counters::num_fenced_read + static_cast<int>(j->action));
 
 		int ret = j->storage->raise_fence(j, m_stats_counters);
 		if (ret == aux::disk_job_fence::fence_post_fence)
@@ -1376,7 +1491,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// and should be scheduled
 		if (j->storage && j->storage->is_blocked(j))
 		{
-			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+			m_stats_counters.add_stats_counter(counters::blocked_disk_jobs);
 			DLOG("blocked job: %s (torrent: %d total: %d)\n"
 				, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
 				, int(m_stats_counters[counters::blocked_disk_jobs]));
@@ -1508,7 +1623,14 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		std::unique_lock<std::mutex> l(m_job_mutex);
 
 		++m_num_running_threads;
-		m_stats_counters.inc_stats_counter(counters::num_running_threads, 1);
+		m_stats_counters.add_stats_counter(counters::num_running_threads, 1);
+
+		// the page faults taken by this thread are added to the counters at
+		// most once a second, rather than around every job, since sampling
+		// them takes a system call. Faults on mapped files are where the disk
+		// I/O actually happens in this back-end
+		page_faults reported_faults = thread_page_faults();
+		time_point next_fault_sample = aux::time_now() + seconds(1);
 
 		for (;;)
 		{
@@ -1516,8 +1638,23 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			bool const should_exit = wait_for_job(queue, pool, l);
 			if (should_exit) break;
 			j = queue.m_queued_jobs.pop_front();
+
+			// the blocks of the read jobs queued right behind this one are
+			// advised to be read in by the kernel while this job runs, for
+			// the disk threads to find them in the page cache. Their locations
+			// are copied, since the jobs may be performed and freed by other
+			// threads as soon as the mutex is released
+			std::array<prefetch_block, max_prefetch_jobs> prefetch;
+			int const num_prefetch = collect_prefetch(queue, prefetch);
 			l.unlock();
 
+			for (int i = 0; i < num_prefetch; ++i)
+			{
+				prefetch_block const& b = prefetch[std::size_t(i)];
+				b.storage->advise(b.piece, b.offset, b.length, aux::advice_t::will_need
+					, m_stats_counters);
+			}
+
 			TORRENT_ASSERT((j->flags & aux::disk_io_job::in_progress) || !j->storage);
 
 			if (&pool == &m_generic_threads && thread_id == pool.first_thread_id())
@@ -1556,9 +1693,18 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 			execute_job(j);
 
+			time_point const now = aux::time_now();
+			if (now >= next_fault_sample)
+			{
+				next_fault_sample = now + seconds(1);
+				report_page_faults(reported_faults);
+			}
+
 			l.lock();
 		}
 
+		report_page_faults(reported_faults);
+
 		// do cleanup in the last running thread
 		// if we're not aborting, that means we just configured the thread pool to
 		// not have any threads (i.e. perform all disk operations in the network
@@ -1570,7 +1716,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			DLOG("exiting disk thread. num_threads: %d aborting: %d\n"
 				, threads_left, int(m_abort));
 			TORRENT_ASSERT(m_magic == 0x1337);
-			m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+			m_stats_counters.add_stats_counter(counters::num_running_threads, -1);
 			return;
 		}
 
@@ -1600,7 +1746,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		abort_jobs();
 
 		TORRENT_ASSERT(m_magic == 0x1337);
-		m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+		m_stats_counters.add_stats_counter(counters::num_running_threads, -1);
 	}
 
 	void mmap_disk_io::abort_jobs()
@@ -1663,7 +1809,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 			if (j->flags & aux::disk_io_job::fence)
 			{
-				m_stats_counters.inc_stats_counter(
+				m_stats_counters.add_stats_counter(
 					counters::num_fenced_read + static_cast<int>(j->action), -1);
 			}
 
@@ -1685,7 +1831,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				, int(m_stats_counters[counters::blocked_disk_jobs]) - ret);
 		}
 
-		m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs, -ret);
+		m_stats_counters.add_stats_counter(counters::blocked_disk_jobs, -ret);
 		TORRENT_ASSERT(int(m_stats_counters[counters::blocked_disk_jobs]) >= 0);
 
 		if (m_abort.load())
@@ -1718,32 +1864,62 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			}
 		}
 
-		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
-		m_completed_jobs.append(jobs);
+		aux::disk_io_job* j = jobs.get_all();
+		if (j == nullptr) return;
 
-		if (!m_job_completions_in_flight)
+		// the jobs are pushed in reverse order, since the network thread
+		// reverses the whole stack, back into the order they completed in
+		aux::disk_io_job* const last = j;
+		aux::disk_io_job* first = nullptr;
+		while (j)
 		{
-			// we take this lock just to make the logging prettier (non-interleaved)
-			DLOG("posting job handlers (%d)\n", m_completed_jobs.size());
+			aux::disk_io_job* next = j->next;
+			j->next = first;
+			first = j;
+			j = next;
+		}
+
+		last->next = m_completed_jobs.load(std::memory_order_relaxed);
+		while (!m_completed_jobs.compare_exchange_weak(last->next, first));
 
-			post(m_ios, [this] { this->call_job_handlers(); });
-			m_job_completions_in_flight = true;
+		// the network thread clears the flag before it takes the jobs off
+		// the stack. Either it will pick up the jobs we just pushed, or we
+		// will see the flag cleared and post another message. This relies
+		// on all of these operations being sequentially consistent
+		if (!m_job_completions_in_flight.exchange(true))
+		{
+			DLOG("posting job handlers\n");
+			post(m_ios, [this, t = clock_type::now()] { this->call_job_handlers(t); });
 		}
 	}
 
 	// This is run in the network thread
-	void mmap_disk_io::call_job_handlers()
+	void mmap_disk_io::call_job_handlers(time_point const posted)
 	{
-		m_stats_counters.inc_stats_counter(counters::on_disk_counter);
-		std::unique_lock<std::mutex> l(m_completed_jobs_mutex);
+		m_stats_counters.add_stats_counter(counters::on_disk_counter);
 
-		DLOG("call_job_handlers (%d)\n", m_completed_jobs.size());
+		m_job_completions_in_flight.store(false);
+		aux::disk_io_job* stack = m_completed_jobs.exchange(nullptr);
 
-		TORRENT_ASSERT(m_job_completions_in_flight);
-		m_job_completions_in_flight = false;
+		// the jobs come off the stack in reverse order
+		aux::disk_io_job* j = nullptr;
+		int num_jobs = 0;
+		while (stack)
+		{
+			aux::disk_io_job* next = stack->next;
+			stack->next = j;
+			j = stack;
+			stack = next;
+			++num_jobs;
+		}
 
-		aux::disk_io_job* j = m_completed_jobs.get_all();
-		l.unlock();
+		DLOG("call_job_handlers (%d)\n", num_jobs);
+
+		// a disk thread may post a second message while we're picking up
+		// the jobs, in which case it finds the stack empty
+		if (num_jobs == 0) return;
+		aux::record_completion_batch(m_stats_counters, num_jobs
+			, clock_type::now() - posted);
 
 		aux::array<aux::disk_io_job*, 64> to_delete;
 		int cnt = 0;
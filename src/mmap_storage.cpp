@@ -67,6 +67,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/disk_buffer_holder.hpp"
 #include "libtorrent/stat_cache.hpp"
 #include "libtorrent/hex.hpp" // to_hex
+#include "libtorrent/performance_counters.hpp"
 
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 
@@ -791,6 +792,45 @@ namespace libtorrent {
 		return static_cast<int>(file_range.size());
 	}
 
+	// applies the access pattern hint to the mapped ranges of the files
+	// backing the block range. Only files already in the pool are advised,
+	// looking them up doesn't open them
+	void mmap_storage::advise(piece_index_t const piece, int const offset
+		, int const len, aux::advice_t const a, counters& cnt)
+	{
+		int counter = counters::mmap_advise_sequential;
+		switch (a)
+		{
+			case aux::advice_t::sequential: counter = counters::mmap_advise_sequential; break;
+			case aux::advice_t::huge_page: counter = counters::mmap_advise_huge_page; break;
+			case aux::advice_t::will_need: counter = counters::mmap_advise_will_need; break;
+			case aux::advice_t::cold: counter = counters::mmap_advise_cold; break;
+		}
+
+		// the original file_storage is used since it's immutable, unlike the
+		// mapped one, which may be replaced by rename_file() on a disk
+		// thread. Renaming files doesn't change their offsets
+		for (auto const& s : m_files.map_block(piece, offset, len))
+		{
+			if (m_files.pad_file_at(s.file_index)) continue;
+
+			auto view = m_pool.find_file(m_storage_index, s.file_index);
+			if (!view) continue;
+
+			switch (view->advise(a, s.offset, s.size))
+			{
+				case aux::advice_result::applied:
+					cnt.add_stats_counter(counter);
+					break;
+				case aux::advice_result::failed:
+					cnt.add_stats_counter(counters::mmap_advise_failed);
+					break;
+				case aux::advice_result::skipped:
+					break;
+			}
+		}
+	}
+
 	// a wrapper around open_file_impl that, if it fails, makes sure the
 	// directories have been created and retries
 	boost::optional<aux::file_view> mmap_storage::open_file(settings_interface const& sett
@@ -164,7 +164,7 @@ namespace libtorrent {
 		, m_exceeded_limit(false)
 		, m_slow_start(true)
 	{
-		m_counters.inc_stats_counter(counters::num_tcp_peers
+		m_counters.add_stats_counter(counters::num_tcp_peers
 			+ static_cast<std::uint8_t>(socket_type_idx(m_socket)));
 		std::shared_ptr<torrent> t = m_torrent.lock();
 
@@ -172,9 +172,9 @@ namespace libtorrent {
 		TORRENT_ASSERT(!t || t->info_hash().has_v2() || !m_peer_info->protocol_v2);
 
 		if (m_connected)
-			m_counters.inc_stats_counter(counters::num_peers_connected);
+			m_counters.add_stats_counter(counters::num_peers_connected);
 		else if (m_connecting)
-			m_counters.inc_stats_counter(counters::num_peers_half_open);
+			m_counters.add_stats_counter(counters::num_peers_half_open);
 
 		// if t is nullptr, we better not be connecting, since
 		// we can't decrement the connecting counter
@@ -526,22 +526,13 @@ namespace libtorrent {
 		if (!t->is_upload_only())
 		{
 			t->need_picker();
-			piece_picker const& p = t->picker();
-			piece_index_t const end_piece(p.num_pieces());
-			for (piece_index_t j(0); j != end_piece; ++j)
-			{
-				if (m_have_piece[j]
-					&& t->piece_priority(j) > dont_download
-					&& !p.has_piece_passed(j))
-				{
-					interested = true;
+			sync_wanted_pieces(t->picker());
+			interested = m_num_wanted_pieces > 0;
 #ifndef TORRENT_DISABLE_LOGGING
-					peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting, piece: %d"
-						, static_cast<int>(j));
+			if (interested)
+				peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting, wanted pieces: %d"
+					, m_num_wanted_pieces);
 #endif
-					break;
-				}
-			}
 		}
 
 #ifndef TORRENT_DISABLE_LOGGING
@@ -557,6 +548,22 @@ namespace libtorrent {
 		disconnect_if_redundant();
 	}
 
+	void peer_connection::sync_wanted_pieces(piece_picker const& p)
+	{
+		if (m_wanted_epoch == p.wanted_epoch()) return;
+		TORRENT_ASSERT(m_have_piece.size() == p.num_pieces());
+		m_num_wanted_pieces = p.num_wanted_pieces(m_have_piece);
+		m_wanted_epoch = p.wanted_epoch();
+	}
+
+	void peer_connection::wanted_piece_changed(piece_picker const& p, int const delta)
+	{
+		TORRENT_ASSERT(delta == 1 || delta == -1);
+		if (m_wanted_epoch != p.wanted_epoch()) return;
+		m_num_wanted_pieces += delta;
+		TORRENT_ASSERT(m_num_wanted_pieces >= 0);
+	}
+
 #ifndef TORRENT_DISABLE_LOGGING
 	bool peer_connection::should_log(peer_log_alert::direction_t) const
 	{
@@ -733,6 +740,7 @@ namespace libtorrent {
 		std::shared_ptr<torrent> t = associated_torrent().lock();
 		m_have_piece.resize(t->torrent_file().num_pieces(), m_have_all);
 		m_num_pieces = m_have_piece.count();
+		invalidate_wanted_pieces();
 
 		piece_index_t const limit(m_num_pieces);
 
@@ -765,6 +773,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(t->ready_for_connections());
 
 		m_have_piece.resize(t->torrent_file().num_pieces(), m_have_all);
+		invalidate_wanted_pieces();
 
 		if (m_have_all)
 		{
@@ -815,15 +824,9 @@ namespace libtorrent {
 		{
 			TORRENT_ASSERT(m_have_piece.size() == t->torrent_file().num_pieces());
 			t->peer_has(m_have_piece, this);
-			bool interesting = false;
-			for (auto const i : m_have_piece.range())
-			{
-				if (!m_have_piece[i]) continue;
-				// if the peer has a piece and we don't, the peer is interesting
-				if (!t->have_piece(i)
-					&& t->picker().piece_priority(i) != dont_download)
-					interesting = true;
-			}
+			// if the peer has a piece and we don't, the peer is interesting
+			sync_wanted_pieces(t->picker());
+			bool const interesting = m_num_wanted_pieces > 0;
 			if (interesting) t->peer_is_interesting(*this);
 			else send_not_interested();
 		}
@@ -835,7 +838,7 @@ namespace libtorrent {
 
 	peer_connection::~peer_connection()
 	{
-		m_counters.inc_stats_counter(counters::num_tcp_peers
+		m_counters.add_stats_counter(counters::num_tcp_peers
 			+ static_cast<std::uint8_t>(socket_type_idx(m_socket)), -1);
 
 //		INVARIANT_CHECK;
@@ -853,22 +856,22 @@ namespace libtorrent {
 		set_endgame(false);
 
 		if (m_interesting)
-			m_counters.inc_stats_counter(counters::num_peers_down_interested, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_interested, -1);
 		if (m_peer_interested)
-			m_counters.inc_stats_counter(counters::num_peers_up_interested, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_interested, -1);
 		if (!m_choked)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_up_unchoked_all, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_unchoked_all, -1);
 			if (!ignore_unchoke_slots())
-				m_counters.inc_stats_counter(counters::num_peers_up_unchoked, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_unchoked, -1);
 		}
 		if (!m_peer_choked)
-			m_counters.inc_stats_counter(counters::num_peers_down_unchoked, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_unchoked, -1);
 		if (m_connected)
-			m_counters.inc_stats_counter(counters::num_peers_connected, -1);
+			m_counters.add_stats_counter(counters::num_peers_connected, -1);
 		m_connected = false;
 		if (!m_download_queue.empty())
-			m_counters.inc_stats_counter(counters::num_peers_down_requests, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_requests, -1);
 
 		// defensive
 		std::shared_ptr<torrent> t = m_torrent.lock();
@@ -879,7 +882,7 @@ namespace libtorrent {
 		// we should really have dealt with this already
 		if (m_connecting)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_half_open, -1);
+			m_counters.add_stats_counter(counters::num_peers_half_open, -1);
 			if (t) t->dec_num_connecting(m_peer_info);
 			m_connecting = false;
 		}
@@ -1467,9 +1470,9 @@ namespace libtorrent {
 		if (m_endgame_mode == b) return;
 		m_endgame_mode = b;
 		if (m_endgame_mode)
-			m_counters.inc_stats_counter(counters::num_peers_end_game);
+			m_counters.add_stats_counter(counters::num_peers_end_game);
 		else
-			m_counters.inc_stats_counter(counters::num_peers_end_game, -1);
+			m_counters.add_stats_counter(counters::num_peers_end_game, -1);
 	}
 
 	void peer_connection::incoming_choke()
@@ -1489,7 +1492,7 @@ namespace libtorrent {
 		peer_log(peer_log_alert::incoming_message, "CHOKE");
 #endif
 		if (m_peer_choked == false)
-			m_counters.inc_stats_counter(counters::num_peers_down_unchoked, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_unchoked, -1);
 
 		m_peer_choked = true;
 		set_endgame(false);
@@ -1600,7 +1603,7 @@ namespace libtorrent {
 			if (m_outstanding_bytes < 0) m_outstanding_bytes = 0;
 
 			if (m_download_queue.empty())
-				m_counters.inc_stats_counter(counters::num_peers_down_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_down_requests, -1);
 
 			// if the peer is in parole mode, keep the request
 			if (peer_info_struct() && peer_info_struct()->on_parole)
@@ -1646,7 +1649,7 @@ namespace libtorrent {
 		if (m_request_queue.empty() && m_download_queue.size() < 2)
 		{
 			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::reject_piece_picks);
+				m_counters.add_stats_counter(counters::reject_piece_picks);
 		}
 
 		send_block_requests();
@@ -1740,7 +1743,7 @@ namespace libtorrent {
 		peer_log(peer_log_alert::incoming_message, "UNCHOKE");
 #endif
 		if (m_peer_choked)
-			m_counters.inc_stats_counter(counters::num_peers_down_unchoked);
+			m_counters.add_stats_counter(counters::num_peers_down_unchoked);
 
 		m_peer_choked = false;
 		m_last_unchoked.set(m_connect, aux::time_now());
@@ -1749,7 +1752,7 @@ namespace libtorrent {
 		if (is_interesting())
 		{
 			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::unchoke_piece_picks);
+				m_counters.add_stats_counter(counters::unchoke_piece_picks);
 			send_block_requests();
 		}
 	}
@@ -1778,7 +1781,7 @@ namespace libtorrent {
 #endif
 		if (m_peer_interested == false)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_up_interested);
+			m_counters.add_stats_counter(counters::num_peers_up_interested);
 			m_peer_interested = true;
 		}
 		if (is_disconnecting()) return;
@@ -1873,7 +1876,7 @@ namespace libtorrent {
 #endif
 		if (m_peer_interested)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_up_interested, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_interested, -1);
 			m_became_uninterested.set(m_connect, aux::time_now());
 			m_peer_interested = false;
 		}
@@ -1902,7 +1905,7 @@ namespace libtorrent {
 		if (m_peer_info && m_peer_info->optimistically_unchoked)
 		{
 			m_peer_info->optimistically_unchoked = false;
-			m_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
 			t->trigger_optimistic_unchoke();
 		}
 		t->choke_peer(*this);
@@ -2024,6 +2027,8 @@ namespace libtorrent {
 		if (!t->valid_metadata()) return;
 
 		t->peer_has(index, this);
+		if (t->has_picker() && t->picker().is_wanted(index))
+			wanted_piece_changed(t->picker(), 1);
 
 		// it's important to not disconnect before we have
 		// updated the piece picker, otherwise we will incorrectly
@@ -2083,6 +2088,119 @@ namespace libtorrent {
 #endif // TORRENT_DISABLE_SUPERSEEDING
 	}
 
+	void peer_connection::incoming_haves(span<piece_index_t const> const pieces)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		INVARIANT_CHECK;
+
+		std::shared_ptr<torrent> t = m_torrent.lock();
+		TORRENT_ASSERT(t);
+
+		// the cases where a HAVE message may do more than set the bit in the
+		// peer's bitfield and update the piece picker take the regular path,
+		// one message at a time
+		bool const one_at_a_time = !t->valid_metadata()
+			|| !m_bitfield_received
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			|| t->super_seeding()
+#endif
+			|| m_settings.get_int(settings_pack::suggest_mode) == settings_pack::suggest_read_cache
+			|| std::any_of(pieces.begin(), pieces.end(), [&](piece_index_t const index)
+				{ return index >= m_have_piece.end_index() || index < piece_index_t(0); });
+
+		if (one_at_a_time)
+		{
+			for (piece_index_t const index : pieces)
+			{
+				incoming_have(index);
+				if (is_disconnecting()) return;
+			}
+			return;
+		}
+
+		// all extensions see the messages before any of them are applied,
+		// since they may disconnect the peer
+		TORRENT_ALLOCA(new_pieces, piece_index_t, pieces.size());
+		int num_new = 0;
+		for (piece_index_t const index : pieces)
+		{
+#ifndef TORRENT_DISABLE_EXTENSIONS
+			if (std::any_of(m_extensions.begin(), m_extensions.end()
+				, [=](std::shared_ptr<peer_plugin> const& e) { return e->on_have(index); }))
+				continue;
+#endif
+			new_pieces[num_new++] = index;
+		}
+
+		if (is_disconnecting()) return;
+
+		int const num_announced = num_new;
+		num_new = 0;
+		for (int i = 0; i < num_announced; ++i)
+		{
+			piece_index_t const index = new_pieces[i];
+
+#ifndef TORRENT_DISABLE_LOGGING
+			peer_log(peer_log_alert::incoming_message, "HAVE", "piece: %d"
+				, static_cast<int>(index));
+#endif
+
+			if (m_have_piece[index])
+			{
+#ifndef TORRENT_DISABLE_LOGGING
+				peer_log(peer_log_alert::incoming, "HAVE"
+					, "got redundant HAVE message for index: %d"
+					, static_cast<int>(index));
+#endif
+				continue;
+			}
+
+			m_have_piece.set_bit(index);
+			new_pieces[num_new++] = index;
+		}
+
+		if (num_new == 0) return;
+
+		new_pieces = new_pieces.first(num_new);
+		m_num_pieces += num_new;
+		m_has_metadata = true;
+
+		t->peer_has(new_pieces, this);
+		if (t->has_picker())
+		{
+			piece_picker const& picker = t->picker();
+			for (piece_index_t const index : new_pieces)
+				if (picker.is_wanted(index)) wanted_piece_changed(picker, 1);
+		}
+
+		if (is_seed())
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			peer_log(peer_log_alert::info, "SEED", "this is a seed. p: %p"
+				, static_cast<void*>(m_peer_info));
+#endif
+
+			TORRENT_ASSERT(t->ready_for_connections());
+			TORRENT_ASSERT(m_have_piece.all_set());
+
+			t->seen_complete();
+			t->set_seed(m_peer_info, true);
+			TORRENT_ASSERT(is_seed());
+			if (disconnect_if_redundant()) return;
+		}
+
+		if (!t->is_upload_only()
+			&& !is_interesting()
+			&& std::any_of(new_pieces.begin(), new_pieces.end(), [&](piece_index_t const index)
+				{
+					return !t->has_piece_passed(index)
+						&& (!t->has_picker() || t->picker().piece_priority(index) != dont_download);
+				}))
+			t->peer_is_interesting(*this);
+
+		disconnect_if_redundant();
+	}
+
 	// -----------------------------
 	// -------- DONT HAVE ----------
 	// -----------------------------
@@ -2155,6 +2273,13 @@ namespace libtorrent {
 			t->set_seed(m_peer_info, false);
 			TORRENT_ASSERT(!is_seed());
 		}
+
+		if (t->has_picker() && t->picker().is_wanted(index))
+		{
+			wanted_piece_changed(t->picker(), -1);
+			// this may have been the last piece we wanted from the peer
+			if (is_interesting()) update_interest();
+		}
 	}
 
 	// -----------------------------
@@ -2230,6 +2355,7 @@ namespace libtorrent {
 #endif
 			m_have_piece = bits;
 			m_num_pieces = bits.count();
+			invalidate_wanted_pieces();
 			t->set_seed(m_peer_info, m_num_pieces == bits.size());
 			TORRENT_ASSERT(is_seed() == (m_num_pieces == bits.size()));
 
@@ -2254,6 +2380,7 @@ namespace libtorrent {
 
 			m_have_piece.set_all();
 			m_num_pieces = num_pieces;
+			invalidate_wanted_pieces();
 			t->peer_has_all(this);
 			TORRENT_ASSERT(is_seed());
 
@@ -2281,6 +2408,7 @@ namespace libtorrent {
 
 		m_have_piece = bits;
 		m_num_pieces = num_pieces;
+		invalidate_wanted_pieces();
 
 		update_interest();
 	}
@@ -2362,7 +2490,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(t);
 		torrent_info const& ti = t->torrent_file();
 
-		m_counters.inc_stats_counter(counters::piece_requests);
+		m_counters.add_stats_counter(counters::piece_requests);
 
 #ifndef TORRENT_DISABLE_LOGGING
 		const bool valid_piece_index
@@ -2377,7 +2505,7 @@ namespace libtorrent {
 		if (t->super_seeding()
 			&& !super_seeded_piece(r.piece))
 		{
-			m_counters.inc_stats_counter(counters::invalid_piece_requests);
+			m_counters.add_stats_counter(counters::invalid_piece_requests);
 			if (m_num_invalid_requests < std::numeric_limits<decltype(m_num_invalid_requests)>::max())
 				++m_num_invalid_requests;
 #ifndef TORRENT_DISABLE_LOGGING
@@ -2425,7 +2553,7 @@ namespace libtorrent {
 
 		if (!t->valid_metadata())
 		{
-			m_counters.inc_stats_counter(counters::invalid_piece_requests);
+			m_counters.add_stats_counter(counters::invalid_piece_requests);
 			// if we don't have valid metadata yet,
 			// we shouldn't get a request
 #ifndef TORRENT_DISABLE_LOGGING
@@ -2437,7 +2565,7 @@ namespace libtorrent {
 
 		if (int(m_requests.size()) > m_settings.get_int(settings_pack::max_allowed_in_request_queue))
 		{
-			m_counters.inc_stats_counter(counters::max_piece_requests);
+			m_counters.add_stats_counter(counters::max_piece_requests);
 			// don't allow clients to abuse our
 			// memory consumption.
 			// ignore requests if the client
@@ -2497,7 +2625,7 @@ namespace libtorrent {
 			|| r.length + r.start > ti.piece_size(r.piece)
 			|| r.length > t->block_size())
 		{
-			m_counters.inc_stats_counter(counters::invalid_piece_requests);
+			m_counters.add_stats_counter(counters::invalid_piece_requests);
 
 #ifndef TORRENT_DISABLE_LOGGING
 			if (should_log(peer_log_alert::info))
@@ -2568,7 +2696,7 @@ namespace libtorrent {
 #ifndef TORRENT_DISABLE_LOGGING
 			peer_log(peer_log_alert::info, "REJECTING REQUEST", "peer choked and piece not in allowed fast set");
 #endif
-			m_counters.inc_stats_counter(counters::choked_piece_requests);
+			m_counters.add_stats_counter(counters::choked_piece_requests);
 			write_reject_request(r);
 
 			// allow peers to send request up to 2 seconds after getting choked,
@@ -2587,7 +2715,7 @@ namespace libtorrent {
 				++m_accept_fast_piece_cnt[fast_idx];
 
 			if (m_requests.empty())
-				m_counters.inc_stats_counter(counters::num_peers_up_requests);
+				m_counters.add_stats_counter(counters::num_peers_up_requests);
 
 			TORRENT_ASSERT(t->valid_metadata());
 			TORRENT_ASSERT(r.piece >= piece_index_t(0));
@@ -2620,7 +2748,7 @@ namespace libtorrent {
 			i = m_requests.erase(i);
 
 			if (m_requests.empty())
-				m_counters.inc_stats_counter(counters::num_peers_up_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_requests, -1);
 		}
 	}
 
@@ -2698,7 +2826,7 @@ namespace libtorrent {
 			}
 
 			if (m_download_queue.empty())
-				m_counters.inc_stats_counter(counters::num_peers_down_requests);
+				m_counters.add_stats_counter(counters::num_peers_down_requests);
 
 			m_download_queue.insert(m_download_queue.begin(), b);
 			if (!in_req_queue)
@@ -2840,7 +2968,7 @@ namespace libtorrent {
 			{
 				m_download_queue.erase(m_download_queue.begin());
 				if (m_download_queue.empty())
-					m_counters.inc_stats_counter(counters::num_peers_down_requests, -1);
+					m_counters.add_stats_counter(counters::num_peers_down_requests, -1);
 			}
 			t->add_redundant_bytes(p.length, waste_reason::piece_seed);
 			return;
@@ -2904,7 +3032,7 @@ namespace libtorrent {
 
 			m_download_queue.erase(b);
 			if (m_download_queue.empty())
-				m_counters.inc_stats_counter(counters::num_peers_down_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_down_requests, -1);
 
 			if (m_disconnecting) return;
 
@@ -2924,7 +3052,7 @@ namespace libtorrent {
 				m_requested.set(m_connect, now);
 
 			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::incoming_redundant_piece_picks);
+				m_counters.add_stats_counter(counters::incoming_redundant_piece_picks);
 			send_block_requests();
 			return;
 		}
@@ -2948,7 +3076,7 @@ namespace libtorrent {
 #endif
 		m_download_queue.erase(b);
 		if (m_download_queue.empty())
-			m_counters.inc_stats_counter(counters::num_peers_down_requests, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_requests, -1);
 
 		if (t->is_deleted()) return;
 
@@ -2966,7 +3094,7 @@ namespace libtorrent {
 		if (exceeded && m_outstanding_writing_bytes > 0)
 		{
 			if (!(m_channel_state[download_channel] & peer_info::bw_disk))
-				m_counters.inc_stats_counter(counters::num_peers_down_disk);
+				m_counters.add_stats_counter(counters::num_peers_down_disk);
 			m_channel_state[download_channel] |= peer_info::bw_disk;
 #ifndef TORRENT_DISABLE_LOGGING
 			peer_log(peer_log_alert::info, "DISK", "exceeded disk buffer watermark");
@@ -3095,7 +3223,7 @@ namespace libtorrent {
 		if (is_disconnecting()) return;
 
 		if (request_a_block(*t, *this))
-			m_counters.inc_stats_counter(counters::incoming_piece_picks);
+			m_counters.add_stats_counter(counters::incoming_piece_picks);
 		send_block_requests();
 	}
 
@@ -3129,7 +3257,7 @@ namespace libtorrent {
 		}
 #endif
 
-		m_counters.inc_stats_counter(counters::queued_write_bytes, -p.length);
+		m_counters.add_stats_counter(counters::queued_write_bytes, -p.length);
 		m_outstanding_writing_bytes -= p.length;
 
 		TORRENT_ASSERT(m_outstanding_writing_bytes >= 0);
@@ -3139,7 +3267,7 @@ namespace libtorrent {
 		if (m_outstanding_writing_bytes == 0
 			&& m_channel_state[download_channel] & peer_info::bw_disk)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_down_disk, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_disk, -1);
 			m_channel_state[download_channel] &= ~peer_info::bw_disk;
 		}
 
@@ -3265,11 +3393,11 @@ namespace libtorrent {
 
 		if (i != m_requests.end())
 		{
-			m_counters.inc_stats_counter(counters::cancelled_piece_requests);
+			m_counters.add_stats_counter(counters::cancelled_piece_requests);
 			m_requests.erase(i);
 
 			if (m_requests.empty())
-				m_counters.inc_stats_counter(counters::num_peers_up_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_requests, -1);
 
 			write_reject_request(r);
 		}
@@ -3363,6 +3491,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(!m_have_piece.empty());
 		m_have_piece.set_all();
 		m_num_pieces = m_have_piece.size();
+		invalidate_wanted_pieces();
 
 		t->peer_has_all(this);
 
@@ -3415,6 +3544,7 @@ namespace libtorrent {
 
 		m_have_piece.clear_all();
 		m_num_pieces = 0;
+		invalidate_wanted_pieces();
 
 		TORRENT_ASSERT(!is_seed());
 
@@ -3792,7 +3922,7 @@ namespace libtorrent {
 		if (m_peer_info && m_peer_info->optimistically_unchoked)
 		{
 			m_peer_info->optimistically_unchoked = false;
-			m_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
 		}
 
 		m_suggest_pieces.clear();
@@ -3802,9 +3932,9 @@ namespace libtorrent {
 		peer_log(peer_log_alert::outgoing_message, "CHOKE");
 #endif
 		write_choke();
-		m_counters.inc_stats_counter(counters::num_peers_up_unchoked_all, -1);
+		m_counters.add_stats_counter(counters::num_peers_up_unchoked_all, -1);
 		if (!ignore_unchoke_slots())
-			m_counters.inc_stats_counter(counters::num_peers_up_unchoked, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_unchoked, -1);
 		m_choked = true;
 
 		m_last_choke.set(m_connect, aux::time_now());
@@ -3821,12 +3951,12 @@ namespace libtorrent {
 				continue;
 			}
 			peer_request const& r = *i;
-			m_counters.inc_stats_counter(counters::choked_piece_requests);
+			m_counters.add_stats_counter(counters::choked_piece_requests);
 			write_reject_request(r);
 			i = m_requests.erase(i);
 
 			if (m_requests.empty())
-				m_counters.inc_stats_counter(counters::num_peers_up_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_requests, -1);
 		}
 		return true;
 	}
@@ -3850,9 +3980,9 @@ namespace libtorrent {
 
 		m_last_unchoke.set(m_connect, aux::time_now());
 		write_unchoke();
-		m_counters.inc_stats_counter(counters::num_peers_up_unchoked_all);
+		m_counters.add_stats_counter(counters::num_peers_up_unchoked_all);
 		if (!ignore_unchoke_slots())
-			m_counters.inc_stats_counter(counters::num_peers_up_unchoked);
+			m_counters.add_stats_counter(counters::num_peers_up_unchoked);
 		m_choked = false;
 
 		m_uploaded_at_last_unchoke = m_statistics.total_payload_upload();
@@ -3872,7 +4002,7 @@ namespace libtorrent {
 		if (!m_interesting)
 		{
 			m_interesting = true;
-			m_counters.inc_stats_counter(counters::num_peers_down_interested);
+			m_counters.add_stats_counter(counters::num_peers_down_interested);
 		}
 		write_interested();
 
@@ -3900,7 +4030,7 @@ namespace libtorrent {
 		{
 			m_interesting = false;
 			m_became_uninteresting.set(m_connect, aux::time_now());
-			m_counters.inc_stats_counter(counters::num_peers_down_interested, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_interested, -1);
 		}
 
 		m_slow_start = false;
@@ -4039,7 +4169,7 @@ namespace libtorrent {
 			r.length = bs;
 
 			if (m_download_queue.empty())
-				m_counters.inc_stats_counter(counters::num_peers_down_requests);
+				m_counters.add_stats_counter(counters::num_peers_down_requests);
 
 			TORRENT_ASSERT(verify_piece(t->to_req(block.block)));
 			block.send_buffer_offset = aux::numeric_cast<std::uint32_t>(m_send_buffer.size());
@@ -4068,7 +4198,7 @@ namespace libtorrent {
 					TORRENT_ASSERT(verify_piece(t->to_req(block.block)));
 
 					if (m_download_queue.empty())
-						m_counters.inc_stats_counter(counters::num_peers_down_requests);
+						m_counters.add_stats_counter(counters::num_peers_down_requests);
 
 					block.send_buffer_offset = aux::numeric_cast<std::uint32_t>(m_send_buffer.size());
 					m_download_queue.push_back(block);
@@ -4153,13 +4283,13 @@ namespace libtorrent {
 			m_ses.session_log("CONNECTION FAILED: %s", print_endpoint(m_remote).c_str());
 #endif
 
-		m_counters.inc_stats_counter(counters::connect_timeouts);
+		m_counters.add_stats_counter(counters::connect_timeouts);
 
 		std::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(!m_connecting || t);
 		if (m_connecting)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_half_open, -1);
+			m_counters.add_stats_counter(counters::num_peers_half_open, -1);
 			if (t && m_peer_info) t->dec_num_connecting(m_peer_info);
 			m_connecting = false;
 		}
@@ -4283,7 +4413,7 @@ namespace libtorrent {
 		}
 
 		if (m_connected)
-			m_counters.inc_stats_counter(counters::num_peers_connected, -1);
+			m_counters.add_stats_counter(counters::num_peers_connected, -1);
 		m_connected = false;
 
 		// for incoming connections, we get invalid argument errors
@@ -4293,76 +4423,76 @@ namespace libtorrent {
 		// for outgoing connections however, why would we get this?
 //		TORRENT_ASSERT(ec != error::invalid_argument || !m_outgoing);
 
-		m_counters.inc_stats_counter(counters::disconnected_peers);
-		if (error == peer_error) m_counters.inc_stats_counter(counters::error_peers);
+		m_counters.add_stats_counter(counters::disconnected_peers);
+		if (error == peer_error) m_counters.add_stats_counter(counters::error_peers);
 
 		if (ec == error::connection_reset)
-			m_counters.inc_stats_counter(counters::connreset_peers);
+			m_counters.add_stats_counter(counters::connreset_peers);
 		else if (ec == error::eof)
-			m_counters.inc_stats_counter(counters::eof_peers);
+			m_counters.add_stats_counter(counters::eof_peers);
 		else if (ec == error::connection_refused)
-			m_counters.inc_stats_counter(counters::connrefused_peers);
+			m_counters.add_stats_counter(counters::connrefused_peers);
 		else if (ec == error::connection_aborted)
-			m_counters.inc_stats_counter(counters::connaborted_peers);
+			m_counters.add_stats_counter(counters::connaborted_peers);
 		else if (ec == error::not_connected)
-			m_counters.inc_stats_counter(counters::notconnected_peers);
+			m_counters.add_stats_counter(counters::notconnected_peers);
 		else if (ec == error::no_permission)
-			m_counters.inc_stats_counter(counters::perm_peers);
+			m_counters.add_stats_counter(counters::perm_peers);
 		else if (ec == error::no_buffer_space)
-			m_counters.inc_stats_counter(counters::buffer_peers);
+			m_counters.add_stats_counter(counters::buffer_peers);
 		else if (ec == error::host_unreachable)
-			m_counters.inc_stats_counter(counters::unreachable_peers);
+			m_counters.add_stats_counter(counters::unreachable_peers);
 		else if (ec == error::broken_pipe)
-			m_counters.inc_stats_counter(counters::broken_pipe_peers);
+			m_counters.add_stats_counter(counters::broken_pipe_peers);
 		else if (ec == error::address_in_use)
-			m_counters.inc_stats_counter(counters::addrinuse_peers);
+			m_counters.add_stats_counter(counters::addrinuse_peers);
 		else if (ec == error::access_denied)
-			m_counters.inc_stats_counter(counters::no_access_peers);
+			m_counters.add_stats_counter(counters::no_access_peers);
 		else if (ec == error::invalid_argument)
-			m_counters.inc_stats_counter(counters::invalid_arg_peers);
+			m_counters.add_stats_counter(counters::invalid_arg_peers);
 		else if (ec == error::operation_aborted)
-			m_counters.inc_stats_counter(counters::aborted_peers);
+			m_counters.add_stats_counter(counters::aborted_peers);
 		else if (ec == errors::upload_upload_connection
 			|| ec == errors::uninteresting_upload_peer
 			|| ec == errors::torrent_aborted
 			|| ec == errors::self_connection
 			|| ec == errors::torrent_paused)
-			m_counters.inc_stats_counter(counters::uninteresting_peers);
+			m_counters.add_stats_counter(counters::uninteresting_peers);
 
 		if (ec == errors::timed_out
 			|| ec == error::timed_out)
-			m_counters.inc_stats_counter(counters::transport_timeout_peers);
+			m_counters.add_stats_counter(counters::transport_timeout_peers);
 
 		if (ec == errors::timed_out_inactivity
 			|| ec == errors::timed_out_no_request
 			|| ec == errors::timed_out_no_interest)
-			m_counters.inc_stats_counter(counters::timeout_peers);
+			m_counters.add_stats_counter(counters::timeout_peers);
 
 		if (ec == errors::no_memory)
-			m_counters.inc_stats_counter(counters::no_memory_peers);
+			m_counters.add_stats_counter(counters::no_memory_peers);
 
 		if (ec == errors::too_many_connections)
-			m_counters.inc_stats_counter(counters::too_many_peers);
+			m_counters.add_stats_counter(counters::too_many_peers);
 
 		if (ec == errors::timed_out_no_handshake)
-			m_counters.inc_stats_counter(counters::connect_timeouts);
+			m_counters.add_stats_counter(counters::connect_timeouts);
 
 		if (error > normal)
 		{
-			if (is_utp(m_socket)) m_counters.inc_stats_counter(counters::error_utp_peers);
-			else m_counters.inc_stats_counter(counters::error_tcp_peers);
+			if (is_utp(m_socket)) m_counters.add_stats_counter(counters::error_utp_peers);
+			else m_counters.add_stats_counter(counters::error_tcp_peers);
 
-			if (m_outgoing) m_counters.inc_stats_counter(counters::error_outgoing_peers);
-			else m_counters.inc_stats_counter(counters::error_incoming_peers);
+			if (m_outgoing) m_counters.add_stats_counter(counters::error_outgoing_peers);
+			else m_counters.add_stats_counter(counters::error_incoming_peers);
 
 #if !defined TORRENT_DISABLE_ENCRYPTION
 			if (type() == connection_type::bittorrent && op != operation_t::connect)
 			{
 				auto* bt = static_cast<bt_peer_connection*>(this);
-				if (bt->supports_encryption()) m_counters.inc_stats_counter(
+				if (bt->supports_encryption()) m_counters.add_stats_counter(
 					counters::error_encrypted_peers);
 				if (bt->rc4_encrypted() && bt->supports_encryption())
-					m_counters.inc_stats_counter(counters::error_rc4_peers);
+					m_counters.add_stats_counter(counters::error_rc4_peers);
 			}
 #endif // TORRENT_DISABLE_ENCRYPTION
 		}
@@ -4373,12 +4503,12 @@ namespace libtorrent {
 
 		if (m_channel_state[upload_channel] & peer_info::bw_disk)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_up_disk, -1);
+			m_counters.add_stats_counter(counters::num_peers_up_disk, -1);
 			m_channel_state[upload_channel] &= ~peer_info::bw_disk;
 		}
 		if (m_channel_state[download_channel] & peer_info::bw_disk)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_down_disk, -1);
+			m_counters.add_stats_counter(counters::num_peers_down_disk, -1);
 			m_channel_state[download_channel] &= ~peer_info::bw_disk;
 		}
 
@@ -4390,7 +4520,7 @@ namespace libtorrent {
 
 		if (m_connecting)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_half_open, -1);
+			m_counters.add_stats_counter(counters::num_peers_half_open, -1);
 			if (t) t->dec_num_connecting(m_peer_info);
 			m_connecting = false;
 		}
@@ -4478,9 +4608,9 @@ namespace libtorrent {
 			if (!m_choked)
 			{
 				m_choked = true;
-				m_counters.inc_stats_counter(counters::num_peers_up_unchoked_all, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_unchoked_all, -1);
 				if (!ignore_unchoke_slots())
-					m_counters.inc_stats_counter(counters::num_peers_up_unchoked, -1);
+					m_counters.add_stats_counter(counters::num_peers_up_unchoked, -1);
 			}
 		}
 		else
@@ -4826,7 +4956,7 @@ namespace libtorrent {
 			TORRENT_ASSERT(t || !m_connecting);
 			if (m_connecting)
 			{
-				m_counters.inc_stats_counter(counters::num_peers_half_open, -1);
+				m_counters.add_stats_counter(counters::num_peers_half_open, -1);
 				if (t) t->dec_num_connecting(m_peer_info);
 				m_connecting = false;
 			}
@@ -4849,7 +4979,7 @@ namespace libtorrent {
 			// if we can pick a busy one
 			m_last_request.set(m_connect, now);
 			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::end_game_piece_picks);
+				m_counters.add_stats_counter(counters::end_game_piece_picks);
 			if (m_disconnecting) return;
 			send_block_requests();
 		}
@@ -5177,7 +5307,7 @@ namespace libtorrent {
 			// same piece indefinitely.
 			m_desired_queue_size = 2;
 			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::snubbed_piece_picks);
+				m_counters.add_stats_counter(counters::snubbed_piece_picks);
 
 			// the block we just picked (potentially)
 			// hasn't been put in m_download_queue yet.
@@ -5341,7 +5471,7 @@ namespace libtorrent {
 			m_requests.erase(m_requests.begin() + i);
 
 			if (m_requests.empty())
-				m_counters.inc_stats_counter(counters::num_peers_up_requests, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_requests, -1);
 
 			--i;
 		}
@@ -5777,7 +5907,7 @@ namespace libtorrent {
 			&& quota_left > 0)
 		{
 			if (!(m_channel_state[upload_channel] & peer_info::bw_disk))
-				m_counters.inc_stats_counter(counters::num_peers_up_disk);
+				m_counters.add_stats_counter(counters::num_peers_up_disk);
 			m_channel_state[upload_channel] |= peer_info::bw_disk;
 #ifndef TORRENT_DISABLE_LOGGING
 			peer_log(peer_log_alert::outgoing, "WAITING_FOR_DISK", "outstanding: %d"
@@ -5810,7 +5940,7 @@ namespace libtorrent {
 		else
 		{
 			if (m_channel_state[upload_channel] & peer_info::bw_disk)
-				m_counters.inc_stats_counter(counters::num_peers_up_disk, -1);
+				m_counters.add_stats_counter(counters::num_peers_up_disk, -1);
 			m_channel_state[upload_channel] &= ~peer_info::bw_disk;
 		}
 
@@ -5888,7 +6018,7 @@ namespace libtorrent {
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::info, "DISK", "dropped below disk buffer watermark");
 #endif
-		m_counters.inc_stats_counter(counters::num_peers_down_disk, -1);
+		m_counters.add_stats_counter(counters::num_peers_down_disk, -1);
 		m_channel_state[download_channel] &= ~peer_info::bw_disk;
 		setup_receive();
 	}
@@ -5997,9 +6127,14 @@ namespace libtorrent {
 		}
 		if (buf.empty()) return;
 
-		// allocate a buffer and initialize the beginning of it with 'buf'
-		aux::buffer snd_buf(std::max(int(buf.size()), 128), buf);
-		m_send_buffer.append_buffer(std::move(snd_buf), int(buf.size()));
+		// small messages, like the headers of piece messages, are copied
+		// into the send buffer's slab. Anything larger gets a buffer of its
+		// own, initialized with 'buf'
+		if (!m_send_buffer.append_to_slab(buf))
+		{
+			aux::buffer snd_buf(std::max(int(buf.size()), 128), buf);
+			m_send_buffer.append_buffer(std::move(snd_buf), int(buf.size()));
+		}
 
 		setup_send();
 	}
@@ -6052,7 +6187,7 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(bytes_transferred > 0 || error);
 
-		m_counters.inc_stats_counter(counters::on_read_counter);
+		m_counters.add_stats_counter(counters::on_read_counter);
 
 		INVARIANT_CHECK;
 
@@ -6165,7 +6300,9 @@ namespace libtorrent {
 			sub_transferred = m_recv_buffer.advance_pos(bytes);
 			TORRENT_ASSERT(sub_transferred > 0);
 			on_receive(error, std::size_t(sub_transferred));
-			bytes -= sub_transferred;
+			bytes -= sub_transferred + m_recv_parsed_ahead;
+			m_recv_parsed_ahead = 0;
+			TORRENT_ASSERT(bytes >= 0);
 			if (m_disconnecting) return;
 		} while (bytes > 0 && sub_transferred > 0);
 
@@ -6251,7 +6388,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(t || !m_connecting);
 		if (m_connecting)
 		{
-			m_counters.inc_stats_counter(counters::num_peers_half_open, -1);
+			m_counters.add_stats_counter(counters::num_peers_half_open, -1);
 			if (t) t->dec_num_connecting(m_peer_info);
 			m_connecting = false;
 		}
@@ -6266,7 +6403,7 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(!m_connected);
 		m_connected = true;
-		m_counters.inc_stats_counter(counters::num_peers_connected);
+		m_counters.add_stats_counter(counters::num_peers_connected);
 
 		if (m_disconnecting) return;
 		m_last_receive.set(m_connect, aux::time_now());
@@ -6381,7 +6518,7 @@ namespace libtorrent {
 		, std::size_t const bytes_transferred)
 	{
 		TORRENT_ASSERT(is_single_thread());
-		m_counters.inc_stats_counter(counters::on_write_counter);
+		m_counters.add_stats_counter(counters::on_write_counter);
 		m_ses.sent_buffer(int(bytes_transferred));
 
 #if TORRENT_USE_ASSERTS
@@ -6517,7 +6654,11 @@ namespace libtorrent {
 #if TORRENT_USE_INVARIANT_CHECKS \
 	&& !defined TORRENT_NO_EXPENSIVE_INVARIANT_CHECK
 		if (t && t->has_picker() && !m_disconnecting)
+		{
 			t->picker().check_peer_invariant(m_have_piece, peer_info_struct());
+			if (m_wanted_epoch == t->picker().wanted_epoch())
+				TORRENT_ASSERT(m_num_wanted_pieces == t->picker().num_wanted_pieces(m_have_piece));
+		}
 #endif
 
 		if (!m_disconnect_started && m_initialized)
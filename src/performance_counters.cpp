@@ -33,10 +33,24 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/thread_index.hpp"
 #include <cstring> // for memset
+#include <memory>
+#include <new> // for nothrow
 
 namespace libtorrent {
 
+#ifdef ATOMIC_LLONG_LOCK_FREE
+	struct counters::shard
+	{
+		// the padding keeps the counters off of the cache lines of whatever
+		// happens to be allocated next to the shard
+		char pad0[64];
+		aux::array<std::atomic<std::int64_t>, num_stats_counters> values;
+		char pad1[64];
+	};
+#endif
+
 	// TODO: move stats_counter_t out of counters
 	// TODO: should bittorrent keep-alive messages have a counter too?
 	// TODO: It would be nice if this could be an internal type. default_disk_constructor depends on it now
@@ -45,18 +59,28 @@ namespace libtorrent {
 #ifdef ATOMIC_LLONG_LOCK_FREE
 		for (auto& counter : m_stats_counter)
 			counter.store(0, std::memory_order_relaxed);
+		for (auto& s : m_shards)
+			s.store(nullptr, std::memory_order_relaxed);
 #else
 		m_stats_counter.fill(0);
 #endif
 	}
 
+	counters::~counters()
+	{
+#ifdef ATOMIC_LLONG_LOCK_FREE
+		for (auto& s : m_shards)
+			delete s.load(std::memory_order_relaxed);
+#endif
+	}
+
 	counters::counters(counters const& c) TORRENT_COUNTER_NOEXCEPT
 	{
 #ifdef ATOMIC_LLONG_LOCK_FREE
 		for (int i = 0; i < m_stats_counter.end_index(); ++i)
-			m_stats_counter[i].store(
-				c.m_stats_counter[i].load(std::memory_order_relaxed)
-					, std::memory_order_relaxed);
+			m_stats_counter[i].store(c[i], std::memory_order_relaxed);
+		for (auto& s : m_shards)
+			s.store(nullptr, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(c.m_mutex);
 		m_stats_counter = c.m_stats_counter;
@@ -68,9 +92,7 @@ namespace libtorrent {
 		if (&c == this) return *this;
 #ifdef ATOMIC_LLONG_LOCK_FREE
 		for (int i = 0; i < m_stats_counter.end_index(); ++i)
-			m_stats_counter[i].store(
-				c.m_stats_counter[i].load(std::memory_order_relaxed)
-					, std::memory_order_relaxed);
+			set_value(i, c[i]);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		std::lock_guard<std::mutex> l2(c.m_mutex);
@@ -79,13 +101,39 @@ namespace libtorrent {
 		return *this;
 	}
 
+#ifdef ATOMIC_LLONG_LOCK_FREE
+	std::atomic<std::int64_t>* counters::local_shard() TORRENT_COUNTER_NOEXCEPT
+	{
+		auto& slot = m_shards[aux::thread_index() % num_shards];
+		shard* s = slot.load(std::memory_order_acquire);
+		if (s != nullptr) return s->values.data();
+
+		// this is the first time a thread using this shard increments a
+		// counter. If we fail to allocate it, fall back to the shared
+		// counters
+		std::unique_ptr<shard> ns(new (std::nothrow) shard);
+		if (!ns) return m_stats_counter.data();
+		for (auto& v : ns->values) v.store(0, std::memory_order_relaxed);
+		if (slot.compare_exchange_strong(s, ns.get(), std::memory_order_acq_rel))
+			s = ns.release();
+		return s->values.data();
+	}
+#endif
+
 	std::int64_t counters::operator[](int i) const TORRENT_COUNTER_NOEXCEPT
 	{
 		TORRENT_ASSERT(i >= 0);
 		TORRENT_ASSERT(i < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		return m_stats_counter[i].load(std::memory_order_relaxed);
+		std::int64_t ret = m_stats_counter[i].load(std::memory_order_relaxed);
+		if (i >= num_stats_counters) return ret;
+		for (auto const& slot : m_shards)
+		{
+			shard const* s = slot.load(std::memory_order_acquire);
+			if (s != nullptr) ret += s->values[i].load(std::memory_order_relaxed);
+		}
+		return ret;
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		return m_stats_counter[i];
@@ -104,6 +152,12 @@ namespace libtorrent {
 		TORRENT_ASSERT(c < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
+		if (c < num_stats_counters)
+		{
+			add_stats_counter(c, value);
+			return (*this)[c];
+		}
+
 		std::int64_t pv = m_stats_counter[c].fetch_add(value, std::memory_order_relaxed);
 		TORRENT_ASSERT(pv + value >= 0);
 		return pv + value;
@@ -114,6 +168,31 @@ namespace libtorrent {
 #endif
 	}
 
+	void counters::add_stats_counter(int const c, std::int64_t const value) TORRENT_COUNTER_NOEXCEPT
+	{
+		TORRENT_ASSERT(value >= 0 || c >= num_stats_counters);
+		TORRENT_ASSERT(c >= 0);
+		TORRENT_ASSERT(c < num_counters);
+
+#ifdef ATOMIC_LLONG_LOCK_FREE
+		if (c >= num_stats_counters)
+		{
+			std::int64_t const pv = m_stats_counter[c].fetch_add(value, std::memory_order_relaxed);
+			TORRENT_ASSERT(pv + value >= 0);
+			TORRENT_UNUSED(pv);
+			return;
+		}
+
+		// the shard is rarely shared with another thread, so this is almost
+		// always uncontended
+		local_shard()[c].fetch_add(value, std::memory_order_relaxed);
+#else
+		std::lock_guard<std::mutex> l(m_mutex);
+		TORRENT_ASSERT(m_stats_counter[c] + value >= 0);
+		m_stats_counter[c] += value;
+#endif
+	}
+
 	// ratio is a value between 0 and 100 representing the percentage the value
 	// is blended in at.
 	void counters::blend_stats_counter(int const c, std::int64_t const value, int const ratio) TORRENT_COUNTER_NOEXCEPT
@@ -145,7 +224,17 @@ namespace libtorrent {
 		TORRENT_ASSERT(c < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		m_stats_counter[c].store(value);
+		if (c >= num_stats_counters)
+		{
+			m_stats_counter[c].store(value);
+			return;
+		}
+
+		// the shards are left alone, since other threads may be updating
+		// them. Instead the shared part is adjusted to make the sum
+		// come out as value
+		std::int64_t const current = (*this)[c];
+		m_stats_counter[c].fetch_add(value - current, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 
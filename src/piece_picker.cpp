@@ -192,6 +192,11 @@ namespace libtorrent {
 #endif
 		}
 
+		m_free_pieces.resize(total_num_pieces);
+		for (piece_index_t const i : m_piece_map.range())
+			update_free_piece(i);
+		bump_wanted_epoch();
+
 		for (auto i = m_piece_map.begin() + static_cast<int>(m_cursor)
 			, end(m_piece_map.end()); i != end && (i->have() || i->filtered());
 			++i, ++m_cursor);
@@ -469,6 +474,13 @@ namespace libtorrent {
 		TORRENT_ASSERT(m_have_filtered_pad_blocks + m_filtered_pad_blocks <= num_pad_blocks());
 		TORRENT_ASSERT(m_have_filtered_pad_blocks <= m_have_pad_blocks);
 
+		TORRENT_ASSERT(m_free_pieces.size() == num_pieces());
+		for (piece_index_t i : m_piece_map.range())
+		{
+			TORRENT_ASSERT(m_free_pieces[i] == (!m_piece_map[i].have()
+				&& !m_piece_map[i].filtered()));
+		}
+
 		// make sure the priority boundaries are monotonically increasing. The
 		// difference between two cursors cannot be negative, but ranges are
 		// allowed to be empty.
@@ -1226,6 +1238,46 @@ namespace libtorrent {
 			update(prev_priority, p.index);
 	}
 
+	void piece_picker::inc_refcount(span<piece_index_t const> const pieces
+		, const torrent_peer* peer)
+	{
+#ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
+		INVARIANT_CHECK;
+#endif
+
+#ifdef TORRENT_PICKER_LOG
+		std::cerr << "[" << this << "] " << "inc_refcount(" << pieces.size() << " pieces)" << std::endl;
+#endif
+
+		// just like for bitfields, if many pieces change, it's cheaper to
+		// update the counters and rebuild the piece list the next time it's
+		// needed
+		if (!m_dirty && pieces.size() >= 50)
+			m_dirty = true;
+
+		for (piece_index_t const index : pieces)
+		{
+			piece_pos& p = m_piece_map[index];
+
+#ifdef TORRENT_DEBUG_REFCOUNTS
+			TORRENT_ASSERT(p.have_peers.count(peer) == 0);
+			p.have_peers.insert(peer);
+#else
+			TORRENT_UNUSED(peer);
+#endif
+
+			int const prev_priority = p.priority(this);
+			++p.peer_count;
+			if (m_dirty) continue;
+			int const new_priority = p.priority(this);
+			if (prev_priority == new_priority) continue;
+			if (prev_priority == -1)
+				add(index);
+			else
+				update(prev_priority, p.index);
+		}
+	}
+
 	// this function decrements the m_seeds counter
 	// and increments the peer counter on every piece
 	// instead. Sometimes of we connect to a seed that
@@ -1592,6 +1644,8 @@ namespace libtorrent {
 		if (i->locked) return;
 
 		TORRENT_ASSERT(!i->passed_hash_check);
+		// the piece is no longer wanted, but m_wanted_epoch is left alone.
+		// The caller updates the peers' counts of wanted pieces instead
 		i->passed_hash_check = true;
 		++m_num_passed;
 
@@ -1623,6 +1677,7 @@ namespace libtorrent {
 				i->passed_hash_check = false;
 				TORRENT_ASSERT(m_num_passed > 0);
 				--m_num_passed;
+				bump_wanted_epoch();
 			}
 			erase_download_piece(i);
 			return;
@@ -1630,6 +1685,7 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(m_num_passed > 0);
 		--m_num_passed;
+		bump_wanted_epoch();
 		if (p.filtered())
 		{
 			m_filtered_pad_blocks += pad_blocks_in_piece(index);
@@ -1656,6 +1712,7 @@ namespace libtorrent {
 		m_have_pad_blocks -= pad_blocks_in_piece(index);
 		TORRENT_ASSERT(m_have_pad_blocks >= 0);
 		p.set_not_have();
+		update_free_piece(index);
 
 		if (m_dirty) return;
 		if (p.priority(this) >= 0) add(index);
@@ -1681,6 +1738,9 @@ namespace libtorrent {
 
 		if (p.have()) return;
 
+		// if the piece passed the hash check, it already stopped being
+		// wanted then
+		bool passed = false;
 		auto const state = p.download_queue();
 		if (state != piece_pos::piece_open)
 		{
@@ -1689,9 +1749,11 @@ namespace libtorrent {
 			TORRENT_ASSERT(i->hashing == 0);
 			// decrement num_passed here to compensate
 			// for the unconditional increment further down
-			if (i->passed_hash_check) --m_num_passed;
+			passed = i->passed_hash_check;
+			if (passed) --m_num_passed;
 			erase_download_piece(i);
 		}
+		if (!passed && !p.filtered()) bump_wanted_epoch();
 
 		if (p.filtered())
 		{
@@ -1708,6 +1770,7 @@ namespace libtorrent {
 		m_have_pad_blocks += pad_blocks_in_piece(index);
 		TORRENT_ASSERT(m_have_pad_blocks <= num_pad_blocks());
 		p.set_have();
+		m_free_pieces.clear_bit(index);
 		if (m_cursor == prev(m_reverse_cursor)
 			&& m_cursor == index)
 		{
@@ -1763,6 +1826,7 @@ namespace libtorrent {
 		m_reverse_cursor = piece_index_t{0};
 		m_num_passed = num_pieces();
 		m_num_have = num_pieces();
+		bump_wanted_epoch();
 
 		for (auto& queue : m_downloads) queue.clear();
 		for (auto& p : m_piece_map)
@@ -1770,6 +1834,7 @@ namespace libtorrent {
 			p.set_have();
 			p.state(piece_pos::piece_open);
 		}
+		m_free_pieces.clear_all();
 	}
 
 	bool piece_picker::set_piece_priority(piece_index_t const index
@@ -1866,6 +1931,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(m_num_have_filtered >= 0);
 
 		p.piece_priority = static_cast<std::uint8_t>(new_piece_priority);
+		update_free_piece(index);
 		int const new_priority = p.priority(this);
 
 		if (prev_priority != new_priority && !m_dirty)
@@ -1881,6 +1947,7 @@ namespace libtorrent {
 				update_piece_state(i);
 		}
 
+		if (ret) bump_wanted_epoch();
 		return ret;
 	}
 
@@ -2038,7 +2105,7 @@ namespace {
 			// that the current peer doesn't have is not included.
 			for (auto& dp : m_downloads[piece_pos::piece_downloading])
 			{
-				pc.inc_stats_counter(counters::piece_picker_partial_loops);
+				pc.add_stats_counter(counters::piece_picker_partial_loops);
 
 				// in time critical mode, only pick high priority pieces
 				if ((options & time_critical_mode)
@@ -2099,7 +2166,7 @@ namespace {
 					&& piece_priority(i) != top_priority)
 					continue;
 
-				pc.inc_stats_counter(counters::piece_picker_suggest_loops);
+				pc.add_stats_counter(counters::piece_picker_suggest_loops);
 				if (!is_piece_free(i, pieces)) continue;
 
 				ret |= picker_log_alert::suggested_pieces;
@@ -2156,9 +2223,13 @@ namespace {
 				}
 				else
 				{
-					for (piece_index_t i = m_cursor; i < m_reverse_cursor; ++i)
+					// jump straight to the next piece the peer has that we
+					// still need
+					for (piece_index_t i = pieces.find_next_set_and(m_free_pieces, m_cursor);
+						i != piece_index_t(-1) && i < m_reverse_cursor;
+						i = pieces.find_next_set_and(m_free_pieces, next(i)))
 					{
-						if (!is_piece_free(i, pieces)) continue;
+						TORRENT_ASSERT(is_piece_free(i, pieces));
 						// we've already added high priority pieces
 						if (piece_priority(i) == top_priority) continue;
 
@@ -2191,7 +2262,7 @@ namespace {
 					prio_index_t const end = priority_end(i);
 					for (prio_index_t p = prev(end); p >= start; --p)
 					{
-						pc.inc_stats_counter(counters::piece_picker_reverse_rare_loops);
+						pc.add_stats_counter(counters::piece_picker_reverse_rare_loops);
 
 						if (!is_piece_free(m_pieces[p], pieces)) continue;
 
@@ -2243,9 +2314,10 @@ namespace {
 					if (to_erase != -1) m_recent_extents.erase(m_recent_extents.begin() + to_erase);
 				}
 
-				for (piece_index_t i : m_pieces)
+				// returns true when we're done picking rarest first
+				auto const pick_rarest = [&](piece_index_t const i)
 				{
-					pc.inc_stats_counter(counters::piece_picker_rare_loops);
+					pc.add_stats_counter(counters::piece_picker_rare_loops);
 
 					// in time critical mode, only pick high priority pieces
 					// it's safe to break here because in this mode we
@@ -2253,9 +2325,9 @@ namespace {
 					// piece, we won't encounter any more high priority ones
 					if ((options & time_critical_mode)
 						&& piece_priority(i) != top_priority)
-						break;
+						return true;
 
-					if (!is_piece_free(i, pieces)) continue;
+					if (!is_piece_free(i, pieces)) return false;
 
 					ret |= picker_log_alert::rarest_first;
 
@@ -2264,8 +2336,36 @@ namespace {
 						, backup_blocks2, num_blocks
 						, prefer_contiguous_blocks, peer, suggested_pieces
 						, options);
-					if (num_blocks <= 0) return ret;
+					return num_blocks <= 0;
+				};
+
+				// walking m_pieces probes the peer's bitfield for every piece.
+				// If the peer has few of the pieces we're missing, that may
+				// visit most of m_pieces. Visiting a piece costs about as much
+				// as scanning 4 words of the bitfields, so once we've visited a
+				// quarter as many pieces as there are words without finding
+				// enough, the rest are found by scanning the intersection of the
+				// bitfields instead
+				prio_index_t const walk_limit(std::min(int(m_pieces.size())
+					, m_free_pieces.num_words() / 4));
+				bool done = false;
+				prio_index_t p(0);
+				for (; p < walk_limit && !done; ++p)
+					done = pick_rarest(m_pieces[p]);
+
+				std::vector<piece_index_t> sparse_pieces;
+				if (!done && p < m_pieces.end_index()
+					&& sparse_free_pieces(pieces, p, sparse_pieces))
+				{
+					for (auto const i : sparse_pieces)
+						if (pick_rarest(i)) break;
+				}
+				else
+				{
+					for (; p < m_pieces.end_index() && !done; ++p)
+						done = pick_rarest(m_pieces[p]);
 				}
+				if (num_blocks <= 0) return ret;
 			}
 		}
 		else if (options & time_critical_mode)
@@ -2304,7 +2404,7 @@ namespace {
 						, suggested_pieces.end(), piece)
 						!= suggested_pieces.end())
 				{
-					pc.inc_stats_counter(counters::piece_picker_rand_start_loops);
+					pc.add_stats_counter(counters::piece_picker_rand_start_loops);
 					++piece;
 					if (piece == m_piece_map.end_index()) piece = piece_index_t(0);
 					// could not find any more pieces
@@ -2328,7 +2428,7 @@ namespace {
 
 						for (int j = 0; j < num_blocks_in_piece; ++j)
 						{
-							pc.inc_stats_counter(counters::piece_picker_rand_loops);
+							pc.add_stats_counter(counters::piece_picker_rand_loops);
 							TORRENT_ASSERT(is_piece_free(k, pieces));
 							interesting_blocks.emplace_back(k, j);
 							--num_blocks;
@@ -2463,7 +2563,7 @@ get_out:
 		partials_size = c;
 		while (partials_size > 0)
 		{
-			pc.inc_stats_counter(counters::piece_picker_busy_loops);
+			pc.add_stats_counter(counters::piece_picker_busy_loops);
 			int piece = int(random(aux::numeric_cast<std::uint32_t>(partials_size - 1)));
 			downloading_piece const* dp = partials[piece];
 			TORRENT_ASSERT(pieces[dp->index]);
@@ -2585,9 +2685,98 @@ get_out:
 	bool piece_picker::is_piece_free(piece_index_t const piece
 		, typed_bitfield<piece_index_t> const& bitmask) const
 	{
-		return bitmask[piece]
-			&& !m_piece_map[piece].have()
-			&& !m_piece_map[piece].filtered();
+		TORRENT_ASSERT(m_free_pieces[piece] == (!m_piece_map[piece].have()
+			&& !m_piece_map[piece].filtered()));
+		return bitmask[piece] && m_free_pieces[piece];
+	}
+
+	bool piece_picker::is_wanted(piece_index_t const piece) const
+	{
+		return m_free_pieces[piece] && !has_piece_passed(piece);
+	}
+
+	int piece_picker::num_wanted_pieces(typed_bitfield<piece_index_t> const& bitmask) const
+	{
+		TORRENT_ASSERT(bitmask.size() == m_free_pieces.size());
+		int ret = bitmask.count_and(m_free_pieces);
+
+		// pieces that passed the hash check, but haven't been written to disk
+		// yet, are still in m_free_pieces
+		if (m_num_passed == m_num_have) return ret;
+		for (auto const& queue : m_downloads)
+		{
+			for (auto const& dp : queue)
+			{
+				if (dp.passed_hash_check && bitmask[dp.index] && m_free_pieces[dp.index])
+					--ret;
+			}
+		}
+		TORRENT_ASSERT(ret >= 0);
+		return ret;
+	}
+
+	void piece_picker::update_free_piece(piece_index_t const piece)
+	{
+		piece_pos const& p = m_piece_map[piece];
+		if (p.have() || p.filtered()) m_free_pieces.clear_bit(piece);
+		else m_free_pieces.set_bit(piece);
+	}
+
+	bool piece_picker::sparse_free_pieces(typed_bitfield<piece_index_t> const& bitmask
+		, prio_index_t const start, std::vector<piece_index_t>& pieces) const
+	{
+		TORRENT_ASSERT(bitmask.size() == m_free_pieces.size());
+		TORRENT_ASSERT(!m_dirty);
+		pieces.clear();
+
+		// if the peer has more pieces than this, walking m_pieces is cheaper
+		// than sorting them
+		int const limit = (int(m_pieces.size()) - static_cast<int>(start)) / 8;
+
+		// both bitfields are stored as 32 bit words in network byte order.
+		// Only words with bits set in both need to be looked at. Each of them
+		// has at least one piece, so we give up once there are more than
+		// limit of them. find_next_set_and() skips the empty stretches in
+		// between with vector instructions
+		auto const* a = reinterpret_cast<std::uint32_t const*>(bitmask.data());
+		auto const* b = reinterpret_cast<std::uint32_t const*>(m_free_pieces.data());
+		TORRENT_ALLOCA(words, int, limit);
+		int num_set_words = 0;
+		for (piece_index_t i = bitmask.find_next_set_and(m_free_pieces, piece_index_t(0));
+			i != piece_index_t(-1);)
+		{
+			if (num_set_words == limit) return false;
+			int const w = static_cast<int>(i) / 32;
+			words[num_set_words++] = w;
+			piece_index_t const next((w + 1) * 32);
+			if (next >= m_free_pieces.end_index()) break;
+			i = bitmask.find_next_set_and(m_free_pieces, next);
+		}
+
+		// the position of each piece in m_pieces, which is ordered by
+		// priority, and the piece. Pieces that are fully requested, or that
+		// nobody has, aren't in m_pieces, and the ones before start have
+		// already been visited
+		using candidate = std::pair<prio_index_t, piece_index_t>;
+		std::vector<candidate> candidates;
+		for (int const w : words.first(num_set_words))
+		{
+			std::uint32_t v = a[w] & b[w];
+			while (v != 0)
+			{
+				int const bit = aux::count_leading_zeros({&v, 1});
+				v &= ~aux::host_to_network(0x80000000u >> bit);
+				piece_index_t const piece(w * 32 + bit);
+				piece_pos const& pp = m_piece_map[piece];
+				if (pp.priority(this) < 0 || pp.index < start) continue;
+				candidates.emplace_back(pp.index, piece);
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		pieces.reserve(candidates.size());
+		for (auto const& c : candidates) pieces.push_back(c.second);
+		return true;
 	}
 
 	bool piece_picker::can_pick(piece_index_t const piece
@@ -3491,6 +3680,7 @@ get_out:
 			i->passed_hash_check = false;
 			TORRENT_ASSERT(m_num_passed > 0);
 			--m_num_passed;
+			bump_wanted_epoch();
 		}
 
 		// prevent this piece from being picked until it's restored
@@ -3543,6 +3733,7 @@ get_out:
 			i->passed_hash_check = false;
 			TORRENT_ASSERT(m_num_passed > 0);
 			--m_num_passed;
+			bump_wanted_epoch();
 		}
 
 		// prevent this hash job from actually completing
@@ -47,8 +47,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/add_torrent_params.hpp"
 #include "libtorrent/aux_/merkle.hpp"
+#include "libtorrent/aux_/disk_completion.hpp"
+#include "libtorrent/aux_/heterogeneous_queue.hpp"
+#include "libtorrent/aux_/disk_io_thread_pool.hpp"
 
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 
 namespace libtorrent {
 
@@ -64,24 +71,256 @@ namespace {
 
 	using aux::posix_storage;
 
+	// a minimal reader-writer lock. Writers are preferred, to not have a
+	// move or delete wait behind a steady stream of reads and writes
+	struct shared_mutex
+	{
+		void lock_shared()
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			m_cond.wait(l, [this] { return !m_writer && m_waiting_writers == 0; });
+			++m_readers;
+		}
+
+		void unlock_shared()
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			TORRENT_ASSERT(m_readers > 0);
+			if (--m_readers == 0) m_cond.notify_all();
+		}
+
+		void lock()
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			++m_waiting_writers;
+			m_cond.wait(l, [this] { return !m_writer && m_readers == 0; });
+			--m_waiting_writers;
+			m_writer = true;
+		}
+
+		void unlock()
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			TORRENT_ASSERT(m_writer);
+			m_writer = false;
+			m_cond.notify_all();
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		int m_readers = 0;
+		int m_waiting_writers = 0;
+		bool m_writer = false;
+	};
+
+	struct shared_lock
+	{
+		explicit shared_lock(shared_mutex& m) : m_mutex(m) { m_mutex.lock_shared(); }
+		~shared_lock() { m_mutex.unlock_shared(); }
+		shared_lock(shared_lock const&) = delete;
+		shared_lock& operator=(shared_lock const&) = delete;
+	private:
+		shared_mutex& m_mutex;
+	};
+
+	// a block read ahead of being requested, kept until it's requested, or
+	// evicted
+	struct read_ahead_block
+	{
+		piece_index_t piece;
+		int offset;
+		int length;
+		char* buffer;
+	};
+
+	// a torrent's storage, along with the state shared between the network
+	// thread and the read threads
+	struct torrent_storage
+	{
+		explicit torrent_storage(storage_params const& p) : storage(p) {}
+
+		posix_storage storage;
+
+		// reads, writes and hashes hold this shared. Jobs changing the
+		// files themselves (move, rename, delete, release, check and file
+		// priorities) hold it exclusively, on the read threads
+		shared_mutex mutex;
+
+		// a write excludes reads of the same piece, and the other way around.
+		// Reads of the same piece, and reads and writes of different pieces,
+		// may run concurrently. The caller must hold mutex (shared)
+		void lock_piece(piece_index_t const piece, bool const write)
+		{
+			std::unique_lock<std::mutex> l(m_piece_mutex);
+			auto i = m_busy_pieces.end();
+			m_piece_cond.wait(l, [&]
+			{
+				i = std::find_if(m_busy_pieces.begin(), m_busy_pieces.end()
+					, [&](busy_piece const& p) { return p.piece == piece; });
+				return i == m_busy_pieces.end() || (!write && !i->writer);
+			});
+			if (i == m_busy_pieces.end()) m_busy_pieces.push_back({piece, 1, write});
+			else ++i->refcount;
+		}
+
+		void unlock_piece(piece_index_t const piece)
+		{
+			std::lock_guard<std::mutex> l(m_piece_mutex);
+			auto const i = std::find_if(m_busy_pieces.begin(), m_busy_pieces.end()
+				, [&](busy_piece const& p) { return p.piece == piece; });
+			TORRENT_ASSERT(i != m_busy_pieces.end());
+			if (--i->refcount > 0) return;
+			m_busy_pieces.erase(i);
+			m_piece_cond.notify_all();
+		}
+
+		// returns the read-ahead buffer holding the data for r, if any. The
+		// ownership of the buffer is passed on to the caller
+		char* take(peer_request const& r)
+		{
+			std::lock_guard<std::mutex> l(m_cache_mutex);
+			auto const i = std::find_if(m_cache.begin(), m_cache.end()
+				, [&](read_ahead_block const& b)
+				{ return b.piece == r.piece && b.offset == r.start && b.length >= r.length; });
+			if (i == m_cache.end()) return nullptr;
+			char* const ret = i->buffer;
+			m_cache.erase(i);
+			return ret;
+		}
+
+		// hands over the read-ahead blocks, evicting the oldest ones beyond
+		// max_blocks. The caller must hold the piece locked, so no write to
+		// the same blocks can happen in between reading and inserting them
+		void insert(aux::disk_buffer_pool& pool, span<read_ahead_block const> blocks
+			, int const max_blocks)
+		{
+			std::lock_guard<std::mutex> l(m_cache_mutex);
+			if (m_removed)
+			{
+				for (auto const& b : blocks) pool.free_buffer(b.buffer);
+				return;
+			}
+			for (auto const& b : blocks)
+			{
+				auto const i = std::find_if(m_cache.begin(), m_cache.end()
+					, [&](read_ahead_block const& e)
+					{ return e.piece == b.piece && e.offset == b.offset; });
+				if (i != m_cache.end())
+				{
+					pool.free_buffer(i->buffer);
+					m_cache.erase(i);
+				}
+				m_cache.push_back(b);
+			}
+			int const evict = int(m_cache.size()) - max_blocks;
+			if (evict <= 0) return;
+			for (auto i = m_cache.begin(); i != m_cache.begin() + evict; ++i)
+				pool.free_buffer(i->buffer);
+			m_cache.erase(m_cache.begin(), m_cache.begin() + evict);
+		}
+
+		// drops the read-ahead blocks overlapping the range in piece
+		void invalidate(aux::disk_buffer_pool& pool, piece_index_t const piece
+			, int const offset, int const length)
+		{
+			std::lock_guard<std::mutex> l(m_cache_mutex);
+			auto const i = std::remove_if(m_cache.begin(), m_cache.end()
+				, [&](read_ahead_block const& b)
+				{
+					if (b.piece != piece || b.offset >= offset + length
+						|| b.offset + b.length <= offset)
+						return false;
+					pool.free_buffer(b.buffer);
+					return true;
+				});
+			m_cache.erase(i, m_cache.end());
+		}
+
+		// drops all read-ahead blocks. Once removed, blocks read by
+		// outstanding jobs are no longer kept
+		void clear(aux::disk_buffer_pool& pool, bool const removed = false)
+		{
+			std::lock_guard<std::mutex> l(m_cache_mutex);
+			for (auto const& b : m_cache) pool.free_buffer(b.buffer);
+			m_cache.clear();
+			if (removed) m_removed = true;
+		}
+
+	private:
+
+		struct busy_piece
+		{
+			piece_index_t piece;
+			int refcount;
+			bool writer;
+		};
+
+		// the pieces currently being read or written. There are only ever a
+		// few, one per thread
+		std::mutex m_piece_mutex;
+		std::condition_variable m_piece_cond;
+		std::vector<busy_piece> m_busy_pieces;
+
+		std::mutex m_cache_mutex;
+
+		// ordered by age, oldest first
+		std::vector<read_ahead_block> m_cache;
+		bool m_removed = false;
+	};
+
+	struct piece_lock
+	{
+		piece_lock(torrent_storage& st, piece_index_t const p, bool const write)
+			: m_storage(st), m_piece(p)
+		{ m_storage.lock_piece(m_piece, write); }
+		~piece_lock() { m_storage.unlock_piece(m_piece); }
+		piece_lock(piece_lock const&) = delete;
+		piece_lock& operator=(piece_lock const&) = delete;
+	private:
+		torrent_storage& m_storage;
+		piece_index_t const m_piece;
+	};
+
+	struct read_job
+	{
+		std::shared_ptr<torrent_storage> storage;
+		peer_request r;
+		std::function<void(disk_buffer_holder block, storage_error const& se)> handler;
+
+		// the number of blocks to read into the read-ahead cache on a miss
+		// (settings_pack::read_cache_line_size)
+		int cache_line;
+	};
+
 } // anonymous namespace
 
 	struct TORRENT_EXTRA_EXPORT posix_disk_io final
 		: disk_interface
 		, buffer_allocator_interface
+		, aux::pool_thread_interface
 	{
 		posix_disk_io(io_context& ios, settings_interface const& sett, counters& cnt)
 			: m_settings(sett)
 			, m_buffer_pool(ios)
 			, m_stats_counters(cnt)
 			, m_ios(ios)
+			, m_threads(*this, ios)
 		{
 			settings_updated();
 		}
 
+		~posix_disk_io() override
+		{
+			m_threads.abort(true);
+			for (auto& t : m_torrents)
+				if (t) t->clear(m_buffer_pool, true);
+		}
+
 		void settings_updated() override
 		{
 			m_buffer_pool.set_settings(m_settings);
+			m_threads.set_max_threads(m_settings.get_int(settings_pack::aio_threads));
 		}
 
 		storage_holder new_torrent(storage_params const& params
@@ -93,7 +332,7 @@ namespace {
 			storage_index_t const idx = m_free_slots.empty()
 				? m_torrents.end_index()
 				: pop(m_free_slots);
-			auto storage = std::make_unique<posix_storage>(params);
+			auto storage = std::make_shared<torrent_storage>(params);
 			if (idx == m_torrents.end_index()) m_torrents.emplace_back(std::move(storage));
 			else m_torrents[idx] = std::move(storage);
 			return storage_holder(idx, *this);
@@ -101,45 +340,45 @@ namespace {
 
 		void remove_torrent(storage_index_t const idx) override
 		{
+			// the storage_holder removes the torrent again when it's destructed
+			if (!m_torrents[idx]) return;
+
+			// outstanding read jobs keep the storage alive
+			m_torrents[idx]->clear(m_buffer_pool, true);
 			m_torrents[idx].reset();
 			m_free_slots.push_back(idx);
 		}
 
-		void abort(bool) override {}
+		void abort(bool const wait) override
+		{
+			// make sure queued reads are performed, the last read thread
+			// drains the queue before exiting
+			submit_jobs();
+			m_threads.abort(wait);
+		}
 
+		// reads are performed on the read threads (or in submit_jobs(), if
+		// there are none). Adjacent reads of the same piece are merged into a
+		// single readv() call, and a read cache miss reads ahead to the end of
+		// the cache line. Subsequent requests for those blocks are served
+		// here, without touching the disk
 		void async_read(storage_index_t storage, peer_request const& r
 			, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
 			, disk_job_flags_t) override
 		{
-			disk_buffer_holder buffer = disk_buffer_holder(*this, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
-			storage_error error;
-			if (!buffer)
+			std::shared_ptr<torrent_storage> const& st = m_torrents[storage];
+			if (char* const buf = st->take(r))
 			{
-				error.ec = errors::no_memory;
-				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [=, h = std::move(handler)]{ h(disk_buffer_holder(*this, nullptr, 0), error); });
+				m_stats_counters.add_stats_counter(counters::disk_read_ahead_hits);
+				post_completion([h = std::move(handler)
+					, b = disk_buffer_holder(*this, buf, default_block_size)] () mutable
+					{ h(std::move(b), storage_error{}); });
 				return;
 			}
 
-			time_point const start_time = clock_type::now();
-
-			iovec_t buf = {buffer.data(), r.length};
-
-			m_torrents[storage]->readv(m_settings, buf, r.piece, r.start, error);
-
-			if (!error.ec)
-			{
-				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
-
-				m_stats_counters.inc_stats_counter(counters::num_read_back);
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
-			}
-
-			post(m_ios, [h = std::move(handler), b = std::move(buffer), error] () mutable
-				{ h(std::move(b), error); });
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			m_read_jobs.push_back(read_job{st, r, std::move(handler)
+				, m_settings.get_int(settings_pack::read_cache_line_size)});
 		}
 
 		bool async_write(storage_index_t storage, peer_request const& r
@@ -153,20 +392,26 @@ namespace {
 
 			time_point const start_time = clock_type::now();
 
+			torrent_storage& st = *m_torrents[storage];
 			storage_error error;
-			m_torrents[storage]->writev(m_settings, b, r.piece, r.start, error);
+			{
+				shared_lock l(st.mutex);
+				piece_lock pl(st, r.piece, true);
+				st.invalidate(m_buffer_pool, r.piece, r.start, r.length);
+				st.storage.writev(m_settings, b, r.piece, r.start, error);
+			}
 
 			if (!error.ec)
 			{
 				std::int64_t const write_time = total_microseconds(clock_type::now() - start_time);
 
-				m_stats_counters.inc_stats_counter(counters::num_blocks_written);
-				m_stats_counters.inc_stats_counter(counters::num_write_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+				m_stats_counters.add_stats_counter(counters::num_blocks_written);
+				m_stats_counters.add_stats_counter(counters::num_write_ops);
+				m_stats_counters.add_stats_counter(counters::disk_write_time, write_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, write_time);
 			}
 
-			post(m_ios, [=, h = std::move(handler)]{ h(error); });
+			post_completion([=, h = std::move(handler)]{ h(error); });
 			return false;
 		}
 
@@ -185,12 +430,14 @@ namespace {
 			{
 				error.ec = errors::no_memory;
 				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [=, h = std::move(handler)]{ h(piece, sha1_hash{}, error); });
+				post_completion([=, h = std::move(handler)]{ h(piece, sha1_hash{}, error); });
 				return;
 			}
 			hasher ph;
 
-			posix_storage* st = m_torrents[storage].get();
+			torrent_storage& ts = *m_torrents[storage];
+			shared_lock l(ts.mutex);
+			posix_storage* st = &ts.storage;
 
 			int const piece_size = v1 ? st->files().piece_size(piece) : 0;
 			int const piece_size2 = v2 ? st->orig_files().piece_size2(piece) : 0;
@@ -224,14 +471,14 @@ namespace {
 			{
 				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-				m_stats_counters.inc_stats_counter(counters::num_read_back);
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read, blocks_to_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+				m_stats_counters.add_stats_counter(counters::num_read_back);
+				m_stats_counters.add_stats_counter(counters::num_blocks_read, blocks_to_read);
+				m_stats_counters.add_stats_counter(counters::num_read_ops);
+				m_stats_counters.add_stats_counter(counters::disk_hash_time, read_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 			}
 
-			post(m_ios, [=, h = std::move(handler)]{ h(piece, hash, error); });
+			post_completion([=, h = std::move(handler)]{ h(piece, hash, error); });
 		}
 
 		void async_hash2(storage_index_t storage, piece_index_t const piece, int offset, disk_job_flags_t
@@ -245,11 +492,13 @@ namespace {
 			{
 				error.ec = errors::no_memory;
 				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [=, h = std::move(handler)]{ h(piece, sha256_hash{}, error); });
+				post_completion([=, h = std::move(handler)]{ h(piece, sha256_hash{}, error); });
 				return;
 			}
 
-			posix_storage* st = m_torrents[storage].get();
+			torrent_storage& ts = *m_torrents[storage];
+			shared_lock l(ts.mutex);
+			posix_storage* st = &ts.storage;
 
 			int const piece_size = st->files().piece_size2(piece);
 
@@ -267,14 +516,14 @@ namespace {
 			{
 				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
 
-				m_stats_counters.inc_stats_counter(counters::num_read_back);
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+				m_stats_counters.add_stats_counter(counters::num_read_back);
+				m_stats_counters.add_stats_counter(counters::num_blocks_read);
+				m_stats_counters.add_stats_counter(counters::num_read_ops);
+				m_stats_counters.add_stats_counter(counters::disk_hash_time, read_time);
+				m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
 			}
 
-			post(m_ios, [=, h = std::move(handler)]{ h(piece, hash, error); });
+			post_completion([=, h = std::move(handler)]{ h(piece, hash, error); });
 		}
 
 
@@ -282,28 +531,48 @@ namespace {
 			, move_flags_t const flags
 			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override
 		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error ec;
-			status_t ret;
-			std::tie(ret, p) = st->move_storage(p, flags, ec);
-			post(m_ios, [=, h = std::move(handler)]{ h(ret, p, ec); });
+			queue_storage_job([this, st = m_torrents[storage], p = std::move(p), flags
+				, h = std::move(handler)] () mutable
+			{
+				storage_error ec;
+				status_t ret;
+				{
+					std::lock_guard<shared_mutex> l(st->mutex);
+					st->clear(m_buffer_pool);
+					std::tie(ret, p) = st->storage.move_storage(p, flags, ec);
+				}
+				post_completion([=, h = std::move(h)]{ h(ret, p, ec); });
+			});
 		}
 
 		void async_release_files(storage_index_t storage, std::function<void()> handler) override
 		{
-			posix_storage* st = m_torrents[storage].get();
-			st->release_files();
-			if (!handler) return;
-			post(m_ios, [=]{ handler(); });
+			queue_storage_job([this, st = m_torrents[storage], h = std::move(handler)]
+			{
+				{
+					std::lock_guard<shared_mutex> l(st->mutex);
+					st->clear(m_buffer_pool);
+					st->storage.release_files();
+				}
+				if (!h) return;
+				post_completion([=]{ h(); });
+			});
 		}
 
 		void async_delete_files(storage_index_t storage, remove_flags_t const options
 			, std::function<void(storage_error const&)> handler) override
 		{
-			storage_error error;
-			posix_storage* st = m_torrents[storage].get();
-			st->delete_files(options, error);
-			post(m_ios, [=, h = std::move(handler)]{ h(error); });
+			queue_storage_job([this, st = m_torrents[storage], options
+				, h = std::move(handler)]
+			{
+				storage_error error;
+				{
+					std::lock_guard<shared_mutex> l(st->mutex);
+					st->clear(m_buffer_pool);
+					st->storage.delete_files(options, error);
+				}
+				post_completion([=]{ h(error); });
+			});
 		}
 
 		void async_check_files(storage_index_t storage
@@ -311,39 +580,45 @@ namespace {
 			, aux::vector<std::string, file_index_t> links
 			, std::function<void(status_t, storage_error const&)> handler) override
 		{
-			posix_storage* st = m_torrents[storage].get();
-
-			add_torrent_params tmp;
-			add_torrent_params const* rd = resume_data ? resume_data : &tmp;
-
-			storage_error error;
-			status_t const ret = [&]
+			queue_storage_job([this, ts = m_torrents[storage], resume_data
+				, links = std::move(links), h = std::move(handler)] () mutable
 			{
-				st->initialize(m_settings, error);
-				if (error) return status_t::fatal_disk_error;
+				std::lock_guard<shared_mutex> l(ts->mutex);
+				ts->clear(m_buffer_pool);
+				posix_storage* st = &ts->storage;
 
-				bool const verify_success = st->verify_resume_data(*rd
-					, std::move(links), error);
+				add_torrent_params tmp;
+				add_torrent_params const* rd = resume_data ? resume_data : &tmp;
 
-				if (m_settings.get_bool(settings_pack::no_recheck_incomplete_resume))
-					return status_t::no_error;
-
-				if (!aux::contains_resume_data(*rd))
+				storage_error error;
+				status_t const ret = [&]
 				{
-					// if we don't have any resume data, we still may need to trigger a
-					// full re-check, if there are *any* files.
-					storage_error ignore;
-					return (st->has_any_file(ignore))
-						? status_t::need_full_check
-						: status_t::no_error;
-				}
-
-				return verify_success
-					? status_t::no_error
-					: status_t::need_full_check;
-			}();
-
-			post(m_ios, [error, ret, h = std::move(handler)]{ h(ret, error); });
+					st->initialize(m_settings, error);
+					if (error) return status_t::fatal_disk_error;
+
+					bool const verify_success = st->verify_resume_data(*rd
+						, std::move(links), error);
+
+					if (m_settings.get_bool(settings_pack::no_recheck_incomplete_resume))
+						return status_t::no_error;
+
+					if (!aux::contains_resume_data(*rd))
+					{
+						// if we don't have any resume data, we still may need to trigger a
+						// full re-check, if there are *any* files.
+						storage_error ignore;
+						return (st->has_any_file(ignore))
+							? status_t::need_full_check
+							: status_t::no_error;
+					}
+
+					return verify_success
+						? status_t::no_error
+						: status_t::need_full_check;
+				}();
+
+				post_completion([error, ret, h = std::move(h)]{ h(ret, error); });
+			});
 		}
 
 		void async_rename_file(storage_index_t const storage
@@ -351,17 +626,24 @@ namespace {
 			, std::string name
 			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override
 		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error error;
-			st->rename_file(idx, name, error);
-			post(m_ios, [idx, error, h = std::move(handler), n = std::move(name)] () mutable
-				{ h(std::move(n), idx, error); });
+			queue_storage_job([this, st = m_torrents[storage], idx, name = std::move(name)
+				, h = std::move(handler)] () mutable
+			{
+				storage_error error;
+				{
+					std::lock_guard<shared_mutex> l(st->mutex);
+					st->clear(m_buffer_pool);
+					st->storage.rename_file(idx, name, error);
+				}
+				post_completion([idx, error, h = std::move(h), n = std::move(name)] () mutable
+					{ h(std::move(n), idx, error); });
+			});
 		}
 
 		void async_stop_torrent(storage_index_t, std::function<void()> handler) override
 		{
 			if (!handler) return;
-			post(m_ios, std::move(handler));
+			post_completion(std::move(handler));
 		}
 
 		void async_set_file_priority(storage_index_t const storage
@@ -369,17 +651,24 @@ namespace {
 			, std::function<void(storage_error const&
 				, aux::vector<download_priority_t, file_index_t>)> handler) override
 		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error error;
-			st->set_file_priority(prio, error);
-			post(m_ios, [p = std::move(prio), h = std::move(handler), error] () mutable
-				{ h(error, std::move(p)); });
+			queue_storage_job([this, st = m_torrents[storage], prio = std::move(prio)
+				, h = std::move(handler)] () mutable
+			{
+				storage_error error;
+				{
+					std::lock_guard<shared_mutex> l(st->mutex);
+					st->clear(m_buffer_pool);
+					st->storage.set_file_priority(prio, error);
+				}
+				post_completion([p = std::move(prio), h = std::move(h), error] () mutable
+					{ h(error, std::move(p)); });
+			});
 		}
 
 		void async_clear_piece(storage_index_t, piece_index_t index
 			, std::function<void(piece_index_t)> handler) override
 		{
-			post(m_ios, [=, h = std::move(handler)]{ h(index); });
+			post_completion([=, h = std::move(handler)]{ h(index); });
 		}
 
 		// implements buffer_allocator_interface
@@ -391,11 +680,297 @@ namespace {
 		std::vector<open_file_state> get_status(storage_index_t) const override
 		{ return {}; }
 
-		void submit_jobs() override {}
+		void submit_jobs() override
+		{
+			std::unique_lock<std::mutex> l(m_job_mutex);
+			if (!has_jobs()) return;
+
+			if (m_threads.max_threads() > 0)
+			{
+				m_job_cond.notify_all();
+				m_threads.job_queued(int(m_read_jobs.size() + m_storage_jobs.size()));
+				return;
+			}
+
+			// there are no read threads, perform the jobs here, on the
+			// network thread
+			std::vector<read_job> batch;
+			while (has_jobs()) perform_job(l, batch);
+		}
+
+		// implements pool_thread_interface
+		void notify_all() override
+		{
+			m_job_cond.notify_all();
+		}
+
+		void thread_fun(aux::disk_io_thread_pool& pool
+			, executor_work_guard<io_context::executor_type> work) override
+		{
+			m_stats_counters.add_stats_counter(counters::num_running_threads, 1);
+
+			std::vector<read_job> batch;
+			std::unique_lock<std::mutex> l(m_job_mutex);
+			while (!wait_for_job(pool, l)) perform_job(l, batch);
+			l.unlock();
+
+			m_stats_counters.add_stats_counter(counters::num_running_threads, -1);
+
+			// the work guard keeps the io_context running until this thread
+			// stops posting completions to it
+			TORRENT_UNUSED(work);
+		}
 
 	private:
 
-		aux::vector<std::unique_ptr<posix_storage>, storage_index_t> m_torrents;
+		// queues a job that needs the storage exclusively, to be performed
+		// on a read thread rather than blocking the network thread on the
+		// reads and writes in progress
+		void queue_storage_job(std::function<void()> job)
+		{
+			{
+				std::lock_guard<std::mutex> l(m_job_mutex);
+				m_storage_jobs.push_back(std::move(job));
+			}
+			submit_jobs();
+		}
+
+		// returns true if there's a job a thread can pick up. The caller must
+		// hold m_job_mutex
+		bool has_jobs() const
+		{
+			return !m_read_jobs.empty()
+				|| (!m_storage_jobs.empty() && !m_storage_job_running);
+		}
+
+		// performs the first queued storage job, or the next batch of reads.
+		// l is m_job_mutex, held on entry and exit but not while performing
+		// the job
+		void perform_job(std::unique_lock<std::mutex>& l, std::vector<read_job>& batch)
+		{
+			TORRENT_ASSERT(l.owns_lock());
+			TORRENT_ASSERT(has_jobs());
+			if (!m_storage_jobs.empty() && !m_storage_job_running)
+			{
+				std::function<void()> const job = std::move(m_storage_jobs.front());
+				m_storage_jobs.pop_front();
+				m_storage_job_running = true;
+				l.unlock();
+				job();
+				l.lock();
+				m_storage_job_running = false;
+				if (!m_storage_jobs.empty()) m_job_cond.notify_all();
+			}
+			else
+			{
+				take_read_batch(batch);
+				l.unlock();
+				perform_reads(batch);
+				l.lock();
+			}
+		}
+
+		// returns true if the thread should exit
+		bool wait_for_job(aux::disk_io_thread_pool& threads
+			, std::unique_lock<std::mutex>& l)
+		{
+			TORRENT_ASSERT(l.owns_lock());
+			if (has_jobs()) return false;
+
+			threads.thread_idle();
+			do
+			{
+				// when we're terminating the last thread, make sure we
+				// finish up all queued jobs first
+				if (threads.should_exit()
+					&& (!has_jobs() || threads.num_threads() > 1)
+					// try_thread_exit must be the last condition
+					&& threads.try_thread_exit(std::this_thread::get_id()))
+				{
+					threads.thread_active();
+					return true;
+				}
+
+				m_job_cond.wait(l);
+			} while (!has_jobs());
+			threads.thread_active();
+			return false;
+		}
+
+		// pops the first queued read job, along with any queued jobs reading
+		// the range following it, in the same piece. The caller must hold
+		// m_job_mutex
+		void take_read_batch(std::vector<read_job>& batch)
+		{
+			TORRENT_ASSERT(!m_read_jobs.empty());
+			TORRENT_ASSERT(batch.empty());
+			batch.push_back(std::move(m_read_jobs.front()));
+			m_read_jobs.pop_front();
+
+			torrent_storage const* const st = batch.front().storage.get();
+			piece_index_t const piece = batch.front().r.piece;
+			for (;;)
+			{
+				int const end = batch.back().r.start + batch.back().r.length;
+				auto const i = std::find_if(m_read_jobs.begin(), m_read_jobs.end()
+					, [&](read_job const& j)
+					{
+						return j.storage.get() == st
+							&& j.r.piece == piece
+							&& j.r.start == end;
+					});
+				if (i == m_read_jobs.end()) break;
+				batch.push_back(std::move(*i));
+				m_read_jobs.erase(i);
+			}
+		}
+
+		// performs the batch of adjacent reads with a single readv() call.
+		// If the batch starts and ends at block boundaries, the blocks
+		// following it, up to the end of the cache line (capped by the piece
+		// boundary), are read along with it and kept in the torrent's
+		// read-ahead cache
+		void perform_reads(std::vector<read_job>& batch)
+		{
+			TORRENT_ASSERT(!batch.empty());
+			read_job const& first = batch.front();
+			torrent_storage& st = *first.storage;
+			piece_index_t const piece = first.r.piece;
+			int const start = first.r.start;
+			int const end = batch.back().r.start + batch.back().r.length;
+
+			std::vector<disk_buffer_holder> buffers;
+			std::vector<iovec_t> iov;
+			buffers.reserve(batch.size());
+			for (auto const& j : batch)
+			{
+				buffers.emplace_back(*this, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
+				if (!buffers.back()) break;
+				iov.emplace_back(buffers.back().data(), j.r.length);
+			}
+
+			storage_error error;
+			if (buffers.back())
+			{
+				time_point const start_time = clock_type::now();
+
+				shared_lock l(st.mutex);
+				piece_lock pl(st, piece, false);
+
+				std::vector<read_ahead_block> ahead;
+				int const line_end = std::min(st.storage.files().piece_size(piece)
+					, start + first.cache_line * default_block_size);
+				if (start % default_block_size == 0 && end % default_block_size == 0)
+				{
+					for (int offset = end; offset < line_end; offset += default_block_size)
+					{
+						char* const buf = m_buffer_pool.allocate_buffer("read cache");
+						if (buf == nullptr) break;
+						int const len = std::min(default_block_size, line_end - offset);
+						ahead.push_back({piece, offset, len, buf});
+						iov.emplace_back(buf, len);
+					}
+				}
+
+				st.storage.readv(m_settings, iov, piece, start, error);
+
+				if (error && !ahead.empty())
+				{
+					// the read-ahead may fail where the requested range
+					// doesn't, e.g. by extending past the end of a file that's
+					// too short. Try again without it
+					for (auto const& b : ahead) m_buffer_pool.free_buffer(b.buffer);
+					ahead.clear();
+					error = storage_error{};
+					st.storage.readv(m_settings, span<iovec_t const>(iov).first(int(batch.size()))
+						, piece, start, error);
+				}
+
+				if (!error.ec)
+				{
+					std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+					int const blocks = int(batch.size() + ahead.size());
+
+					m_stats_counters.add_stats_counter(counters::num_read_back, blocks);
+					m_stats_counters.add_stats_counter(counters::num_blocks_read, blocks);
+					m_stats_counters.add_stats_counter(counters::num_read_ops);
+					m_stats_counters.add_stats_counter(counters::disk_read_time, read_time);
+					m_stats_counters.add_stats_counter(counters::disk_job_time, read_time);
+					m_stats_counters.add_stats_counter(counters::disk_read_ahead_blocks
+						, std::int64_t(ahead.size()));
+
+					// insert while still holding the piece lock, so a write
+					// can't invalidate the blocks before they're inserted
+					st.insert(m_buffer_pool, ahead, std::max(1, first.cache_line) * 4);
+				}
+				else
+				{
+					for (auto const& b : ahead) m_buffer_pool.free_buffer(b.buffer);
+				}
+			}
+			else
+			{
+				error.ec = errors::no_memory;
+				error.operation = operation_t::alloc_cache_piece;
+				buffers.clear();
+			}
+
+			// post all completions at once, to have them called in a single
+			// batch
+			std::lock_guard<std::mutex> l(m_completion_mutex);
+			for (std::size_t i = 0; i < batch.size(); ++i)
+			{
+				disk_buffer_holder b = i < buffers.size()
+					? std::move(buffers[i]) : disk_buffer_holder{};
+				queue_completion([h = std::move(batch[i].handler), b = std::move(b), error] () mutable
+					{ h(std::move(b), error); });
+			}
+			batch.clear();
+		}
+
+		// the handlers of completed jobs are queued, and called by a single
+		// message posted to the io_context, rather than one each. This
+		// coalesces the completions of all jobs issued by the network thread
+		// before it gets back to the io_context (typically the reads for all
+		// requests received from a peer)
+		template <typename Handler>
+		void post_completion(Handler h)
+		{
+			std::lock_guard<std::mutex> l(m_completion_mutex);
+			queue_completion(std::move(h));
+		}
+
+		// the caller must hold m_completion_mutex
+		template <typename Handler>
+		void queue_completion(Handler h)
+		{
+			m_completed_jobs.emplace_back<completion<Handler>>(std::move(h));
+			if (m_job_completions_in_flight) return;
+			m_job_completions_in_flight = true;
+			post(m_ios, [this, t = clock_type::now()] { call_job_handlers(t); });
+		}
+
+		void call_job_handlers(time_point const posted)
+		{
+			{
+				std::lock_guard<std::mutex> l(m_completion_mutex);
+				TORRENT_ASSERT(m_job_completions_in_flight);
+				m_job_completions_in_flight = false;
+
+				// handlers may issue new jobs, their completions go in the
+				// next batch
+				TORRENT_ASSERT(m_calling_jobs.empty());
+				m_calling_jobs.swap(m_completed_jobs);
+			}
+			m_calling_jobs.get_pointers(m_handlers);
+
+			aux::record_completion_batch(m_stats_counters, int(m_handlers.size())
+				, clock_type::now() - posted);
+			for (auto* h : m_handlers) h->call();
+			m_calling_jobs.clear();
+		}
+
+		aux::vector<std::shared_ptr<torrent_storage>, storage_index_t> m_torrents;
 
 		// slots that are unused in the m_torrents vector
 		std::vector<storage_index_t> m_free_slots;
@@ -409,6 +984,50 @@ namespace {
 
 		// callbacks are posted on this
 		io_context& m_ios;
+
+		struct completion_handler
+		{
+			virtual void call() = 0;
+			virtual ~completion_handler() = default;
+		};
+
+		template <typename Handler>
+		struct completion final : completion_handler
+		{
+			explicit completion(Handler h) : m_handler(std::move(h)) {}
+			void call() override { m_handler(); }
+			Handler m_handler;
+		};
+
+		// handlers of completed jobs, waiting for the message posted to
+		// m_ios to call them. They are stored back-to-back, without an
+		// allocation per handler. m_calling_jobs holds the batch whose
+		// handlers are being called, the two queues are swapped for every
+		// batch to reuse their storage
+		heterogeneous_queue<completion_handler> m_completed_jobs;
+		heterogeneous_queue<completion_handler> m_calling_jobs;
+		std::vector<completion_handler*> m_handlers;
+
+		// true while there's a call_job_handlers message in flight
+		bool m_job_completions_in_flight = false;
+
+		// protects m_completed_jobs and m_job_completions_in_flight, which
+		// are also used by the read threads
+		std::mutex m_completion_mutex;
+
+		// read jobs and storage jobs, waiting for submit_jobs() or a read
+		// thread to perform them. Storage jobs are performed first, one at a
+		// time, in the order they were issued
+		std::mutex m_job_mutex;
+		std::condition_variable m_job_cond;
+		std::deque<read_job> m_read_jobs;
+		std::deque<std::function<void()>> m_storage_jobs;
+		bool m_storage_job_running = false;
+
+		// the read threads (settings_pack::aio_threads). This is the last
+		// member, to have the threads stopped before anything they use is
+		// destructed
+		aux::disk_io_thread_pool m_threads;
 	};
 
 	TORRENT_EXPORT std::unique_ptr<disk_interface> posix_disk_io_constructor(
@@ -181,6 +181,7 @@ namespace aux {
 	{
 		TORRENT_ASSERT(offset >= 0);
 		TORRENT_ASSERT(int(bufs.size()) + offset <= m_piece_size);
+		std::unique_lock<std::mutex> l(m_mutex);
 
 		auto f = open_file(open_mode::read_write, ec);
 		if (ec) return -1;
@@ -189,6 +190,8 @@ namespace aux {
 		slot_index_t const slot = (i == m_piece_map.end())
 			? allocate_slot(piece) : i->second;
 
+		l.unlock();
+
 		if (portable_fseeko(f.file(), slot_offset(slot) + offset, SEEK_SET) != 0)
 		{
 			ec.assign(errno, generic_category());
@@ -214,6 +217,7 @@ namespace aux {
 	{
 		TORRENT_ASSERT(offset >= 0);
 		TORRENT_ASSERT(int(bufs.size()) + offset <= m_piece_size);
+		std::unique_lock<std::mutex> l(m_mutex);
 
 		auto const i = m_piece_map.find(piece);
 		if (i == m_piece_map.end())
@@ -223,6 +227,7 @@ namespace aux {
 		}
 
 		slot_index_t const slot = i->second;
+		l.unlock();
 
 		auto f = open_file(open_mode::read_only, ec);
 		if (ec) return -1;
@@ -271,6 +276,7 @@ namespace aux {
 		TORRENT_ASSERT(offset >= 0);
 		TORRENT_ASSERT(len >= 0);
 		TORRENT_ASSERT(int(len) + offset <= m_piece_size);
+		std::unique_lock<std::mutex> l(m_mutex);
 
 		auto const i = m_piece_map.find(piece);
 		if (i == m_piece_map.end())
@@ -281,6 +287,8 @@ namespace aux {
 		}
 
 		slot_index_t const slot = i->second;
+		l.unlock();
+
 		auto f = open_file(open_mode::read_only, ec);
 		if (ec) return -1;
 
@@ -340,6 +348,8 @@ namespace aux {
 
 	void posix_part_file::free_piece(piece_index_t const piece)
 	{
+		std::lock_guard<std::mutex> l(m_mutex);
+
 		auto const i = m_piece_map.find(piece);
 		if (i == m_piece_map.end()) return;
 
@@ -355,6 +365,8 @@ namespace aux {
 
 	void posix_part_file::move_partfile(std::string const& path, error_code& ec)
 	{
+		std::lock_guard<std::mutex> l(m_mutex);
+
 		flush_metadata_impl(ec);
 		if (ec) return;
 
@@ -380,6 +392,8 @@ namespace aux {
 	void posix_part_file::export_file(std::function<void(std::int64_t, span<char>)> f
 		, std::int64_t const offset, std::int64_t size, error_code& ec)
 	{
+		std::unique_lock<std::mutex> l(m_mutex);
+
 		// there's nothing stored in the posix_part_file. Nothing to do
 		if (m_piece_map.empty()) return;
 
@@ -426,6 +440,8 @@ namespace aux {
 
 	void posix_part_file::flush_metadata(error_code& ec)
 	{
+		std::lock_guard<std::mutex> l(m_mutex);
+
 		flush_metadata_impl(ec);
 	}
 
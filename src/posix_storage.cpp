@@ -307,6 +307,18 @@ namespace aux {
 		});
 	}
 
+	std::string posix_storage::file_path(file_index_t const idx) const
+	{
+		return files().file_path(idx, m_save_path);
+	}
+
+	bool posix_storage::in_part_file(file_index_t const idx) const
+	{
+		return idx < m_file_priority.end_index()
+			&& m_file_priority[idx] == dont_download
+			&& use_partfile(idx);
+	}
+
 	bool posix_storage::has_any_file(storage_error& error)
 	{
 		m_stat_cache.reserve(files().num_files());
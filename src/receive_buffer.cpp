@@ -152,6 +152,14 @@ span<char const> receive_buffer::get() const
 	return span<char const>(m_recv_buffer).subspan(m_recv_start, m_recv_pos);
 }
 
+span<char const> receive_buffer::unparsed() const
+{
+	if (m_recv_buffer.empty()) return {};
+	TORRENT_ASSERT(m_recv_start + m_recv_pos <= m_recv_end);
+	return span<char const>(m_recv_buffer).subspan(m_recv_start + m_recv_pos
+		, m_recv_end - m_recv_start - m_recv_pos);
+}
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 span<char> receive_buffer::mutable_buffer()
 {
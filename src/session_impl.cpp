@@ -519,6 +519,7 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 			, alert_category_t{static_cast<unsigned int>(m_settings.get_int(settings_pack::alert_mask))})
 		, m_disk_thread((disk_io_constructor ? disk_io_constructor : default_disk_io_constructor)
 			(m_io_context, m_settings, m_stats_counters))
+		, m_inflate_pool(m_io_context, m_settings, m_stats_counters)
 		, m_download_rate(peer_connection::download_channel)
 		, m_upload_rate(peer_connection::upload_channel)
 		, m_host_resolver(m_io_context)
@@ -1165,6 +1166,7 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		// has an internal counter and won't release the network
 		// thread until they're all dead (via m_work).
 		m_disk_thread->abort(false);
+		m_inflate_pool.abort(false);
 
 		// now it's OK for the network thread to exit
 		m_work.reset();
@@ -2525,7 +2527,7 @@ namespace {
 			return;
 		}
 
-		m_stats_counters.inc_stats_counter(counters::on_udp_counter);
+		m_stats_counters.add_stats_counter(counters::on_udp_counter);
 
 		std::shared_ptr<session_udp_socket> s = socket.lock();
 		if (!s) return;
@@ -2656,7 +2658,7 @@ namespace {
 		TORRENT_ASSERT(!m_abort);
 
 		std::weak_ptr<tcp::acceptor> ls(listener);
-		m_stats_counters.inc_stats_counter(counters::num_outstanding_accept);
+		m_stats_counters.add_stats_counter(counters::num_outstanding_accept);
 		ADD_OUTSTANDING_ASYNC("session_impl::on_accept_connection");
 		listener->async_accept([this, ls, ssl] (error_code const& ec, true_tcp_socket s)
 			{ return wrap(&session_impl::on_accept_connection, std::move(s), ec, ls, ssl); });
@@ -2678,8 +2680,8 @@ namespace {
 		, std::weak_ptr<tcp::acceptor> listen_socket, transport const ssl)
 	{
 		COMPLETE_ASYNC("session_impl::on_accept_connection");
-		m_stats_counters.inc_stats_counter(counters::on_accept_counter);
-		m_stats_counters.inc_stats_counter(counters::num_outstanding_accept, -1);
+		m_stats_counters.add_stats_counter(counters::on_accept_counter);
+		m_stats_counters.add_stats_counter(counters::num_outstanding_accept, -1);
 
 		TORRENT_ASSERT(is_single_thread());
 		std::shared_ptr<tcp::acceptor> listener = listen_socket.lock();
@@ -3097,7 +3099,7 @@ namespace {
 			}
 		}
 
-		m_stats_counters.inc_stats_counter(counters::incoming_connections);
+		m_stats_counters.add_stats_counter(counters::incoming_connections);
 
 		if (m_alerts.should_post<incoming_connection_alert>())
 			m_alerts.emplace_alert<incoming_connection_alert>(socket_type_idx(s), endp);
@@ -3256,9 +3258,9 @@ namespace {
 	{
 		TORRENT_ASSERT(bytes_payload >= 0);
 		TORRENT_ASSERT(bytes_protocol >= 0);
-		m_stats_counters.inc_stats_counter(counters::sent_bytes
+		m_stats_counters.add_stats_counter(counters::sent_bytes
 			, bytes_payload + bytes_protocol);
-		m_stats_counters.inc_stats_counter(counters::sent_payload_bytes
+		m_stats_counters.add_stats_counter(counters::sent_payload_bytes
 			, bytes_payload);
 
 		m_stat.sent_bytes(bytes_payload, bytes_protocol);
@@ -3268,9 +3270,9 @@ namespace {
 	{
 		TORRENT_ASSERT(bytes_payload >= 0);
 		TORRENT_ASSERT(bytes_protocol >= 0);
-		m_stats_counters.inc_stats_counter(counters::recv_bytes
+		m_stats_counters.add_stats_counter(counters::recv_bytes
 			, bytes_payload + bytes_protocol);
-		m_stats_counters.inc_stats_counter(counters::recv_payload_bytes
+		m_stats_counters.add_stats_counter(counters::recv_payload_bytes
 			, bytes_payload);
 
 		m_stat.received_bytes(bytes_payload, bytes_protocol);
@@ -3287,9 +3289,9 @@ namespace {
 		int const mtu = 1500;
 		int const packet_size = mtu - header;
 		int const overhead = std::max(1, (bytes + packet_size - 1) / packet_size) * header;
-		m_stats_counters.inc_stats_counter(counters::sent_ip_overhead_bytes
+		m_stats_counters.add_stats_counter(counters::sent_ip_overhead_bytes
 			, overhead);
-		m_stats_counters.inc_stats_counter(counters::recv_ip_overhead_bytes
+		m_stats_counters.add_stats_counter(counters::recv_ip_overhead_bytes
 			, overhead);
 
 		m_stat.trancieve_ip_packet(bytes, ipv6);
@@ -3298,7 +3300,7 @@ namespace {
 	void session_impl::sent_syn(bool ipv6)
 	{
 		int const overhead = ipv6 ? 60 : 40;
-		m_stats_counters.inc_stats_counter(counters::sent_ip_overhead_bytes
+		m_stats_counters.add_stats_counter(counters::sent_ip_overhead_bytes
 			, overhead);
 
 		m_stat.sent_syn(ipv6);
@@ -3307,9 +3309,9 @@ namespace {
 	void session_impl::received_synack(bool ipv6)
 	{
 		int const overhead = ipv6 ? 60 : 40;
-		m_stats_counters.inc_stats_counter(counters::sent_ip_overhead_bytes
+		m_stats_counters.add_stats_counter(counters::sent_ip_overhead_bytes
 			, overhead);
-		m_stats_counters.inc_stats_counter(counters::recv_ip_overhead_bytes
+		m_stats_counters.add_stats_counter(counters::recv_ip_overhead_bytes
 			, overhead);
 
 		m_stat.received_synack(ipv6);
@@ -3318,7 +3320,7 @@ namespace {
 	void session_impl::on_tick(error_code const& e)
 	{
 		COMPLETE_ASYNC("session_impl::on_tick");
-		m_stats_counters.inc_stats_counter(counters::on_tick_counter);
+		m_stats_counters.add_stats_counter(counters::on_tick_counter);
 
 		TORRENT_ASSERT(is_single_thread());
 
@@ -3526,6 +3528,13 @@ namespace {
 				p->disconnect(errors::timed_out, operation_t::bittorrent);
 		}
 
+		// --------------------------------------------------------------
+		// expire torrent deadlines
+		// --------------------------------------------------------------
+		m_torrent_timers.advance(total_seconds(now.time_since_epoch()));
+		while (timer_entry* e = m_torrent_timers.pop_expired())
+			e->on_timer();
+
 		// --------------------------------------------------------------
 		// second_tick every torrent (that wants it)
 		// --------------------------------------------------------------
@@ -3657,15 +3666,19 @@ namespace {
 				int const limit = std::min(m_settings.get_int(settings_pack::connections_limit)
 					, std::numeric_limits<int>::max() / 100);
 				int const cutoff = std::min(m_settings.get_int(settings_pack::peer_turnover_cutoff), 100);
-				if (num_connections() >= limit * cutoff / 100 && !m_torrents.empty())
+				// only torrents with peers have any to disconnect, and every
+				// torrent with peers wants to be ticked. Idle torrents are
+				// not considered
+				aux::vector<torrent*>& want_tick = m_torrent_lists[torrent_want_tick];
+				if (num_connections() >= limit * cutoff / 100 && !want_tick.empty())
 				{
 					// every 90 seconds, disconnect the worst peers
 					// if we have reached the connection limit
-					auto const i = std::max_element(m_torrents.begin(), m_torrents.end()
-						, [] (std::shared_ptr<torrent> const& lhs, std::shared_ptr<torrent> const& rhs)
+					auto const i = std::max_element(want_tick.begin(), want_tick.end()
+						, [] (torrent const* lhs, torrent const* rhs)
 						{ return lhs->num_peers() < rhs->num_peers(); });
 
-					TORRENT_ASSERT(i != m_torrents.end());
+					TORRENT_ASSERT(i != want_tick.end());
 					int const peers_to_disconnect = std::min(std::max(
 						(*i)->num_peers() * m_settings.get_int(settings_pack::peer_turnover) / 100, 1)
 						, (*i)->num_connect_candidates());
@@ -3676,19 +3689,27 @@ namespace {
 				{
 					// if we haven't reached the global max. see if any torrent
 					// has reached its local limit
-					for (auto const& t : m_torrents)
+					for (int i = 0; i < int(want_tick.size()); ++i)
 					{
+						torrent& t = *want_tick[i];
+
 						// ths disconnect logic is disabled for torrents with
 						// too low connection limit
-						int const max = std::min(t->max_connections()
+						int const max = std::min(t.max_connections()
 							, std::numeric_limits<int>::max() / 100);
-						if (t->num_peers() < max * cutoff / 100 || max < 6)
+						if (t.num_peers() < max * cutoff / 100 || max < 6)
 							continue;
 
-						int const peers_to_disconnect = std::min(std::max(t->num_peers()
+						int const peers_to_disconnect = std::min(std::max(t.num_peers()
 							* m_settings.get_int(settings_pack::peer_turnover) / 100, 1)
-							, t->num_connect_candidates());
-						t->disconnect_peers(peers_to_disconnect, errors::optimistic_disconnect);
+							, t.num_connect_candidates());
+						t.disconnect_peers(peers_to_disconnect, errors::optimistic_disconnect);
+
+						// if disconnecting peers caused the torrent to no longer
+						// want to be ticked, it was removed from the list and we
+						// need to back up the counter to not miss the torrent
+						// after it
+						if (i >= int(want_tick.size()) || want_tick[i] != &t) --i;
 					}
 				}
 			}
@@ -3698,13 +3719,13 @@ namespace {
 	void session_impl::received_buffer(int s)
 	{
 		int index = std::min(aux::log2p1(std::uint32_t(s >> 3)), 17);
-		m_stats_counters.inc_stats_counter(counters::socket_recv_size3 + index);
+		m_stats_counters.add_stats_counter(counters::socket_recv_size3 + index);
 	}
 
 	void session_impl::sent_buffer(int s)
 	{
 		int index = std::min(aux::log2p1(std::uint32_t(s >> 3)), 17);
-		m_stats_counters.inc_stats_counter(counters::socket_send_size3 + index);
+		m_stats_counters.add_stats_counter(counters::socket_send_size3 + index);
 	}
 
 	void session_impl::prioritize_connections(std::weak_ptr<torrent> t)
@@ -3831,7 +3852,7 @@ namespace {
 	void session_impl::on_lsd_announce(error_code const& e)
 	{
 		COMPLETE_ASYNC("session_impl::on_lsd_announce");
-		m_stats_counters.inc_stats_counter(counters::on_lsd_counter);
+		m_stats_counters.add_stats_counter(counters::on_lsd_counter);
 		TORRENT_ASSERT(is_single_thread());
 		if (e) return;
 
@@ -3855,6 +3876,37 @@ namespace {
 			m_next_lsd_torrent = 0;
 	}
 
+	namespace {
+
+	// orders the auto-managed torrents in ``list`` by ascending ``key``, as
+	// far as the auto manager looks at the order. Only the first n torrents
+	// may be started, the rest will be paused regardless of their order. So
+	// the first n are selected in linear time, and only sorted among
+	// themselves. Keys are computed once per torrent rather than once per
+	// comparison, since some (like seed_rank()) are not cheap
+	template <typename Key>
+	void order_auto_managed(std::vector<torrent*>& list, int const n, Key key)
+	{
+		if (list.empty() || n <= 0) return;
+
+		using entry = std::pair<decltype(key(list.front())), torrent*>;
+		std::vector<entry> ranked;
+		ranked.reserve(list.size());
+		for (torrent* t : list) ranked.emplace_back(key(t), t);
+
+		auto const cmp = [](entry const& lhs, entry const& rhs)
+		{ return lhs.first < rhs.first; };
+		auto const mid = ranked.begin() + std::min(n, int(ranked.size()));
+		if (mid != ranked.end())
+			std::nth_element(ranked.begin(), mid, ranked.end(), cmp);
+		std::sort(ranked.begin(), mid, cmp);
+
+		std::transform(ranked.begin(), ranked.end(), list.begin()
+			, [](entry const& e) { return e.second; });
+	}
+
+	} // anonymous namespace
+
 	void session_impl::auto_manage_checking_torrents(std::vector<torrent*>& list
 		, int& limit)
 	{
@@ -3917,6 +3969,12 @@ namespace {
 				continue;
 			}
 
+			// most torrents past the active ones were paused by a previous pass
+			// already, and have nothing left to change
+			if (t->is_torrent_paused() && !t->graceful_pause()
+				&& !t->announces_anywhere())
+				continue;
+
 #ifndef TORRENT_DISABLE_LOGGING
 			if (!t->is_torrent_paused())
 				t->log_to_all_peers("auto manager pausing torrent");
@@ -3937,6 +3995,39 @@ namespace {
 		return v;
 	}
 
+	// fills in the auto-managed checking and downloading torrents, in queue
+	// order. The download queue is kept in queue order as torrents are added,
+	// removed and moved, so this is a walk over it, rather than a sort of the
+	// lists. Torrents without a queue position go first, as they would when
+	// sorted by it
+	void session_impl::queued_auto_managed_torrents(std::vector<torrent*>& checking
+		, std::vector<torrent*>& downloaders) const
+	{
+		auto const& checking_list = m_torrent_lists[torrent_checking_auto_managed];
+		auto const& downloading_list = m_torrent_lists[torrent_downloading_auto_managed];
+		checking.reserve(checking_list.size());
+		downloaders.reserve(downloading_list.size());
+
+		for (torrent* t : checking_list)
+			if (t->queue_position() == no_pos) checking.push_back(t);
+		for (torrent* t : downloading_list)
+			if (t->queue_position() == no_pos) downloaders.push_back(t);
+
+		if (checking.size() == checking_list.size()
+			&& downloaders.size() == downloading_list.size())
+			return;
+
+		for (torrent* t : m_download_queue)
+		{
+			if (t->m_links[torrent_checking_auto_managed].in_list())
+				checking.push_back(t);
+			if (t->m_links[torrent_downloading_auto_managed].in_list())
+				downloaders.push_back(t);
+		}
+		TORRENT_ASSERT(checking.size() == checking_list.size());
+		TORRENT_ASSERT(downloaders.size() == downloading_list.size());
+	}
+
 	void session_impl::recalculate_auto_managed_torrents()
 	{
 		INVARIANT_CHECK;
@@ -3946,12 +4037,12 @@ namespace {
 
 		if (m_paused) return;
 
-		// make copies of the lists of torrents that we want to consider for auto
-		// management. We need copies because they will be sorted.
-		std::vector<torrent*> checking
-			= torrent_list(session_interface::torrent_checking_auto_managed);
-		std::vector<torrent*> downloaders
-			= torrent_list(session_interface::torrent_downloading_auto_managed);
+		// the checking and downloading torrents are picked out of the download
+		// queue, already in order. The seeds are copied, since they will be
+		// sorted
+		std::vector<torrent*> checking;
+		std::vector<torrent*> downloaders;
+		queued_auto_managed_torrents(checking, downloaders);
 		std::vector<torrent*> seeds
 			= torrent_list(session_interface::torrent_seeding_auto_managed);
 
@@ -3966,27 +4057,15 @@ namespace {
 		int hard_limit = get_int_setting(settings_pack::active_limit);
 
 		// if hard_limit is <= 0, all torrents in these lists should be paused.
-		// The order is not relevant
+		// The order is not relevant. Otherwise, only the first n seeds need to
+		// be in order, where n is the number of torrents we allow to be
+		// active. The rest of the list is still used to make sure the
+		// remaining torrents are paused, but their order is not relevant
 		if (hard_limit > 0)
 		{
-			// we only need to sort the first n torrents here, where n is the number
-			// of checking torrents we allow. The rest of the list is still used to
-			// make sure the remaining torrents are paused, but their order is not
-			// relevant
-			std::partial_sort(checking.begin(), checking.begin() +
-				std::min(checking_limit, int(checking.size())), checking.end()
-				, [](torrent const* lhs, torrent const* rhs)
-				{ return lhs->sequence_number() < rhs->sequence_number(); });
-
-			std::partial_sort(downloaders.begin(), downloaders.begin() +
-				std::min(hard_limit, int(downloaders.size())), downloaders.end()
-				, [](torrent const* lhs, torrent const* rhs)
-				{ return lhs->sequence_number() < rhs->sequence_number(); });
-
-			std::partial_sort(seeds.begin(), seeds.begin() +
-				std::min(hard_limit, int(seeds.size())), seeds.end()
-				, [this](torrent const* lhs, torrent const* rhs)
-				{ return lhs->seed_rank(m_settings) > rhs->seed_rank(m_settings); });
+			// higher seed rank goes first
+			order_auto_managed(seeds, hard_limit
+				, [this](torrent const* t) { return -t->seed_rank(m_settings); });
 		}
 
 		auto_manage_checking_torrents(checking, checking_limit);
@@ -4186,7 +4265,7 @@ namespace {
 				if (ret)
 				{
 					pi->optimistically_unchoked = true;
-					m_stats_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic);
+					m_stats_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic);
 					pi->last_optimistically_unchoked = std::uint16_t(session_time());
 #ifndef TORRENT_DISABLE_LOGGING
 					p->peer_log(peer_log_alert::info, "OPTIMISTIC UNCHOKE"
@@ -4203,7 +4282,7 @@ namespace {
 			auto* const p = static_cast<peer_connection*>(pi->connection);
 			std::shared_ptr<torrent> t = p->associated_torrent().lock();
 			pi->optimistically_unchoked = false;
-			m_stats_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
+			m_stats_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
 			t->choke_peer(*p);
 		}
 
@@ -4327,7 +4406,7 @@ namespace {
 			{
 				--max_connections;
 				steps_since_last_connect = 0;
-				m_stats_counters.inc_stats_counter(counters::connection_attempts);
+				m_stats_counters.add_stats_counter(counters::connection_attempts);
 			}
 
 			++steps_since_last_connect;
@@ -4393,7 +4472,7 @@ namespace {
 				}
 				if (pi && pi->optimistically_unchoked)
 				{
-					m_stats_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
+					m_stats_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
 					pi->optimistically_unchoked = false;
 					// force a new optimistic unchoke
 					m_optimistic_unchoke_time_scaler = 0;
@@ -4473,7 +4552,7 @@ namespace {
 					// proper unchoke set
 					m_optimistic_unchoke_time_scaler = 0;
 					p->peer_info_struct()->optimistically_unchoked = false;
-					m_stats_counters.inc_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
+					m_stats_counters.add_stats_counter(counters::num_peers_up_unchoked_optimistic, -1);
 				}
 			}
 			else
@@ -4721,33 +4800,76 @@ namespace {
 		m_posting_torrent_updates = true;
 #endif
 
+		// only the first torrents are included, if there's a limit on the
+		// number of torrents in an update. The others are moved to the front
+		// of the list, to be included in the next update, ahead of the
+		// torrents updated after them
+		int const limit = m_settings.get_int(settings_pack::state_update_batch_size);
+		int const num_updates = limit > 0
+			? std::min(limit, int(state_updates.size()))
+			: int(state_updates.size());
+		auto const end = state_updates.begin() + num_updates;
+
+		bool const compact = m_settings.get_bool(settings_pack::compact_state_updates);
 		std::vector<torrent_status> status;
-		status.reserve(state_updates.size());
-
-		// TODO: it might be a nice feature here to limit the number of torrents
-		// to send in a single update. By just posting the first n torrents, they
-		// would nicely be round-robined because the torrent lists are always
-		// pushed back. Perhaps the status_update_alert could even have a fixed
-		// array of n entries rather than a vector, to further improve memory
-		// locality.
-		for (auto& t : state_updates)
-		{
-			TORRENT_ASSERT(t->m_links[aux::session_impl::torrent_state_updates].in_list());
-			status.emplace_back();
-			// querying accurate download counters may require
-			// the torrent to be loaded. Loading a torrent, and evicting another
-			// one will lead to calling state_updated(), which screws with
-			// this list while we're working on it, and break things
-			t->status(&status.back(), flags);
-			t->clear_in_state_update();
-		}
-		state_updates.clear();
+		if (compact)
+		{
+			m_deltas.clear();
+			m_delta_strings.clear();
+			m_delta_torrents.clear();
+			for (auto i = state_updates.begin(); i != end; ++i)
+			{
+				torrent* t = *i;
+				TORRENT_ASSERT(t->m_links[aux::session_impl::torrent_state_updates].in_list());
+				m_deltas.emplace_back();
+				if (t->status_delta(m_delta_status, flags, m_deltas.back(), m_delta_strings))
+					m_delta_torrents.push_back(t);
+				else
+					m_deltas.pop_back();
+				t->clear_in_state_update();
+			}
+		}
+		else
+		{
+			status.reserve(std::size_t(num_updates));
+			for (auto i = state_updates.begin(); i != end; ++i)
+			{
+				torrent* t = *i;
+				TORRENT_ASSERT(t->m_links[aux::session_impl::torrent_state_updates].in_list());
+				status.emplace_back();
+				// querying accurate download counters may require
+				// the torrent to be loaded. Loading a torrent, and evicting another
+				// one will lead to calling state_updated(), which screws with
+				// this list while we're working on it, and break things
+				t->status(&status.back(), flags);
+				t->clear_in_state_update();
+			}
+		}
+
+		state_updates.erase(state_updates.begin(), end);
+		for (int i = 0; i < int(state_updates.size()); ++i)
+			state_updates[i]->m_links[aux::session_impl::torrent_state_updates].index = i;
 
 #if TORRENT_USE_ASSERTS
 		m_posting_torrent_updates = false;
 #endif
 
-		m_alerts.emplace_alert<state_update_alert>(std::move(status));
+		if (compact)
+		{
+			// status_delta() has already recorded these records as reported.
+			// If the alert was dropped, the client never sees them, so these
+			// torrents are included in the next update, in full
+			if (!m_alerts.emplace_alert<state_delta_alert>(m_deltas, m_delta_strings))
+			{
+				for (torrent* t : m_delta_torrents)
+				{
+					t->reset_status_delta();
+					t->state_updated();
+				}
+			}
+		}
+		else
+			m_alerts.emplace_alert<state_update_alert>(std::move(status));
 	}
 
 	void session_impl::post_session_stats()
@@ -5559,7 +5681,7 @@ namespace {
 
 	void session_impl::on_lsd_peer(tcp::endpoint const& peer, sha1_hash const& ih)
 	{
-		m_stats_counters.inc_stats_counter(counters::on_lsd_peer_counter);
+		m_stats_counters.add_stats_counter(counters::on_lsd_peer_counter);
 		TORRENT_ASSERT(is_single_thread());
 
 		INVARIANT_CHECK;
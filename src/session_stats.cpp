@@ -568,6 +568,63 @@ namespace {
 		// this measure the number of tracker announces currently in the
 		// queue
 		METRIC(tracker, num_queued_tracker_announces)
+
+		// ``queued_inflate_jobs`` is the number of pieces downloaded from zip
+		// web seeds waiting for an inflate thread. ``inflate_time`` is the
+		// cumulative time spent inflating them, in microseconds
+		METRIC(zip, queued_inflate_jobs)
+		METRIC(zip, inflate_time)
+
+		// the number of batches of completed disk jobs delivered to the
+		// network thread, by size. Each batch is delivered by a single
+		// message posted to the network thread. The batch size is less than
+		// 1 << n, where n is the number at the end of the counter name
+		// (except for the last one, which counts all larger batches too)
+		METRIC(disk, disk_completion_batch1)
+		METRIC(disk, disk_completion_batch2)
+		METRIC(disk, disk_completion_batch3)
+		METRIC(disk, disk_completion_batch4)
+		METRIC(disk, disk_completion_batch5)
+		METRIC(disk, disk_completion_batch6)
+		METRIC(disk, disk_completion_batch7)
+		METRIC(disk, disk_completion_batch8)
+
+		// the time it took for batches of completed disk jobs to be picked
+		// up by the network thread, once posted to it. The latency is less
+		// than 1 << n microseconds, where n is the number at the end of the
+		// counter name (except for the last one, which counts all longer
+		// latencies too)
+		METRIC(disk, disk_completion_latency4)
+		METRIC(disk, disk_completion_latency5)
+		METRIC(disk, disk_completion_latency6)
+		METRIC(disk, disk_completion_latency7)
+		METRIC(disk, disk_completion_latency8)
+		METRIC(disk, disk_completion_latency9)
+		METRIC(disk, disk_completion_latency10)
+		METRIC(disk, disk_completion_latency11)
+		METRIC(disk, disk_completion_latency12)
+		METRIC(disk, disk_completion_latency13)
+		METRIC(disk, disk_completion_latency14)
+		METRIC(disk, disk_completion_latency15)
+		METRIC(disk, disk_read_ahead_blocks)
+		METRIC(disk, disk_read_ahead_hits)
+		METRIC(disk, disk_job_cache_hits)
+		METRIC(disk, disk_job_cache_misses)
+		METRIC(net, send_zero_copy_bytes)
+		METRIC(net, send_copied_bytes)
+
+		// the number of madvise() hints issued for memory mapped files, by
+		// kind, and the number that failed
+		METRIC(disk, mmap_advise_sequential)
+		METRIC(disk, mmap_advise_will_need)
+		METRIC(disk, mmap_advise_huge_page)
+		METRIC(disk, mmap_advise_cold)
+		METRIC(disk, mmap_advise_failed)
+
+		// page faults taken by the disk threads while performing disk jobs,
+		// when using memory mapped files
+		METRIC(disk, disk_major_page_faults)
+		METRIC(disk, disk_minor_page_faults)
 		// ... more
 	}});
 #undef METRIC
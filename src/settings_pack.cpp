@@ -220,7 +220,9 @@ namespace libtorrent {
 		SET(ssrf_mitigation, true, nullptr),
 		SET(allow_idna, false, nullptr),
 		SET(enable_set_file_valid_data, false, nullptr),
-		SET(forbid_bt_connet, false, nullptr)
+		SET(forbid_bt_connet, false, nullptr),
+		SET(disk_buffer_huge_pages, false, nullptr),
+		SET(compact_state_updates, false, nullptr)
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -377,6 +379,9 @@ namespace libtorrent {
 		SET(dht_sample_infohashes_interval, 21600, nullptr),
 		SET(dht_max_infohashes_sample_count, 20, nullptr),
 		SET(max_piece_count, 0x200000, nullptr),
+		SET(inflate_threads, 1, nullptr),
+		SET(mmap_advice, settings_pack::advise_sequential_check | settings_pack::advise_prefetch_requests, nullptr),
+		SET(state_update_batch_size, 0, nullptr),
 	}});
 
 #undef SET
@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/aux_/timer_wheel.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm> // for max
+
+namespace libtorrent {
+namespace aux {
+
+	timer_entry::~timer_entry()
+	{
+		unlink();
+	}
+
+	void timer_entry::unlink()
+	{
+		if (m_pprev == nullptr) return;
+		*m_pprev = m_next;
+		if (m_next != nullptr) m_next->m_pprev = m_pprev;
+		m_next = nullptr;
+		m_pprev = nullptr;
+	}
+
+	timer_wheel::timer_wheel(std::int64_t const now)
+		: m_now(now)
+	{
+		for (auto& level : m_slots) level.fill(nullptr);
+	}
+
+	timer_wheel::~timer_wheel()
+	{
+		// entries that outlive the wheel must not point back into it
+		for (auto& level : m_slots)
+			for (auto& head : level)
+				while (head != nullptr) head->unlink();
+		while (m_expired != nullptr) m_expired->unlink();
+	}
+
+	void timer_wheel::push(timer_entry*& head, timer_entry& e)
+	{
+		TORRENT_ASSERT(e.m_pprev == nullptr);
+		e.m_next = head;
+		if (head != nullptr) head->m_pprev = &e.m_next;
+		e.m_pprev = &head;
+		head = &e;
+	}
+
+	void timer_wheel::schedule(timer_entry& e, std::int64_t const deadline)
+	{
+		e.unlink();
+		e.m_deadline = deadline;
+		insert(e);
+	}
+
+	void timer_wheel::cancel(timer_entry& e)
+	{
+		e.unlink();
+	}
+
+	void timer_wheel::insert(timer_entry& e)
+	{
+		// deadlines that have already passed expire on the next tick. Deadlines
+		// too far out for the wheel are parked in the last slot of the top
+		// level, to be re-inserted when it comes around
+		std::int64_t constexpr max_delta
+			= (std::int64_t(1) << (slot_bits * num_levels)) - 1;
+		std::int64_t const t = std::min(std::max(e.m_deadline, m_now + 1), m_now + max_delta);
+		std::int64_t const delta = t - m_now;
+
+		int level = 0;
+		while (level < num_levels - 1 && delta >= (std::int64_t(1) << (slot_bits * (level + 1))))
+			++level;
+
+		int const slot = int((t >> (slot_bits * level)) & (num_slots - 1));
+		push(m_slots[level][slot], e);
+	}
+
+	void timer_wheel::advance(std::int64_t const now)
+	{
+		if (now - m_now > (std::int64_t(1) << (slot_bits * num_levels)))
+		{
+			// we're jumping further than the wheel spans. Rather than turning
+			// it one tick at a time, take every entry out and re-insert it
+			timer_entry* all = nullptr;
+			for (auto& level : m_slots)
+			{
+				for (auto& head : level)
+				{
+					while (head != nullptr)
+					{
+						timer_entry* e = head;
+						e->unlink();
+						push(all, *e);
+					}
+				}
+			}
+			m_now = now;
+			while (all != nullptr)
+			{
+				timer_entry* e = all;
+				e->unlink();
+				if (e->m_deadline <= m_now) push(m_expired, *e);
+				else insert(*e);
+			}
+			return;
+		}
+
+		while (m_now < now)
+		{
+			++m_now;
+
+			// every slot boundary we cross in the higher levels is a slot that
+			// now is within range of the level below it. Cascade its entries
+			// down, starting at the top
+			int top = 1;
+			while (top < num_levels
+				&& (m_now & ((std::int64_t(1) << (slot_bits * top)) - 1)) == 0)
+				++top;
+
+			for (int level = top - 1; level > 0; --level)
+			{
+				timer_entry*& head = m_slots[level][int((m_now >> (slot_bits * level)) & (num_slots - 1))];
+				while (head != nullptr)
+				{
+					timer_entry* e = head;
+					e->unlink();
+					if (e->m_deadline <= m_now) push(m_expired, *e);
+					else insert(*e);
+				}
+			}
+
+			timer_entry*& head = m_slots[0][int(m_now & (num_slots - 1))];
+			while (head != nullptr)
+			{
+				timer_entry* e = head;
+				TORRENT_ASSERT(e->m_deadline <= m_now);
+				e->unlink();
+				push(m_expired, *e);
+			}
+		}
+	}
+
+	timer_entry* timer_wheel::pop_expired()
+	{
+		timer_entry* e = m_expired;
+		if (e == nullptr) return nullptr;
+		e->unlink();
+		return e;
+	}
+}
+}
@@ -190,7 +190,7 @@ bool is_downloading_state(int const st)
 		, m_total_uploaded(p.total_uploaded)
 		, m_total_downloaded(p.total_downloaded)
 		, m_tracker_timer(ses.get_context())
-		, m_inactivity_timer(ses.get_context())
+		, m_inactivity_timer(*this)
 		, m_trackerid(p.trackerid)
 		, m_save_path(complete(p.save_path))
 		, m_stats_counters(ses.stats_counters())
@@ -434,7 +434,7 @@ bool is_downloading_state(int const st)
 	}
 
 	void torrent::inc_stats_counter(int c, int value)
-	{ m_ses.stats_counters().inc_stats_counter(c, value); }
+	{ m_ses.stats_counters().add_stats_counter(c, value); }
 
 	int torrent::current_stats_state() const
 	{
@@ -1211,6 +1211,8 @@ bool is_downloading_state(int const st)
 		for (auto const p : m_connections)
 		{
 			TORRENT_INCREMENT(m_iterating_connections);
+			// their counts of wanted pieces may refer to a previous picker
+			p->invalidate_wanted_pieces();
 			if (p->is_disconnecting()) continue;
 			peer_has(p->get_bitfield(), p);
 		}
@@ -1317,7 +1319,7 @@ bool is_downloading_state(int const st)
 
 			p.length = std::min(piece_size - p.start, block_size());
 
-			m_stats_counters.inc_stats_counter(counters::queued_write_bytes, p.length);
+			m_stats_counters.add_stats_counter(counters::queued_write_bytes, p.length);
 			m_ses.disk_thread().async_write(m_storage, p, data + p.start, nullptr
 				, [self, p](storage_error const& error) { self->on_disk_write_complete(error, p); });
 
@@ -1345,7 +1347,7 @@ bool is_downloading_state(int const st)
 	{
 		TORRENT_ASSERT(is_single_thread());
 
-		m_stats_counters.inc_stats_counter(counters::queued_write_bytes, -p.length);
+		m_stats_counters.add_stats_counter(counters::queued_write_bytes, -p.length);
 
 //		std::fprintf(stderr, "torrent::on_disk_write_complete ret:%d piece:%d block:%d\n"
 //			, j->ret, j->piece, j->offset/0x4000);
@@ -4293,6 +4295,18 @@ namespace {
 		}
 
 		m_picker->piece_passed(index);
+
+		// the piece is no longer wanted. The peers that have it keep track of
+		// how many of their pieces we want, this is where they're told
+		if (m_picker->piece_priority(index) != dont_download)
+		{
+			for (auto p : m_connections)
+			{
+				TORRENT_INCREMENT(m_iterating_connections);
+				if (p->has_piece(index)) p->wanted_piece_changed(*m_picker, -1);
+			}
+		}
+
 		update_gauge();
 		we_have(index);
 	}
@@ -4618,6 +4632,20 @@ namespace {
 		}
 	}
 
+	void torrent::peer_has(span<piece_index_t const> const pieces
+		, peer_connection const* peer)
+	{
+		if (has_picker())
+		{
+			torrent_peer* pp = peer->peer_info_struct();
+			m_picker->inc_refcount(pieces, pp);
+		}
+		else
+		{
+			TORRENT_ASSERT(is_seed() || !m_have_all);
+		}
+	}
+
 	// when we get a bitfield message, this is called for that piece
 	void torrent::peer_has(typed_bitfield<piece_index_t> const& bits
 		, peer_connection const* peer)
@@ -4698,7 +4726,8 @@ namespace {
 			m_peer_class = peer_class_t{0};
 		}
 
-		m_inactivity_timer.cancel();
+		m_ses.torrent_timers().cancel(m_inactivity_timer);
+		m_pending_active_change = false;
 
 #ifndef TORRENT_DISABLE_LOGGING
 		log_to_all_peers("aborting");
@@ -6011,7 +6040,7 @@ namespace {
 			if (pp->optimistically_unchoked)
 			{
 				pp->optimistically_unchoked = false;
-				m_stats_counters.inc_stats_counter(
+				m_stats_counters.add_stats_counter(
 					counters::num_peers_up_unchoked_optimistic, -1);
 				trigger_optimistic_unchoke();
 			}
@@ -9267,7 +9296,8 @@ namespace {
 		// should not come back to life again.
 		if (m_pending_active_change)
 		{
-			m_inactivity_timer.cancel();
+			m_ses.torrent_timers().cancel(m_inactivity_timer);
+			m_pending_active_change = false;
 		}
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
@@ -9956,15 +9986,15 @@ namespace {
 			if (is_inactive != m_inactive && !m_pending_active_change)
 			{
 				int const delay = settings().get_int(settings_pack::auto_manage_startup);
-				m_inactivity_timer.expires_after(seconds(delay));
-				m_inactivity_timer.async_wait([self](error_code const& ec) {
-					self->wrap(&torrent::on_inactivity_tick, ec); });
+				aux::timer_wheel& timers = m_ses.torrent_timers();
+				timers.schedule(m_inactivity_timer, timers.now() + delay);
 				m_pending_active_change = true;
 			}
 			else if (is_inactive == m_inactive
 				&& m_pending_active_change)
 			{
-				m_inactivity_timer.cancel();
+				m_ses.torrent_timers().cancel(m_inactivity_timer);
+				m_pending_active_change = false;
 			}
 		}
 
@@ -10002,6 +10032,11 @@ namespace {
 	}
 	catch (...) { handle_exception(); }
 
+	void torrent::inactivity_timer::on_timer()
+	{
+		m_torrent.on_inactivity_tick(error_code());
+	}
+
 	namespace {
 		int zero_or(int const val, int const def_val)
 		{ return (val <= 0) ? def_val : val; }
@@ -10855,14 +10890,14 @@ namespace {
 
 		if (p == nullptr)
 		{
-			m_stats_counters.inc_stats_counter(counters::no_peer_connection_attempts);
+			m_stats_counters.add_stats_counter(counters::no_peer_connection_attempts);
 			update_want_peers();
 			return false;
 		}
 
 		if (!connect_to_peer(p))
 		{
-			m_stats_counters.inc_stats_counter(counters::missed_connection_attempts);
+			m_stats_counters.add_stats_counter(counters::missed_connection_attempts);
 			m_peer_list->inc_failcount(p);
 			update_want_peers();
 			return false;
@@ -11705,6 +11740,124 @@ namespace {
 		st->last_seen_complete = m_swarm_last_seen_complete;
 	}
 
+	struct torrent::delta_state
+	{
+		torrent_status_delta status;
+		std::string name;
+		std::string save_path;
+		std::string tracker;
+	};
+
+	namespace {
+
+	// appends s to the string table, if it differs from the previously
+	// reported value. Returns the offset of the string, or -1
+	int intern_if_changed(std::string& prev, std::string const& s
+		, std::string& strings, bool const first)
+	{
+		if (!first && prev == s) return -1;
+		prev = s;
+		int const ret = int(strings.size());
+		strings.append(s);
+		strings.push_back('\0');
+		return ret;
+	}
+
+	}
+
+	bool torrent::status_delta(torrent_status& st, status_flags_t const flags
+		, torrent_status_delta& d, std::string& strings)
+	{
+		// pieces, distributed copies and the torrent file aren't part of the
+		// delta, don't waste time on them
+		status(&st, flags & (torrent_handle::query_name
+			| torrent_handle::query_save_path
+			| torrent_handle::query_accurate_download_counters));
+
+		bool const first = !m_last_delta;
+		if (first) m_last_delta = std::make_unique<delta_state>();
+		delta_state& last = *m_last_delta;
+		torrent_status_delta const& prev = last.status;
+
+		d = torrent_status_delta{};
+
+		// this is the same as torrent_handle::id()
+		d.id = std::uint32_t(reinterpret_cast<std::uintptr_t>(this) >> 10);
+
+		d.state = st.state;
+		d.flags = st.flags;
+		d.progress_ppm = st.progress_ppm;
+		d.download_payload_rate = st.download_payload_rate;
+		d.upload_payload_rate = st.upload_payload_rate;
+		d.num_peers = st.num_peers;
+		d.num_seeds = st.num_seeds;
+		d.total_done = st.total_done;
+		d.total_wanted_done = st.total_wanted_done;
+		d.total_wanted = st.total_wanted;
+		d.total_payload_download = st.total_payload_download;
+		d.total_payload_upload = st.total_payload_upload;
+		d.all_time_download = st.all_time_download;
+		d.all_time_upload = st.all_time_upload;
+		d.queue_position = st.queue_position;
+		d.num_pieces = st.num_pieces;
+		d.is_seeding = st.is_seeding;
+		d.is_finished = st.is_finished;
+		d.has_metadata = st.has_metadata;
+		d.need_save_resume = st.need_save_resume;
+		d.errc = st.errc;
+		d.error_file = st.error_file;
+
+		using sd = torrent_status_delta;
+		if (first || d.state != prev.state) d.fields |= sd::state_field;
+		if (first || d.flags != prev.flags) d.fields |= sd::flags_field;
+		if (first || d.progress_ppm != prev.progress_ppm) d.fields |= sd::progress_field;
+		if (first || d.download_payload_rate != prev.download_payload_rate
+			|| d.upload_payload_rate != prev.upload_payload_rate)
+			d.fields |= sd::rates_field;
+		if (first || d.num_peers != prev.num_peers
+			|| d.num_seeds != prev.num_seeds)
+			d.fields |= sd::peers_field;
+		if (first || d.total_done != prev.total_done
+			|| d.total_wanted_done != prev.total_wanted_done
+			|| d.total_wanted != prev.total_wanted
+			|| d.total_payload_download != prev.total_payload_download
+			|| d.total_payload_upload != prev.total_payload_upload
+			|| d.all_time_download != prev.all_time_download
+			|| d.all_time_upload != prev.all_time_upload)
+			d.fields |= sd::transfer_field;
+		if (first || d.queue_position != prev.queue_position) d.fields |= sd::queue_position_field;
+		if (first || d.num_pieces != prev.num_pieces
+			|| d.is_seeding != prev.is_seeding
+			|| d.is_finished != prev.is_finished
+			|| d.has_metadata != prev.has_metadata
+			|| d.need_save_resume != prev.need_save_resume)
+			d.fields |= sd::pieces_field;
+		if (first || d.errc != prev.errc || d.error_file != prev.error_file)
+			d.fields |= sd::error_field;
+
+		if (flags & torrent_handle::query_name)
+		{
+			d.name_offset = intern_if_changed(last.name, st.name, strings, first);
+			if (d.name_offset >= 0) d.fields |= sd::name_field;
+		}
+		if (flags & torrent_handle::query_save_path)
+		{
+			d.save_path_offset = intern_if_changed(last.save_path, st.save_path, strings, first);
+			if (d.save_path_offset >= 0) d.fields |= sd::save_path_field;
+		}
+		d.tracker_offset = intern_if_changed(last.tracker, st.current_tracker, strings, first);
+		if (d.tracker_offset >= 0) d.fields |= sd::tracker_field;
+
+		if (d.fields == delta_fields_t{}) return false;
+		last.status = d;
+		return true;
+	}
+
+	void torrent::reset_status_delta()
+	{
+		m_last_delta.reset();
+	}
+
 	int torrent::priority() const
 	{
 		int priority = 0;
@@ -11748,8 +11901,8 @@ namespace {
 			m_total_redundant_bytes = std::numeric_limits<std::int64_t>::max();
 
 		// the stats counters are 64 bits, so we don't check for overflow there
-		m_stats_counters.inc_stats_counter(counters::recv_redundant_bytes, b);
-		m_stats_counters.inc_stats_counter(counters::waste_piece_timed_out + static_cast<int>(reason), b);
+		m_stats_counters.add_stats_counter(counters::recv_redundant_bytes, b);
+		m_stats_counters.add_stats_counter(counters::waste_piece_timed_out + static_cast<int>(reason), b);
 	}
 
 	void torrent::add_failed_bytes(int const b)
@@ -11762,7 +11915,7 @@ namespace {
 			m_total_failed_bytes = std::numeric_limits<std::int64_t>::max();
 
 		// the stats counters are 64 bits, so we don't check for overflow there
-		m_stats_counters.inc_stats_counter(counters::recv_failed_bytes, b);
+		m_stats_counters.add_stats_counter(counters::recv_failed_bytes, b);
 	}
 
 	// the number of connected peers that are seeds
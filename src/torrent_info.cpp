@@ -57,6 +57,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/file_pointer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
 #include "libtorrent/span.hpp"
+#include "libtorrent/aux_/io.hpp" // for read_uint32
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/crc.hpp>
@@ -1705,52 +1706,8 @@ namespace {
 				m_web_seeds.push_back(std::move(ent));
 			}
 		}
-		auto zip_info =  torrent_file.dict_find("zipinfo");
-		do 
-		{
-			if (!zip_info) break;
-			auto size_node = zip_info.dict_find_int("total size");
-			if (!size_node) break;
-			m_zip_web_seeds.total_size = size_node.int_value();
-
-			auto level_node = zip_info.dict_find_int("level");
-			if (!level_node) break;
-			m_zip_web_seeds.zip_level = level_node.int_value();
-
-			bdecode_node const offsets_node = zip_info.dict_find_string("pieces size");
-			if (!offsets_node) break;
-			std::string offsets = offsets_node.string_value().to_string();
-			if (offsets.length() != num_pieces() * (sizeof(uint32_t))) break;
-
-			uint32_t host_psize = 0;
-			uint64_t offset = 0;
-			std::size_t pos = 0;
-
-			for (int i = 0; i < num_pieces(); ++i)
-			{
-				host_psize = aux::network_to_host(*((uint32_t*)(offsets.data() + sizeof(uint32_t) * i)));
-				pos += sizeof(uint32_t);
-				m_zip_web_seeds.pieces_size.emplace_back(offset, host_psize);
-				offset += host_psize;
-			}
-
-			bdecode_node const zip_url_seeds = zip_info.dict_find("url-list");
-			if (!zip_url_seeds) break;
-			if (zip_url_seeds.type() == bdecode_node::string_t) {
-				m_zip_web_seeds.urls.push_back(zip_url_seeds.string_value().to_string());
-			}
-			else if (zip_url_seeds.type() == bdecode_node::list_t) {
-				for (int i = 0, end(zip_url_seeds.list_size()); i < end; ++i)
-				{
-					bdecode_node const url = zip_url_seeds.list_at(i);
-					if (url.type() != bdecode_node::string_t) continue;
-					if (url.string_length() == 0) continue;
-					m_zip_web_seeds.urls.push_back(url.string_value().to_string());
-				}
-			}
-		} while (false);
-		
-		
+		if (bdecode_node const zip_info = torrent_file.dict_find_dict("zipinfo"))
+			aux::parse_zip_info(zip_info, num_pieces(), m_zip_web_seeds);
 
 		// if there are any http-seeds, extract them
 		bdecode_node const http_seeds = torrent_file.dict_find("httpseeds");
@@ -1839,6 +1796,98 @@ namespace {
 	}
 #endif // TORRENT_ABI_VERSION
 
+	constexpr int zip_web_seed_entry::checkpoint_interval;
+
+	zip_web_seed_entry::pieces_size_t zip_web_seed_entry::piece(piece_index_t const index) const
+	{
+		int const i = static_cast<int>(index);
+		TORRENT_ASSERT_PRECOND(i >= 0 && i < num_pieces());
+
+		int const first = i - i % checkpoint_interval;
+		std::uint64_t offset = m_table->checkpoints[std::size_t(first / checkpoint_interval)];
+		span<char const> sizes(m_table->sizes);
+		sizes = sizes.subspan(first * int(sizeof(std::uint32_t)));
+		for (int k = first; k < i; ++k)
+			offset += aux::read_uint32(sizes);
+		return {offset, aux::read_uint32(sizes)};
+	}
+
+	void zip_web_seed_entry::set_piece_size_table(string_view const sizes)
+	{
+		TORRENT_ASSERT_PRECOND(sizes.size() % sizeof(std::uint32_t) == 0);
+		if (sizes.empty())
+		{
+			m_table.reset();
+			return;
+		}
+
+		auto t = std::make_shared<piece_table>();
+		t->sizes.assign(sizes.data(), sizes.size());
+		int const num = int(sizes.size() / sizeof(std::uint32_t));
+		t->checkpoints.reserve(std::size_t((num + checkpoint_interval - 1)
+			/ checkpoint_interval));
+
+		std::uint64_t offset = 0;
+		span<char const> table(t->sizes);
+		for (int i = 0; i < num; ++i)
+		{
+			if (i % checkpoint_interval == 0) t->checkpoints.push_back(offset);
+			offset += aux::read_uint32(table);
+		}
+		m_table = std::move(t);
+	}
+
+namespace aux {
+
+	bool parse_zip_info(bdecode_node const& zip_info, int const num_pieces
+		, zip_web_seed_entry& ret)
+	{
+		if (zip_info.type() != bdecode_node::dict_t) return false;
+
+		zip_web_seed_entry e;
+		bdecode_node const size_node = zip_info.dict_find_int("total size");
+		if (!size_node) return false;
+		e.total_size = std::uint64_t(size_node.int_value());
+
+		bdecode_node const level_node = zip_info.dict_find_int("level");
+		if (!level_node) return false;
+		e.zip_level = std::uint64_t(level_node.int_value());
+
+		// pieces compressed with a codec we don't support can't be
+		// downloaded from the zip web seeds
+		bdecode_node const codec_node = zip_info.dict_find_string("codec");
+		if (codec_node && !parse_zip_codec(codec_node.string_value(), e.codec))
+			return false;
+		if (!zip_codec_supported(e.codec)) return false;
+
+		bdecode_node const sizes_node = zip_info.dict_find_string("pieces size");
+		if (!sizes_node) return false;
+		if (sizes_node.string_length() != num_pieces * int(sizeof(std::uint32_t)))
+			return false;
+
+		bdecode_node const url_seeds = zip_info.dict_find("url-list");
+		if (!url_seeds) return false;
+		if (url_seeds.type() == bdecode_node::string_t)
+		{
+			e.urls.push_back(url_seeds.string_value().to_string());
+		}
+		else if (url_seeds.type() == bdecode_node::list_t)
+		{
+			for (int i = 0, end(url_seeds.list_size()); i < end; ++i)
+			{
+				bdecode_node const url = url_seeds.list_at(i);
+				if (url.type() != bdecode_node::string_t) continue;
+				if (url.string_length() == 0) continue;
+				e.urls.push_back(url.string_value().to_string());
+			}
+		}
+
+		e.set_piece_size_table(sizes_node.string_value());
+		ret = std::move(e);
+		return true;
+	}
+}
+
 	void torrent_info::add_url_seed(std::string const& url
 		, std::string const& ext_auth
 		, web_seed_entry::headers_t const& ext_headers)
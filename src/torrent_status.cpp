@@ -41,6 +41,19 @@ namespace libtorrent {
 	file_index_t constexpr torrent_status::error_file_partfile;
 	file_index_t constexpr torrent_status::error_file_metadata;
 
+	constexpr delta_fields_t torrent_status_delta::state_field;
+	constexpr delta_fields_t torrent_status_delta::flags_field;
+	constexpr delta_fields_t torrent_status_delta::progress_field;
+	constexpr delta_fields_t torrent_status_delta::rates_field;
+	constexpr delta_fields_t torrent_status_delta::peers_field;
+	constexpr delta_fields_t torrent_status_delta::transfer_field;
+	constexpr delta_fields_t torrent_status_delta::queue_position_field;
+	constexpr delta_fields_t torrent_status_delta::pieces_field;
+	constexpr delta_fields_t torrent_status_delta::error_field;
+	constexpr delta_fields_t torrent_status_delta::name_field;
+	constexpr delta_fields_t torrent_status_delta::save_path_field;
+	constexpr delta_fields_t torrent_status_delta::tracker_field;
+
 	torrent_status::torrent_status() noexcept {}
 	torrent_status::~torrent_status() = default;
 	torrent_status::torrent_status(torrent_status const&) = default;
@@ -218,13 +218,13 @@ constexpr tracker_request_flags_t tracker_request::i2p;
 	void tracker_manager::sent_bytes(int bytes)
 	{
 		TORRENT_ASSERT(m_ses.is_single_thread());
-		m_stats_counters.inc_stats_counter(counters::sent_tracker_bytes, bytes);
+		m_stats_counters.add_stats_counter(counters::sent_tracker_bytes, bytes);
 	}
 
 	void tracker_manager::received_bytes(int bytes)
 	{
 		TORRENT_ASSERT(m_ses.is_single_thread());
-		m_stats_counters.inc_stats_counter(counters::recv_tracker_bytes, bytes);
+		m_stats_counters.add_stats_counter(counters::recv_tracker_bytes, bytes);
 	}
 
 	void tracker_manager::remove_request(http_tracker_connection const* c)
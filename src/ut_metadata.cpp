@@ -285,8 +285,8 @@ namespace {
 					span<char>(const_cast<char*>(metadata), metadata_piece_size), metadata_piece_size);
 			}
 
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_extended);
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_metadata);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_extended);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_metadata);
 		}
 
 		bool on_extended(int const length
@@ -400,7 +400,7 @@ namespace {
 				break;
 			}
 
-			m_pc.stats_counters().inc_stats_counter(counters::num_incoming_metadata);
+			m_pc.stats_counters().add_stats_counter(counters::num_incoming_metadata);
 
 			return true;
 		}
@@ -414,7 +414,7 @@ namespace libtorrent { namespace {
 				, num_dropped, num_added);
 #endif
 
-			m_pc.stats_counters().inc_stats_counter(counters::num_incoming_pex);
+			m_pc.stats_counters().add_stats_counter(counters::num_incoming_pex);
 
 			if (peers_added) m_torrent.do_connect_boost();
 			return true;
@@ -470,8 +470,8 @@ namespace libtorrent { namespace {
 			m_pc.send_buffer(msg);
 			m_pc.send_buffer(pex_msg);
 
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_extended);
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_pex);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_extended);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_pex);
 
 #ifndef TORRENT_DISABLE_LOGGING
 			if (m_pc.should_log(peer_log_alert::outgoing_message))
@@ -581,8 +581,8 @@ namespace libtorrent { namespace {
 			m_pc.send_buffer(msg);
 			m_pc.send_buffer(pex_msg);
 
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_extended);
-			m_pc.stats_counters().inc_stats_counter(counters::num_outgoing_pex);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_extended);
+			m_pc.stats_counters().add_stats_counter(counters::num_outgoing_pex);
 
 #ifndef TORRENT_DISABLE_LOGGING
 			m_pc.peer_log(peer_log_alert::outgoing_message, "PEX_FULL"
@@ -305,7 +305,7 @@ namespace aux {
 				&& counter <= counters::utp_redundant_pkts_in)
 			|| (counter >= counters::num_utp_idle
 				&& counter <= counters::num_utp_deleted));
-		m_counters.inc_stats_counter(counter, delta);
+		m_counters.add_stats_counter(counter, delta);
 	}
 
 	utp_socket_impl* utp_socket_manager::new_utp_socket(utp_stream* str)
@@ -33,9 +33,21 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "libtorrent/web_zip_peer_connection.hpp"
-#include "libtorrent/miniz.hpp"
 using namespace libtorrent;
 
+web_zip_peer_connection::web_zip_peer_connection(peer_connection_args& pack
+	, web_seed_t& web)
+	: web_peer_connection(pack, web)
+{
+	m_picker_options |= piece_picker::align_expanded_pieces;
+	m_picker_options |= piece_picker::on_parole;
+
+	std::shared_ptr<torrent> t = associated_torrent().lock();
+	TORRENT_ASSERT(t);
+	m_inflate_stream = m_ses.inflate_pool().open_stream(
+		t->torrent_file().const_zip_web_seeds().codec);
+}
+
 void web_zip_peer_connection::send_block_requests()
 {
 	TORRENT_ASSERT(is_single_thread());
@@ -63,15 +75,17 @@ void web_zip_peer_connection::send_block_requests()
 
 	bool const empty_download_queue = m_download_queue.empty();
 
+	// the pieces picked in this round. They are requested once they've all
+	// been picked, to allow merging adjacent ones into a single request
+	std::vector<peer_request> pieces;
+
 	while (!m_request_queue.empty() && (int(m_download_queue.size()) < m_desired_queue_size
 			|| m_queued_time_critical > 0))
 	{
 		pending_block block = m_request_queue.front();
-		auto iter_r = std::find_if(m_requests.begin(), m_requests.end(), [index = block.block.piece_index](const peer_request& pr) {
-			return pr.piece == index;
-		});
-		if (iter_r != m_requests.end()) continue; // every piece only need request once.
-			
+
+		// every piece only needs to be requested once, drop all of its
+		// blocks from the request queue
 		auto iter = std::remove_if(m_request_queue.begin(), m_request_queue.end(),
 			[index = block.block.piece_index](const pending_block& block) {
 			return block.block.piece_index == index;
@@ -79,6 +93,11 @@ void web_zip_peer_connection::send_block_requests()
 		m_request_queue.erase(iter, m_request_queue.end());
 		if (m_queued_time_critical) --m_queued_time_critical;
 
+		auto iter_r = std::find_if(m_requests.begin(), m_requests.end(), [index = block.block.piece_index](const peer_request& pr) {
+			return pr.piece == index;
+		});
+		if (iter_r != m_requests.end()) continue;
+
 		// if we're a seed, we don't have a piece picker
 		// so we don't have to worry about invariants getting
 		// out of sync with it
@@ -99,7 +118,7 @@ void web_zip_peer_connection::send_block_requests()
 		r.length = t->torrent_file().piece_size(block.block.piece_index);
 
 		if (m_download_queue.empty())
-			m_counters.inc_stats_counter(counters::num_peers_down_requests);
+			m_counters.add_stats_counter(counters::num_peers_down_requests);
 
 		piece_block pb(block.block);
 		pb.block_index = 0;
@@ -128,8 +147,7 @@ void web_zip_peer_connection::send_block_requests()
 		if (!handled)
 #endif
 		{
-			write_request(r);
-			m_last_request.set(m_connect, aux::time_now());
+			pieces.push_back(r);
 		}
 
 #ifndef TORRENT_DISABLE_LOGGING
@@ -143,8 +161,31 @@ void web_zip_peer_connection::send_block_requests()
 		}
 #endif
 	}
-		
-		
+
+	// runs of pieces that are stored back-to-back in the zip file are
+	// merged into a single range request, as long as it doesn't exceed
+	// urlseed_max_request_bytes. Each request is pipelined behind the
+	// outstanding ones, the responses are split back into pieces in
+	// incoming_payload()
+	auto const& zip = t->torrent_file().const_zip_web_seeds();
+	std::int64_t const max_request_bytes = m_settings.get_int(settings_pack::urlseed_max_request_bytes);
+	for (std::size_t i = 0; i < pieces.size();)
+	{
+		std::size_t end = i + 1;
+		std::int64_t request_bytes = zip.piece(pieces[i].piece).size;
+		for (; end < pieces.size(); ++end)
+		{
+			auto const prev = zip.piece(pieces[end - 1].piece);
+			auto const next = zip.piece(pieces[end].piece);
+			if (prev.offset + prev.size != next.offset) break;
+			if (request_bytes + next.size > max_request_bytes) break;
+			request_bytes += next.size;
+		}
+		write_requests({pieces.data() + i, std::ptrdiff_t(end - i)});
+		m_last_request.set(m_connect, aux::time_now());
+		i = end;
+	}
+
 	m_last_piece.set(m_connect, aux::time_now());
 
 	if (empty_download_queue)
@@ -156,50 +197,59 @@ void web_zip_peer_connection::send_block_requests()
 	}
 }
 
-void web_zip_peer_connection::write_request(peer_request const& r) {
+void web_zip_peer_connection::write_request(peer_request const& r)
+{
+	write_requests({&r, 1});
+}
+
+void web_zip_peer_connection::write_requests(span<peer_request const> rs)
+{
 	INVARIANT_CHECK;
 
 	std::shared_ptr<torrent> t = associated_torrent().lock();
 	TORRENT_ASSERT(t);
 
 	TORRENT_ASSERT(t->valid_metadata());
+	TORRENT_ASSERT(!rs.empty());
 
 	torrent_info const& info = t->torrent_file();
+	auto const& zip = info.const_zip_web_seeds();
 
 	std::string request;
 	request.reserve(400);
 
-	//const int block_size = t->block_size();
-	//const int piece_size = t->torrent_file().piece_length();
-
-
 #ifndef TORRENT_DISABLE_LOGGING
 	peer_log(peer_log_alert::outgoing_message, "REQUESTING", "(piece: %d start: %d) - (piece: %d end: %d)"
-		, static_cast<int>(r.piece), r.start
-		, static_cast<int>(r.piece), r.start + r.length);
+		, static_cast<int>(rs.front().piece), rs.front().start
+		, static_cast<int>(rs.back().piece), rs.back().start + rs.back().length);
 #endif
 
 	int const proxy_type = m_settings.get_int(settings_pack::proxy_type);
 	bool const using_proxy = (proxy_type == settings_pack::http
 		|| proxy_type == settings_pack::http_pw) && !m_ssl;
 
-	// the number of pad files that have been "requested". In case we _only_
-	// request padfiles, we can't rely on handling them in the on_receive()
-	// callback (because we won't receive anything), instead we have to post a
-	// pretend read callback where we can deliver the zeroes for the partfile
-	// int num_pad_files = 0;
-
-	// TODO: 3 do we really need a special case here? wouldn't the multi-file
-	// case handle single file torrents correctly too?
-	TORRENT_ASSERT(r.piece < piece_index_t(info.const_zip_web_seeds().pieces_size.size()));
-	const auto& zip_piece = info.const_zip_web_seeds().pieces_size[int32_t(r.piece)];
-
-	peer_request pr{};
-	pr.piece = r.piece;
-	pr.length = zip_piece.size;
-	pr.start = r.start;
-	pr.unzip_length = r.length;
-	m_requests.push_back(pr);
+	// every piece is pushed as a separate request, with the length of its
+	// compressed data. The response is split back into pieces by these
+	// lengths in incoming_payload()
+	TORRENT_ASSERT(rs.front().piece < piece_index_t(zip.num_pieces()));
+	std::int64_t const range_start = zip.piece(rs.front().piece).offset;
+	std::int64_t range_end = range_start;
+	for (peer_request const& r : rs)
+	{
+		TORRENT_ASSERT(r.piece < piece_index_t(zip.num_pieces()));
+		auto const zip_piece = zip.piece(r.piece);
+
+		// the pieces of a single request must be back-to-back in the zip file
+		TORRENT_ASSERT(zip_piece.offset == std::uint64_t(range_end));
+
+		peer_request pr{};
+		pr.piece = r.piece;
+		pr.length = int(zip_piece.size);
+		pr.start = r.start;
+		pr.unzip_length = r.length;
+		m_requests.push_back(pr);
+		range_end += zip_piece.size;
+	}
 
 	request += "GET ";
 	// do not encode single file paths, they are
@@ -208,37 +258,18 @@ void web_zip_peer_connection::write_request(peer_request const& r) {
 	request += " HTTP/1.1\r\n";
 	add_headers(request, m_settings, using_proxy);
 	request += "\r\nRange: bytes=";
-	request += to_string(zip_piece.offset).data();
+	request += to_string(range_start).data();
 	request += "-";
-	request += to_string(zip_piece.offset + zip_piece.size - 1).data();
+	request += to_string(range_end - 1).data();
 	request += "\r\n\r\n";
 
 	file_request_t file_req;
 	file_req.file_index = file_index_t(0);
-	file_req.start = zip_piece.offset;
-	file_req.length = zip_piece.size;
+	file_req.start = range_start;
+	file_req.length = int(range_end - range_start);
 
 	m_file_requests.push_back(file_req);
 
-	//std::vector<file_slice> files = info.orig_files().map_block(r.piece, 0, info.piece_length());
-	//for (auto&& f : files)
-	//{
-	//	
-
-	//	if (info.orig_files().pad_file_at(f.file_index))
-	//	{
-	//		++num_pad_files;
-	//	}
-	//}
-
-	//if (num_pad_files == int(m_file_requests.size()))
-	//{
-	//	post(get_context(), std::bind(
-	//		&web_peer_connection::on_receive_padfile,
-	//		std::static_pointer_cast<web_peer_connection>(self())));
-	//	return;
-	//}
-
 #ifndef TORRENT_DISABLE_LOGGING
 	peer_log(peer_log_alert::outgoing_message, "REQUEST", "%s", request.c_str());
 #endif
@@ -278,73 +309,92 @@ void web_zip_peer_connection::incoming_payload(char const* buf, int len)
 	peer_log(peer_log_alert::incoming_message, "INCOMING_PAYLOAD", "%d bytes", len);
 #endif
 
-	// deliver all complete bittorrent requests to the bittorrent engine
+	std::shared_ptr<torrent> t = associated_torrent().lock();
+	TORRENT_ASSERT(t);
+
+	// feed the compressed bytes to the inflate stream as they arrive, so
+	// that blocks can be delivered to the bittorrent engine without waiting
+	// for the whole piece
 	while (len > 0)
 	{
 		if (m_requests.empty()) return;
 
-		TORRENT_ASSERT(!m_requests.empty());
 		peer_request const& front_request = m_requests.front();
-		int const piece_size = int(m_piece.size());
-		int const copy_size = std::min(front_request.length - piece_size, len);
+		int const copy_size = std::min(front_request.length - m_zip_received, len);
 
-		// m_piece may not hold more than the response to the next BT request
-		TORRENT_ASSERT(front_request.length > piece_size);
+		// the input may not hold more than the response to the next BT request
+		TORRENT_ASSERT(front_request.length > m_zip_received);
 
-		// copy_size is the number of bytes we need to add to the end of m_piece
-		// to not exceed the size of the next bittorrent request to be delivered.
-		// m_piece can only hold the response for a single BT request at a time
-		m_piece.resize(piece_size + copy_size);
-		std::memcpy(m_piece.data() + piece_size, buf, aux::numeric_cast<std::size_t>(copy_size));
+		m_inflate_input.insert(m_inflate_input.end(), buf, buf + copy_size);
 		len -= copy_size;
 		buf += copy_size;
+		m_zip_received += copy_size;
 
 		// keep peer stats up-to-date
 		incoming_piece_fragment(copy_size);
 
-		TORRENT_ASSERT(front_request.length >= piece_size);
-		if (int(m_piece.size()) == front_request.length)
-		{
-			std::shared_ptr<torrent> t = associated_torrent().lock();
-			TORRENT_ASSERT(t);
+		bool const last = m_zip_received == front_request.length;
 
+		// don't bother the inflate thread with anything less than a block
+		// worth of input, unless it's the end of the piece
+		if (!last && int(m_inflate_input.size()) < t->block_size()) continue;
+
+		peer_request const front_request_copy = front_request;
+		if (last)
+		{
 #ifndef TORRENT_DISABLE_LOGGING
 			peer_log(peer_log_alert::incoming_message, "POP_REQUEST"
 				, "piece: %d start: %d len: %d"
 				, static_cast<int>(front_request.piece), front_request.start, front_request.length);
 #endif
-
-			// Make a copy of the request and pop it off the queue before calling
-			// incoming_piece because that may lead to a call to disconnect()
-			// which will clear the request queue and invalidate any references
-			// to the request
-			peer_request front_request_copy = front_request;
 			m_requests.pop_front();
-			
-			std::string unzip_buf;
-			mz_ulong unzip_len = front_request_copy.unzip_length;
-			unzip_buf.resize(unzip_len);
-			auto ret = mz_uncompress((unsigned char*)unzip_buf.data(), &unzip_len, (const unsigned char*)m_piece.data(), m_piece.size());
-			if (ret != MZ_OK) {
-				m_piece.clear();
-				return;
-			}
-			m_piece.clear();
-
-
-			peer_request ipr(front_request_copy);
-			ipr.start = 0;
-			ipr.length = 0;
-			while (unzip_len > 0)
-			{
-				ipr.length = unzip_len >= (mz_ulong)t->block_size() ? t->block_size() : unzip_len;
-				unzip_len -= ipr.length;
-#if TORRENT_USE_ASSERTS
-				m_received_in_piece = ipr.length;
-#endif
-				incoming_piece(ipr, unzip_buf.data() + ipr.start);
-				ipr.start += ipr.length;
-			}
+			m_zip_received = 0;
 		}
+
+		std::vector<char> input;
+		input.swap(m_inflate_input);
+		m_inflate_input.reserve(std::size_t(t->block_size()));
+		m_ses.inflate_pool().async_inflate(m_inflate_stream, std::move(input)
+			, front_request_copy.unzip_length, t->block_size(), last
+			, [conn = std::static_pointer_cast<web_zip_peer_connection>(self())
+				, front_request_copy](error_code const& ec, int const start
+					, std::vector<disk_buffer_holder> blocks)
+			{ conn->on_blocks_inflated(ec, front_request_copy, start, std::move(blocks)); });
+	}
+}
+
+void web_zip_peer_connection::on_blocks_inflated(error_code const& ec
+	, peer_request const& r, int const start, std::vector<disk_buffer_holder> blocks)
+{
+	TORRENT_ASSERT(is_single_thread());
+	if (is_disconnecting()) return;
+
+	if (ec)
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::info, "INFLATE_FAILED", "piece: %d error: %s"
+			, static_cast<int>(r.piece), ec.message().c_str());
+#endif
+		// the request may already have been popped, and the remaining input
+		// of the response can't be decoded. Disconnecting returns all
+		// outstanding requests to the piece picker
+		disconnect(ec, operation_t::bittorrent, peer_error);
+		return;
+	}
+
+	// this is not zero-copy, the disk subsystem copies each block into its
+	// own buffer in async_write(). The inflate buffers are released as they
+	// go out of scope
+	peer_request ipr(r);
+	ipr.start = start;
+	for (auto const& b : blocks)
+	{
+		ipr.length = int(b.size());
+#if TORRENT_USE_ASSERTS
+		m_received_in_piece = ipr.length;
+#endif
+		incoming_piece(ipr, b.data());
+		if (is_disconnecting()) return;
+		ipr.start += ipr.length;
 	}
 }
@@ -102,7 +102,6 @@ namespace libtorrent {
 
 		ret["info-hash"] = atp.info_hashes.v1;
 		ret["info-hash2"] = atp.info_hashes.v2;
-		uint32_t net_size = 0;
 		if (atp.ti)
 		{
 			auto const info = atp.ti->info_section();
@@ -128,15 +127,11 @@ namespace libtorrent {
 					ret["zipinfo"]["url-list"] = atp.ti->zip_web_seeds().urls[0];
 				}
 
-				std::stringstream ss;
-				for (const auto& psize : atp.ti->zip_web_seeds().pieces_size)
-				{
-					net_size = libtorrent::aux::host_to_network(uint32_t(psize.size));
-					ss.write((char*)&net_size, sizeof(net_size));
-				}
-				ret["zipinfo"]["pieces size"] = ss.str();
+				ret["zipinfo"]["pieces size"] = atp.ti->zip_web_seeds().piece_size_table().to_string();
 				ret["zipinfo"]["total size"] = atp.ti->zip_web_seeds().total_size;
 				ret["zipinfo"]["level"] = atp.ti->zip_web_seeds().zip_level;
+				if (atp.ti->zip_web_seeds().codec != zip_codec::zlib)
+					ret["zipinfo"]["codec"] = zip_codec_name(atp.ti->zip_web_seeds().codec);
 			}
 		}
 
@@ -0,0 +1,248 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/zip_decoder.hpp"
+#include "libtorrent/zip_codec.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/miniz.hpp"
+
+#if TORRENT_USE_ZSTD
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <zstd.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+#endif
+
+#include <cstdlib>
+
+namespace libtorrent {
+
+	bool zip_codec_supported(zip_codec const c)
+	{
+		switch (c)
+		{
+			case zip_codec::zlib: return true;
+			case zip_codec::zstd: return TORRENT_USE_ZSTD;
+		}
+		return false;
+	}
+
+	char const* zip_codec_name(zip_codec const c)
+	{
+		switch (c)
+		{
+			case zip_codec::zlib: return "zlib";
+			case zip_codec::zstd: return "zstd";
+		}
+		return "";
+	}
+
+	bool parse_zip_codec(string_view const name, zip_codec& c)
+	{
+		if (name == "zlib") c = zip_codec::zlib;
+		else if (name == "zstd") c = zip_codec::zstd;
+		else return false;
+		return true;
+	}
+
+namespace aux {
+
+namespace {
+
+	// mz_inflateInit() allocates the decompressor state (about 40 kiB) for
+	// every piece. The decoder keeps one around for reuse instead
+	struct state_cache
+	{
+		state_cache() = default;
+		state_cache(state_cache const&) = delete;
+		state_cache& operator=(state_cache const&) = delete;
+		~state_cache() { std::free(buf); }
+
+		void* buf = nullptr;
+		std::size_t size = 0;
+		bool in_use = false;
+	};
+
+	void* cached_alloc(void* opaque, std::size_t const items, std::size_t const size)
+	{
+		auto* c = static_cast<state_cache*>(opaque);
+		std::size_t const n = items * size;
+		if (c->in_use) return std::malloc(n);
+		if (c->size < n)
+		{
+			std::free(c->buf);
+			c->buf = std::malloc(n);
+			c->size = c->buf ? n : 0;
+			if (c->buf == nullptr) return nullptr;
+		}
+		c->in_use = true;
+		return c->buf;
+	}
+
+	void cached_free(void* opaque, void* p)
+	{
+		auto* c = static_cast<state_cache*>(opaque);
+		if (p == c->buf) c->in_use = false;
+		else std::free(p);
+	}
+
+	struct zlib_decoder final : zip_decoder
+	{
+		zlib_decoder() = default;
+		~zlib_decoder() override { if (m_open) mz_inflateEnd(&m_strm); }
+
+		bool reset() override
+		{
+			if (m_open) mz_inflateEnd(&m_strm);
+			m_strm = mz_stream{};
+			m_strm.zalloc = &cached_alloc;
+			m_strm.zfree = &cached_free;
+			m_strm.opaque = &m_cache;
+			m_open = mz_inflateInit(&m_strm) == MZ_OK;
+			return m_open;
+		}
+
+		status decode(span<char const>& in, span<char>& out) override
+		{
+			TORRENT_ASSERT(m_open);
+			m_strm.next_in = reinterpret_cast<unsigned char const*>(in.data());
+			m_strm.avail_in = static_cast<unsigned int>(in.size());
+			m_strm.next_out = reinterpret_cast<unsigned char*>(out.data());
+			m_strm.avail_out = static_cast<unsigned int>(out.size());
+			int const ret = mz_inflate(&m_strm, MZ_SYNC_FLUSH);
+			in = in.last(m_strm.avail_in);
+			out = out.last(m_strm.avail_out);
+
+			if (ret == MZ_STREAM_END) return status::end;
+			if (ret == MZ_BUF_ERROR && in.empty()) return status::need_input;
+			if (ret != MZ_OK) return status::error;
+			return status::ok;
+		}
+
+	private:
+		state_cache m_cache;
+		mz_stream m_strm{};
+		bool m_open = false;
+	};
+
+#if TORRENT_USE_ZSTD
+	struct zstd_decoder final : zip_decoder
+	{
+		zstd_decoder() : m_ctx(ZSTD_createDCtx()) {}
+		~zstd_decoder() override { ZSTD_freeDCtx(m_ctx); }
+
+		bool reset() override
+		{
+			m_end = false;
+			return m_ctx != nullptr
+				&& !ZSTD_isError(ZSTD_DCtx_reset(m_ctx, ZSTD_reset_session_only));
+		}
+
+		status decode(span<char const>& in, span<char>& out) override
+		{
+			// every piece is a single frame, anything following it is
+			// corrupt
+			if (m_end) return in.empty() ? status::end : status::error;
+
+			ZSTD_inBuffer ib{in.data(), std::size_t(in.size()), 0};
+			ZSTD_outBuffer ob{out.data(), std::size_t(out.size()), 0};
+			std::size_t const ret = ZSTD_decompressStream(m_ctx, &ob, &ib);
+			in = in.subspan(std::ptrdiff_t(ib.pos));
+			out = out.subspan(std::ptrdiff_t(ob.pos));
+
+			if (ZSTD_isError(ret)) return status::error;
+			if (ret == 0)
+			{
+				m_end = true;
+				return in.empty() ? status::end : status::error;
+			}
+			// zstd holds on to decoded bytes it has no room for, so it's
+			// only out of input if there's still room in the output buffer
+			if (in.empty() && !out.empty()) return status::need_input;
+			return status::ok;
+		}
+
+	private:
+		ZSTD_DCtx* m_ctx;
+
+		// set once the frame of the current piece is complete
+		bool m_end = false;
+	};
+#endif
+}
+
+	std::unique_ptr<zip_decoder> make_zip_decoder(zip_codec const c)
+	{
+		switch (c)
+		{
+			case zip_codec::zlib: return std::unique_ptr<zip_decoder>(new zlib_decoder);
+#if TORRENT_USE_ZSTD
+			case zip_codec::zstd: return std::unique_ptr<zip_decoder>(new zstd_decoder);
+#else
+			case zip_codec::zstd: break;
+#endif
+		}
+		return {};
+	}
+
+	bool zip_compress(zip_codec const c, span<char const> const in
+		, std::vector<char>& out, int const level)
+	{
+		switch (c)
+		{
+			case zip_codec::zlib:
+			{
+				mz_ulong len = mz_compressBound(mz_ulong(in.size()));
+				out.resize(len);
+				int const ret = mz_compress2(reinterpret_cast<unsigned char*>(out.data()), &len
+					, reinterpret_cast<unsigned char const*>(in.data()), mz_ulong(in.size())
+					, level);
+				out.resize(len);
+				return ret == MZ_OK;
+			}
+			case zip_codec::zstd:
+			{
+#if TORRENT_USE_ZSTD
+				out.resize(ZSTD_compressBound(std::size_t(in.size())));
+				std::size_t const len = ZSTD_compress(out.data(), out.size()
+					, in.data(), std::size_t(in.size()), level);
+				if (ZSTD_isError(len)) return false;
+				out.resize(len);
+				return true;
+#else
+				break;
+#endif
+			}
+		}
+		return false;
+	}
+}
+}
@@ -0,0 +1,225 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+// measures the throughput of the alert queue with every alert category
+// enabled, compared to a queue where every emplace and get_all takes the same
+// mutex (which is what the alert_manager used to be). One thread plays the
+// network thread, posting a mix of peer-level alerts as fast as it can. The
+// other plays the client, waiting for alerts and draining them with get_all().
+//
+// usage: bench_alert_queue [-s seconds] [queue-size...]
+//
+// The queue size defaults to 2000 (the default of
+// settings_pack::alert_queue_size) and 100000.
+
+#include "libtorrent/aux_/alert_manager.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/torrent_handle.hpp"
+#include "libtorrent/peer_request.hpp"
+#include "libtorrent/time.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using lt::alert;
+using lt::alert_category_t;
+using lt::heterogeneous_queue;
+
+// the alert queue before it was made lock-free
+struct locked_alert_manager
+{
+	locked_alert_manager(int const queue_limit, alert_category_t const mask)
+		: m_alert_mask(mask), m_queue_size_limit(queue_limit) {}
+
+	template <class T, typename... Args>
+	void emplace_alert(Args&&... args)
+	{
+		std::unique_lock<std::recursive_mutex> lock(m_mutex);
+		heterogeneous_queue<alert>& queue = m_alerts[m_generation];
+		if (queue.size() / (1 + static_cast<int>(T::priority)) >= m_queue_size_limit)
+			return;
+		queue.emplace_back<T>(m_allocations[m_generation], std::forward<Args>(args)...);
+		if (queue.size() == 1) m_condition.notify_all();
+	}
+
+	template <class T>
+	bool should_post() const
+	{ return bool(m_alert_mask & T::static_category); }
+
+	alert* wait_for_alert(lt::time_duration const max_wait)
+	{
+		std::unique_lock<std::recursive_mutex> lock(m_mutex);
+		if (!m_alerts[m_generation].empty()) return m_alerts[m_generation].front();
+		m_condition.wait_for(lock, max_wait);
+		if (!m_alerts[m_generation].empty()) return m_alerts[m_generation].front();
+		return nullptr;
+	}
+
+	void get_all(std::vector<alert*>& alerts)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		m_alerts[m_generation].get_pointers(alerts);
+		m_generation = (m_generation + 1) & 1;
+		m_alerts[m_generation].clear();
+		m_allocations[m_generation].reset();
+	}
+
+private:
+	mutable std::recursive_mutex m_mutex;
+	std::condition_variable_any m_condition;
+	alert_category_t m_alert_mask;
+	int m_queue_size_limit;
+	int m_generation = 0;
+	lt::aux::array<heterogeneous_queue<alert>, 2> m_alerts;
+	lt::aux::array<lt::aux::stack_allocator, 2> m_allocations;
+};
+
+struct result
+{
+	double posted;
+	double delivered;
+};
+
+// returns the number of alerts posted and delivered per second
+template <typename AlertManager>
+result bench(int const queue_size, lt::time_duration const duration)
+{
+	AlertManager mgr(queue_size, lt::alert_category::all);
+	std::atomic<bool> done{false};
+	std::int64_t posted = 0;
+	std::int64_t delivered = 0;
+
+	std::thread network([&]
+	{
+		lt::torrent_handle const h;
+		lt::tcp::endpoint const ep(lt::address_v4::loopback(), 6881);
+		lt::peer_id const pid;
+		lt::peer_request const r{lt::piece_index_t(0), 0, 0x4000};
+		std::int64_t n = 0;
+		for (std::int64_t i = 0; !done.load(std::memory_order_relaxed); ++i)
+		{
+			// the alerts posted for a block coming in and a block going out.
+			// Like the network thread, check the alert mask before posting
+			lt::piece_index_t const piece(int(i / 16 % 1000));
+			if (mgr.template should_post<lt::block_finished_alert>())
+			{
+				mgr.template emplace_alert<lt::block_finished_alert>(h, ep, pid, int(i % 16), piece);
+				++n;
+			}
+			if (mgr.template should_post<lt::incoming_request_alert>())
+			{
+				mgr.template emplace_alert<lt::incoming_request_alert>(r, h, ep, pid);
+				++n;
+			}
+			if (mgr.template should_post<lt::block_uploaded_alert>())
+			{
+				mgr.template emplace_alert<lt::block_uploaded_alert>(h, ep, pid, int(i % 16), piece);
+				++n;
+			}
+			if (i % 16 == 15 && mgr.template should_post<lt::piece_finished_alert>())
+			{
+				mgr.template emplace_alert<lt::piece_finished_alert>(h, piece);
+				++n;
+			}
+		}
+		posted = n;
+	});
+
+	// the client, draining the queue as it's notified about alerts
+	std::thread client([&]
+	{
+		std::vector<alert*> alerts;
+		std::int64_t n = 0;
+		while (!done.load(std::memory_order_relaxed))
+		{
+			if (mgr.wait_for_alert(lt::milliseconds(100)) == nullptr) continue;
+			mgr.get_all(alerts);
+			for (alert const* a : alerts)
+				n += (a->type() >= 0) ? 1 : 0;
+		}
+		delivered = n;
+	});
+
+	std::this_thread::sleep_for(duration);
+	done = true;
+	network.join();
+	client.join();
+
+	double const us = double(lt::total_microseconds(duration));
+	return {double(posted) / us * 1000000., double(delivered) / us * 1000000.};
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int seconds = 2;
+	std::vector<int> queue_sizes;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == '-' && argv[i][1] == 's' && i + 1 < argc)
+		{
+			seconds = std::atoi(argv[++i]);
+			continue;
+		}
+		int const n = std::atoi(argv[i]);
+		if (n <= 0)
+		{
+			std::fprintf(stderr, "usage: bench_alert_queue [-s seconds] [queue-size...]\n");
+			return 1;
+		}
+		queue_sizes.push_back(n);
+	}
+	if (queue_sizes.empty()) queue_sizes = {2000, 100000};
+
+	for (int const n : queue_sizes)
+	{
+		result const locked = bench<locked_alert_manager>(n, lt::seconds(seconds));
+		result const lock_free = bench<lt::aux::alert_manager>(n, lt::seconds(seconds));
+		std::printf("queue size: %6d locked: %6.2f / %6.2f Malerts/s lock-free: %6.2f / %6.2f Malerts/s"
+			" (posted / delivered, %.1fx)\n"
+			, n, locked.posted / 1000000., locked.delivered / 1000000.
+			, lock_free.posted / 1000000., lock_free.delivered / 1000000.
+			, lock_free.delivered / locked.delivered);
+	}
+	return 0;
+}
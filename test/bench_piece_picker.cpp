@@ -0,0 +1,162 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// measures the time it takes to pick pieces rarest first, in a torrent with
+// one million pieces and 500 peers. We have half of the pieces. The peers
+// range from seeds to peers that have just joined the swarm, since the
+// cost of picking depends on how many of the pieces we're missing the peer
+// has.
+//
+// usage: bench_piece_picker [-p pieces] [-n peers] [-r rounds]
+
+#include "libtorrent/piece_picker.hpp"
+#include "libtorrent/bitfield.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/piece_block.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct peer_class
+{
+	char const* name;
+	// the fraction of pieces the peer has
+	double density;
+};
+
+peer_class const peer_classes[] = {
+	{"seed", 1.0},
+	{"75%", 0.75},
+	{"25%", 0.25},
+	{"1%", 0.01},
+	{"0.1%", 0.001},
+	{"0.01%", 0.0001},
+};
+
+int const num_classes = int(sizeof(peer_classes) / sizeof(peer_classes[0]));
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int num_pieces = 1000000;
+	int num_peers = 500;
+	int rounds = 4;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == '-' && i + 1 < argc)
+		{
+			int const v = std::atoi(argv[i + 1]);
+			switch (argv[i][1])
+			{
+				case 'p': num_pieces = v; ++i; continue;
+				case 'n': num_peers = v; ++i; continue;
+				case 'r': rounds = v; ++i; continue;
+			}
+		}
+		std::fprintf(stderr, "usage: bench_piece_picker [-p pieces] [-n peers] [-r rounds]\n");
+		return 1;
+	}
+	if (num_pieces <= 0 || num_peers <= 0 || rounds <= 0)
+	{
+		std::fprintf(stderr, "usage: bench_piece_picker [-p pieces] [-n peers] [-r rounds]\n");
+		return 1;
+	}
+
+	std::mt19937 rng(0x1337);
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	lt::piece_picker picker(16, 16, num_pieces);
+
+	std::vector<lt::typed_bitfield<lt::piece_index_t>> peers(std::size_t(num_peers)
+		, lt::typed_bitfield<lt::piece_index_t>(num_pieces, false));
+	for (int i = 0; i < num_peers; ++i)
+	{
+		auto& bits = peers[std::size_t(i)];
+		double const density = peer_classes[i % num_classes].density;
+		for (lt::piece_index_t p : bits.range())
+			if (dist(rng) < density) bits.set_bit(p);
+		picker.inc_refcount(bits, nullptr);
+	}
+
+	for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+		if (dist(rng) < 0.5) picker.we_have(p);
+
+	lt::time_duration elapsed[num_classes] = {};
+	std::int64_t loops[num_classes] = {};
+	int picks[num_classes] = {};
+
+	std::vector<lt::piece_block> picked;
+	std::vector<lt::piece_index_t> const suggested;
+
+	// the first pick sorts the pieces by priority, don't include that in the
+	// measurements
+	{
+		lt::counters cnt;
+		picker.pick_pieces(peers[0], picked, 64, 0, nullptr
+			, lt::piece_picker::rarest_first, suggested, num_peers, cnt);
+	}
+
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int i = 0; i < num_peers; ++i)
+		{
+			int const c = i % num_classes;
+			lt::counters cnt;
+			picked.clear();
+			auto const start = lt::clock_type::now();
+			picker.pick_pieces(peers[std::size_t(i)], picked, 64, 0, nullptr
+				, lt::piece_picker::rarest_first, suggested, num_peers, cnt);
+			elapsed[c] += lt::clock_type::now() - start;
+			loops[c] += cnt[lt::counters::piece_picker_rare_loops];
+			++picks[c];
+		}
+	}
+
+	std::printf("pieces: %d peers: %d\n", num_pieces, num_peers);
+	for (int c = 0; c < num_classes; ++c)
+	{
+		if (picks[c] == 0) continue;
+		std::printf("%-6s peers: %9.2f us/pick %10.1f pieces visited/pick\n"
+			, peer_classes[c].name
+			, double(lt::total_microseconds(elapsed[c])) / picks[c]
+			, double(loops[c]) / picks[c]);
+	}
+	return 0;
+}
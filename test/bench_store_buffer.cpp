@@ -0,0 +1,231 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// measures the throughput of the store buffer, compared to a single map
+// behind a single mutex (which is what the store buffer used to be), with
+// the access pattern of mmap_disk_io. One thread plays the network thread,
+// inserting the blocks of incoming writes. The others play the disk threads,
+// probing the store buffer for every read and erasing blocks as their
+// writes complete.
+//
+// usage: bench_store_buffer [-s seconds] [threads...]
+//
+// The number of disk threads defaults to 8, 16 and 32, a typical range for
+// settings_pack::aio_threads.
+
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/time.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using lt::aux::torrent_location;
+
+// the store buffer before it was sharded
+struct single_mutex_store_buffer
+{
+	template <typename Fun>
+	bool get(torrent_location const loc, Fun f) const
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		auto const it = m_store_buffer.find(loc);
+		if (it == m_store_buffer.end()) return false;
+		f(it->second);
+		return true;
+	}
+
+	void insert(torrent_location const loc, char const* buf)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_store_buffer.insert({loc, buf});
+	}
+
+	void erase(torrent_location const loc)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_store_buffer.erase(loc);
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::unordered_map<torrent_location, char const*> m_store_buffer;
+};
+
+int const num_torrents = 16;
+int const num_pieces = 64;
+int const blocks_per_piece = 16;
+
+torrent_location random_location(std::mt19937& rng)
+{
+	return {lt::storage_index_t(int(rng() % num_torrents))
+		, lt::piece_index_t(int(rng() % num_pieces))
+		, int(rng() % blocks_per_piece) * lt::default_block_size};
+}
+
+std::size_t block_index(torrent_location const& loc)
+{
+	return std::size_t((static_cast<int>(loc.torrent) * num_pieces
+		+ static_cast<int>(loc.piece)) * blocks_per_piece
+		+ loc.offset / lt::default_block_size);
+}
+
+// returns the number of operations per second
+template <typename StoreBuffer>
+double bench(int const num_threads, lt::time_duration const duration)
+{
+	StoreBuffer sb;
+	std::atomic<bool> done{false};
+	std::atomic<std::int64_t> ops{0};
+	char const buffer[1] = {0};
+
+	// blocks written by the network thread, for the disk threads to erase.
+	// Each disk thread owns a queue, to not measure the contention on this
+	// one instead
+	struct write_queue
+	{
+		std::mutex mutex;
+		std::vector<torrent_location> blocks;
+	};
+	std::vector<write_queue> queues(static_cast<std::size_t>(num_threads));
+
+	// the blocks currently in the store buffer, indexed by block_index()
+	std::vector<std::atomic<bool>> in_flight(num_torrents * num_pieces * blocks_per_piece);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			std::mt19937 rng(static_cast<std::uint32_t>(t));
+			write_queue& q = queues[std::size_t(t)];
+			std::vector<torrent_location> completed;
+			std::int64_t n = 0;
+			while (!done.load(std::memory_order_relaxed))
+			{
+				// a read job, probing the store buffer
+				sb.get(random_location(rng), [](char const*) {});
+				++n;
+
+				// every fourth job is a write completing
+				if (n % 4 != 0) continue;
+				{
+					std::lock_guard<std::mutex> l(q.mutex);
+					completed.swap(q.blocks);
+				}
+				for (auto const& loc : completed)
+				{
+					sb.erase(loc);
+					in_flight[block_index(loc)].store(false, std::memory_order_release);
+				}
+				n += std::int64_t(completed.size());
+				completed.clear();
+			}
+			ops += n;
+		});
+	}
+
+	// the network thread, inserting the blocks of incoming writes. Every
+	// location is only inserted once at a time
+	std::thread network([&]
+	{
+		std::int64_t n = 0;
+		std::size_t idx = 0;
+		while (!done.load(std::memory_order_relaxed))
+		{
+			idx = (idx + 1) % in_flight.size();
+			if (in_flight[idx].load(std::memory_order_acquire)) continue;
+			in_flight[idx].store(true, std::memory_order_relaxed);
+
+			int const i = int(idx);
+			torrent_location const loc{lt::storage_index_t(i / (num_pieces * blocks_per_piece))
+				, lt::piece_index_t(i / blocks_per_piece % num_pieces)
+				, i % blocks_per_piece * lt::default_block_size};
+			sb.insert(loc, buffer);
+			++n;
+			write_queue& q = queues[idx % queues.size()];
+			std::lock_guard<std::mutex> l(q.mutex);
+			q.blocks.push_back(loc);
+		}
+		ops += n;
+	});
+
+	std::this_thread::sleep_for(duration);
+	done = true;
+	network.join();
+	for (auto& t : threads) t.join();
+
+	return double(ops.load()) / lt::total_microseconds(duration) * 1000000.;
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int seconds = 2;
+	std::vector<int> thread_counts;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == '-' && argv[i][1] == 's' && i + 1 < argc)
+		{
+			seconds = std::atoi(argv[++i]);
+			continue;
+		}
+		int const n = std::atoi(argv[i]);
+		if (n <= 0)
+		{
+			std::fprintf(stderr, "usage: bench_store_buffer [-s seconds] [threads...]\n");
+			return 1;
+		}
+		thread_counts.push_back(n);
+	}
+	if (thread_counts.empty()) thread_counts = {8, 16, 32};
+
+	for (int const n : thread_counts)
+	{
+		double const single = bench<single_mutex_store_buffer>(n, lt::seconds(seconds));
+		double const sharded = bench<lt::aux::store_buffer>(n, lt::seconds(seconds));
+		std::printf("disk threads: %2d single mutex: %6.2f Mops/s sharded: %6.2f Mops/s (%.1fx)\n"
+			, n, single / 1000000., sharded / 1000000., sharded / single);
+	}
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+// measures the cost of one session tick as the number of torrents grows. Each
+// torrent has a deadline it needs to be woken up for (like a tracker
+// announce) and is otherwise idle. It compares looping over every torrent on
+// each tick, checking its deadline, to scheduling the deadlines with the
+// session's timer wheel.
+//
+// usage: bench_torrent_tick [-t ticks] [torrents...]
+//
+// The number of torrents defaults to 1000, 10000, 100000 and 1000000. Each
+// run simulates one hour (3600 ticks) by default.
+
+#include "libtorrent/aux_/timer_wheel.hpp"
+#include "libtorrent/time.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+// a torrent is woken up every 30 minutes, give or take
+std::int64_t next_deadline(std::mt19937& rng, std::int64_t const now)
+{
+	return now + 1500 + std::int64_t(rng() % 600);
+}
+
+struct scanned_torrent
+{
+	std::int64_t deadline;
+	int woken = 0;
+};
+
+struct wheel_torrent final : lt::aux::timer_entry
+{
+	wheel_torrent(lt::aux::timer_wheel& w, std::mt19937& r)
+		: wheel(w), rng(r) {}
+	void on_timer() override
+	{
+		++woken;
+		wheel.schedule(*this, next_deadline(rng, wheel.now()));
+	}
+	lt::aux::timer_wheel& wheel;
+	std::mt19937& rng;
+	int woken = 0;
+};
+
+struct result
+{
+	// nanoseconds per tick
+	double ns;
+	std::int64_t woken;
+};
+
+result bench_scan(int const num_torrents, int const ticks)
+{
+	std::mt19937 rng(0x1337);
+	std::vector<scanned_torrent> torrents(static_cast<std::size_t>(num_torrents));
+	for (auto& t : torrents)
+		t.deadline = std::int64_t(rng() % 1800);
+
+	lt::time_point const start = lt::clock_type::now();
+	for (std::int64_t now = 0; now < ticks; ++now)
+	{
+		for (auto& t : torrents)
+		{
+			if (t.deadline > now) continue;
+			++t.woken;
+			t.deadline = next_deadline(rng, now);
+		}
+	}
+	lt::time_point const end = lt::clock_type::now();
+
+	std::int64_t woken = 0;
+	for (auto const& t : torrents) woken += t.woken;
+	return {double(lt::total_microseconds(end - start)) * 1000. / ticks, woken};
+}
+
+result bench_wheel(int const num_torrents, int const ticks)
+{
+	std::mt19937 rng(0x1337);
+	lt::aux::timer_wheel wheel(0);
+	std::vector<std::unique_ptr<wheel_torrent>> torrents;
+	torrents.reserve(static_cast<std::size_t>(num_torrents));
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		torrents.emplace_back(new wheel_torrent(wheel, rng));
+		wheel.schedule(*torrents.back(), std::int64_t(rng() % 1800));
+	}
+
+	lt::time_point const start = lt::clock_type::now();
+	for (std::int64_t now = 0; now < ticks; ++now)
+	{
+		wheel.advance(now);
+		while (lt::aux::timer_entry* e = wheel.pop_expired())
+			e->on_timer();
+	}
+	lt::time_point const end = lt::clock_type::now();
+
+	std::int64_t woken = 0;
+	for (auto const& t : torrents) woken += t->woken;
+	return {double(lt::total_microseconds(end - start)) * 1000. / ticks, woken};
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int ticks = 3600;
+	std::vector<int> torrent_counts;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == '-' && argv[i][1] == 't' && i + 1 < argc)
+		{
+			ticks = std::max(1, std::atoi(argv[++i]));
+			continue;
+		}
+		int const n = std::atoi(argv[i]);
+		if (n <= 0)
+		{
+			std::fprintf(stderr, "usage: bench_torrent_tick [-t ticks] [torrents...]\n");
+			return 1;
+		}
+		torrent_counts.push_back(n);
+	}
+	if (torrent_counts.empty()) torrent_counts = {1000, 10000, 100000, 1000000};
+
+	for (int const n : torrent_counts)
+	{
+		result const scan = bench_scan(n, ticks);
+		result const wheel = bench_wheel(n, ticks);
+		std::printf("torrents: %7d loop: %10.0f ns/tick timer wheel: %8.0f ns/tick (%.1fx)"
+			" wake-ups: %lld / %lld\n"
+			, n, scan.ns, wheel.ns, scan.ns / wheel.ns
+			, static_cast<long long>(scan.woken), static_cast<long long>(wheel.woken));
+	}
+	return 0;
+}
@@ -0,0 +1,253 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// measures the compression ratio and the single-core decompression
+// throughput of the codecs supported for zip web seeds. Pieces are decoded
+// the same way the inflate thread pool does it, into 16 kiB blocks, with a
+// decoder that's reused across pieces.
+//
+// usage: bench_zip_codec [-p piece-size] [-l level] [file...]
+//
+// The files are split into pieces, like a torrent would be. Without any
+// files, a synthetic, moderately compressible payload is used. Benchmark
+// on real payloads where possible, the ratio and speed of every codec
+// depend heavily on the data.
+
+#include "libtorrent/aux_/zip_decoder.hpp"
+#include "libtorrent/zip_codec.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/time.hpp"
+#include "libtorrent/span.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using piece_list = std::vector<std::vector<char>>;
+
+void print_usage()
+{
+	std::fprintf(stderr, "usage: bench_zip_codec [-p piece-size] [-l level] [file...]\n"
+		"\n"
+		"  -p piece-size  the size of each piece, in kiB (default: 1024)\n"
+		"  -l level       the compression level, overrides each codec's default\n");
+}
+
+bool load_pieces(char const* filename, int const piece_size, piece_list& pieces)
+{
+	FILE* f = std::fopen(filename, "rb");
+	if (f == nullptr)
+	{
+		std::fprintf(stderr, "failed to open \"%s\": %s\n", filename, std::strerror(errno));
+		return false;
+	}
+	for (;;)
+	{
+		std::vector<char> piece(std::size_t(piece_size), 0);
+		std::size_t const n = std::fread(piece.data(), 1, piece.size(), f);
+		if (n == 0) break;
+		piece.resize(n);
+		pieces.push_back(std::move(piece));
+	}
+	std::fclose(f);
+	return true;
+}
+
+// text-like data with a small alphabet and lots of short repeats
+piece_list synthetic_pieces(int const piece_size)
+{
+	std::mt19937 rng(0x1337);
+	piece_list pieces(32, std::vector<char>(std::size_t(piece_size)));
+	for (auto& p : pieces)
+	{
+		std::size_t i = 0;
+		while (i < p.size())
+		{
+			if (i > 64 && rng() % 3 == 0)
+			{
+				std::size_t const dist = 1 + rng() % 64;
+				std::size_t const len = std::min(p.size() - i, std::size_t(4 + rng() % 16));
+				for (std::size_t k = 0; k < len; ++k, ++i) p[i] = p[i - dist];
+			}
+			else
+			{
+				p[i++] = char('a' + rng() % 20);
+			}
+		}
+	}
+	return pieces;
+}
+
+double mb_per_s(std::int64_t const bytes, lt::time_duration const d)
+{
+	std::int64_t const us = std::max(std::int64_t(1), lt::total_microseconds(d));
+	return double(bytes) / double(us);
+}
+
+void bench(lt::zip_codec const codec, int const level, piece_list const& pieces)
+{
+	std::int64_t total_size = 0;
+	std::int64_t compressed_size = 0;
+	piece_list compressed(pieces.size());
+
+	lt::time_point start = lt::clock_type::now();
+	for (std::size_t i = 0; i < pieces.size(); ++i)
+	{
+		if (!lt::aux::zip_compress(codec, pieces[i], compressed[i], level))
+		{
+			std::fprintf(stderr, "%s: failed to compress piece %d\n"
+				, lt::zip_codec_name(codec), int(i));
+			return;
+		}
+		total_size += std::int64_t(pieces[i].size());
+		compressed_size += std::int64_t(compressed[i].size());
+	}
+	lt::time_duration const compress_time = lt::clock_type::now() - start;
+
+	auto decoder = lt::aux::make_zip_decoder(codec);
+	std::vector<char> block(lt::default_block_size);
+
+	// decode the whole payload enough times to run for about a second
+	int rounds = 0;
+	std::int64_t decoded = 0;
+	start = lt::clock_type::now();
+	lt::time_duration decode_time;
+	do
+	{
+		for (std::size_t i = 0; i < compressed.size(); ++i)
+		{
+			if (!decoder->reset())
+			{
+				std::fprintf(stderr, "%s: failed to initialize decoder\n"
+					, lt::zip_codec_name(codec));
+				return;
+			}
+			lt::span<char const> in(compressed[i]);
+			std::size_t piece_offset = 0;
+			for (;;)
+			{
+				lt::span<char> out(block);
+				auto const ret = decoder->decode(in, out);
+				std::size_t const n = block.size() - std::size_t(out.size());
+				if (n > 0 && std::memcmp(block.data(), pieces[i].data() + piece_offset, n) != 0)
+				{
+					std::fprintf(stderr, "%s: piece %d decoded incorrectly\n"
+						, lt::zip_codec_name(codec), int(i));
+					return;
+				}
+				piece_offset += n;
+				if (ret == lt::aux::zip_decoder::status::end) break;
+				if (ret == lt::aux::zip_decoder::status::ok) continue;
+				std::fprintf(stderr, "%s: failed to decode piece %d\n"
+					, lt::zip_codec_name(codec), int(i));
+				return;
+			}
+		}
+		decoded += total_size;
+		++rounds;
+		decode_time = lt::clock_type::now() - start;
+	} while (decode_time < lt::seconds(1));
+
+	std::printf("%-6s level: %2d ratio: %5.1f %% compress: %7.1f MB/s decompress: %7.1f MB/s (%d rounds)\n"
+		, lt::zip_codec_name(codec), level
+		, double(compressed_size) * 100. / double(std::max(std::int64_t(1), total_size))
+		, mb_per_s(total_size, compress_time)
+		, mb_per_s(decoded, decode_time)
+		, rounds);
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int piece_size = 1024 * 1024;
+	int level = -1;
+	std::vector<char const*> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] != '-')
+		{
+			files.push_back(argv[i]);
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			print_usage();
+			return 1;
+		}
+		switch (argv[i][1])
+		{
+			case 'p': piece_size = std::atoi(argv[++i]) * 1024; break;
+			case 'l': level = std::atoi(argv[++i]); break;
+			default: print_usage(); return 1;
+		}
+	}
+
+	if (piece_size <= 0)
+	{
+		print_usage();
+		return 1;
+	}
+
+	piece_list pieces;
+	for (char const* f : files)
+		if (!load_pieces(f, piece_size, pieces)) return 1;
+	if (pieces.empty()) pieces = synthetic_pieces(piece_size);
+
+	// the default levels are the ones create_torrent would typically be
+	// configured with
+	struct { lt::zip_codec codec; int level; } const codecs[] = {
+		{lt::zip_codec::zlib, 2},
+		{lt::zip_codec::zlib, 6},
+		{lt::zip_codec::zstd, 3},
+		{lt::zip_codec::zstd, 9},
+	};
+
+	for (auto const& c : codecs)
+	{
+		if (!lt::zip_codec_supported(c.codec))
+		{
+			std::printf("%-6s not supported by this build\n", lt::zip_codec_name(c.codec));
+			continue;
+		}
+		bench(c.codec, level >= 0 ? level : c.level, pieces);
+	}
+	return 0;
+}
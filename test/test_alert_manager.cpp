@@ -362,3 +362,39 @@ TORRENT_TEST(recursive_alerts)
 }
 
 #endif // TORRENT_DISABLE_EXTENSIONS
+
+// the network thread posts alerts while the client drains them. Every alert
+// must be delivered exactly once, in order
+TORRENT_TEST(concurrent_get_all)
+{
+	int const num_alerts = 100000;
+	aux::alert_manager mgr(std::numeric_limits<int>::max(), alert_category::all);
+
+	std::thread posting_thread([&mgr]
+	{
+		for (auto i = 0_piece; i < piece_index_t(num_alerts); ++i)
+			mgr.emplace_alert<piece_finished_alert>(torrent_handle(), i);
+	});
+
+	std::vector<alert*> alerts;
+	int received = 0;
+	bool in_order = true;
+	while (received < num_alerts)
+	{
+		if (mgr.wait_for_alert(seconds(10)) == nullptr) break;
+		mgr.get_all(alerts);
+		for (alert* a : alerts)
+		{
+			auto* pf = alert_cast<piece_finished_alert>(a);
+			if (pf == nullptr || pf->piece_index != piece_index_t(received))
+				in_order = false;
+			++received;
+		}
+	}
+	posting_thread.join();
+
+	TEST_EQUAL(received, num_alerts);
+	TEST_CHECK(in_order);
+	mgr.get_all(alerts);
+	TEST_CHECK(alerts.empty());
+}
@@ -182,10 +182,11 @@ TORRENT_TEST(alerts_types)
 	TEST_ALERT_TYPE(alerts_dropped_alert, 95, alert_priority::meta, alert_category::error);
 	TEST_ALERT_TYPE(socks5_alert, 96, alert_priority::normal, alert_category::error);
 	TEST_ALERT_TYPE(file_prio_alert, 97, alert_priority::normal, alert_category::storage);
+	TEST_ALERT_TYPE(state_delta_alert, 98, alert_priority::high, alert_category::status);
 
 #undef TEST_ALERT_TYPE
 
-	TEST_EQUAL(num_alert_types, 98);
+	TEST_EQUAL(num_alert_types, 99);
 	TEST_EQUAL(num_alert_types, count_alert_types);
 }
 
@@ -280,6 +281,44 @@ TORRENT_TEST(session_stats_alert)
 #endif
 }
 
+TORRENT_TEST(state_delta_alert)
+{
+	aux::alert_manager mgr(1, {});
+
+	std::vector<torrent_status_delta> deltas(2);
+	deltas[0].id = 1;
+	deltas[0].fields = torrent_status_delta::progress_field | torrent_status_delta::name_field;
+	deltas[0].progress_ppm = 500000;
+	deltas[0].name_offset = 0;
+	deltas[1].id = 2;
+	deltas[1].fields = torrent_status_delta::tracker_field;
+	deltas[1].tracker_offset = 5;
+
+	std::string const strings("test\0http://tracker.com/announce\0", 33);
+	mgr.emplace_alert<state_delta_alert>(deltas, strings);
+
+	std::vector<alert*> alerts;
+	mgr.get_all(alerts);
+	TEST_EQUAL(alerts.size(), 1);
+
+	auto const* a = alert_cast<state_delta_alert>(alerts[0]);
+	TEST_CHECK(a != nullptr);
+	auto const d = a->deltas();
+	TEST_EQUAL(d.size(), 2);
+	TEST_EQUAL(d[0].id, 1);
+	TEST_EQUAL(d[0].progress_ppm, 500000);
+	TEST_EQUAL(a->name(d[0]), std::string("test"));
+	TEST_CHECK(a->current_tracker(d[0]) == nullptr);
+	TEST_EQUAL(d[1].id, 2);
+	TEST_CHECK(d[1].fields == torrent_status_delta::tracker_field);
+	TEST_EQUAL(a->current_tracker(d[1]), std::string("http://tracker.com/announce"));
+	TEST_CHECK(a->name(d[1]) == nullptr);
+	TEST_CHECK(a->save_path(d[1]) == nullptr);
+#ifndef TORRENT_DISABLE_ALERT_MSG
+	TEST_EQUAL(a->message(), "state deltas for 2 torrents");
+#endif
+}
+
 TORRENT_TEST(dht_sample_infohashes_alert)
 {
 	aux::alert_manager mgr(1, dht_sample_infohashes_alert::static_category);
@@ -429,3 +429,112 @@ TORRENT_TEST(bitfield_index_range)
 	TEST_EQUAL(sum, 15 * 16 / 2);
 }
 
+
+namespace {
+
+// fill the bitfield with a pseudo random pattern, with about one bit in
+// ``sparseness`` set
+void fill_random(bitfield& b, int const sparseness)
+{
+	for (int i = 0; i < b.size(); ++i)
+	{
+		if (std::rand() % sparseness == 0) b.set_bit(i);
+		else b.clear_bit(i);
+	}
+}
+
+}
+
+TORRENT_TEST(count_and)
+{
+	// cover the vectorized loops as well as the scalar tails
+	for (int const size : {1, 31, 32, 33, 255, 256, 257, 511, 512, 513, 3000})
+	{
+		for (int const sparseness : {1, 2, 7, 100})
+		{
+			bitfield a(size);
+			bitfield b(size);
+			fill_random(a, sparseness);
+			fill_random(b, 3);
+
+			int expect_and = 0;
+			int expect_and_not = 0;
+			int expect_count = 0;
+			for (int i = 0; i < size; ++i)
+			{
+				if (a.get_bit(i)) ++expect_count;
+				if (a.get_bit(i) && b.get_bit(i)) ++expect_and;
+				if (a.get_bit(i) && !b.get_bit(i)) ++expect_and_not;
+			}
+			TEST_EQUAL(a.count(), expect_count);
+			TEST_EQUAL(a.count_and(b), expect_and);
+			TEST_EQUAL(b.count_and(a), expect_and);
+			TEST_EQUAL(a.count_and_not(b), expect_and_not);
+		}
+	}
+}
+
+TORRENT_TEST(count_and_empty)
+{
+	bitfield a;
+	bitfield b;
+	TEST_EQUAL(a.count_and(b), 0);
+	TEST_EQUAL(a.count_and_not(b), 0);
+	TEST_EQUAL(a.find_next_set_and(b, 0), -1);
+}
+
+TORRENT_TEST(count_and_not_full)
+{
+	// the bits past the end of the last word must not be counted
+	bitfield a(1001, true);
+	bitfield b(1001, false);
+	TEST_EQUAL(a.count_and_not(b), 1001);
+	TEST_EQUAL(b.count_and_not(a), 0);
+	TEST_EQUAL(a.count_and(a), 1001);
+}
+
+TORRENT_TEST(find_next_set_and)
+{
+	for (int const size : {1, 31, 32, 33, 255, 256, 257, 511, 512, 513, 3000})
+	{
+		for (int const sparseness : {1, 7, 100, 1000})
+		{
+			bitfield a(size);
+			bitfield b(size);
+			fill_random(a, sparseness);
+			fill_random(b, 3);
+
+			// visit every bit set in both, and make sure none were skipped
+			int prev = -1;
+			for (int i = a.find_next_set_and(b, 0); i != -1;
+				i = i + 1 < size ? a.find_next_set_and(b, i + 1) : -1)
+			{
+				TEST_CHECK(i > prev);
+				TEST_CHECK(a.get_bit(i) && b.get_bit(i));
+				for (int k = prev + 1; k < i; ++k)
+					TEST_CHECK(!(a.get_bit(k) && b.get_bit(k)));
+				prev = i;
+			}
+			for (int k = prev + 1; k < size; ++k)
+				TEST_CHECK(!(a.get_bit(k) && b.get_bit(k)));
+		}
+	}
+}
+
+TORRENT_TEST(find_next_set_and_bounds)
+{
+	bitfield a(300, true);
+	bitfield b(300, false);
+	TEST_EQUAL(a.find_next_set_and(b, 0), -1);
+	b.set_bit(299);
+	TEST_EQUAL(a.find_next_set_and(b, 0), 299);
+	TEST_EQUAL(a.find_next_set_and(b, 299), 299);
+	TEST_EQUAL(a.find_next_set_and(b, 300), -1);
+	b.set_bit(33);
+	TEST_EQUAL(a.find_next_set_and(b, 0), 33);
+	TEST_EQUAL(a.find_next_set_and(b, 33), 33);
+	TEST_EQUAL(a.find_next_set_and(b, 34), 299);
+
+	typed_bitfield<int> ta(a);
+	TEST_EQUAL(ta.find_next_set_and(b, 34), 299);
+}
@@ -309,3 +309,54 @@ TORRENT_TEST(chained_buffer)
 	}
 	TEST_CHECK(buffer_list.empty());
 }
+
+TORRENT_TEST(chained_buffer_slab)
+{
+	char hdr[] = "0123456789abc";
+	{
+		chained_buffer b;
+
+		// small messages are copied into the slab
+		TEST_CHECK(b.append_to_slab({hdr, 13}));
+		TEST_EQUAL(b.size(), 13);
+		TEST_EQUAL(b.capacity(), 13);
+		TEST_EQUAL(b.space_in_last_buffer(), 0);
+
+		// the last buffer can grow into the rest of the slab
+		TEST_CHECK(b.append({hdr, 4}) != nullptr);
+		TEST_EQUAL(b.size(), 17);
+		TEST_CHECK(compare_chained_buffer(b, "0123456789abc0123", 17));
+
+		char* b1 = allocate_buffer(512);
+		std::memcpy(b1, "foobar", 6);
+		b.append_buffer(holder(b1, 6), 6);
+
+		// once another buffer follows it, the slab buffer is frozen
+		TEST_CHECK(b.append({hdr, 2}) == nullptr);
+
+		TEST_CHECK(b.append_to_slab({hdr, 3}));
+		TEST_EQUAL(b.size(), 26);
+		TEST_CHECK(compare_chained_buffer(b, "0123456789abc0123foobar012", 26));
+
+		// messages too large for the slab are rejected
+		std::vector<char> large(chained_buffer::max_slab_message + 1);
+		TEST_CHECK(!b.append_to_slab(large));
+
+		// fill up more than one slab
+		for (int i = 0; i < chained_buffer::slab_size / 13 * 2; ++i)
+			TEST_CHECK(b.append_to_slab({hdr, 13}));
+
+		b.pop_front(b.size());
+		TEST_CHECK(b.empty());
+		TEST_EQUAL(b.capacity(), 0);
+
+		// the slab is reused from the start once everything has been sent
+		TEST_CHECK(b.append_to_slab({hdr, 13}));
+		TEST_CHECK(compare_chained_buffer(b, hdr, 13));
+		b.pop_front(5);
+		TEST_CHECK(compare_chained_buffer(b, "56789abc", 8));
+		TEST_CHECK(b.append({hdr, 2}) != nullptr);
+		TEST_CHECK(compare_chained_buffer(b, "56789abc01", 10));
+	}
+	TEST_CHECK(buffer_list.empty());
+}
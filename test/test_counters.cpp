@@ -0,0 +1,116 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/performance_counters.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace lt;
+
+TORRENT_TEST(counters_inc)
+{
+	counters c;
+	TEST_EQUAL(c[counters::on_read_counter], 0);
+	c.inc_stats_counter(counters::on_read_counter);
+	c.inc_stats_counter(counters::on_read_counter, 10);
+	TEST_EQUAL(c[counters::on_read_counter], 11);
+	TEST_EQUAL(c[counters::on_write_counter], 0);
+}
+
+TORRENT_TEST(counters_inc_returns_value)
+{
+	counters c;
+	std::thread t([&c] { c.add_stats_counter(counters::recv_bytes, 100); });
+	t.join();
+	TEST_EQUAL(c.inc_stats_counter(counters::recv_bytes, 10), 110);
+	TEST_EQUAL(c.inc_stats_counter(counters::queued_write_bytes, 16), 16);
+	TEST_EQUAL(c.inc_stats_counter(counters::queued_write_bytes, -6), 10);
+}
+
+TORRENT_TEST(counters_threads)
+{
+	counters c;
+	int const num_threads = 20;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < num_threads; ++i)
+	{
+		threads.emplace_back([&c] {
+			for (int k = 0; k < 10000; ++k)
+			{
+				c.add_stats_counter(counters::sent_bytes, 3);
+				c.add_stats_counter(counters::disk_blocks_in_use, 1);
+				c.add_stats_counter(counters::disk_blocks_in_use, -1);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	TEST_EQUAL(c[counters::sent_bytes], num_threads * 10000 * 3);
+	TEST_EQUAL(c[counters::disk_blocks_in_use], 0);
+}
+
+TORRENT_TEST(counters_set_value)
+{
+	counters c;
+	std::thread t([&c] { c.inc_stats_counter(counters::num_peers_connected, 5); });
+	t.join();
+	c.inc_stats_counter(counters::num_peers_connected, 2);
+	TEST_EQUAL(c[counters::num_peers_connected], 7);
+
+	c.set_value(counters::num_peers_connected, 3);
+	TEST_EQUAL(c[counters::num_peers_connected], 3);
+
+	c.inc_stats_counter(counters::num_peers_connected, -1);
+	TEST_EQUAL(c[counters::num_peers_connected], 2);
+
+	c.blend_stats_counter(counters::num_peers_connected, 12, 50);
+	TEST_EQUAL(c[counters::num_peers_connected], 7);
+}
+
+TORRENT_TEST(counters_copy)
+{
+	counters c;
+	std::thread t([&c] { c.inc_stats_counter(counters::recv_bytes, 100); });
+	t.join();
+	c.inc_stats_counter(counters::recv_bytes, 10);
+
+	counters c2(c);
+	TEST_EQUAL(c2[counters::recv_bytes], 110);
+
+	counters c3;
+	c3.inc_stats_counter(counters::recv_bytes, 1000);
+	c3 = c;
+	TEST_EQUAL(c3[counters::recv_bytes], 110);
+}
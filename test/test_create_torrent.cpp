@@ -44,11 +44,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/escape_string.hpp" // for convert_path_to_posix
 #include "libtorrent/announce_entry.hpp"
 #include "libtorrent/units.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/miniz.hpp"
+#include "libtorrent/aux_/zip_decoder.hpp"
 
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <stdexcept>
 
 using namespace std::literals::string_literals;
 
@@ -523,3 +528,163 @@ TORRENT_TEST(piece_layer)
 	TEST_CHECK(info.piece_layer(1_file).size() == lt::sha256_hash::size());
 	TEST_CHECK(info.piece_layer(2_file).size() == lt::sha256_hash::size());
 }
+
+TORRENT_TEST(set_piece_hashes_zip)
+{
+	lt::error_code ec;
+	lt::create_directories("test-zip-torrent", ec);
+	{
+		std::ofstream f1("test-zip-torrent/file-1", std::ios::binary);
+		for (int i = 0; i < 100000; ++i) f1.put(char(i % 7 * (i % 13)));
+		std::ofstream f2("test-zip-torrent/file-2", std::ios::binary);
+		for (int i = 0; i < 50000; ++i) f2.put(char(i % 251));
+	}
+
+	lt::file_storage fs1;
+	lt::add_files(fs1, "test-zip-torrent");
+	lt::create_torrent ref(fs1, 0x4000);
+	lt::set_piece_hashes(ref, ".");
+
+	lt::file_storage fs2;
+	lt::add_files(fs2, "test-zip-torrent");
+	lt::create_torrent t(fs2, 0x4000);
+	t.add_zip_web_seed("http://example.com/test-zip-torrent.dat");
+
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::hashing_threads, 3);
+	int num_pieces = 0;
+	lt::set_piece_hashes_zip(t, ".", "test-zip-torrent.dat", pack
+		, [&](lt::piece_index_t const p)
+		{
+			// pieces are reported in order
+			TEST_EQUAL(static_cast<int>(p), num_pieces);
+			++num_pieces;
+		}, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(num_pieces, t.num_pieces());
+
+	// the hashes are the same as the ones set by set_piece_hashes()
+	lt::entry const e = t.generate();
+	TEST_CHECK(e["info"] == ref.generate()["info"]);
+
+	std::vector<char> buffer;
+	lt::bencode(std::back_inserter(buffer), e);
+	lt::torrent_info const ti(buffer, lt::from_span);
+	auto const& zip = ti.const_zip_web_seeds();
+	TEST_EQUAL(zip.urls.size(), 1);
+	TEST_EQUAL(int(zip.zip_level), t.zip_level());
+	TEST_EQUAL(zip.num_pieces(), ti.num_pieces());
+
+	std::vector<char> payload;
+	TEST_CHECK(load_file("test-zip-torrent.dat", payload, ec, 1000000) == 0);
+	TEST_EQUAL(std::uint64_t(payload.size()), zip.total_size);
+
+	// every piece inflates to the data it was hashed from
+	for (lt::piece_index_t const i : ti.piece_range())
+	{
+		auto const zp = zip.piece(i);
+		std::vector<char> piece(std::size_t(ti.piece_size(i)));
+		mz_ulong len = mz_ulong(piece.size());
+		TEST_EQUAL(mz_uncompress(reinterpret_cast<unsigned char*>(piece.data()), &len
+			, reinterpret_cast<unsigned char const*>(payload.data() + zp.offset), zp.size), MZ_OK);
+		TEST_EQUAL(len, piece.size());
+		TEST_EQUAL(lt::hasher(piece).final(), ti.hash_for_piece(i));
+	}
+}
+
+TORRENT_TEST(set_piece_hashes_zip_throwing_callback)
+{
+	lt::error_code ec;
+	lt::create_directories("test-zip-throw", ec);
+	{
+		std::ofstream f("test-zip-throw/file", std::ios::binary);
+		for (int i = 0; i < 100000; ++i) f.put(char(i % 7 * (i % 13)));
+	}
+
+	lt::file_storage fs;
+	lt::add_files(fs, "test-zip-throw");
+	lt::create_torrent t(fs, 0x4000);
+	t.add_zip_web_seed("http://example.com/test-zip-throw.dat");
+
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::hashing_threads, 3);
+
+	// the worker threads are stopped while the exception propagates
+	bool thrown = false;
+	try
+	{
+		lt::set_piece_hashes_zip(t, ".", "test-zip-throw.dat", pack
+			, [](lt::piece_index_t const p)
+			{
+				if (p == 1_piece) throw std::runtime_error("abort");
+			}, ec);
+	}
+	catch (std::runtime_error const&)
+	{
+		thrown = true;
+	}
+	TEST_CHECK(thrown);
+}
+
+TORRENT_TEST(set_piece_hashes_zip_codec)
+{
+	lt::error_code ec;
+	lt::create_directories("test-zip-codec", ec);
+	{
+		std::ofstream f("test-zip-codec/file", std::ios::binary);
+		for (int i = 0; i < 100000; ++i) f.put(char(i % 7 * (i % 13)));
+	}
+
+	lt::file_storage fs;
+	lt::add_files(fs, "test-zip-codec");
+	lt::create_torrent t(fs, 0x4000);
+	t.add_zip_web_seed("http://example.com/test-zip-codec.dat");
+	t.set_zip_codec(lt::zip_codec::zstd);
+	t.set_zip_level(3);
+
+	lt::set_piece_hashes_zip(t, ".", "test-zip-codec.dat", [](lt::piece_index_t) {}, ec);
+	if (!lt::zip_codec_supported(lt::zip_codec::zstd))
+	{
+		TEST_EQUAL(ec, lt::error_code(boost::asio::error::operation_not_supported));
+
+		// a torrent whose pieces are compressed with a codec we don't
+		// support doesn't get any zip web seeds
+		lt::set_piece_hashes(t, ".");
+		for (lt::piece_index_t const i : fs.piece_range())
+			t.set_zip_piece_size(i, 100);
+		std::vector<char> buffer;
+		lt::bencode(std::back_inserter(buffer), t.generate());
+		lt::torrent_info const ti(buffer, lt::from_span);
+		TEST_CHECK(ti.const_zip_web_seeds().urls.empty());
+		return;
+	}
+	TEST_CHECK(!ec);
+
+	lt::entry const e = t.generate();
+	TEST_EQUAL(e["zipinfo"]["codec"].string(), "zstd");
+
+	std::vector<char> buffer;
+	lt::bencode(std::back_inserter(buffer), e);
+	lt::torrent_info const ti(buffer, lt::from_span);
+	auto const& zip = ti.const_zip_web_seeds();
+	TEST_EQUAL(zip.urls.size(), 1);
+	TEST_CHECK(zip.codec == lt::zip_codec::zstd);
+
+	std::vector<char> payload;
+	TEST_CHECK(load_file("test-zip-codec.dat", payload, ec, 1000000) == 0);
+
+	auto decoder = lt::aux::make_zip_decoder(zip.codec);
+	TEST_CHECK(decoder);
+	for (lt::piece_index_t const i : ti.piece_range())
+	{
+		auto const zp = zip.piece(i);
+		std::vector<char> piece(std::size_t(ti.piece_size(i)));
+		lt::span<char const> in(payload.data() + zp.offset, std::ptrdiff_t(zp.size));
+		lt::span<char> out(piece);
+		TEST_CHECK(decoder->reset());
+		TEST_CHECK(decoder->decode(in, out) == lt::aux::zip_decoder::status::end);
+		TEST_CHECK(in.empty());
+		TEST_CHECK(out.empty());
+		TEST_EQUAL(lt::hasher(piece).final(), ti.hash_for_piece(i));
+	}
+}
@@ -0,0 +1,232 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/disk_observer.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+using lt::aux::disk_buffer_pool;
+
+namespace {
+
+struct test_observer final : lt::disk_observer
+{
+	void on_disk() override { ++called; }
+	int called = 0;
+};
+
+void free_all(disk_buffer_pool& pool, std::vector<char*>& bufs)
+{
+	for (char* b : bufs) pool.free_buffer(b);
+	bufs.clear();
+}
+
+}
+
+TORRENT_TEST(disk_buffer_pool_allocate)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes, 16 * 1024 * 1024);
+	pool.set_settings(pack);
+
+	// more than fits in one region
+	int const num_blocks = 2 * disk_buffer_pool::region_size / lt::default_block_size;
+	std::vector<char*> bufs;
+	std::set<char*> unique;
+	for (int i = 0; i < num_blocks; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		TEST_EQUAL(reinterpret_cast<std::uintptr_t>(b) % lt::default_block_size, 0);
+		TEST_CHECK(pool.is_disk_buffer(b));
+		std::memset(b, i & 0xff, lt::default_block_size);
+		bufs.push_back(b);
+		unique.insert(b);
+	}
+	TEST_EQUAL(int(unique.size()), num_blocks);
+	TEST_EQUAL(pool.in_use(), num_blocks);
+
+	// the buffers don't overlap
+	for (int i = 0; i < int(bufs.size()); ++i)
+	{
+		TEST_EQUAL(bufs[std::size_t(i)][0], char(i & 0xff));
+		TEST_EQUAL(bufs[std::size_t(i)][lt::default_block_size - 1], char(i & 0xff));
+	}
+
+	free_all(pool, bufs);
+	TEST_EQUAL(pool.in_use(), 0);
+
+	// freed blocks are reused
+	char* b = pool.allocate_buffer("test");
+	TEST_CHECK(unique.count(b) == 1);
+	pool.free_buffer(b);
+}
+
+TORRENT_TEST(disk_buffer_pool_partial_regions)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes, 32 * 1024 * 1024);
+	pool.set_settings(pack);
+
+	int const num_blocks = 4 * disk_buffer_pool::region_size / lt::default_block_size;
+	std::vector<char*> bufs;
+	for (int i = 0; i < num_blocks; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		bufs.push_back(b);
+	}
+
+	// free every other block, leaving all regions partially used. They're
+	// all allocated from again, before any new region
+	std::vector<char*> kept;
+	std::set<char const*> regions;
+	for (int i = 0; i < int(bufs.size()); ++i)
+	{
+		char* const b = bufs[std::size_t(i)];
+		regions.insert(disk_buffer_pool::region_base(b));
+		if (i % 2) pool.free_buffer(b);
+		else kept.push_back(b);
+	}
+
+	std::set<char*> unique(kept.begin(), kept.end());
+	std::vector<char*> again;
+	for (int i = 0; i < num_blocks / 2; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		TEST_CHECK(unique.insert(b).second);
+		TEST_CHECK(regions.count(disk_buffer_pool::region_base(b)) == 1);
+		again.push_back(b);
+	}
+	TEST_EQUAL(pool.in_use(), num_blocks);
+
+	free_all(pool, kept);
+	free_all(pool, again);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+TORRENT_TEST(disk_buffer_pool_ownership)
+{
+	lt::io_context ios;
+	lt::settings_pack pack;
+	disk_buffer_pool pool1(ios);
+	disk_buffer_pool pool2(ios);
+	pool1.set_settings(pack);
+	pool2.set_settings(pack);
+
+	char* b1 = pool1.allocate_buffer("test");
+	char* b2 = pool2.allocate_buffer("test");
+	TEST_CHECK(pool1.is_disk_buffer(b1));
+	TEST_CHECK(!pool1.is_disk_buffer(b2));
+	TEST_CHECK(pool2.is_disk_buffer(b2));
+	TEST_CHECK(!pool2.is_disk_buffer(b1));
+	pool1.free_buffer(b1);
+	pool2.free_buffer(b2);
+}
+
+TORRENT_TEST(disk_buffer_pool_watermark)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes, 8 * lt::default_block_size);
+	pool.set_settings(pack);
+
+	auto o = std::make_shared<test_observer>();
+	std::vector<char*> bufs;
+	bool exceeded = false;
+	while (!exceeded)
+	{
+		char* b = pool.allocate_buffer(exceeded, o, "test");
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		bufs.push_back(b);
+	}
+	// the high watermark is half way between the low watermark and the max
+	TEST_EQUAL(int(bufs.size()), 6);
+
+	free_all(pool, bufs);
+	ios.run();
+	TEST_EQUAL(o->called, 1);
+}
+
+TORRENT_TEST(disk_buffer_pool_threads)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes, 16 * 1024 * 1024);
+	pool.set_settings(pack);
+
+	// buffers are allocated on one thread and freed on another, like the
+	// network thread and the disk threads do
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&pool]
+		{
+			std::vector<char*> bufs;
+			for (int i = 0; i < 2000; ++i)
+			{
+				char* b = pool.allocate_buffer("test");
+				TEST_CHECK(b != nullptr);
+				if (b == nullptr) break;
+				std::memset(b, 0, 64);
+				bufs.push_back(b);
+				if (bufs.size() == 100)
+				{
+					std::thread([&] { free_all(pool, bufs); }).join();
+				}
+			}
+			free_all(pool, bufs);
+		});
+	}
+	for (auto& t : threads) t.join();
+	TEST_EQUAL(pool.in_use(), 0);
+}
@@ -0,0 +1,114 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_job_pool.hpp"
+#include "libtorrent/aux_/disk_io_job.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace lt;
+
+TORRENT_TEST(disk_job_pool_in_use)
+{
+	aux::disk_job_pool pool;
+
+	aux::disk_io_job* r = pool.allocate_job(aux::job_action_t::read);
+	aux::disk_io_job* w = pool.allocate_job(aux::job_action_t::write);
+	aux::disk_io_job* h = pool.allocate_job(aux::job_action_t::hash);
+	TEST_CHECK(r->action == aux::job_action_t::read);
+	TEST_CHECK(w->action == aux::job_action_t::write);
+	TEST_CHECK(h->action == aux::job_action_t::hash);
+	TEST_EQUAL(pool.jobs_in_use(), 3);
+	TEST_EQUAL(pool.read_jobs_in_use(), 1);
+	TEST_EQUAL(pool.write_jobs_in_use(), 1);
+
+	pool.free_job(r);
+	TEST_EQUAL(pool.jobs_in_use(), 2);
+	TEST_EQUAL(pool.read_jobs_in_use(), 0);
+
+	aux::disk_io_job* jobs[] = { w, h };
+	pool.free_jobs(jobs, 2);
+	TEST_EQUAL(pool.jobs_in_use(), 0);
+	TEST_EQUAL(pool.write_jobs_in_use(), 0);
+}
+
+TORRENT_TEST(disk_job_pool_cache)
+{
+	aux::disk_job_pool pool;
+
+	// the first allocation refills this thread's job cache, the following
+	// ones are served from it
+	std::vector<aux::disk_io_job*> jobs;
+	for (int i = 0; i < 10; ++i)
+		jobs.push_back(pool.allocate_job(aux::job_action_t::hash));
+	TEST_EQUAL(pool.cache_misses(), 1);
+	TEST_EQUAL(pool.cache_hits(), 9);
+
+	// freed jobs go back to the cache they're allocated from next
+	pool.free_jobs(jobs.data(), int(jobs.size()));
+	for (auto& j : jobs) j = pool.allocate_job(aux::job_action_t::hash);
+	TEST_EQUAL(pool.cache_misses(), 1);
+	TEST_EQUAL(pool.cache_hits(), 19);
+	pool.free_jobs(jobs.data(), int(jobs.size()));
+	TEST_EQUAL(pool.jobs_in_use(), 0);
+}
+
+TORRENT_TEST(disk_job_pool_threads)
+{
+	aux::disk_job_pool pool;
+
+	// jobs are allocated on one thread and freed on another, the way the
+	// disk threads hand completed jobs back to the network thread
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&pool]
+		{
+			for (int round = 0; round < 100; ++round)
+			{
+				std::vector<aux::disk_io_job*> jobs;
+				for (int i = 0; i < 100; ++i)
+					jobs.push_back(pool.allocate_job(i % 2
+						? aux::job_action_t::read : aux::job_action_t::write));
+				std::thread([&] { pool.free_jobs(jobs.data(), int(jobs.size())); }).join();
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	TEST_EQUAL(pool.jobs_in_use(), 0);
+	TEST_EQUAL(pool.read_jobs_in_use(), 0);
+	TEST_EQUAL(pool.write_jobs_in_use(), 0);
+}
@@ -941,6 +941,66 @@ TORRENT_TEST(dont_have)
 	print_session_log(*ses);
 }
 
+// makes sure a run of HAVE messages arriving in a single read are all applied
+TORRENT_TEST(have_run)
+{
+	using namespace lt::aux;
+
+	std::cout << "\n === test have run ===\n" << std::endl;
+
+	info_hash_t ih;
+	torrent_handle th;
+	std::shared_ptr<lt::session> ses;
+	io_context ios;
+	tcp::socket s(ios);
+	setup_peer(s, ios, ih, ses, true, false, false, torrent_flags_t{}, &th);
+
+	char recv_buffer[1000];
+	do_handshake(s, ih, recv_buffer);
+	print_session_log(*ses);
+	send_have_none(s);
+	print_session_log(*ses);
+
+	// a run of HAVE messages, with a redundant one, interrupted by a
+	// keepalive and followed by a second run
+	char msg[200];
+	char* ptr = msg;
+	for (int const piece : {0, 2, 5, 2, 7})
+	{
+		write_uint32(5, ptr);
+		write_uint8(4, ptr);
+		write_uint32(piece, ptr);
+	}
+	write_uint32(0, ptr);
+	for (int const piece : {9, 12})
+	{
+		write_uint32(5, ptr);
+		write_uint8(4, ptr);
+		write_uint32(piece, ptr);
+	}
+
+	error_code ec;
+	boost::asio::write(s, boost::asio::buffer(msg, std::size_t(ptr - msg))
+		, boost::asio::transfer_all(), ec);
+	if (ec) TEST_ERROR(ec.message());
+
+	std::this_thread::sleep_for(lt::milliseconds(500));
+	print_session_log(*ses);
+
+	std::vector<peer_info> pi;
+	th.get_peer_info(pi);
+
+	TEST_EQUAL(pi.size(), 1);
+	if (pi.size() != 1) return;
+
+	TEST_EQUAL(pi[0].pieces.count(), 6);
+	for (piece_index_t const i : {0_piece, 2_piece, 5_piece, 7_piece, 9_piece, 12_piece})
+		TEST_CHECK(pi[0].pieces[i]);
+	TEST_CHECK(pi[0].flags & peer_info::interesting);
+
+	print_session_log(*ses);
+}
+
 TORRENT_TEST(extension_handshake)
 {
 	using namespace lt::aux;
@@ -0,0 +1,335 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/inflate_thread_pool.hpp"
+#include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/aux_/zip_decoder.hpp"
+#include "libtorrent/zip_codec.hpp"
+
+#include <vector>
+#include <random>
+#include <functional>
+#include <algorithm>
+
+using namespace lt;
+
+namespace {
+
+std::vector<char> make_payload(int const size, char const seed)
+{
+	std::vector<char> ret(static_cast<std::size_t>(size));
+	for (int i = 0; i < size; ++i)
+		ret[std::size_t(i)] = char(seed + (i % 7) * (i % 13));
+	return ret;
+}
+
+// collects the blocks of one piece, as they are delivered
+struct piece_collector
+{
+	explicit piece_collector(int const bs) : block_size(bs) {}
+
+	void add(int const start, std::vector<disk_buffer_holder> const& blocks)
+	{
+		// blocks are delivered in order, without gaps
+		TEST_EQUAL(start, int(data.size()));
+		for (auto const& b : blocks)
+		{
+			// only the last block may be short
+			TEST_CHECK(b.size() <= block_size);
+			TEST_CHECK(short_block == false);
+			if (b.size() < block_size) short_block = true;
+			data.insert(data.end(), b.data(), b.data() + b.size());
+		}
+	}
+
+	int block_size;
+	bool short_block = false;
+	std::vector<char> data;
+};
+
+// feeds ``compressed`` to the stream, ``chunk_size`` bytes at a time
+void feed(aux::inflate_thread_pool& pool
+	, std::shared_ptr<aux::inflate_stream> const& s
+	, std::vector<char> const& compressed, int const unzip_length
+	, int const block_size, int const chunk_size
+	, std::function<void(error_code const&, int, std::vector<disk_buffer_holder>, bool)> h)
+{
+	for (std::size_t i = 0; i < compressed.size(); i += std::size_t(chunk_size))
+	{
+		std::size_t const end = std::min(compressed.size(), i + std::size_t(chunk_size));
+		bool const last = end == compressed.size();
+		pool.async_inflate(s, std::vector<char>(compressed.begin() + std::ptrdiff_t(i)
+			, compressed.begin() + std::ptrdiff_t(end)), unzip_length, block_size, last
+			, [h, last](error_code const& ec, int const start, std::vector<disk_buffer_holder> blocks)
+			{ h(ec, start, std::move(blocks), last); });
+	}
+}
+
+std::vector<char> compress_buffer(std::vector<char> const& buf
+	, zip_codec const c = zip_codec::zlib)
+{
+	std::vector<char> ret;
+	TEST_CHECK(aux::zip_compress(c, buf, ret, 3));
+	return ret;
+}
+
+std::vector<zip_codec> supported_codecs()
+{
+	std::vector<zip_codec> ret;
+	for (zip_codec const c : {zip_codec::zlib, zip_codec::zstd})
+		if (zip_codec_supported(c)) ret.push_back(c);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(inflate_in_order)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::inflate_threads, 2);
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+
+	auto const s0 = pool.open_stream(zip_codec::zlib);
+	auto const s1 = pool.open_stream(zip_codec::zlib);
+	TEST_CHECK(s0 != s1);
+
+	std::vector<std::vector<char>> payloads;
+	for (int i = 0; i < 10; ++i)
+		payloads.push_back(make_payload(0x4000 * (i + 1) - i, char(i)));
+
+	int num_done = 0;
+	std::vector<piece_collector> pieces(10, piece_collector(default_block_size));
+	for (int i = 0; i < 10; ++i)
+	{
+		// alternate between the two streams, feeding whole pieces
+		auto const& s = (i & 1) ? s1 : s0;
+		pool.async_inflate(s, compress_buffer(payloads[std::size_t(i)])
+			, int(payloads[std::size_t(i)].size()), default_block_size, true
+			, [&, i](error_code const& ec, int const start, std::vector<disk_buffer_holder> blocks)
+		{
+			TEST_CHECK(!ec);
+			pieces[std::size_t(i)].add(start, blocks);
+			TEST_CHECK(pieces[std::size_t(i)].data == payloads[std::size_t(i)]);
+			++num_done;
+		});
+	}
+
+	while (num_done < 10) ios.run_one();
+
+	TEST_EQUAL(cnt[counters::queued_inflate_jobs], 0);
+	pool.abort(true);
+}
+
+TORRENT_TEST(inflate_streaming)
+{
+	io_context ios;
+	aux::session_settings sett;
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+
+	// a payload that doesn't compress well, to have the blocks trickle out
+	// as the compressed bytes arrive
+	std::mt19937 rng(0x1337);
+	std::vector<char> payload(0x4000 * 4 + 123);
+	for (auto& c : payload) c = char(rng() % 4);
+
+	for (zip_codec const codec : supported_codecs())
+	for (int const chunk_size : {1, 100, 0x1000, 0x4000})
+	{
+		auto const s = pool.open_stream(codec);
+		std::vector<char> const compressed = compress_buffer(payload, codec);
+
+		piece_collector piece(default_block_size);
+		int blocks_before_last = 0;
+		bool done = false;
+		feed(pool, s, compressed, int(payload.size()), default_block_size, chunk_size
+			, [&](error_code const& ec, int const start
+				, std::vector<disk_buffer_holder> blocks, bool const last)
+		{
+			TEST_CHECK(!ec);
+			TEST_CHECK(!done);
+			if (!last) blocks_before_last += int(blocks.size());
+			piece.add(start, blocks);
+			done = last;
+		});
+
+		while (!done) ios.run_one();
+		TEST_CHECK(piece.data == payload);
+		// the blocks are not held back until the end of the piece. zstd
+		// can't produce any output until it has a whole compressed block
+		// (up to 128 kiB), which this piece fits in
+		if (codec == zip_codec::zlib) TEST_CHECK(blocks_before_last >= 3);
+	}
+	pool.abort(true);
+}
+
+TORRENT_TEST(inflate_small_blocks)
+{
+	io_context ios;
+	aux::session_settings sett;
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+
+	// torrents with pieces smaller than 16 kiB also have smaller blocks
+	std::vector<char> const payload = make_payload(0x2000 * 3 + 100, 'x');
+	bool done = false;
+	pool.async_inflate(pool.open_stream(zip_codec::zlib), compress_buffer(payload), int(payload.size())
+		, 0x2000, true
+		, [&](error_code const& ec, int const start, std::vector<disk_buffer_holder> blocks)
+	{
+		TEST_CHECK(!ec);
+		TEST_EQUAL(start, 0);
+		TEST_EQUAL(blocks.size(), 4);
+		piece_collector piece(0x2000);
+		piece.add(start, blocks);
+		TEST_CHECK(piece.data == payload);
+		done = true;
+	});
+
+	while (!done) ios.run_one();
+	pool.abort(true);
+}
+
+TORRENT_TEST(inflate_corrupt)
+{
+	io_context ios;
+	aux::session_settings sett;
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+	std::vector<char> const payload = make_payload(0x10000, 'a');
+
+	for (zip_codec const codec : supported_codecs())
+	{
+		auto const s = pool.open_stream(codec);
+
+		std::vector<char> compressed = compress_buffer(payload, codec);
+		compressed[compressed.size() / 2] ^= 0x55;
+		compressed.resize(compressed.size() - 4);
+
+		int num_errors = 0;
+		bool done = false;
+		feed(pool, s, compressed, int(payload.size()), default_block_size, 16
+			, [&](error_code const& ec, int, std::vector<disk_buffer_holder> blocks, bool const last)
+		{
+			if (ec)
+			{
+				TEST_EQUAL(ec, error_code(errors::http_failed_decompress));
+				++num_errors;
+			}
+			// nothing is delivered once the piece has failed
+			if (num_errors > 0) TEST_CHECK(blocks.empty());
+			done = last;
+		});
+
+		while (!done) ios.run_one();
+		TEST_EQUAL(num_errors, 1);
+
+		// the stream recovers for the next piece
+		compressed = compress_buffer(payload, codec);
+		piece_collector piece(default_block_size);
+		done = false;
+		feed(pool, s, compressed, int(payload.size()), default_block_size, 100
+			, [&](error_code const& ec, int const start, std::vector<disk_buffer_holder> blocks, bool const last)
+		{
+			TEST_CHECK(!ec);
+			piece.add(start, blocks);
+			done = last;
+		});
+
+		while (!done) ios.run_one();
+		TEST_CHECK(piece.data == payload);
+	}
+	pool.abort(true);
+}
+
+TORRENT_TEST(inflate_trailing_data)
+{
+	io_context ios;
+	aux::session_settings sett;
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+	std::vector<char> const payload = make_payload(0x8000, 'b');
+
+	// a piece whose compressed stream is followed by garbage is corrupt,
+	// even though it inflates to the right size
+	for (zip_codec const codec : supported_codecs())
+	{
+		std::vector<char> compressed = compress_buffer(payload, codec);
+		compressed.push_back('x');
+
+		int num_errors = 0;
+		bool done = false;
+		feed(pool, pool.open_stream(codec), compressed, int(payload.size())
+			, default_block_size, 1000
+			, [&](error_code const& ec, int, std::vector<disk_buffer_holder>, bool const last)
+		{
+			if (ec) ++num_errors;
+			done = last;
+		});
+
+		while (!done) ios.run_one();
+		TEST_EQUAL(num_errors, 1);
+	}
+	pool.abort(true);
+}
+
+TORRENT_TEST(inflate_unsupported_codec)
+{
+	if (zip_codec_supported(zip_codec::zstd)) return;
+
+	io_context ios;
+	aux::session_settings sett;
+	counters cnt;
+	aux::inflate_thread_pool pool(ios, sett, cnt);
+
+	// every piece fails on a stream for a codec this build doesn't support
+	std::vector<char> const payload = make_payload(0x4000, 'c');
+	bool done = false;
+	pool.async_inflate(pool.open_stream(zip_codec::zstd), compress_buffer(payload)
+		, int(payload.size()), default_block_size, true
+		, [&](error_code const& ec, int, std::vector<disk_buffer_holder> blocks)
+	{
+		TEST_EQUAL(ec, error_code(errors::http_failed_decompress));
+		TEST_CHECK(blocks.empty());
+		done = true;
+	});
+
+	while (!done) ios.run_one();
+	pool.abort(true);
+}
@@ -111,6 +111,47 @@ TORRENT_TEST(mmap_write)
 	}
 }
 
+TORRENT_TEST(mmap_advise)
+{
+	std::vector<char> buf = filled_buffer(100000);
+
+	{
+		std::ofstream file("test_file3", std::ios::binary);
+		file.write(buf.data(), std::streamsize(buf.size()));
+	}
+
+	auto m = std::make_shared<file_mapping>(aux::file_handle("test_file3", 100000, open_mode::read_only)
+		, open_mode::read_only, 100000
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+		, std::make_shared<std::mutex>()
+#endif
+		);
+
+	file_view v = m->view();
+#if TORRENT_USE_MADVISE
+	auto const expect = advice_result::applied;
+#else
+	auto const expect = advice_result::skipped;
+#endif
+
+	// hints applying to the whole mapping are only passed on once
+	TEST_CHECK(v.advise(advice_t::sequential, 0, 100000) == expect);
+	TEST_CHECK(v.advise(advice_t::sequential, 0, 100000) == advice_result::skipped);
+
+	// ranges don't need to be page aligned
+	TEST_CHECK(v.advise(advice_t::will_need, 5000, 16384) == expect);
+	TEST_CHECK(v.advise(advice_t::cold, 5000, 16384) == expect);
+
+	// ranges outside of the file are ignored
+	TEST_CHECK(v.advise(advice_t::will_need, 100000, 16384) == advice_result::skipped);
+
+	// the mapping is still intact after having been advised as cold
+	for (auto const i : boost::combine(v.range(), buf))
+	{
+		if (boost::get<0>(i) != boost::get<1>(i)) TEST_ERROR("mmap view mismatching");
+	}
+}
+
 #else
 
 TORRENT_TEST(dummy) {}
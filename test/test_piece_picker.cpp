@@ -616,6 +616,28 @@ TORRENT_TEST(dec_refcount_split_seed)
 	TEST_CHECK(avail[4_piece] != 0);
 }
 
+TORRENT_TEST(inc_refcount_run)
+{
+	// a run of HAVE messages bumps the availability of each of its pieces
+	auto p = setup_picker("1111111", "       ", "1111111", "");
+	std::vector<piece_index_t> const run{2_piece, 4_piece, 5_piece};
+	p->inc_refcount(run, &tmp0);
+	p->inc_refcount(span<piece_index_t const>(run).first(2), &tmp1);
+
+	aux::vector<int, piece_index_t> avail;
+	p->get_availability(avail);
+	TEST_EQUAL(avail.size(), 7);
+	TEST_EQUAL(avail[0_piece], 1);
+	TEST_EQUAL(avail[2_piece], 3);
+	TEST_EQUAL(avail[4_piece], 3);
+	TEST_EQUAL(avail[5_piece], 2);
+	TEST_EQUAL(avail[6_piece], 1);
+
+	// the pieces nobody else has are still picked first
+	TEST_CHECK(test_pick(p) != 2_piece);
+	TEST_CHECK(test_pick(p) != 4_piece);
+}
+
 TORRENT_TEST(resize)
 {
 	// make sure init preserves priorities
@@ -1676,6 +1698,48 @@ TORRENT_TEST(piece_passed)
 	TEST_EQUAL(p->have_piece(2_piece), true);
 }
 
+TORRENT_TEST(wanted_pieces)
+{
+	auto p = setup_picker("1111111", "*      ", "", "0300000");
+	auto const peer = string2vec(" ** ***");
+
+	TEST_EQUAL(p->num_wanted_pieces(peer), 5);
+	TEST_CHECK(!p->is_wanted(0_piece));
+	TEST_CHECK(p->is_wanted(1_piece));
+
+	// passing the hash check makes a piece unwanted, before it's written to
+	// disk, and without changing the epoch
+	auto epoch = p->wanted_epoch();
+	p->piece_passed(1_piece);
+	TEST_CHECK(!p->is_wanted(1_piece));
+	TEST_EQUAL(p->num_wanted_pieces(peer), 4);
+	TEST_EQUAL(p->wanted_epoch(), epoch);
+
+	p->we_have(1_piece);
+	TEST_EQUAL(p->num_wanted_pieces(peer), 4);
+	TEST_EQUAL(p->wanted_epoch(), epoch);
+
+	// filtering a piece changes the epoch
+	p->set_piece_priority(4_piece, dont_download);
+	TEST_CHECK(!p->is_wanted(4_piece));
+	TEST_EQUAL(p->num_wanted_pieces(peer), 3);
+	TEST_CHECK(p->wanted_epoch() != epoch);
+
+	// as does having a piece that never passed the hash check, like when
+	// it's loaded from resume data
+	epoch = p->wanted_epoch();
+	p->we_have(5_piece);
+	TEST_EQUAL(p->num_wanted_pieces(peer), 2);
+	TEST_CHECK(p->wanted_epoch() != epoch);
+
+	// and losing one
+	epoch = p->wanted_epoch();
+	p->we_dont_have(1_piece);
+	TEST_CHECK(p->is_wanted(1_piece));
+	TEST_EQUAL(p->num_wanted_pieces(peer), 3);
+	TEST_CHECK(p->wanted_epoch() != epoch);
+}
+
 TORRENT_TEST(piece_passed_causing_we_have)
 {
 	auto p = setup_picker("1111111", "*      ", "", "0700000");
@@ -2487,6 +2551,52 @@ TORRENT_TEST(piece_extent_affinity_no_duplicates)
 	TEST_CHECK(picked == full_piece(9_piece, blocks));
 }
 
+TORRENT_TEST(rarest_first_sparse_peer)
+{
+	// when a peer has only a few of the pieces we're missing, they are found
+	// by scanning the bitfields. They must still be picked rarest first, and
+	// pieces we have or that are filtered must not be picked
+	int const num_pieces = 1024;
+	auto p = std::make_shared<piece_picker>(1, 1, num_pieces);
+
+	typed_bitfield<piece_index_t> all(num_pieces, true);
+	p->inc_refcount(all, &tmp0);
+
+	auto const peer = [&](std::initializer_list<int> pieces)
+	{
+		typed_bitfield<piece_index_t> ret(num_pieces, false);
+		for (int const i : pieces) ret.set_bit(piece_index_t(i));
+		return ret;
+	};
+	p->inc_refcount(peer({100, 500, 700}), &tmp1);
+	p->inc_refcount(peer({100, 500, 700}), &tmp2);
+	p->inc_refcount(peer({100, 300}), &tmp3);
+
+	p->we_have(300_piece);
+	p->set_piece_priority(700_piece, dont_download);
+
+	std::vector<piece_block> picked;
+	counters pc;
+	p->pick_pieces(peer({100, 300, 500, 700, 900}), picked, 10, 0, nullptr
+		, piece_picker::rarest_first, empty_vector, 20, pc);
+	TEST_EQUAL(int(picked.size()), 3);
+	TEST_CHECK(verify_pick(p, picked));
+	TEST_CHECK(picked.size() == 3
+		&& picked[0] == piece_block(900_piece, 0)
+		&& picked[1] == piece_block(500_piece, 0)
+		&& picked[2] == piece_block(100_piece, 0));
+	// only a few pieces are visited before the bitfields are scanned,
+	// rather than all of them
+	TEST_CHECK(pc[counters::piece_picker_rare_loops] < 100);
+
+	// a peer with every piece walks the pickable pieces, rarest first
+	picked.clear();
+	p->pick_pieces(all, picked, 1, 0, nullptr
+		, piece_picker::rarest_first, empty_vector, 20, pc);
+	TEST_EQUAL(int(picked.size()), 1);
+	TEST_CHECK(picked.size() == 1 && p->get_availability(picked[0].piece_index) == 1);
+}
+
 TORRENT_TEST(piece_block_exported)
 {
 	// piece_block is part of the public API via picker_log_alert::blocks
@@ -167,6 +167,33 @@ TORRENT_TEST(recv_buffer_reserve)
 	TEST_CHECK(range2.size() >= 50);
 }
 
+TORRENT_TEST(recv_buffer_unparsed)
+{
+	receive_buffer b;
+	TEST_EQUAL(b.unparsed().size(), 0);
+
+	b.reset(5);
+	auto range = b.reserve(20);
+	for (int i = 0; i < 20; ++i) range[i] = char(i);
+	b.received(20);
+
+	TEST_EQUAL(b.unparsed().size(), 20);
+
+	// consume the first packet
+	b.advance_pos(20);
+	TEST_EQUAL(b.pos(), 5);
+	TEST_EQUAL(b.unparsed().size(), 15);
+	TEST_EQUAL(b.unparsed()[0], 5);
+
+	// the next packet starts right after it
+	b.reset(10);
+	TEST_EQUAL(b.unparsed().size(), 15);
+	b.advance_pos(15);
+	TEST_EQUAL(b.unparsed().size(), 5);
+	TEST_EQUAL(b.unparsed()[0], 15);
+	TEST_EQUAL(b.get()[0], 5);
+}
+
 TORRENT_TEST(receive_buffer_normalize)
 {
 	receive_buffer b;
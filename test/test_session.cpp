@@ -49,6 +49,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <functional>
 #include <fstream>
+#include <map>
 
 using namespace std::placeholders;
 using namespace lt;
@@ -253,6 +254,145 @@ TORRENT_TEST(paused_session)
 	TEST_CHECK(!(h.flags() & torrent_flags::paused));
 }
 
+namespace {
+
+struct delta_record
+{
+	torrent_status_delta delta;
+	std::string name;
+	std::string save_path;
+};
+
+// posts a compact state update and returns its records, by torrent id
+std::map<std::uint32_t, delta_record> post_deltas(lt::session& ses)
+{
+	ses.post_torrent_updates();
+	auto const* a = alert_cast<state_delta_alert>(
+		wait_for_alert(ses, state_delta_alert::alert_type, "ses"));
+	TEST_CHECK(a != nullptr);
+	std::map<std::uint32_t, delta_record> ret;
+	if (a == nullptr) return ret;
+	for (auto const& d : a->deltas())
+	{
+		delta_record& r = ret[d.id];
+		r.delta = d;
+		if (char const* n = a->name(d)) r.name = n;
+		if (char const* sp = a->save_path(d)) r.save_path = sp;
+	}
+	return ret;
+}
+
+torrent_handle add_delta_torrent(lt::session& ses, char const* name)
+{
+	add_torrent_params atp;
+	atp.info_hashes.v1 = lt::sha1_hash(name);
+	atp.name = name;
+	atp.save_path = ".";
+	atp.flags &= ~torrent_flags::auto_managed;
+	atp.flags |= torrent_flags::paused;
+	return ses.add_torrent(std::move(atp));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(compact_state_updates)
+{
+	settings_pack p = settings();
+	p.set_int(settings_pack::alert_mask, alert_category::status);
+	p.set_bool(settings_pack::compact_state_updates, true);
+	lt::session ses(p);
+
+	torrent_handle const h1 = add_delta_torrent(ses, "delta-torrent-1.....");
+	torrent_handle const h2 = add_delta_torrent(ses, "delta-torrent-2.....");
+
+	// wait for the torrents to settle in their initial state, to not have
+	// it change between updates
+	for (int i = 0; i < 100; ++i)
+	{
+		if (h1.status().state == torrent_status::downloading_metadata
+			&& h2.status().state == torrent_status::downloading_metadata)
+			break;
+		std::this_thread::sleep_for(lt::milliseconds(50));
+	}
+
+	using sd = torrent_status_delta;
+
+	// the first record of a torrent is complete, strings included
+	auto deltas = post_deltas(ses);
+	TEST_EQUAL(deltas.size(), 2);
+	for (auto const& h : {h1, h2})
+	{
+		auto const& r = deltas[h.id()];
+		TEST_CHECK(r.delta.fields & sd::state_field);
+		TEST_CHECK(r.delta.fields & sd::flags_field);
+		TEST_CHECK(r.delta.fields & sd::transfer_field);
+		TEST_CHECK(r.delta.fields & sd::queue_position_field);
+		TEST_CHECK(r.delta.fields & sd::name_field);
+		TEST_CHECK(r.delta.fields & sd::save_path_field);
+		TEST_CHECK(r.delta.flags & torrent_flags::paused);
+		TEST_CHECK(!r.save_path.empty());
+	}
+	TEST_EQUAL(deltas[h1.id()].name, "delta-torrent-1.....");
+	TEST_EQUAL(deltas[h2.id()].name, "delta-torrent-2.....");
+
+	// nothing changed
+	deltas = post_deltas(ses);
+	TEST_CHECK(deltas.empty());
+
+	// only what changed is included. Unchanged strings aren't sent again
+	h1.set_flags(torrent_flags::upload_mode);
+	deltas = post_deltas(ses);
+	TEST_EQUAL(deltas.size(), 1);
+	TEST_EQUAL(deltas.count(h1.id()), 1);
+	{
+		auto const& r = deltas[h1.id()];
+		TEST_CHECK(r.delta.fields & sd::flags_field);
+		TEST_CHECK(r.delta.flags & torrent_flags::upload_mode);
+		TEST_CHECK(!(r.delta.fields & sd::state_field));
+		TEST_CHECK(!(r.delta.fields & sd::name_field));
+		TEST_CHECK(!(r.delta.fields & sd::save_path_field));
+		TEST_CHECK(r.name.empty());
+	}
+
+	// torrents past the batch size are carried over to the next update
+	p.set_int(settings_pack::state_update_batch_size, 1);
+	ses.apply_settings(p);
+	h1.unset_flags(torrent_flags::upload_mode);
+	h2.set_flags(torrent_flags::upload_mode);
+	deltas = post_deltas(ses);
+	TEST_EQUAL(deltas.size(), 1);
+	TEST_EQUAL(deltas.count(h1.id()), 1);
+	deltas = post_deltas(ses);
+	TEST_EQUAL(deltas.size(), 1);
+	TEST_EQUAL(deltas.count(h2.id()), 1);
+	deltas = post_deltas(ses);
+	TEST_CHECK(deltas.empty());
+
+	// if the update is dropped because the alert queue is full, the records
+	// are sent again, in full, with the next update
+	p.set_int(settings_pack::state_update_batch_size, 0);
+	p.set_int(settings_pack::alert_queue_size, 1);
+	ses.apply_settings(p);
+	ses.post_session_stats();
+	ses.post_session_stats();
+	h2.unset_flags(torrent_flags::upload_mode);
+	ses.post_torrent_updates();
+	wait_for_alert(ses, session_stats_alert::alert_type, "ses");
+
+	p.set_int(settings_pack::alert_queue_size, 1000);
+	ses.apply_settings(p);
+	deltas = post_deltas(ses);
+	TEST_EQUAL(deltas.size(), 1);
+	TEST_EQUAL(deltas.count(h2.id()), 1);
+	{
+		auto const& r = deltas[h2.id()];
+		TEST_CHECK(!(r.delta.flags & torrent_flags::upload_mode));
+		TEST_CHECK(r.delta.fields & sd::state_field);
+		TEST_CHECK(r.delta.fields & sd::name_field);
+		TEST_EQUAL(r.name, "delta-torrent-2.....");
+	}
+}
+
 template <typename Set, typename Save, typename Test>
 void test_save_restore(Set setup, Save s, Test t)
 {
@@ -58,6 +58,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/random.hpp"
 #include "libtorrent/mmap_disk_io.hpp"
 #include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
 
 #include <memory>
 #include <functional> // for bind
@@ -1761,3 +1762,388 @@ TORRENT_TEST(posix_unaligned_read_both_store_buffer)
 	test_unaligned_read(lt::posix_disk_io_constructor, second_side_from_store_buffer);
 	test_unaligned_read(lt::posix_disk_io_constructor, none_from_store_buffer);
 }
+
+TORRENT_TEST(posix_disk_io_completion_batch)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::file_pool_size, 2);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::posix_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", lt::default_block_size * 8);
+	fs.set_num_pieces(1);
+	fs.set_piece_length(lt::default_block_size * 8);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(lt::default_block_size * 8);
+	aux::random_bytes(write_buffer);
+
+	int outstanding = 0;
+	for (int i = 0; i < 8; ++i)
+	{
+		lt::peer_request const req{0_piece, i * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_write(t, req, write_buffer.data() + req.start, {}, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// all 8 write handlers are called by a single message
+	TEST_EQUAL(cnt[lt::counters::disk_completion_batch4], 1);
+
+	// the handlers are called in the order the jobs were issued
+	std::vector<int> order;
+	for (int i = 0; i < 8; ++i)
+	{
+		lt::peer_request const req{0_piece, i * lt::default_block_size, lt::default_block_size};
+		lt::span<char const> const expected(write_buffer.data() + req.start, req.length);
+		++outstanding;
+		disk_io->async_read(t, req, [&, i, expected](lt::disk_buffer_holder h, lt::storage_error const& ec)
+		{
+			read_handler(outstanding, expected)(std::move(h), ec);
+			order.push_back(i);
+		});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	TEST_EQUAL(cnt[lt::counters::disk_completion_batch4], 2);
+	TEST_CHECK((order == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}));
+
+	std::int64_t latency = 0;
+	for (int i = lt::counters::disk_completion_latency4;
+		i <= lt::counters::disk_completion_latency15; ++i)
+		latency += cnt[i];
+	TEST_EQUAL(latency, 2);
+
+	disk_io->remove_torrent(t);
+	disk_io->abort(true);
+}
+
+namespace {
+
+void test_posix_read_ahead(int const threads)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, threads);
+	pack.set_int(lt::settings_pack::read_cache_line_size, 8);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::posix_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", lt::default_block_size * 16);
+	fs.set_num_pieces(1);
+	fs.set_piece_length(lt::default_block_size * 16);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+	delete_dirs(combine_path(save_path, "renamed"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(lt::default_block_size * 16);
+	aux::random_bytes(write_buffer);
+
+	auto block = [](int const i)
+	{ return lt::peer_request{0_piece, i * lt::default_block_size, lt::default_block_size}; };
+
+	int outstanding = 0;
+	auto read = [&](int const i)
+	{
+		lt::peer_request const req = block(i);
+		++outstanding;
+		disk_io->async_read(t, req, read_handler(outstanding
+			, {write_buffer.data() + req.start, req.length}));
+	};
+
+	for (int i = 0; i < 16; ++i)
+	{
+		lt::peer_request const req = block(i);
+		++outstanding;
+		disk_io->async_write(t, req, write_buffer.data() + req.start, {}, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// a cache miss reads the rest of the cache line along with the block
+	read(0);
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::num_read_ops], 1);
+	TEST_EQUAL(cnt[lt::counters::disk_read_ahead_blocks], 7);
+
+	// the following blocks are served from the read-ahead cache
+	for (int i = 1; i < 8; ++i) read(i);
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::num_read_ops], 1);
+	TEST_EQUAL(cnt[lt::counters::disk_read_ahead_hits], 7);
+
+	// adjacent requests are merged into a single read, followed by the
+	// read-ahead
+	for (int i = 8; i < 12; ++i) read(i);
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::num_read_ops], 2);
+	TEST_EQUAL(cnt[lt::counters::num_blocks_read], 16);
+	TEST_EQUAL(cnt[lt::counters::disk_read_ahead_blocks], 11);
+
+	// writing a block drops it from the read-ahead cache
+	aux::random_bytes(lt::span<char>(write_buffer).subspan(12 * lt::default_block_size
+		, lt::default_block_size));
+	++outstanding;
+	disk_io->async_write(t, block(12), write_buffer.data() + 12 * lt::default_block_size
+		, {}, write_handler(outstanding));
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	read(12);
+	read(13);
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::disk_read_ahead_hits], 8);
+	TEST_EQUAL(cnt[lt::counters::num_read_ops], 3);
+
+	// renaming the file is performed on the read threads, if there are
+	// any, and drops the read-ahead cache
+	++outstanding;
+	disk_io->async_rename_file(t, 0_file, "renamed"
+		, [&](std::string const& name, lt::file_index_t, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_CHECK(!ec);
+			TEST_EQUAL(name, "renamed");
+		});
+	sync(ioc, outstanding);
+	TEST_CHECK(exists(combine_path(save_path, "renamed")));
+
+	read(14);
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::disk_read_ahead_hits], 8);
+	TEST_EQUAL(cnt[lt::counters::num_read_ops], 4);
+
+	disk_io->remove_torrent(t);
+	disk_io->abort(true);
+}
+
+}
+
+TORRENT_TEST(posix_read_ahead)
+{
+	test_posix_read_ahead(0);
+}
+
+TORRENT_TEST(posix_read_ahead_threads)
+{
+	test_posix_read_ahead(2);
+}
+
+#if TORRENT_HAVE_IO_URING
+TORRENT_TEST(io_uring_unaligned_read_both_store_buffer)
+{
+	test_unaligned_read(lt::io_uring_disk_io_constructor, both_sides_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, first_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, second_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, none_from_store_buffer);
+}
+
+namespace {
+
+void test_io_uring_disk_io(int const hashing_threads)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::file_pool_size, 2);
+	pack.set_int(lt::settings_pack::hashing_threads, hashing_threads);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::io_uring_disk_io_constructor(ioc, pack, cnt);
+
+	// the blocks span files, and there are more files than the file pool
+	// may keep open
+	int const piece_size = lt::default_block_size * 4;
+	lt::file_storage fs;
+	fs.add_file("test/a", 1000);
+	fs.add_file("test/b", lt::default_block_size * 3);
+	fs.add_file("test/c", lt::default_block_size * 5 - 1000);
+	fs.set_num_pieces(2);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(std::size_t(fs.total_size()));
+	aux::random_bytes(write_buffer);
+
+	int outstanding = 0;
+	for (int i = 0; i < 8; ++i)
+	{
+		lt::peer_request const req{lt::piece_index_t(i / 4)
+			, (i % 4) * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_write(t, req, write_buffer.data() + i * lt::default_block_size
+			, {}, write_handler(outstanding));
+	}
+
+	// the hash job is issued along with the writes, and sees their data
+	lt::sha1_hash piece_hash;
+	++outstanding;
+	disk_io->async_hash(t, 1_piece, {}, lt::disk_interface::v1_hash
+		, [&](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_CHECK(!ec);
+			piece_hash = h;
+		});
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(piece_hash, lt::hasher(lt::span<char const>(write_buffer).subspan(piece_size)).final());
+
+	// release the files (a job on the storage as a whole) and read the data
+	// back
+	++outstanding;
+	disk_io->async_release_files(t, [&] { --outstanding; });
+	for (int i = 0; i < 8; ++i)
+	{
+		lt::peer_request const req{lt::piece_index_t(i / 4)
+			, (i % 4) * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_read(t, req, read_handler(outstanding
+			, {write_buffer.data() + i * lt::default_block_size, lt::default_block_size}));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	lt::sha256_hash block_hash;
+	++outstanding;
+	// piece 1 lies entirely within test/c, so its v2 size is a full piece
+	disk_io->async_hash2(t, 1_piece, lt::default_block_size, {}
+		, [&](lt::piece_index_t, lt::sha256_hash const& h, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_CHECK(!ec);
+			block_hash = h;
+		});
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(block_hash, lt::hasher256(lt::span<char const>(write_buffer)
+		.subspan(piece_size + lt::default_block_size, lt::default_block_size)).final());
+
+	TEST_EQUAL(cnt[lt::counters::num_blocks_written], 8);
+
+	disk_io->remove_torrent(t);
+	disk_io->abort(true);
+}
+
+}
+
+TORRENT_TEST(io_uring_disk_io)
+{
+	test_io_uring_disk_io(0);
+}
+
+TORRENT_TEST(io_uring_disk_io_hashing_threads)
+{
+	test_io_uring_disk_io(2);
+}
+
+TORRENT_TEST(io_uring_short_read)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::io_uring_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", lt::default_block_size * 2);
+	fs.set_num_pieces(1);
+	fs.set_piece_length(lt::default_block_size * 2);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(lt::default_block_size * 2);
+	aux::random_bytes(write_buffer);
+
+	// only write half of the second block, leaving the file short
+	int const half = lt::default_block_size / 2;
+	int outstanding = 0;
+	lt::peer_request const req0{0_piece, 0, lt::default_block_size};
+	lt::peer_request const req1{0_piece, lt::default_block_size, half};
+	++outstanding;
+	disk_io->async_write(t, req0, write_buffer.data(), {}, write_handler(outstanding));
+	++outstanding;
+	disk_io->async_write(t, req1, write_buffer.data() + lt::default_block_size
+		, {}, write_handler(outstanding));
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// the half block that's there is read, and the remainder hits the end
+	// of the file
+	++outstanding;
+	disk_io->async_read(t, {0_piece, lt::default_block_size, lt::default_block_size}
+		, [&](lt::disk_buffer_holder, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_EQUAL(ec.ec, lt::error_code(lt::errors::file_too_short));
+			TEST_CHECK(ec.operation == lt::operation_t::file_read);
+		});
+
+	// a read within the file succeeds
+	++outstanding;
+	disk_io->async_read(t, {0_piece, lt::default_block_size, half}
+		, read_handler(outstanding, {write_buffer.data() + lt::default_block_size, half}));
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	disk_io->remove_torrent(t);
+	disk_io->abort(true);
+}
+#endif
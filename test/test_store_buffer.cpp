@@ -34,6 +34,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/store_buffer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
 
+#include <thread>
+
 using lt::aux::torrent_location;
 using lt::aux::store_buffer;
 
@@ -184,3 +186,28 @@ TORRENT_TEST(store_buffer_get2)
 	check2_miss(sb, loc[7], loc[4]);
 }
 
+
+TORRENT_TEST(store_buffer_threads)
+{
+	store_buffer sb;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&sb, t]
+		{
+			lt::storage_index_t const st(t);
+			char buf;
+			for (int i = 0; i < 1000; ++i)
+			{
+				torrent_location const l0(st, lt::piece_index_t(i % 50), 0);
+				torrent_location const l1(st, lt::piece_index_t(i % 50), lt::default_block_size);
+				sb.insert(l0, &buf);
+				check(sb, l0, &buf);
+				check2(sb, l0, l1, &buf, nullptr);
+				sb.erase(l0);
+				check_miss(sb, l0);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+}
@@ -0,0 +1,198 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in
+the documentation and/or other materials provided with the distribution.
+* Neither the name of the author nor the names of its
+contributors may be used to endorse or promote products derived
+from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <random>
+
+using namespace lt;
+
+namespace {
+
+struct test_entry final : aux::timer_entry
+{
+	void on_timer() override { ++fired; }
+	int fired = 0;
+};
+
+// advances the wheel to now and returns the expired entries
+std::vector<aux::timer_entry*> advance(aux::timer_wheel& w, std::int64_t const now)
+{
+	w.advance(now);
+	std::vector<aux::timer_entry*> ret;
+	while (aux::timer_entry* e = w.pop_expired())
+	{
+		e->on_timer();
+		ret.push_back(e);
+	}
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(timer_wheel_expire)
+{
+	aux::timer_wheel w(100);
+	test_entry a;
+	test_entry b;
+	w.schedule(a, 105);
+	w.schedule(b, 103);
+	TEST_CHECK(a.scheduled());
+
+	TEST_CHECK(advance(w, 102).empty());
+	auto e = advance(w, 103);
+	TEST_EQUAL(e.size(), 1);
+	TEST_CHECK(e[0] == &b);
+	TEST_CHECK(!b.scheduled());
+	TEST_CHECK(a.scheduled());
+
+	e = advance(w, 110);
+	TEST_EQUAL(e.size(), 1);
+	TEST_CHECK(e[0] == &a);
+	TEST_EQUAL(a.fired, 1);
+	TEST_EQUAL(b.fired, 1);
+	TEST_EQUAL(w.now(), 110);
+}
+
+TORRENT_TEST(timer_wheel_past_deadline)
+{
+	aux::timer_wheel w(100);
+	test_entry a;
+	w.schedule(a, 50);
+	TEST_CHECK(advance(w, 100).empty());
+	TEST_EQUAL(advance(w, 101).size(), 1);
+}
+
+TORRENT_TEST(timer_wheel_cancel)
+{
+	aux::timer_wheel w(0);
+	test_entry a;
+	test_entry b;
+	test_entry c;
+	w.schedule(a, 10);
+	w.schedule(b, 10);
+	w.schedule(c, 10);
+	w.cancel(b);
+	TEST_CHECK(!b.scheduled());
+
+	// cancel an entry that has expired but not been popped yet
+	w.advance(10);
+	w.cancel(c);
+	TEST_CHECK(w.pop_expired() == &a);
+	TEST_CHECK(w.pop_expired() == nullptr);
+	TEST_EQUAL(b.fired, 0);
+	TEST_EQUAL(c.fired, 0);
+}
+
+TORRENT_TEST(timer_wheel_reschedule)
+{
+	aux::timer_wheel w(0);
+	test_entry a;
+	w.schedule(a, 10);
+	w.schedule(a, 5000);
+	TEST_CHECK(advance(w, 4999).empty());
+	TEST_EQUAL(advance(w, 5000).size(), 1);
+}
+
+TORRENT_TEST(timer_wheel_destruct_scheduled)
+{
+	aux::timer_wheel w(0);
+	test_entry a;
+	{
+		test_entry b;
+		w.schedule(b, 10);
+		w.schedule(a, 10);
+	}
+	auto const e = advance(w, 10);
+	TEST_EQUAL(e.size(), 1);
+	TEST_CHECK(e[0] == &a);
+}
+
+// deadlines on every level of the wheel, and beyond it, expire on the tick
+// they're scheduled for, no sooner and no later
+TORRENT_TEST(timer_wheel_levels)
+{
+	std::int64_t const start = 1000000;
+	aux::timer_wheel w(start);
+	std::vector<std::int64_t> const deltas = {1, 2, 63, 64, 65, 100, 4095, 4096
+		, 4097, 262143, 262144, 262145, 1000000, 16777215, 16777216, 20000000};
+	std::vector<test_entry> entries(deltas.size());
+	for (std::size_t i = 0; i < deltas.size(); ++i)
+		w.schedule(entries[i], start + deltas[i]);
+
+	for (auto const d : deltas)
+	{
+		TEST_CHECK(advance(w, start + d - 1).empty());
+		auto const e = advance(w, start + d);
+		TEST_EQUAL(e.size(), 1);
+		if (e.size() == 1) TEST_EQUAL(e[0]->deadline(), start + d);
+	}
+	for (auto const& e : entries) TEST_EQUAL(e.fired, 1);
+}
+
+// jumping further ahead than the wheel spans
+TORRENT_TEST(timer_wheel_jump)
+{
+	aux::timer_wheel w(0);
+	test_entry a;
+	test_entry b;
+	w.schedule(a, 100);
+	w.schedule(b, 40000000);
+	auto e = advance(w, 30000000);
+	TEST_EQUAL(e.size(), 1);
+	TEST_CHECK(e[0] == &a);
+	TEST_CHECK(advance(w, 39999999).empty());
+	e = advance(w, 40000000);
+	TEST_EQUAL(e.size(), 1);
+	TEST_CHECK(e[0] == &b);
+}
+
+TORRENT_TEST(timer_wheel_random)
+{
+	std::mt19937 rng(0x1337);
+	aux::timer_wheel w(0);
+	std::vector<test_entry> entries(1000);
+	for (auto& e : entries)
+		w.schedule(e, std::int64_t(rng() % 100000));
+
+	for (std::int64_t now = 0; now <= 100000; now += std::int64_t(rng() % 200))
+	{
+		for (auto* e : advance(w, now))
+			TEST_CHECK(e->deadline() <= now && e->deadline() > now - 200);
+	}
+	advance(w, 100001);
+	for (auto const& e : entries) TEST_EQUAL(e.fired, 1);
+}
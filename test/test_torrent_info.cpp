@@ -46,6 +46,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/escape_string.hpp" // for convert_path_to_posix
 #include "libtorrent/piece_picker.hpp"
 #include "libtorrent/hex.hpp" // to_hex
+#include "libtorrent/aux_/io.hpp" // for write_uint32
 
 #include <iostream>
 
@@ -1292,3 +1293,80 @@ TORRENT_TEST(torrent_info_with_hashes_roundtrip)
 	TEST_EQUAL(out_buffer, data);
 }
 
+
+TORRENT_TEST(zip_piece_size_table)
+{
+	// span a few checkpoints, and end in the middle of one
+	int const num_pieces = 64 * 3 + 17;
+	std::string table;
+	std::vector<std::uint64_t> offsets;
+	std::uint64_t offset = 0;
+	for (int i = 0; i < num_pieces; ++i)
+	{
+		std::uint32_t const size = std::uint32_t(0x8000 + i * 1237 % 0x4000);
+		char buf[4];
+		span<char> out(buf);
+		aux::write_uint32(size, out);
+		table.append(buf, sizeof(buf));
+		offsets.push_back(offset);
+		offset += size;
+	}
+
+	zip_web_seed_entry zip;
+	zip.set_piece_size_table(table);
+	TEST_EQUAL(zip.num_pieces(), num_pieces);
+	TEST_CHECK(zip.piece_size_table() == table);
+
+	for (int i = 0; i < num_pieces; ++i)
+	{
+		auto const p = zip.piece(piece_index_t(i));
+		TEST_EQUAL(p.offset, offsets[std::size_t(i)]);
+		std::uint64_t const next = i + 1 < num_pieces ? offsets[std::size_t(i + 1)] : offset;
+		TEST_EQUAL(p.offset + p.size, next);
+	}
+}
+
+TORRENT_TEST(parse_zip_info)
+{
+	std::string table(4 * 3, '\0');
+	table[3] = 10;
+	table[7] = 20;
+	table[11] = 30;
+
+	entry e;
+	e["total size"] = 60;
+	e["level"] = 2;
+	e["pieces size"] = table;
+	e["url-list"] = "http://example.com/a.dat";
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), e);
+	error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+
+	zip_web_seed_entry zip;
+	TEST_CHECK(aux::parse_zip_info(n, 3, zip));
+	TEST_EQUAL(zip.urls.size(), 1);
+	TEST_EQUAL(zip.total_size, std::uint64_t(60));
+	TEST_CHECK(zip.codec == zip_codec::zlib);
+	TEST_EQUAL(zip.piece(piece_index_t(2)).offset, std::uint64_t(30));
+
+	// copies share the table
+	zip_web_seed_entry const copy = zip;
+	TEST_CHECK(copy.piece_size_table().data() == zip.piece_size_table().data());
+
+	// a table of the wrong size is rejected, and the entry is left as it was
+	TEST_CHECK(!aux::parse_zip_info(n, 4, zip));
+	TEST_EQUAL(zip.num_pieces(), 3);
+	TEST_EQUAL(zip.urls.size(), 1);
+
+	e["codec"] = "foobar";
+	buf.clear();
+	bencode(std::back_inserter(buf), e);
+	bdecode_node const n2 = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+	zip_web_seed_entry zip2;
+	TEST_CHECK(!aux::parse_zip_info(n2, 3, zip2));
+	TEST_EQUAL(zip2.num_pieces(), 0);
+	TEST_CHECK(zip2.urls.empty());
+}
@@ -31,6 +31,11 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/session.hpp" // for default_disk_io_constructor
+#include "libtorrent/session_params.hpp" // for disk_io_constructor_type
+#include "libtorrent/mmap_disk_io.hpp"
+#include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
+#include "libtorrent/time.hpp"
 #include "libtorrent/disk_interface.hpp"
 #include "libtorrent/settings_pack.hpp"
 #include "libtorrent/file_storage.hpp"
@@ -45,6 +50,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <algorithm>
 #include <vector>
 #include <iostream>
+#include <cstring>
 
 using disk_test_mode_t = lt::flags::bitfield_flag<std::uint8_t, struct disk_test_mode_tag>;
 
@@ -103,7 +109,8 @@ void remove_all(std::string path)
 #endif
 }
 
-int run_test(disk_test_mode_t const flags
+int run_test(lt::disk_io_constructor_type const& disk_io_constructor
+	, disk_test_mode_t const flags
 	, int const num_threads
 	, int const file_pool_size
 	, int const num_files
@@ -117,7 +124,7 @@ int run_test(disk_test_mode_t const flags
 	pack.set_int(lt::settings_pack::file_pool_size, file_pool_size);
 
 	std::unique_ptr<lt::disk_interface> disk_io
-		= lt::default_disk_io_constructor(ioc, pack, cnt);
+		= disk_io_constructor(ioc, pack, cnt);
 
 	lt::file_storage fs;
 
@@ -195,6 +202,7 @@ int run_test(disk_test_mode_t const flags
 	}
 
 	int job_counter = 0;
+	lt::time_point const start_time = lt::clock_type::now();
 
 	while (!blocks_to_write.empty()
 		|| !blocks_to_read.empty()
@@ -285,7 +293,8 @@ int run_test(disk_test_mode_t const flags
 
 	disk_io->abort(true);
 
-	std::cerr << "OK\n";
+	std::cerr << "OK (" << lt::total_milliseconds(lt::clock_type::now() - start_time)
+		<< " ms)\n";
 	return 0;
 }
 catch (std::exception const& e)
@@ -294,11 +303,47 @@ catch (std::exception const& e)
 	return 1;
 }
 
-int main(int, char const*[])
+struct backend
+{
+	char const* name;
+	lt::disk_io_constructor_type constructor;
+};
+
+int main(int argc, char const* argv[])
 {
 	// TODO: make it possible to run a test with all custom arguments from the
 	// command line
 
+	std::vector<backend> const all_backends = {
+		{"default", lt::default_disk_io_constructor},
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+		{"mmap", lt::mmap_disk_io_constructor},
+#endif
+		{"posix", lt::posix_disk_io_constructor},
+#if TORRENT_HAVE_IO_URING
+		{"io_uring", lt::io_uring_disk_io_constructor},
+#endif
+	};
+
+	// "compare" runs every test with both the mmap and the io_uring
+	// back-ends, to compare the time they take
+	std::vector<backend> backends;
+	char const* const mode = argc > 1 ? argv[1] : "default";
+	for (auto const& b : all_backends)
+	{
+		if (std::strcmp(mode, b.name) == 0
+			|| (std::strcmp(mode, "compare") == 0
+				&& (std::strcmp(b.name, "mmap") == 0 || std::strcmp(b.name, "io_uring") == 0)))
+			backends.push_back(b);
+	}
+	if (backends.empty())
+	{
+		std::cerr << "usage: disk_io_stress_test [compare";
+		for (auto const& b : all_backends) std::cerr << '|' << b.name;
+		std::cerr << "]\n";
+		return 1;
+	}
+
 	int num_files = 20;
 	int queue_size = 32;
 	int num_threads = 16;
@@ -306,12 +351,16 @@ int main(int, char const*[])
 	int file_pool_size = 10;
 
 	int ret = 0;
-	ret |= run_test(test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::read_random_order | test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::flush_files | test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+	for (auto const& b : backends)
+	{
+		std::cerr << "=== " << b.name << " ===\n";
+		auto const& c = b.constructor;
+		ret |= run_test(c, test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+		ret |= run_test(c, test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+		ret |= run_test(c, test_mode::read_random_order | test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+		ret |= run_test(c, test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+		ret |= run_test(c, test_mode::flush_files | test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+	}
 
 	return ret;
 }
-